@@ -0,0 +1,82 @@
+/**
+ * @file cwfirstpass_inc.c
+ * @brief Main interpolation computation for the first pass
+ *
+ * This file is included by cwinterp.c once for each instruction set level,
+ * with CWFIRSTPASS_FUNC defined as the name of the function to define and
+ * CWFIRSTPASS_ISA as the target, or not defined for the baseline.  The
+ * arithmetic is in fixed point, so every variant gives the same result.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/** @brief Main interpolation computation for the first pass */
+static
+#ifdef CWFIRSTPASS_ISA
+ATTRIBUTE_TARGET(CWFIRSTPASS_ISA)
+#endif
+void CWFIRSTPASS_FUNC(int32_t *Interpolation, int ScaleFactor,
+    const int32_t *Input, int InputWidth, int InputHeight,
+    const int *Stencil, const int32_t *Psi, const unsigned char *IsEdge)
+{
+    const int *StencilBase = Stencil;
+    const int32_t *PsiPtr, *SrcWindow;
+    int32_t *DestWindow;
+    
+    const int Pad = 2;
+    const int SampleRange = (NEIGHRADIUS+1)*ScaleFactor - 1;
+    const int SampleWidth = 2*SampleRange + 1;
+    
+    const int OutputWidth = ScaleFactor*InputWidth;
+    const int DestWindowJump = PIXEL_STRIDE*(OutputWidth - SampleWidth);
+    const int DestStep = PIXEL_STRIDE*ScaleFactor;
+    const int DestJump = PIXEL_STRIDE*(ScaleFactor-1)*OutputWidth + 2*Pad*DestStep;
+    const int SrcWindowJump = PIXEL_STRIDE*(InputWidth - NEIGHDIAMETER);
+    const int SrcJump = 2*PIXEL_STRIDE*Pad;
+    const int StencilJump = 2*Pad;
+    
+    int x, y, NeighX, NeighY, SampleX, SampleY;
+    int32_t cr, cg, cb;
+
+    
+    Interpolation += PIXEL_STRIDE*(Pad*ScaleFactor - SampleRange)*(1 + OutputWidth);
+    Input += PIXEL_STRIDE*(Pad - NEIGHRADIUS)*(1 + InputWidth);
+    Stencil += Pad*(1 + InputWidth);
+    
+    for(y = InputHeight - 2*Pad; y; y--,
+        Stencil += StencilJump, Input += SrcJump, Interpolation += DestJump)
+    for(x = InputWidth - 2*Pad; x; x--,
+        Stencil++, Input += PIXEL_STRIDE, Interpolation += DestStep)
+    {
+        if(IsEdge && !IsEdge[Stencil - StencilBase])
+            continue;
+        
+        PsiPtr = Psi + *Stencil;
+        SrcWindow = Input;
+        
+        for(NeighY = NEIGHDIAMETER; NeighY; NeighY--, SrcWindow += SrcWindowJump)
+        for(NeighX = NEIGHDIAMETER; NeighX; NeighX--, SrcWindow += PIXEL_STRIDE)
+        {
+            cr = SrcWindow[0];
+            cg = SrcWindow[1];
+            cb = SrcWindow[2];
+            DestWindow = Interpolation;
+            SampleY = SampleWidth;
+            
+            for(SampleY = SampleWidth; SampleY;
+                SampleY--, DestWindow += DestWindowJump, PsiPtr += SampleWidth)
+            for(SampleX = 0; SampleX < SampleWidth;
+                SampleX++, DestWindow += PIXEL_STRIDE)
+            {
+                int32_t Temp = PsiPtr[SampleX];
+                DestWindow[0] += cr * Temp;
+                DestWindow[1] += cg * Temp;
+                DestWindow[2] += cb * Temp;
+            }
+        }
+    }
+}
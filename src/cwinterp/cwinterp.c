@@ -68,6 +68,7 @@
 #include "invmat.h"
 #include "nninterp.h"
 #include "drawline.h"
+#include "cpudispatch.h"
 
 
 /** @brief The number of contour stencils, cardinality of \f$\Sigma\f$ */
@@ -95,6 +96,24 @@
 /** @brief Number of fractional bits in the output array */
 #define OUTPUT_FRACBITS		(INPUT_FRACBITS + PSI_FRACBITS)
 
+/**
+* @brief Tile size in input pixels for hybrid interpolation
+*
+* When \c cwparams::EdgeThreshold is positive, the input is classified in
+* tiles of HYBRID_TILESIZE x HYBRID_TILESIZE pixels as edge or flat.  Contour
+* stencil windowed interpolation is only applied on edge tiles.
+*/
+#define HYBRID_TILESIZE     8
+
+/**
+* @brief Tile size in input pixels for incremental interpolation
+*
+* \c CWInterpIncremental compares successive frames in tiles of
+* INCREMENTAL_TILESIZE x INCREMENTAL_TILESIZE pixels.  It must be a multiple
+* of HYBRID_TILESIZE.
+*/
+#define INCREMENTAL_TILESIZE    16
+
 /** @brief The number 1.0 in fixed-point with N fractional bits */
 #define FIXED_ONE(N)	(1 << (N))
 /** @brief The number 0.5 in fixed-point with N fractional bits */
@@ -410,6 +429,32 @@ Catch:  /* This label is used for error handling.  If something went wrong
 }
 
 
+/* Instances of the first pass for each instruction set level */
+#define CWFIRSTPASS_FUNC    CWFirstPassBaseline
+#include "cwfirstpass_inc.c"
+#undef CWFIRSTPASS_FUNC
+
+#ifdef CPUDISPATCH_TARGETS
+#define CWFIRSTPASS_FUNC    CWFirstPassSse2
+#define CWFIRSTPASS_ISA     "sse2"
+#include "cwfirstpass_inc.c"
+#undef CWFIRSTPASS_FUNC
+#undef CWFIRSTPASS_ISA
+
+#define CWFIRSTPASS_FUNC    CWFirstPassAvx2
+#define CWFIRSTPASS_ISA     "avx2"
+#include "cwfirstpass_inc.c"
+#undef CWFIRSTPASS_FUNC
+#undef CWFIRSTPASS_ISA
+
+#define CWFIRSTPASS_FUNC    CWFirstPassAvx512
+#define CWFIRSTPASS_ISA     "avx512f"
+#include "cwfirstpass_inc.c"
+#undef CWFIRSTPASS_FUNC
+#undef CWFIRSTPASS_ISA
+#endif
+
+
 /**
 * @brief Main interpolation computation for the first pass
 * @param Interpolation pointer where to store the result
@@ -418,67 +463,43 @@ Catch:  /* This label is used for error handling.  If something went wrong
 * @param InputWidth, InputHeight dimensions of the input image
 * @param Stencil pointer to the selected stencils
 * @param Sample array of precomputed w*psi samples
+* @param IsEdge edge classification of each input pixel, or NULL
 *
 * This is the main computation for refinement passes: it adds to the
 * interpolation
 * \f[ u(x) = \sum_{k\in\mathbb{Z}^2} w(x - k) \Bigl[ v_k +
 *     \sum_{n\in\mathcal{N}\backslash\{0\}} (v_{k+n} - v_k)
 *     \psi^n_{\mathcal{S}^\star(k)}(x - k) \Bigr]. \f]
+* If \c IsEdge is not NULL, the sum is only over k where IsEdge[k] is
+* nonzero (see \c CWCubicPass).
+*
+* The variant for the instruction set level of the CPU is selected with
+* \c GetCpuLevel, see cwfirstpass_inc.c.
 */
-static void CWFirstPass(int32_t *Interpolation, int ScaleFactor, const int32_t *Input,
-    int InputWidth, int InputHeight, const int *Stencil, const int32_t *Psi)
+static void CWFirstPass(int32_t *Interpolation, int ScaleFactor,
+    const int32_t *Input, int InputWidth, int InputHeight,
+    const int *Stencil, const int32_t *Psi, const unsigned char *IsEdge)
 {
-    const int32_t *PsiPtr, *SrcWindow;
-    int32_t *DestWindow;
-    
-    const int Pad = 2;
-    const int SampleRange = (NEIGHRADIUS+1)*ScaleFactor - 1;
-    const int SampleWidth = 2*SampleRange + 1;
-    
-    const int OutputWidth = ScaleFactor*InputWidth;
-    const int DestWindowJump = PIXEL_STRIDE*(OutputWidth - SampleWidth);
-    const int DestStep = PIXEL_STRIDE*ScaleFactor;
-    const int DestJump = PIXEL_STRIDE*(ScaleFactor-1)*OutputWidth + 2*Pad*DestStep;
-    const int SrcWindowJump = PIXEL_STRIDE*(InputWidth - NEIGHDIAMETER);
-    const int SrcJump = 2*PIXEL_STRIDE*Pad;
-    const int StencilJump = 2*Pad;
-    
-    int x, y, NeighX, NeighY, SampleX, SampleY;
-    int32_t cr, cg, cb;
-
-    
-    Interpolation += PIXEL_STRIDE*(Pad*ScaleFactor - SampleRange)*(1 + OutputWidth);
-    Input += PIXEL_STRIDE*(Pad - NEIGHRADIUS)*(1 + InputWidth);
-    Stencil += Pad*(1 + InputWidth);
-    
-    for(y = InputHeight - 2*Pad; y; y--,
-        Stencil += StencilJump, Input += SrcJump, Interpolation += DestJump)
-    for(x = InputWidth - 2*Pad; x; x--,
-        Stencil++, Input += PIXEL_STRIDE, Interpolation += DestStep)
+    switch(GetCpuLevel())
     {
-        PsiPtr = Psi + *Stencil;
-        SrcWindow = Input;
-        
-        for(NeighY = NEIGHDIAMETER; NeighY; NeighY--, SrcWindow += SrcWindowJump)
-        for(NeighX = NEIGHDIAMETER; NeighX; NeighX--, SrcWindow += PIXEL_STRIDE)
-        {
-            cr = SrcWindow[0];
-            cg = SrcWindow[1];
-            cb = SrcWindow[2];
-            DestWindow = Interpolation;
-            SampleY = SampleWidth;
-            
-            for(SampleY = SampleWidth; SampleY;
-                SampleY--, DestWindow += DestWindowJump, PsiPtr += SampleWidth)
-            for(SampleX = 0; SampleX < SampleWidth;
-                SampleX++, DestWindow += PIXEL_STRIDE)
-            {
-                int32_t Temp = PsiPtr[SampleX];
-                DestWindow[0] += cr * Temp;
-                DestWindow[1] += cg * Temp;
-                DestWindow[2] += cb * Temp;
-            }
-        }
+#ifdef CPUDISPATCH_TARGETS
+    case CPU_AVX512:
+        CWFirstPassAvx512(Interpolation, ScaleFactor, Input,
+            InputWidth, InputHeight, Stencil, Psi, IsEdge);
+        break;
+    case CPU_AVX2:
+        CWFirstPassAvx2(Interpolation, ScaleFactor, Input,
+            InputWidth, InputHeight, Stencil, Psi, IsEdge);
+        break;
+    case CPU_SSE2:
+        CWFirstPassSse2(Interpolation, ScaleFactor, Input,
+            InputWidth, InputHeight, Stencil, Psi, IsEdge);
+        break;
+#endif
+    default:
+        CWFirstPassBaseline(Interpolation, ScaleFactor, Input,
+            InputWidth, InputHeight, Stencil, Psi, IsEdge);
+        break;
     }
 }
 
@@ -491,18 +512,22 @@ static void CWFirstPass(int32_t *Interpolation, int ScaleFactor, const int32_t *
 * @param InputWidth, InputHeight dimensions of the input image
 * @param Stencil pointer to the selected stencils
 * @param Sample array of precomputed w*psi samples
+* @param IsEdge edge classification of each input pixel, or NULL
 *
 * This is the main computation for refinement passes: it adds to the
 * interpolation
 * \f[ u(x) = u(x) + \sum_{k\in\mathbb{Z}^2} w(x - k) \Bigl[ r_k +
 *     \sum_{n\in\mathcal{N}\backslash\{0\}} (r_{k+n} - r_k)
 *     \psi^n_{\mathcal{S}^\star(k)}(x - k) \Bigr]. \f]
+* If \c IsEdge is not NULL, the sum is only over k where IsEdge[k] is
+* nonzero.
 */
 static void CWRefinementPass(int32_t *Interpolation, int ScaleFactor,
     const int32_t *Residual, int InputWidth, int InputHeight,
-    const int *Stencil, const int32_t *Sample)
+    const int *Stencil, const int32_t *Sample, const unsigned char *IsEdge)
 {
     const int Pad = 4;
+    const int *StencilBase = Stencil;
 
     const int32_t *SamplePtr, *SrcWindow;
     int32_t *DestWindow;
@@ -531,6 +556,9 @@ static void CWRefinementPass(int32_t *Interpolation, int ScaleFactor,
     for(x = InputWidth - 2*Pad; x; x--,
         Stencil++, Residual += PIXEL_STRIDE, Interpolation += DestStep)
     {
+        if(IsEdge && !IsEdge[Stencil - StencilBase])
+            continue;
+        
         SamplePtr = Sample + *Stencil;
         SrcWindow = Residual;
         
@@ -603,7 +631,7 @@ static int32_t CWResidual(int32_t *Residual, const int32_t *Interpolation,
     float *Temp = NULL, *PsfBuf = NULL;
     float ExpDenom, Weight, Sum[3], DenomSum;
     float XStart, YStart, X, Y;
-    int IndexX0, IndexY0, SrcOffset, DestOffset;
+    int IndexX0, IndexY0, IndexOffset, SrcOffset, DestOffset;
     int x, y, i, n, c, Success = 0;
     int x1, x2;
     int32_t ResNorm = 0;
@@ -629,14 +657,18 @@ static int32_t CWResidual(int32_t *Residual, const int32_t *Interpolation,
     if(Pad < ScaleFactor)
         Pad = ScaleFactor;
     
+    /* Evaluate the PSF.  The samples are the same for every x, which also
+    makes the residual invariant to translations of the image by whole
+    pixels (as relied on by CWInterpIncremental). */
+    X = -XStart*ScaleFactor;
+    IndexOffset = (int)ceil(X - PsfRadius);
+    
+    for(n = 0; n < PsfWidth; n++)
+        PsfBuf[n] = (float)exp(-Sqr(X - (IndexOffset + n)) / ExpDenom);
+    
     for(x = 0; x < CoarseWidth; x++)
     {
-        X = (-XStart + x)*ScaleFactor;
-        IndexX0 = (int)ceil(X - PsfRadius);
-        
-        /* Evaluate the PSF */
-        for(n = 0; n < PsfWidth; n++)
-            PsfBuf[n] = (float)exp(-Sqr(X - (IndexX0 + n)) / ExpDenom);
+        IndexX0 = ScaleFactor*x + IndexOffset;
         
         for(y = 0, SrcOffset = 0, DestOffset = 3*x; y < InterpHeight;
             y++, SrcOffset += InterpWidth, DestOffset += CoarseStride)
@@ -660,6 +692,11 @@ static int32_t CWResidual(int32_t *Residual, const int32_t *Interpolation,
     
     x1 = 3*Pad;
     x2 = CoarseStride - 3*Pad;
+    Y = -YStart*ScaleFactor;
+    IndexOffset = (int)ceil(Y - PsfRadius);
+    
+    for(n = 0; n < PsfWidth; n++)
+        PsfBuf[n] = (float)exp(-Sqr(Y - (IndexOffset + n)) / ExpDenom);
     
     for(y = 0; y < CoarseHeight; y++,
         Residual += CoarseStride, Input += CoarseStride)
@@ -667,12 +704,7 @@ static int32_t CWResidual(int32_t *Residual, const int32_t *Interpolation,
         if(!(y >= Pad && y < CoarseHeight-Pad))
             continue;
         
-        Y = (-YStart + y)*ScaleFactor;
-        IndexY0 = (int)ceil(Y - PsfRadius);
-            
-        /* Evaluate the PSF */
-        for(n = 0; n < PsfWidth; n++)
-            PsfBuf[n] = (float)exp(-Sqr(Y - (IndexY0 + n)) / ExpDenom);
+        IndexY0 = ScaleFactor*y + IndexOffset;
                 
         for(x = x1; x < x2; x += 3)
         {
@@ -709,6 +741,245 @@ Catch:
 }
 
 
+/** @brief Keys cubic convolution kernel with a = -0.5 */
+static float CubicKernel(float x)
+{
+    x = (float)fabs(x);
+    
+    if(x < 1)
+        return (1.5f*x - 2.5f)*x*x + 1;
+    else if(x < 2)
+        return ((-0.5f*x + 2.5f)*x - 4)*x + 2;
+    else
+        return 0;
+}
+
+
+/**
+* @brief Classify input tiles as edge or flat
+*
+* @param IsEdge pointer to array of size Width by Height to be filled with
+*        the classification of each pixel
+* @param Image the input RGB fixed-point image
+* @param Width, Height image dimensions
+* @param Threshold fixed-point threshold on the pixel differences
+* @return fraction of pixels classified as edge
+*
+* The image is divided into tiles of HYBRID_TILESIZE x HYBRID_TILESIZE
+* pixels.  A tile is edge if the absolute difference between any two
+* horizontally or vertically adjacent pixels within the tile or within
+* NEIGHRADIUS + 1 pixels of the tile exceeds Threshold in some channel.  The
+* margin ensures that the windows of pixels near a contour are treated as
+* edge even if the contour lies in the neighboring tile.
+*/
+static double ClassifyTiles(unsigned char *IsEdge, const int32_t *Image,
+    int Width, int Height, int32_t Threshold)
+{
+    const int Margin = NEIGHRADIUS + 1;
+    const int Stride = PIXEL_STRIDE*Width;
+    const int32_t *Ptr;
+    long NumEdge = 0;
+    int x, y, tx, ty, x1, x2, y1, y2, c, Edge;
+    
+    
+    for(ty = 0; ty < Height; ty += HYBRID_TILESIZE)
+        for(tx = 0; tx < Width; tx += HYBRID_TILESIZE)
+        {
+            x1 = (tx - Margin > 0) ? tx - Margin : 0;
+            y1 = (ty - Margin > 0) ? ty - Margin : 0;
+            x2 = (tx + HYBRID_TILESIZE + Margin < Width) ?
+                tx + HYBRID_TILESIZE + Margin : Width;
+            y2 = (ty + HYBRID_TILESIZE + Margin < Height) ?
+                ty + HYBRID_TILESIZE + Margin : Height;
+            
+            for(y = y1, Edge = 0; y < y2 && !Edge; y++)
+                for(x = x1; x < x2 && !Edge; x++)
+                {
+                    Ptr = Image + PIXEL_STRIDE*x + Stride*y;
+                    
+                    for(c = 0; c < PIXEL_STRIDE; c++)
+                        if((x < x2 - 1
+                            && abs(Ptr[c + PIXEL_STRIDE] - Ptr[c]) > Threshold)
+                            || (y < y2 - 1
+                            && abs(Ptr[c + Stride] - Ptr[c]) > Threshold))
+                            Edge = 1;
+                }
+            
+            x2 = (tx + HYBRID_TILESIZE < Width) ?
+                tx + HYBRID_TILESIZE : Width;
+            y2 = (ty + HYBRID_TILESIZE < Height) ?
+                ty + HYBRID_TILESIZE : Height;
+            
+            for(y = ty; y < y2; y++)
+                for(x = tx; x < x2; x++)
+                    IsEdge[x + Width*y] = (unsigned char)Edge;
+            
+            if(Edge)
+                NumEdge += ((long)(x2 - tx))*((long)(y2 - ty));
+        }
+    
+    return NumEdge / (((double)Width)*((double)Height));
+}
+
+
+/**
+* @brief Sum the windows of edge pixels
+*
+* @param WeightSum array to accumulate into, with the dimensions of the
+*        interpolation (should be initialized to zero)
+* @param ScaleFactor the interpolation scale factor
+* @param InputWidth, InputHeight dimensions of the input image
+* @param IsEdge edge classification of each input pixel
+* @param Window array of window samples w(x) in fixed-point with
+*        PSI_FRACBITS fractional bits
+*
+* Computes \f$ W(x) = \sum_{k: \mathrm{IsEdge}[k]} w(x - k) \f$ over the same
+* pixels k as \c CWFirstPass.  Since the window translates sum to one, the
+* flat pixels contribute with total weight 1 - W(x).
+*/
+static void CWWindowWeights(int32_t *WeightSum, int ScaleFactor,
+    int InputWidth, int InputHeight, const unsigned char *IsEdge,
+    const int32_t *Window)
+{
+    const int Pad = 2;
+    const int SampleRange = (NEIGHRADIUS+1)*ScaleFactor - 1;
+    const int SampleWidth = 2*SampleRange + 1;
+    const int OutputWidth = ScaleFactor*InputWidth;
+    const int32_t *WindowPtr;
+    int32_t *DestWindow;
+    int x, y, SampleX, SampleY;
+    
+    
+    for(y = Pad; y < InputHeight - Pad; y++)
+        for(x = Pad; x < InputWidth - Pad; x++)
+            if(IsEdge[x + InputWidth*y])
+            {
+                DestWindow = WeightSum + (ScaleFactor*x - SampleRange)
+                    + OutputWidth*(ScaleFactor*y - SampleRange);
+                WindowPtr = Window;
+                
+                for(SampleY = SampleWidth; SampleY; SampleY--,
+                    DestWindow += OutputWidth, WindowPtr += SampleWidth)
+                    for(SampleX = 0; SampleX < SampleWidth; SampleX++)
+                        DestWindow[SampleX] += WindowPtr[SampleX];
+            }
+}
+
+
+/**
+* @brief Add cubic interpolation where the flat pixels have weight
+*
+* @param Interpolation pointer to where interpolation is stored
+* @param ScaleFactor the interpolation scale factor
+* @param Input pointer to the input (or residual) RGB fixed-point image
+* @param InputWidth, InputHeight dimensions of the input image
+* @param WeightSum the summed windows of edge pixels from \c CWWindowWeights
+* @param CenteredGrid if nonzero, use the centered grid
+* @return 1 on success, 0 on failure
+*
+* Adds \f$ (1 - W(x)) \tilde v(x) \f$ to the interpolation, where
+* \f$ \tilde v \f$ is the separable cubic convolution interpolation of the
+* input and \f$ W \f$ is the sum of windows of edge pixels.  Together with
+* \c CWFirstPass restricted to edge pixels, this computes
+* \f[ u(x) = \sum_{k\,\mathrm{edge}} w(x - k) \bigl[ \cdots \bigr]
+*     + \sum_{k\,\mathrm{flat}} w(x - k) \, \tilde v(x), \f]
+* so the two methods are blended by the same smooth window that joins the
+* local reconstructions and there are no seams between tiles.  Pixels where
+* W(x) = 1 are skipped in the vertical pass.
+*/
+static int CWCubicPass(int32_t *Interpolation, int ScaleFactor,
+    const int32_t *Input, int InputWidth, int InputHeight,
+    const int32_t *WeightSum, int CenteredGrid)
+{
+    const int OutputWidth = ScaleFactor*InputWidth;
+    const int OutputHeight = ScaleFactor*InputHeight;
+    const float Start = (CenteredGrid) ? (1.0f/ScaleFactor - 1)/2 : 0;
+    float *Temp = NULL, *Coeff = NULL, *TempPtr, Sum[3], Weight, FlatWeight;
+    const int32_t *Src;
+    int *Offset = NULL;
+    int x, y, p, q, i, t, c, Success = 0;
+    
+    
+    if(!(Temp = (float *)Malloc(sizeof(float)*3*OutputWidth*InputHeight))
+        || !(Coeff = (float *)Malloc(sizeof(float)*4*ScaleFactor))
+        || !(Offset = (int *)Malloc(sizeof(int)*ScaleFactor)))
+        goto Catch;
+    
+    /* Precompute the cubic weights for each phase */
+    for(p = 0; p < ScaleFactor; p++)
+    {
+        Offset[p] = (int)floor(Start + ((float)p)/ScaleFactor);
+        
+        for(t = 0; t < 4; t++)
+            Coeff[4*p + t] = CubicKernel(Start + ((float)p)/ScaleFactor
+                - (Offset[p] + t - 1));
+    }
+    
+    /* Interpolate the rows */
+    for(y = 0, TempPtr = Temp; y < InputHeight; y++)
+    {
+        Src = Input + PIXEL_STRIDE*InputWidth*y;
+        
+        for(q = 0; q < InputWidth; q++)
+            for(p = 0; p < ScaleFactor; p++, TempPtr += 3)
+            {
+                Sum[0] = Sum[1] = Sum[2] = 0;
+                
+                for(t = 0; t < 4; t++)
+                {
+                    i = PIXEL_STRIDE*ConstExtension(InputWidth,
+                        q + Offset[p] + t - 1);
+                    Weight = Coeff[4*p + t];
+                    
+                    for(c = 0; c < 3; c++)
+                        Sum[c] += Weight * Src[i + c];
+                }
+                
+                for(c = 0; c < 3; c++)
+                    TempPtr[c] = Sum[c];
+            }
+    }
+    
+    /* Interpolate the columns and blend */
+    for(y = 0; y < OutputHeight; y++)
+    {
+        q = y / ScaleFactor;
+        p = y % ScaleFactor;
+        
+        for(x = 0; x < OutputWidth; x++, Interpolation += PIXEL_STRIDE)
+        {
+            FlatWeight = (float)(FIXED_ONE(PSI_FRACBITS)
+                - WeightSum[x + OutputWidth*y]);
+            
+            if(FlatWeight <= 0)
+                continue;
+            
+            Sum[0] = Sum[1] = Sum[2] = 0;
+            
+            for(t = 0; t < 4; t++)
+            {
+                TempPtr = Temp + 3*(x + OutputWidth*ConstExtension(InputHeight,
+                    q + Offset[p] + t - 1));
+                Weight = Coeff[4*p + t];
+                
+                for(c = 0; c < 3; c++)
+                    Sum[c] += Weight * TempPtr[c];
+            }
+            
+            for(c = 0; c < 3; c++)
+                Interpolation[c] += (int32_t)ROUNDF(FlatWeight * Sum[c]);
+        }
+    }
+    
+    Success = 1;
+Catch:
+    Free(Offset);
+    Free(Coeff);
+    Free(Temp);
+    return Success;
+}
+
+
 /**
 * @brief Simultaneously pad and convert to RGB fixed-point image
 *
@@ -835,6 +1106,11 @@ static void ConvertOutput(uint32_t *Output, int OutputWidth, int OutputHeight,
 }
 
 
+static int CWInterpCore(uint32_t *Output, const uint32_t *Input,
+    int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param,
+    int Verbose, unsigned long TimeLimit, double *ResidualNorm);
+
+
 /**
 * @brief Contour stencil windowed interpolation
 *
@@ -843,19 +1119,62 @@ static void ConvertOutput(uint32_t *Output, int OutputWidth, int OutputHeight,
 * @param InputWidth, InputHeight input image dimensions
 * @param Psi \f$\psi\f$ samples computed by \c PreCWInterp
 * @param Param cwparams struct of interpolation parameters
+*
+* If Param.EdgeThreshold is positive, the hybrid mode is used: the input is
+* classified in tiles by \c ClassifyTiles, contour stencil windowed
+* interpolation is applied only on edge tiles, and flat tiles are filled by
+* cubic convolution interpolation (\c CWCubicPass) blended with the window.
 */
 int CWInterp(uint32_t *Output, const uint32_t *Input,
     int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param)
+{
+    return CWInterpCore(Output, Input, InputWidth, InputHeight, Psi, Param,
+        Param.Verbose, 0, NULL);
+}
+
+
+/**
+* @brief Contour stencil windowed interpolation with a time limit
+*
+* @param TimeLimit time limit in milliseconds, or 0 for no limit
+* @param ResidualNorm if non-NULL, set to the residual norm of the output
+*
+* @return 0 on failure, 1 on success, 2 if stopped by the time limit
+*
+* This is CWInterp() skipping the remaining refinement passes once TimeLimit
+* milliseconds have passed since the start of the computation.  The clock is
+* checked before each refinement pass, so the first interpolation pass is
+* always done and the limit may be exceeded by about one pass.  Computing
+* ResidualNorm costs one more residual evaluation after the interpolation.
+* The other parameters are as in CWInterp().
+*/
+int CWInterpTimed(uint32_t *Output, const uint32_t *Input,
+    int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param,
+    unsigned long TimeLimit, double *ResidualNorm)
+{
+    return CWInterpCore(Output, Input, InputWidth, InputHeight, Psi, Param,
+        Param.Verbose, TimeLimit, ResidualNorm);
+}
+
+
+/** @brief CWInterpTimed with optional printing of the residuals and timing */
+static int CWInterpCore(uint32_t *Output, const uint32_t *Input,
+    int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param,
+    int Verbose, unsigned long TimeLimit, double *ResidualNorm)
 {
     const int ScaleFactor = (int)ceil(Param.ScaleFactor);
     const int SupportRadius = (NEIGHRADIUS+1)*ScaleFactor - 1;
     const int SupportWidth = 2*SupportRadius + 1;
     const int SupportSize = SupportWidth*SupportWidth;
     const int StencilMul = NUMNEIGH*SupportSize;
+    const int Hybrid = (Param.EdgeThreshold > 0);
     int *Stencil = NULL;
+    unsigned char *IsEdge = NULL;
     int32_t *InputFixed = NULL, *OutputFixed = NULL, *Residual = NULL;
+    int32_t *Window = NULL, *WeightSum = NULL;
     unsigned long StartTime, StopTime;
-    int i, PadInput, pw, ph, Success = 0;
+    double EdgeFraction;
+    int i, m, PadInput, pw, ph, TimedOut = 0, Success = 0;
     int32_t ResNorm;
     
     
@@ -871,7 +1190,11 @@ int CWInterp(uint32_t *Output, const uint32_t *Input,
             PIXEL_STRIDE*pw*ScaleFactor*ph*ScaleFactor))
         || !(InputFixed = (int32_t *)Malloc(sizeof(int32_t)*PIXEL_STRIDE*pw*ph))
         || !(Residual = (int32_t *)Malloc(sizeof(int32_t)*PIXEL_STRIDE*pw*ph))
-        || !(Stencil = (int *)Malloc(sizeof(int)*pw*ph)) )
+        || !(Stencil = (int *)Malloc(sizeof(int)*pw*ph))
+        || (Hybrid && (!(IsEdge = (unsigned char *)Malloc(pw*ph))
+        || !(Window = (int32_t *)Malloc(sizeof(int32_t)*SupportSize))
+        || !(WeightSum = (int32_t *)Malloc(sizeof(int32_t)*
+            pw*ScaleFactor*ph*ScaleFactor)))) )
         goto Catch;
 
     /* Start timing */
@@ -881,30 +1204,66 @@ int CWInterp(uint32_t *Output, const uint32_t *Input,
     ConvertInput(InputFixed, Input, InputWidth, InputHeight, PadInput);
     
     /* Select the best-fitting contour stencils */
-    if(!FitStencils(Stencil, InputFixed, pw, ph, StencilMul))
+    if(!FitStencils(Stencil, InputFixed, pw, ph, StencilMul, NULL))
         goto Catch;
     
     memset(OutputFixed, 0, sizeof(int32_t)*
         3*pw*ScaleFactor*ph*ScaleFactor);
     memset(Residual, 0, sizeof(int32_t)*3*pw*ph);
     
-    printf("\n  Iteration   Residual norm\n  -------------------------\n");
+    if(Hybrid)
+    {
+        EdgeFraction = ClassifyTiles(IsEdge, InputFixed, pw, ph,
+            (int32_t)ROUND(Param.EdgeThreshold*FIXED_ONE(INPUT_FRACBITS)));
+        
+        /* The window samples are the sum over the neighborhood of psi */
+        for(i = 0; i < SupportSize; i++)
+            for(m = 0, Window[i] = 0; m < NUMNEIGH; m++)
+                Window[i] += Psi[i + SupportSize*m];
+        
+        memset(WeightSum, 0, sizeof(int32_t)*pw*ScaleFactor*ph*ScaleFactor);
+        CWWindowWeights(WeightSum, ScaleFactor, pw, ph, IsEdge, Window);
+        
+        if(Verbose)
+            printf("\n  Hybrid interpolation, %.1f%% edge pixels\n",
+                100*EdgeFraction);
+    }
+    
+    if(Verbose)
+        printf("\n  Iteration   Residual norm\n  -------------------------\n");
     
     /* First interpolation pass */
-    CWFirstPass(OutputFixed, ScaleFactor, InputFixed, pw, ph, Stencil, Psi);
+    CWFirstPass(OutputFixed, ScaleFactor, InputFixed, pw, ph, Stencil, Psi,
+        IsEdge);
+    
+    if(Hybrid && !CWCubicPass(OutputFixed, ScaleFactor, InputFixed, pw, ph,
+        WeightSum, Param.CenteredGrid))
+        goto Catch;
     
     /* Iterative refinement */
     for(i = 1; i <= Param.RefinementSteps; i++)
     {
+        if(TimeLimit > 0 && Clock() - StartTime >= TimeLimit)
+        {
+            TimedOut = 1;
+            break;
+        }
+        
         /* Compute the residual */
         if((ResNorm = CWResidual(Residual, OutputFixed, InputFixed,
             pw, ph, Param)) < 0.0)
             goto Catch;
         
-        printf("  %8d %15.8f\n", i, ResNorm/(255.0*256.0));
+        if(Verbose)
+            printf("  %8d %15.8f\n", i, ResNorm/(255.0*256.0));
         
         /* Interpolation refinement pass */
-        CWRefinementPass(OutputFixed, ScaleFactor, Residual, pw, ph, Stencil, Psi);
+        CWRefinementPass(OutputFixed, ScaleFactor, Residual, pw, ph,
+            Stencil, Psi, IsEdge);
+        
+        if(Hybrid && !CWCubicPass(OutputFixed, ScaleFactor, Residual, pw, ph,
+            WeightSum, Param.CenteredGrid))
+            goto Catch;
     }
     
     /* Convert output integer array to 32-bit RGBA */
@@ -915,20 +1274,39 @@ int CWInterp(uint32_t *Output, const uint32_t *Input,
     /* The final interpolation is now complete, stop timing. */
     StopTime = Clock();
 
-    /* Compute the residual norm of the final interpolation.  This
-    computation is not included in the CPU timing since it is for
-    information purposes only. */
-    ResNorm = CWResidual(Residual, OutputFixed, InputFixed, pw, ph, Param);
-    printf("  %8d %15.8f\n\n", Param.RefinementSteps + 1, ResNorm/(255.0*256.0));
+    if(Verbose || ResidualNorm)
+    {
+        /* Compute the residual norm of the final interpolation.  This
+        computation is not included in the CPU timing since it is for
+        information purposes only. */
+        if((ResNorm = CWResidual(Residual, OutputFixed, InputFixed,
+            pw, ph, Param)) < 0.0)
+            goto Catch;
+        
+        if(ResidualNorm)
+            *ResidualNorm = ResNorm/(255.0*256.0);
+    }
     
-    /* Display the CPU time spent performing the interpolation. */
-    printf("  CPU time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    if(Verbose)
+    {
+        printf("  %8d %15.8f\n\n", i, ResNorm/(255.0*256.0));
+        
+        if(TimedOut)
+            printf("  Time limit reached after %d refinement passes\n\n",
+                i - 1);
+        
+        /* Display the CPU time spent performing the interpolation. */
+        printf("  CPU time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    }
 
-    Success = 1;
+    Success = (TimedOut) ? 2 : 1;
     
 Catch:  /* This label is used for error handling.  If something went wrong
         above (which may be out of memory or a computation error), then
         execution jumps to this point to clean up and exit. */
+    Free(WeightSum);
+    Free(Window);
+    Free(IsEdge);
     Free(Stencil);
     Free(Residual);
     Free(InputFixed);
@@ -962,20 +1340,245 @@ Catch:  /* This label is used for error handling.  If something went wrong
 #define ROUND_FIXED(X,N)    (((X) + FIXED_HALF(N)) >> (N))
 #define FLOAT_TO_FIXED(X,N) ((int32_t)ROUND((X) * FIXED_ONE(N)))
     
-/** @brief Arbitrary scale factor interpolation */
+/**
+* @brief Radius in input pixels over which CWInterp depends on the input
+*
+* @param Param cwparams struct of interpolation parameters
+*
+* An interpolated pixel at x only depends on input pixels within this
+* distance of x/ScaleFactor.  Stencils are fit from differences filtered by
+* a 3x3 filter (radius 2), each pass adds the windows over the 3x3
+* neighborhood (radius 2 + NEIGHRADIUS), and each residual depends on the
+* interpolation over the PSF support.  In hybrid mode, the tile
+* classification adds up to a tile plus its margin.
+*/
+static int CWDependencyRadius(cwparams Param)
+{
+    const int PassRadius = 2 + NEIGHRADIUS;
+    int Radius = 2 + PassRadius;
+    
+    
+    if(Param.EdgeThreshold > 0)
+        Radius += HYBRID_TILESIZE + NEIGHRADIUS + 2;
+    
+    if(Param.PsfSigma != 0.0)
+        Radius += Param.RefinementSteps*(PassRadius
+            + (int)ceil(4*Param.PsfSigma) + 1);
+    
+    return Radius;
+}
+
+
+/** @brief Test whether the RGB components of two image regions differ */
+static int RegionDiffers(const uint32_t *A, const uint32_t *B,
+    int Width, int x1, int y1, int x2, int y2)
+{
+    const uint8_t *APtr, *BPtr;
+    int x, y;
+    
+    
+    for(y = y1; y < y2; y++)
+    {
+        APtr = (const uint8_t *)(A + x1 + Width*y);
+        BPtr = (const uint8_t *)(B + x1 + Width*y);
+        
+        for(x = x1; x < x2; x++, APtr += 4, BPtr += 4)
+            if(APtr[0] != BPtr[0] || APtr[1] != BPtr[1] || APtr[2] != BPtr[2])
+                return 1;
+    }
+    
+    return 0;
+}
+
+
+/**
+* @brief Contour stencil windowed interpolation of a frame in a sequence
+*
+* @param Output pointer to the interpolation of PrevInput, overwritten with
+*        the interpolation of Input
+* @param Input the input image
+* @param PrevInput the previous input image, or NULL
+* @param InputWidth, InputHeight input image dimensions
+* @param Psi \f$\psi\f$ samples computed by \c PreCWInterp
+* @param Param cwparams struct of interpolation parameters
+* @return 1 on success, 0 on failure
+*
+* For video where most of each frame is unchanged, this routine updates the
+* interpolation of the previous frame rather than recomputing it.  Input
+* and PrevInput are compared in tiles of INCREMENTAL_TILESIZE pixels.  Tiles
+* within \c CWDependencyRadius of a changed tile are marked for update, and
+* each rectangle of marked tiles (a horizontal run, merged with identical
+* runs in the following rows) is interpolated with \c CWInterp on a crop
+* extended by the dependency radius.  Since the interpolation is local
+* and invariant to translations, the result is identical to calling
+* \c CWInterp on the whole frame.  Output must have been computed with the
+* same Psi and Param.  If PrevInput is NULL, the whole frame is interpolated.
+*/
+int CWInterpIncremental(uint32_t *Output, const uint32_t *Input,
+    const uint32_t *PrevInput, int InputWidth, int InputHeight,
+    const int32_t *Psi, cwparams Param)
+{
+    const int ScaleFactor = (int)ceil(Param.ScaleFactor);
+    const int OutputWidth = ScaleFactor*InputWidth;
+    const int NumTilesX = (InputWidth + INCREMENTAL_TILESIZE - 1)
+        / INCREMENTAL_TILESIZE;
+    const int NumTilesY = (InputHeight + INCREMENTAL_TILESIZE - 1)
+        / INCREMENTAL_TILESIZE;
+    unsigned char *Dirty = NULL, *Update = NULL;
+    uint32_t *CropInput = NULL, *CropOutput = NULL;
+    unsigned long StartTime, StopTime;
+    int Radius, TileRadius, NumUpdate = 0, Success = 0;
+    int tx, ty, tx2, ty2, i, j, x1, x2, y1, y2, cx1, cx2, cy1, cy2, cw, ch, y;
+    
+    
+    if(!PrevInput)
+        return CWInterp(Output, Input, InputWidth, InputHeight, Psi, Param);
+    
+    Radius = CWDependencyRadius(Param);
+    
+    /* Round the radius up so that crops are aligned with the hybrid tiles */
+    if(Param.EdgeThreshold > 0)
+        Radius = HYBRID_TILESIZE*((Radius + HYBRID_TILESIZE - 1)
+            / HYBRID_TILESIZE);
+
+    TileRadius = (Radius + INCREMENTAL_TILESIZE - 1)/INCREMENTAL_TILESIZE;
+    
+    if(!(Dirty = (unsigned char *)Malloc(NumTilesX*NumTilesY))
+        || !(Update = (unsigned char *)Malloc(NumTilesX*NumTilesY))
+        || !(CropInput = (uint32_t *)Malloc(sizeof(uint32_t)*
+            InputWidth*InputHeight))
+        || !(CropOutput = (uint32_t *)Malloc(sizeof(uint32_t)*
+            ScaleFactor*InputWidth*ScaleFactor*InputHeight)))
+        goto Catch;
+    
+    StartTime = Clock();
+    
+    for(ty = 0; ty < NumTilesY; ty++)
+        for(tx = 0; tx < NumTilesX; tx++)
+        {
+            x1 = INCREMENTAL_TILESIZE*tx;
+            y1 = INCREMENTAL_TILESIZE*ty;
+            Dirty[tx + NumTilesX*ty] = (unsigned char)RegionDiffers(
+                Input, PrevInput, InputWidth, x1, y1,
+                (x1 + INCREMENTAL_TILESIZE < InputWidth) ?
+                    x1 + INCREMENTAL_TILESIZE : InputWidth,
+                (y1 + INCREMENTAL_TILESIZE < InputHeight) ?
+                    y1 + INCREMENTAL_TILESIZE : InputHeight);
+        }
+    
+    /* Dilate the changed tiles by the dependency radius */
+    for(ty = 0; ty < NumTilesY; ty++)
+        for(tx = 0; tx < NumTilesX; tx++)
+        {
+            Update[tx + NumTilesX*ty] = 0;
+            
+            for(j = ty - TileRadius; j <= ty + TileRadius; j++)
+                for(i = tx - TileRadius; i <= tx + TileRadius; i++)
+                    if(i >= 0 && i < NumTilesX && j >= 0 && j < NumTilesY
+                        && Dirty[i + NumTilesX*j])
+                        Update[tx + NumTilesX*ty] = 1;
+            
+            NumUpdate += Update[tx + NumTilesX*ty];
+        }
+    
+    for(ty = 0; ty < NumTilesY; ty++)
+        for(tx = 0; tx < NumTilesX; tx = tx2)
+        {
+            if(!Update[tx + NumTilesX*ty])
+            {
+                tx2 = tx + 1;
+                continue;
+            }
+            
+            /* Find the run of tiles tx <= i < tx2 to update */
+            for(tx2 = tx + 1; tx2 < NumTilesX
+                && Update[tx2 + NumTilesX*ty]; tx2++)
+                ;
+            
+            /* Merge the same run in the following rows, ty <= j < ty2 */
+            for(ty2 = ty + 1; ty2 < NumTilesY; ty2++)
+            {
+                for(i = tx; i < tx2 && Update[i + NumTilesX*ty2]; i++)
+                    ;
+                
+                if(i < tx2 || (tx > 0 && Update[tx - 1 + NumTilesX*ty2])
+                    || (tx2 < NumTilesX && Update[tx2 + NumTilesX*ty2]))
+                    break;
+                
+                for(i = tx; i < tx2; i++)
+                    Update[i + NumTilesX*ty2] = 0;
+            }
+            
+            x1 = INCREMENTAL_TILESIZE*tx;
+            y1 = INCREMENTAL_TILESIZE*ty;
+            x2 = (INCREMENTAL_TILESIZE*tx2 < InputWidth) ?
+                INCREMENTAL_TILESIZE*tx2 : InputWidth;
+            y2 = (INCREMENTAL_TILESIZE*ty2 < InputHeight) ?
+                INCREMENTAL_TILESIZE*ty2 : InputHeight;
+            cx1 = (x1 - Radius > 0) ? x1 - Radius : 0;
+            cy1 = (y1 - Radius > 0) ? y1 - Radius : 0;
+            cx2 = (x2 + Radius < InputWidth) ? x2 + Radius : InputWidth;
+            cy2 = (y2 + Radius < InputHeight) ? y2 + Radius : InputHeight;
+            cw = cx2 - cx1;
+            ch = cy2 - cy1;
+            
+            /* Interpolate the crop */
+            for(y = 0; y < ch; y++)
+                memcpy(CropInput + cw*y, Input + cx1 + InputWidth*(cy1 + y),
+                    sizeof(uint32_t)*cw);
+            
+            if(!CWInterpCore(CropOutput, CropInput, cw, ch, Psi, Param, 0,
+                0, NULL))
+                goto Catch;
+            
+            /* Copy the updated tiles into the output */
+            for(y = ScaleFactor*y1; y < ScaleFactor*y2; y++)
+                memcpy(Output + ScaleFactor*x1 + OutputWidth*y,
+                    CropOutput + ScaleFactor*(x1 - cx1)
+                    + ScaleFactor*cw*(y - ScaleFactor*cy1),
+                    sizeof(uint32_t)*ScaleFactor*(x2 - x1));
+        }
+    
+    StopTime = Clock();
+    
+    if(Param.Verbose)
+    {
+        printf("  Updated %d of %d tiles\n", NumUpdate, NumTilesX*NumTilesY);
+        printf("  CPU time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    }
+    
+    Success = 1;
+Catch:
+    Free(CropOutput);
+    Free(CropInput);
+    Free(Update);
+    Free(Dirty);
+    return Success;
+}
+
+
+/** @brief Number of entries in the exp table of CWArbitraryInterp() */
+#define EXP_TABLE_SIZE  1024
+
+/**
+ * @brief Arbitrary scale factor interpolation
+ *
+ * Coeff must have space for 3*(NUMNEIGH + 1)*InputWidth*InputHeight
+ * elements and ExpTable for EXP_TABLE_SIZE elements.
+ */
 int CWArbitraryInterp(uint32_t *Output, int OutputWidth, int OutputHeight,
     const int32_t *Input, int InputWidth, int InputHeight,
-    const int *Stencil, const double *InverseA, cwparams Param)
+    const int *Stencil, const double *InverseA, cwparams Param,
+    int32_t *Coeff, int32_t *ExpTable)
 {
     /*int (*Extension)(int, int) = ExtensionMethod[Param.Boundary];*/
     int (*Extension)(int, int) = ConstExtension;
-    const int InputNumEl = 3*InputWidth*InputHeight;
-    const int ExpTableSize = 1024;
+    const int ExpTableSize = EXP_TABLE_SIZE;
     const double ExpArgScale = 37.0236;
     const double PhiTScale = sqrt(ExpArgScale/2)/Param.PhiSigmaTangent;
     const double PhiNScale = sqrt(ExpArgScale/2)/Param.PhiSigmaNormal;
     
-    int32_t *Coeff = NULL, *CoeffPtr, *ExpTable = NULL;
+    int32_t *CoeffPtr;
     
     float X, Y, XStart, YStart;
     float Temp, cr[NUMNEIGH], cg[NUMNEIGH], cb[NUMNEIGH];
@@ -984,14 +1587,10 @@ int CWArbitraryInterp(uint32_t *Output, int OutputWidth, int OutputHeight,
     int32_t CosTableTf[NUMSTENCILS], SinTableTf[NUMSTENCILS];
     int32_t CosTableNf[NUMSTENCILS], SinTableNf[NUMSTENCILS];
     int32_t Pixel;
-    int i, k, x, y, m, n, mx, my, nx, ny, S, Success = 0;
+    int i, k, x, y, m, n, mx, my, nx, ny, S;
     int ix, iy, Cur, Offset;
 
     
-    if(!(Coeff = (int32_t *)Malloc(sizeof(int32_t)*(NUMNEIGH + 1)*InputNumEl))
-        || !(ExpTable = (int32_t *)Malloc(sizeof(int32_t)*ExpTableSize)))
-        goto Catch;
-    
     if(Param.CenteredGrid)
     {
         XStart = (float)(1/Param.ScaleFactor - 1)/2;
@@ -1207,11 +1806,7 @@ int CWArbitraryInterp(uint32_t *Output, int OutputWidth, int OutputHeight,
         }
     }
               
-    Success = 1;
-Catch:
-    Free(ExpTable);
-    Free(Coeff);
-    return Success;
+    return 1;
 }
 
 
@@ -1257,6 +1852,83 @@ static void StencilStripPad(int *Stencil,
     }
 }
 
+/** @brief Reserve Size bytes of Workspace at Offset, aligned for doubles */
+static void *WorkspacePart(char *Workspace, long *Offset, long Size)
+{
+    void *Part = (Workspace) ? (void *)(Workspace + *Offset) : NULL;
+    
+    *Offset += ((Size + (long)sizeof(double) - 1) / (long)sizeof(double))
+        * (long)sizeof(double);
+    return Part;
+}
+
+
+/**
+ * @brief Partition the CWInterpEx() workspace among its arrays
+ *
+ * @param Workspace the workspace, or NULL to only compute its size
+ *
+ * @return workspace size in bytes
+ */
+static long CWInterpExPartition(char *Workspace, double **InverseA,
+    int32_t **OutputFixed, int32_t **InputFixed, int32_t **InputAdjusted,
+    int32_t **Residual, int **Stencil, int **StencilTv, int32_t **Coeff,
+    int32_t **ExpTable, int InputWidth, int InputHeight, cwparams Param)
+{
+    const int ScaleFactor = (int)ceil(Param.ScaleFactor);
+    const int PadInput = 4 + (ScaleFactor + 1)/2;
+    const long pw = InputWidth + 2*PadInput;
+    const long ph = InputHeight + 2*PadInput;
+    const long InputNumPixels = ((long)InputWidth)*((long)InputHeight);
+    long Offset = 0;
+    
+    /* InverseA is first so that the doubles are aligned */
+    *InverseA = (double *)WorkspacePart(Workspace, &Offset,
+        sizeof(double)*NUMNEIGH*NUMNEIGH*NUMSTENCILS);
+    *OutputFixed = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*PIXEL_STRIDE*pw*ScaleFactor*ph*ScaleFactor);
+    *InputFixed = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*PIXEL_STRIDE*pw*ph);
+    *InputAdjusted = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*PIXEL_STRIDE*InputNumPixels);
+    *Residual = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*PIXEL_STRIDE*pw*ph);
+    *Stencil = (int *)WorkspacePart(Workspace, &Offset, sizeof(int)*pw*ph);
+    *StencilTv = (int *)WorkspacePart(Workspace, &Offset,
+        sizeof(int)*8*pw*ph);
+    *Coeff = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*3*(NUMNEIGH + 1)*InputNumPixels);
+    *ExpTable = (int32_t *)WorkspacePart(Workspace, &Offset,
+        sizeof(int32_t)*EXP_TABLE_SIZE);
+    return Offset;
+}
+
+
+/**
+ * @brief Workspace size needed for CWInterpEx()
+ *
+ * @param InputWidth, InputHeight input image dimensions
+ * @param Param cwparams struct of interpolation parameters
+ *
+ * @return required workspace size in bytes
+ *
+ * The size depends only on the input dimensions and Param.ScaleFactor, and
+ * the workspace is also large enough for any smaller input.
+ */
+long CWInterpExWorkspaceSize(int InputWidth, int InputHeight,
+    cwparams Param)
+{
+    double *InverseA;
+    int32_t *OutputFixed, *InputFixed, *InputAdjusted, *Residual;
+    int32_t *Coeff, *ExpTable;
+    int *Stencil, *StencilTv;
+    
+    return CWInterpExPartition(NULL, &InverseA, &OutputFixed, &InputFixed,
+        &InputAdjusted, &Residual, &Stencil, &StencilTv, &Coeff, &ExpTable,
+        InputWidth, InputHeight, Param);
+}
+
+
 /**
  * @brief Contour stencil windowed interpolation for arbitrary scale factors
  *
@@ -1266,19 +1938,28 @@ static void StencilStripPad(int *Stencil,
  * @param InputWidth, InputHeight input image dimensions
  * @param Psi \f$\psi\f$ samples computed by \c PreCWInterp
  * @param Param cwparams struct of interpolation parameters
+ * @param Workspace array with space for CWInterpExWorkspaceSize() bytes,
+ *        or NULL to allocate the workspace internally
+ *
+ * A caller interpolating many images can allocate the workspace once and
+ * reuse it, so that the interpolation itself does not allocate memory
+ * (except for a small matrix in \c ComputeMatrices).  The contents of
+ * Workspace on entry do not matter and are overwritten.
  */
 int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
     const uint32_t *Input, int InputWidth, int InputHeight,
-    const int32_t *Psi, cwparams Param)
+    const int32_t *Psi, cwparams Param, void *Workspace)
 {
     const int ScaleFactor = (int)ceil(Param.ScaleFactor);
     const int SupportRadius = (NEIGHRADIUS+1)*ScaleFactor - 1;
     const int SupportWidth = 2*SupportRadius + 1;
     const int SupportSize = SupportWidth*SupportWidth;
     const int StencilMul = NUMNEIGH*SupportSize;
-    double *InverseA = NULL;
-    int *Stencil = NULL;
-    int32_t *InputFixed = NULL, *InputAdjusted = NULL, *OutputFixed = NULL, *Residual = NULL;
+    double *InverseA;
+    int *Stencil, *StencilTv;
+    int32_t *InputFixed, *InputAdjusted, *OutputFixed, *Residual;
+    int32_t *Coeff, *ExpTable;
+    void *OwnWorkspace = NULL;
     unsigned long StartTime, StopTime;
     int i, PadInput, pw, ph, Success = 0;
     int32_t ResNorm;
@@ -1292,15 +1973,15 @@ int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
     pw = InputWidth + 2*PadInput;
     ph = InputHeight + 2*PadInput;
     
-    if( !(InverseA = (double *)Malloc(sizeof(double)*NUMNEIGH*NUMNEIGH*NUMSTENCILS))
-        || !(OutputFixed = (int32_t *)Malloc(sizeof(int32_t)*
-            PIXEL_STRIDE*pw*ScaleFactor*ph*ScaleFactor))
-        || !(InputFixed = (int32_t *)Malloc(sizeof(int32_t)*PIXEL_STRIDE*pw*ph))
-        || !(InputAdjusted = (int32_t *)Malloc(sizeof(int32_t)*PIXEL_STRIDE*InputWidth*InputHeight))
-        || !(Residual = (int32_t *)Malloc(sizeof(int32_t)*PIXEL_STRIDE*pw*ph))
-        || !(Stencil = (int *)Malloc(sizeof(int)*pw*ph)) )
+    /* Allocate memory, unless the caller did */
+    if(!Workspace && !(Workspace = OwnWorkspace = Malloc(
+        CWInterpExWorkspaceSize(InputWidth, InputHeight, Param))))
         goto Catch;
     
+    CWInterpExPartition((char *)Workspace, &InverseA, &OutputFixed,
+        &InputFixed, &InputAdjusted, &Residual, &Stencil, &StencilTv,
+        &Coeff, &ExpTable, InputWidth, InputHeight, Param);
+    
     if(!ComputeMatrices(InverseA, Param))
         goto Catch;
     
@@ -1316,17 +1997,21 @@ int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
         AddResidual(InputAdjusted, InputFixed, InputWidth, InputHeight, PadInput);
         
         /* Select the best-fitting contour stencils */
-        if(!FitStencils(Stencil, InputFixed, pw, ph, StencilMul))
+        if(!FitStencils(Stencil, InputFixed, pw, ph, StencilMul,
+            StencilTv))
             goto Catch;
         
         memset(OutputFixed, 0, sizeof(int32_t)*
             3*pw*ScaleFactor*ph*ScaleFactor);
         memset(Residual, 0, sizeof(int32_t)*3*pw*ph);
         
-        printf("\n  Iteration   Residual norm\n  -------------------------\n");
+        if(Param.Verbose)
+            printf("\n  Iteration   Residual norm\n"
+                "  -------------------------\n");
         
         /* First interpolation pass */
-        CWFirstPass(OutputFixed, ScaleFactor, InputFixed, pw, ph, Stencil, Psi);
+        CWFirstPass(OutputFixed, ScaleFactor, InputFixed, pw, ph,
+            Stencil, Psi, NULL);
         
         /* Iterative refinement */
         for(i = 1; i <= Param.RefinementSteps; i++)
@@ -1336,14 +2021,16 @@ int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
                 pw, ph, Param)) < 0.0)
                 goto Catch;
             
-            printf("  %8d %15.8f\n", i, ResNorm/(255.0*256.0));
+            if(Param.Verbose)
+                printf("  %8d %15.8f\n", i, ResNorm/(255.0*256.0));
         
             AddResidual(InputAdjusted, Residual, InputWidth, InputHeight, PadInput);
             
             if(i < Param.RefinementSteps)
             {
                 /* Interpolation refinement pass */
-                CWRefinementPass(OutputFixed, ScaleFactor, Residual, pw, ph, Stencil, Psi);
+                CWRefinementPass(OutputFixed, ScaleFactor, Residual, pw, ph,
+                    Stencil, Psi, NULL);
             }
         }
         
@@ -1355,34 +2042,34 @@ int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
         ConvertInput(InputAdjusted, Input, InputWidth, InputHeight, 0);
         
         /* Select the best-fitting contour stencils */
-        if(!FitStencils(Stencil, InputAdjusted, InputWidth, InputHeight, 1))
+        if(!FitStencils(Stencil, InputAdjusted, InputWidth, InputHeight, 1,
+            StencilTv))
             goto Catch;
     }
     
     if(!CWArbitraryInterp(Output, OutputWidth, OutputHeight,
-        InputAdjusted, InputWidth, InputHeight, Stencil, InverseA, Param))
+        InputAdjusted, InputWidth, InputHeight, Stencil, InverseA, Param,
+        Coeff, ExpTable))
         goto Catch;
         
     /* The final interpolation is now complete, stop timing. */
     StopTime = Clock();
 
-    if(Param.RefinementSteps > 1)
-        printf("  %8d   (not computed)\n\n", Param.RefinementSteps + 1);
-    
-    /* Display the CPU time spent performing the interpolation. */
-    printf("  CPU time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    if(Param.Verbose)
+    {
+        if(Param.RefinementSteps > 1)
+            printf("  %8d   (not computed)\n\n", Param.RefinementSteps + 1);
+        
+        /* Display the CPU time spent performing the interpolation. */
+        printf("  CPU time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    }
 
     Success = 1;
     
 Catch:  /* This label is used for error handling.  If something went wrong
         above (which may be out of memory or a computation error), then
         execution jumps to this point to clean up and exit. */
-    Free(Stencil);
-    Free(Residual);
-    Free(InputAdjusted);
-    Free(InputFixed);
-    Free(OutputFixed);
-    Free(InverseA);
+    Free(OwnWorkspace);
     return Success;
 }
 
@@ -1411,7 +2098,7 @@ int DisplayContours(uint32_t *Output, int OutputWidth, int OutputHeight,
     ConvertInput(InputInt, Input, InputWidth, InputHeight, Pad);
     
     /* Select the best-fitting contour stencils */
-    if(!FitStencils(Stencil, InputInt, pw, ph, 1))
+    if(!FitStencils(Stencil, InputInt, pw, ph, 1, NULL))
         goto Catch;
     
     /* Lighten the image */
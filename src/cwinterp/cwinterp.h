@@ -32,6 +32,10 @@ typedef struct
     double PhiSigmaTangent;
     /** \f$\sigma_\nu\f$, normal spread of \f$\varphi\f$ */
     double PhiSigmaNormal;
+    /** Edge threshold for hybrid interpolation in [0,255], 0 to disable */
+    double EdgeThreshold;
+    /** Print the residuals and CPU time to stdout if nonzero */
+    int Verbose;
 } cwparams;
 
 
@@ -40,9 +44,20 @@ int32_t *PreCWInterp(cwparams Param);
 int CWInterp(uint32_t *Output, const uint32_t *Input,
     int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param);
 
+int CWInterpTimed(uint32_t *Output, const uint32_t *Input,
+    int InputWidth, int InputHeight, const int32_t *Psi, cwparams Param,
+    unsigned long TimeLimit, double *ResidualNorm);
+
+int CWInterpIncremental(uint32_t *Output, const uint32_t *Input,
+    const uint32_t *PrevInput, int InputWidth, int InputHeight,
+    const int32_t *Psi, cwparams Param);
+
 int CWInterpEx(uint32_t *Output, int OutputWidth, int OutputHeight,
     const uint32_t *Input, int InputWidth, int InputHeight,
-    const int32_t *Psi, cwparams Param);
+    const int32_t *Psi, cwparams Param, void *Workspace);
+
+long CWInterpExWorkspaceSize(int InputWidth, int InputHeight,
+    cwparams Param);
 
 int DisplayContours(uint32_t *Output, int OutputWidth, int OutputHeight,
     uint32_t *Input, int InputWidth, int InputHeight, cwparams Param);
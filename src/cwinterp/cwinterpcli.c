@@ -24,6 +24,7 @@
 
 #include <ipol/imageio.h>
 #include "cwinterp.h"
+#include "cwinterpd.h"
 
 /** @brief Set to 1 for informative program output, 0 for quiet */
 #define VERBOSE     0
@@ -50,6 +51,8 @@ typedef struct
     int OnlyShowContours;
     /** @brief Quality for saving JPEG images (0 to 100) */
     int JpegQuality;
+    /** @brief Socket of the iminterpcwd daemon, or NULL to run locally */
+    char *DaemonSocket;
     /** @brief interpolation parameters */
     cwparams Cw;
     
@@ -75,7 +78,11 @@ static void PrintHelpMessage()
     "show the estimated orientations instead of interpolating\n");
     puts("  -t <number>  sigma_tau, spread of phi in the tagential direction");
     puts("  -n <number>  sigma_nu, spread of phi in the normal direction");
-    puts("  -r <number>  the number of refinement passes\n");
+    puts("  -r <number>  the number of refinement passes");
+    puts("  -e <number>  edge threshold in [0,255] for hybrid interpolation,\n"
+    "               flat tiles use cubic interpolation (0 disables, default)\n");
+    puts("  -d <socket>  interpolate with the iminterpcwd daemon listening on\n"
+    "               <socket> instead of in this process\n");
 #ifdef USE_LIBJPEG
     puts("  -q <number>  quality for saving JPEG images (0 to 100)\n");
 #endif
@@ -95,8 +102,9 @@ int main(int argc, char *argv[])
     if(!ParseParams(&Param, argc, argv))
         return 0;
 
-    /* Perform precomputations (but not when only showing contours) */
-    if(!Param.OnlyShowContours)
+    /* Perform precomputations (but not when only showing contours or when
+       the daemon interpolates, which keeps its own) */
+    if(!Param.OnlyShowContours && !Param.DaemonSocket)
         if(!(Psi = PreCWInterp(Param.Cw)))
             goto Catch;
     
@@ -113,7 +121,17 @@ int main(int argc, char *argv[])
         ((long int)u.Width)*((long int)u.Height))))
         goto Catch;
     
-    if(!Param.OnlyShowContours)
+    if(Param.DaemonSocket && !Param.OnlyShowContours)
+    {
+        printf("Interpolation by daemon %dx%d input -> %dx%d output\n",
+            v.Width, v.Height, u.Width, u.Height);
+        
+        if(!CWInterpRemote(u.Data, u.Width, u.Height,
+            v.Data, v.Width, v.Height, Param.Cw, Param.TestFlag,
+            Param.DaemonSocket))
+            goto Catch;
+    }
+    else if(!Param.OnlyShowContours)
     {
         if(!Param.TestFlag && Param.Cw.ScaleFactor == ceil(Param.Cw.ScaleFactor))
         {
@@ -131,7 +149,7 @@ int main(int argc, char *argv[])
             
             /* Perform interpolation by an arbitrary scale factor. */
             if(!CWInterpEx(u.Data, u.Width, u.Height,
-                v.Data, v.Width, v.Height, Psi, Param.Cw))
+                v.Data, v.Width, v.Height, Psi, Param.Cw, NULL))
                 goto Catch;
         }
     }
@@ -184,6 +202,7 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->OutputFile = DefaultOutputFile;
     Param->OnlyShowContours = 0;
     Param->JpegQuality = 70;
+    Param->DaemonSocket = NULL;
     
     Param->Cw.ScaleFactor = 4;
     Param->Cw.CenteredGrid = 1;
@@ -191,6 +210,8 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->Cw.PsfSigma = 0.35;
     Param->Cw.PhiSigmaTangent = 1.2;
     Param->Cw.PhiSigmaNormal = 0.6;
+    Param->Cw.EdgeThreshold = 0;
+    Param->Cw.Verbose = 1;
     
     Param->TestFlag = 0;
 
@@ -279,6 +300,18 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
                     return 0;
                 }
                 break;
+            case 'e':
+                Param->Cw.EdgeThreshold = atof(OptionString);
+
+                if(Param->Cw.EdgeThreshold < 0.0)
+                {
+                    ErrorMessage("Edge threshold must be nonnegative.\n");
+                    return 0;
+                }
+                break;
+            case 'd':
+                Param->DaemonSocket = OptionString;
+                break;
             case 's':
                 Param->OnlyShowContours = 1;
                 i--;
@@ -351,6 +384,10 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
         printf("\nsigma_h = %g, sigma_tau = %g, sigma_nu = %g\n",
             Param->Cw.PsfSigma, Param->Cw.PhiSigmaTangent,
             Param->Cw.PhiSigmaNormal);
+        
+        if(Param->Cw.EdgeThreshold > 0)
+            printf("hybrid with edge threshold %g\n",
+                Param->Cw.EdgeThreshold);
     }
 
     return 1;
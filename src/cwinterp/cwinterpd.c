@@ -0,0 +1,596 @@
+/**
+ * @file cwinterpd.c
+ * @brief Contour stencil interpolation daemon
+ *
+ * This program keeps running and serves interpolation requests from
+ * CWInterpRemote over a Unix domain socket (see cwinterpd.h for the
+ * protocol).  Compared to running iminterpcw for each image, it saves the
+ * process startup and, more importantly, the precomputation of \f$\psi\f$
+ * by PreCWInterp, which is done once per distinct set of parameters and
+ * kept in a cache.
+ *
+ * Requests are processed concurrently by a fixed pool of threads.  Each
+ * thread accepts a connection and serves the requests on it until the
+ * client closes it or stays silent for longer than the timeout, so that
+ * idle or stalled clients cannot occupy the workers indefinitely.  The
+ * interpolation routines have no global state, so they run in parallel
+ * without locking; only the cache is locked.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/* Request the POSIX declarations, which strict ANSI mode hides */
+#if !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <math.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "cwinterpd.h"
+
+/** @brief Maximum number of distinct parameter sets with cached psi */
+#define PSI_CACHE_SIZE      16
+/** @brief Maximum number of worker threads */
+#define MAX_THREADS         256
+/** @brief Number of pending connections the socket queues */
+#define LISTEN_BACKLOG      64
+/** @brief Default timeout in seconds for reading from and writing to clients */
+#define DEFAULT_TIMEOUT     30
+
+/** @brief A cached psi and the parameters it was computed for */
+typedef struct
+{
+    cwparams Param;
+    int32_t *Psi;
+} psicacheentry;
+
+/** @brief struct of daemon state shared by the worker threads */
+typedef struct
+{
+    /** @brief Listening socket */
+    int Listen;
+    /** @brief Timeout in seconds for each read or write on a connection */
+    int Timeout;
+    /** @brief Lock protecting the cache */
+    pthread_mutex_t CacheLock;
+    /** @brief Cache of psi for recently used parameters */
+    psicacheentry Cache[PSI_CACHE_SIZE];
+    /** @brief Number of entries in Cache */
+    int NumCached;
+} daemonstate;
+
+/** @brief struct of program parameters */
+typedef struct
+{
+    /** @brief Socket file name */
+    char *SocketPath;
+    /** @brief Number of worker threads */
+    int NumThreads;
+    /** @brief Timeout in seconds for each read or write on a connection */
+    int Timeout;
+} programparams;
+
+
+static int ParseParams(programparams *Param, int argc, char *argv[]);
+
+
+static void PrintHelpMessage()
+{
+    puts("Contour stencil interpolation daemon\n");
+    puts("Usage: iminterpcwd [options] <socket file>\n");
+    puts("Serves interpolation requests from \"iminterpcw -d <socket file>\"\n"
+        "until interrupted.\n");
+    puts("Options:");
+    puts("  -j <number>  number of requests to process concurrently");
+    printf("  -i <number>  seconds after which a silent client is "
+        "disconnected (default %d)\n\n", DEFAULT_TIMEOUT);
+    puts("Example:\n"
+    "  iminterpcwd /tmp/cwinterp.sock &\n"
+    "  iminterpcw -d /tmp/cwinterp.sock -x 4 frog.bmp frog-4x.bmp");
+}
+
+
+/** @brief Test whether psi computed for A can be used for B */
+static int SamePsiParams(cwparams A, cwparams B)
+{
+    /* These are the parameters that PreCWInterp depends on */
+    return A.ScaleFactor == B.ScaleFactor
+        && A.CenteredGrid == B.CenteredGrid
+        && A.PsfSigma == B.PsfSigma
+        && A.PhiSigmaTangent == B.PhiSigmaTangent
+        && A.PhiSigmaNormal == B.PhiSigmaNormal;
+}
+
+
+/** @brief Look up psi in the cache, the caller holds CacheLock */
+static int32_t *FindPsi(daemonstate *State, cwparams Param)
+{
+    int i;
+
+    for(i = 0; i < State->NumCached; i++)
+        if(SamePsiParams(State->Cache[i].Param, Param))
+            return State->Cache[i].Psi;
+
+    return NULL;
+}
+
+
+/**
+ * @brief Get psi for the given parameters
+ * @param State the daemon state
+ * @param Param interpolation parameters
+ * @param Owned set to 1 if the caller must free the returned psi
+ * @return psi, or NULL on failure
+ *
+ * Psi is computed without holding the lock, so that a slow precomputation
+ * does not delay requests with other parameters.  Cached entries are never
+ * evicted, so they stay valid while other threads use them.  Once the
+ * cache is full, psi for new parameters is computed for each request.
+ */
+static int32_t *GetPsi(daemonstate *State, cwparams Param, int *Owned)
+{
+    int32_t *Psi, *NewPsi;
+
+
+    *Owned = 0;
+    pthread_mutex_lock(&State->CacheLock);
+    Psi = FindPsi(State, Param);
+    pthread_mutex_unlock(&State->CacheLock);
+
+    if(Psi || !(NewPsi = PreCWInterp(Param)))
+        return Psi;
+
+    pthread_mutex_lock(&State->CacheLock);
+
+    if((Psi = FindPsi(State, Param)))    /* Another thread was faster */
+        Free(NewPsi);
+    else if(State->NumCached < PSI_CACHE_SIZE)
+    {
+        State->Cache[State->NumCached].Param = Param;
+        State->Cache[State->NumCached].Psi = Psi = NewPsi;
+        State->NumCached++;
+    }
+    else
+    {
+        Psi = NewPsi;
+        *Owned = 1;
+    }
+
+    pthread_mutex_unlock(&State->CacheLock);
+    return Psi;
+}
+
+
+/** @brief Check that a request describes a valid job */
+static int ValidRequest(const cwdrequest *Request)
+{
+    return Request->Magic == CWD_MAGIC
+        && Request->InputWidth > 0 && Request->InputHeight > 0
+        && Request->InputWidth <= CWD_MAX_PIXELS / Request->InputHeight
+        && Request->OutputWidth > 0 && Request->OutputHeight > 0
+        && Request->OutputWidth <= CWD_MAX_PIXELS / Request->OutputHeight
+        && Request->Param.ScaleFactor >= 1
+        && Request->Param.ScaleFactor <= 64
+        && Request->Param.RefinementSteps >= 0
+        && Request->Param.PsfSigma >= 0 && Request->Param.PsfSigma <= 2
+        && Request->Param.PhiSigmaTangent > 0
+        && Request->Param.PhiSigmaNormal > 0
+        && Request->Param.EdgeThreshold >= 0;
+}
+
+
+/**
+ * @brief Grow a buffer that is kept across requests
+ * @param Buffer the buffer, reallocated if it is smaller than Size
+ * @param Capacity the current size of Buffer in bytes
+ * @param Size the needed size in bytes
+ * @return 1 on success, 0 if out of memory
+ */
+static int ReserveBuffer(void **Buffer, size_t *Capacity, size_t Size)
+{
+    if(Size <= *Capacity)
+        return 1;
+
+    Free(*Buffer);
+    *Capacity = 0;
+
+    if(!(*Buffer = Malloc(Size)))
+        return 0;
+
+    *Capacity = Size;
+    return 1;
+}
+
+
+/**
+ * @brief Serve the requests on one connection
+ * @return 1 if the client closed the connection, 0 on error
+ *
+ * The input, output, and CWInterpEx() workspace buffers are kept for the
+ * whole connection and only grown when a request needs more, so that a
+ * client sending a stream of same-size images causes no allocations after
+ * the first request.
+ */
+static int ServeConnection(daemonstate *State, int Socket)
+{
+    cwdrequest Request;
+    cwdreply Reply;
+    void *Input = NULL, *Output = NULL, *Workspace = NULL;
+    int32_t *Psi = NULL;
+    size_t InputSize, OutputSize, WorkspaceSize;
+    size_t InputCapacity = 0, OutputCapacity = 0, WorkspaceCapacity = 0;
+    int Owned = 0, Success = 0;
+
+
+    /* Each iteration serves one request, until the client closes */
+    while(CwdReadAll(Socket, &Request, sizeof(Request)))
+    {
+        Reply.Status = 0;
+
+        if(!ValidRequest(&Request))
+        {
+            ErrorMessage("Invalid request.\n");
+            goto Catch;
+        }
+
+        InputSize = sizeof(uint32_t)*((size_t)Request.InputWidth)
+            *((size_t)Request.InputHeight);
+        OutputSize = sizeof(uint32_t)*((size_t)Request.OutputWidth)
+            *((size_t)Request.OutputHeight);
+
+        if(!ReserveBuffer(&Input, &InputCapacity, InputSize)
+            || !CwdReadAll(Socket, Input, InputSize))
+            goto Catch;
+
+        if(Request.Param.PsfSigma == 0)
+            Request.Param.RefinementSteps = 0;
+
+        /* Worker threads run concurrently, so per-request output from the
+           interpolation routines would be interleaved and is disabled */
+        Request.Param.Verbose = 0;
+
+        if(ReserveBuffer(&Output, &OutputCapacity, OutputSize)
+            && (Psi = GetPsi(State, Request.Param, &Owned)))
+        {
+            /* Use the same routine as iminterpcw would */
+            if(!Request.TestFlag
+                && Request.Param.ScaleFactor == ceil(Request.Param.ScaleFactor)
+                && Request.OutputWidth
+                == (int)Request.Param.ScaleFactor*Request.InputWidth
+                && Request.OutputHeight
+                == (int)Request.Param.ScaleFactor*Request.InputHeight)
+                Reply.Status = CWInterp((uint32_t *)Output, (uint32_t *)Input,
+                    Request.InputWidth, Request.InputHeight,
+                    Psi, Request.Param);
+            else
+            {
+                WorkspaceSize = (size_t)CWInterpExWorkspaceSize(
+                    Request.InputWidth, Request.InputHeight, Request.Param);
+
+                if(ReserveBuffer(&Workspace, &WorkspaceCapacity,
+                    WorkspaceSize))
+                    Reply.Status = CWInterpEx((uint32_t *)Output,
+                        Request.OutputWidth, Request.OutputHeight,
+                        (uint32_t *)Input,
+                        Request.InputWidth, Request.InputHeight,
+                        Psi, Request.Param, Workspace);
+            }
+        }
+
+        if(!CwdWriteAll(Socket, &Reply, sizeof(Reply))
+            || (Reply.Status == 1
+            && !CwdWriteAll(Socket, Output, OutputSize)))
+            goto Catch;
+
+        if(Owned)
+            Free(Psi);
+        Psi = NULL;
+        Owned = 0;
+    }
+
+    Success = 1;
+Catch:
+    if(Owned)
+        Free(Psi);
+    Free(Workspace);
+    Free(Output);
+    Free(Input);
+    return Success;
+}
+
+
+/**
+ * @brief Remove a socket file left behind by a previous daemon
+ * @param Address address the daemon will bind to
+ * @return 1 if the path is free, 0 if it is in use or not a socket
+ *
+ * Only a socket that no daemon listens on anymore is removed.  Any other
+ * kind of file at the path is left untouched.
+ */
+static int RemoveStaleSocket(const struct sockaddr_un *Address)
+{
+    struct stat Info;
+    int Socket, Connected;
+
+
+    if(lstat(Address->sun_path, &Info))
+    {
+        if(errno == ENOENT)
+            return 1;
+
+        ErrorMessage("Unable to access \"%s\".\n", Address->sun_path);
+        return 0;
+    }
+    else if(!S_ISSOCK(Info.st_mode))
+    {
+        ErrorMessage("\"%s\" exists and is not a socket.\n",
+            Address->sun_path);
+        return 0;
+    }
+
+    /* Check whether another daemon is still listening on it */
+    if((Socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return 0;
+
+    Connected = !connect(Socket, (const struct sockaddr *)Address,
+        sizeof(*Address));
+    close(Socket);
+
+    if(Connected)
+    {
+        ErrorMessage("Another daemon is listening on \"%s\".\n",
+            Address->sun_path);
+        return 0;
+    }
+    else if(unlink(Address->sun_path) && errno != ENOENT)
+    {
+        ErrorMessage("Unable to remove \"%s\".\n", Address->sun_path);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/** @brief Worker thread, accepts and serves connections */
+static void *WorkerThread(void *Arg)
+{
+    daemonstate *State = (daemonstate *)Arg;
+    struct timeval Timeout;
+    int Socket;
+
+
+    Timeout.tv_sec = State->Timeout;
+    Timeout.tv_usec = 0;
+
+    while(1)
+        if((Socket = accept(State->Listen, NULL, NULL)) >= 0)
+        {
+            /* A read or write that waits longer than the timeout fails
+               with EAGAIN, which ends the connection */
+            if(setsockopt(Socket, SOL_SOCKET, SO_RCVTIMEO,
+                &Timeout, sizeof(Timeout))
+                || setsockopt(Socket, SOL_SOCKET, SO_SNDTIMEO,
+                &Timeout, sizeof(Timeout)))
+                ErrorMessage("Unable to set the connection timeout.\n");
+            else
+                ServeConnection(State, Socket);
+
+            close(Socket);
+        }
+        else if(errno != EINTR && errno != ECONNABORTED)
+        {
+            ErrorMessage("accept failed.\n");
+            break;
+        }
+
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    programparams Param;
+    daemonstate State;
+    struct sockaddr_un Address;
+    pthread_t Threads[MAX_THREADS];
+    sigset_t StopSignals;
+    int i, Signal, NumStarted = 0, Bound = 0, Status = 1;
+
+
+    /* Parse command line parameters */
+    if(!ParseParams(&Param, argc, argv))
+        return 0;
+
+    State.Listen = -1;
+    State.Timeout = Param.Timeout;
+    State.NumCached = 0;
+    pthread_mutex_init(&State.CacheLock, NULL);
+
+    /* A client disconnecting early should not terminate the daemon */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* SIGINT and SIGTERM are handled by the main thread with sigwait */
+    sigemptyset(&StopSignals);
+    sigaddset(&StopSignals, SIGINT);
+    sigaddset(&StopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &StopSignals, NULL);
+
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    strcpy(Address.sun_path, Param.SocketPath);
+
+    if(!RemoveStaleSocket(&Address))
+        goto Catch;
+
+    if((State.Listen = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || !(Bound = !bind(State.Listen,
+        (struct sockaddr *)&Address, sizeof(Address)))
+        || listen(State.Listen, LISTEN_BACKLOG))
+    {
+        ErrorMessage("Unable to listen on \"%s\".\n", Param.SocketPath);
+        goto Catch;
+    }
+
+    for(; NumStarted < Param.NumThreads; NumStarted++)
+        if(pthread_create(&Threads[NumStarted], NULL,
+            WorkerThread, &State))
+        {
+            ErrorMessage("Unable to start worker threads.\n");
+            goto Catch;
+        }
+
+    printf("Listening on \"%s\" with %d threads.\n",
+        Param.SocketPath, Param.NumThreads);
+    fflush(stdout);
+
+    sigwait(&StopSignals, &Signal);
+    printf("Stopping.\n");
+    Status = 0;
+Catch:
+    if(State.Listen >= 0)
+        close(State.Listen);
+    if(Bound)
+        unlink(Param.SocketPath);
+
+    /* Worker threads may be in the middle of a request, so the cache is
+       only freed if none were started, otherwise exiting releases it */
+    if(NumStarted == 0)
+    {
+        for(i = 0; i < State.NumCached; i++)
+            Free(State.Cache[i].Psi);
+
+        pthread_mutex_destroy(&State.CacheLock);
+    }
+
+    return Status;
+}
+
+
+static int ParseParams(programparams *Param, int argc, char *argv[])
+{
+    char *OptionString;
+    char OptionChar;
+    int i;
+
+
+    if(argc < 2)
+    {
+        PrintHelpMessage();
+        return 0;
+    }
+
+    /* Set parameter defaults */
+    Param->SocketPath = NULL;
+#ifdef _SC_NPROCESSORS_ONLN
+    Param->NumThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    Param->NumThreads = 0;
+#endif
+
+    if(Param->NumThreads < 1)
+        Param->NumThreads = 4;
+
+    Param->Timeout = DEFAULT_TIMEOUT;
+
+    for(i = 1; i < argc;)
+    {
+        if(argv[i] && argv[i][0] == '-')
+        {
+            if((OptionChar = argv[i][1]) == 0)
+            {
+                ErrorMessage("Invalid parameter format.\n");
+                return 0;
+            }
+
+            if(argv[i][2])
+                OptionString = &argv[i][2];
+            else if(++i < argc)
+                OptionString = argv[i];
+            else
+            {
+                ErrorMessage("Invalid parameter format.\n");
+                return 0;
+            }
+
+            switch(OptionChar)
+            {
+            case 'j':
+                Param->NumThreads = atoi(OptionString);
+
+                if(Param->NumThreads < 1 || Param->NumThreads > MAX_THREADS)
+                {
+                    ErrorMessage("Number of threads must be between "
+                        "1 and %d.\n", MAX_THREADS);
+                    return 0;
+                }
+                break;
+            case 'i':
+                Param->Timeout = atoi(OptionString);
+
+                if(Param->Timeout < 1)
+                {
+                    ErrorMessage("Timeout must be at least 1 second.\n");
+                    return 0;
+                }
+                break;
+            case '-':
+                PrintHelpMessage();
+                return 0;
+            default:
+                if(isprint(OptionChar))
+                    ErrorMessage("Unknown option \"-%c\".\n", OptionChar);
+                else
+                    ErrorMessage("Unknown option.\n");
+
+                return 0;
+            }
+
+            i++;
+        }
+        else
+        {
+            if(!Param->SocketPath)
+                Param->SocketPath = argv[i];
+            else
+            {
+                ErrorMessage("Too many arguments.\n");
+                return 0;
+            }
+
+            i++;
+        }
+    }
+
+    if(!Param->SocketPath)
+    {
+        PrintHelpMessage();
+        return 0;
+    }
+    else if(strlen(Param->SocketPath) >= sizeof(((struct sockaddr_un *)0)
+        ->sun_path))
+    {
+        ErrorMessage("Socket file name is too long.\n");
+        return 0;
+    }
+
+    if(Param->NumThreads > MAX_THREADS)
+        Param->NumThreads = MAX_THREADS;
+
+    return 1;
+}
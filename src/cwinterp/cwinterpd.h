@@ -0,0 +1,62 @@
+/**
+ * @file cwinterpd.h
+ * @brief Protocol of the contour stencil interpolation daemon
+ *
+ * The daemon iminterpcwd (cwinterpd.c) serves interpolation requests over
+ * a Unix domain socket.  A client connects and sends any number of
+ * requests on the connection, each a cwdrequest header followed by the
+ * InputWidth x InputHeight RGBA input image.  For each request, the
+ * daemon replies with a cwdreply header followed, if Status is 1, by the
+ * OutputWidth x OutputHeight RGBA output image.  Client and daemon run on
+ * the same machine and are built from this header, so all values are sent
+ * in native byte order and layout.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _CWINTERPD_H_
+#define _CWINTERPD_H_
+
+#include "cwinterp.h"
+
+/** @brief Value of cwdrequest.Magic, "CWD2" in little endian */
+#define CWD_MAGIC       0x32445743UL
+
+/** @brief Largest number of pixels accepted for the input or output */
+#define CWD_MAX_PIXELS  (1L << 26)
+
+/** @brief Header of an interpolation request */
+typedef struct
+{
+    /** @brief Must be CWD_MAGIC */
+    uint32_t Magic;
+    /** @brief Input image dimensions */
+    int32_t InputWidth;
+    int32_t InputHeight;
+    /** @brief Output image dimensions */
+    int32_t OutputWidth;
+    int32_t OutputHeight;
+    /** @brief If nonzero, use CWInterpEx even for integer scale factors */
+    int32_t TestFlag;
+    /** @brief Interpolation parameters */
+    cwparams Param;
+} cwdrequest;
+
+/** @brief Header of the reply to a request */
+typedef struct
+{
+    /** @brief 1 if the output image follows, 0 on failure */
+    int32_t Status;
+} cwdreply;
+
+int CwdReadAll(int Socket, void *Data, size_t Size);
+int CwdWriteAll(int Socket, const void *Data, size_t Size);
+int CWInterpRemote(uint32_t *Output, int OutputWidth, int OutputHeight,
+    const uint32_t *Input, int InputWidth, int InputHeight,
+    cwparams Param, int TestFlag, const char *SocketPath);
+
+#endif /* _CWINTERPD_H_ */
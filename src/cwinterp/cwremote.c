@@ -0,0 +1,201 @@
+/**
+ * @file cwremote.c
+ * @brief Client of the contour stencil interpolation daemon
+ *
+ * CWInterpRemote sends an interpolation job to a running iminterpcwd
+ * daemon instead of computing it in the calling process, so that the
+ * precomputation of PreCWInterp is done once by the daemon rather than by
+ * every invocation.  Unix domain sockets are needed, on other systems
+ * CWInterpRemote always fails.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/* Request the POSIX declarations, which strict ANSI mode hides */
+#if !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include "cwinterpd.h"
+
+#if defined(unix) || defined(__unix__) || defined(__unix) \
+    || (defined(__APPLE__) && defined(__MACH__))
+#define USE_UNIX_SOCKETS
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+
+#ifdef USE_UNIX_SOCKETS
+/**
+ * @brief Read exactly Size bytes from a socket
+ * @return 1 on success, 0 on error or end of file
+ */
+int CwdReadAll(int Socket, void *Data, size_t Size)
+{
+    char *Ptr = (char *)Data;
+    ssize_t Count;
+    
+    while(Size > 0)
+    {
+        if((Count = read(Socket, Ptr, Size)) > 0)
+        {
+            Ptr += Count;
+            Size -= (size_t)Count;
+        }
+        else if(Count == 0 || errno != EINTR)
+            return 0;
+    }
+    
+    return 1;
+}
+
+
+/**
+ * @brief Write exactly Size bytes to a socket
+ * @return 1 on success, 0 on error
+ */
+int CwdWriteAll(int Socket, const void *Data, size_t Size)
+{
+    const char *Ptr = (const char *)Data;
+    ssize_t Count;
+    
+    while(Size > 0)
+    {
+        if((Count = write(Socket, Ptr, Size)) >= 0)
+        {
+            Ptr += Count;
+            Size -= (size_t)Count;
+        }
+        else if(errno != EINTR)
+            return 0;
+    }
+    
+    return 1;
+}
+
+
+/**
+ * @brief Contour stencil windowed interpolation by the daemon
+ * @param Output pointer to memory for holding the interpolated image
+ * @param OutputWidth, OutputHeight output image dimensions
+ * @param Input the input image
+ * @param InputWidth, InputHeight input image dimensions
+ * @param Param cwparams struct of interpolation parameters
+ * @param TestFlag if nonzero, use CWInterpEx even for integer scale factors
+ * @param SocketPath socket of the iminterpcwd daemon
+ * @return 1 on success, 0 on failure
+ *
+ * The images are 32-bit RGBA as for CWInterp.  The daemon uses CWInterp
+ * if TestFlag is zero, the scale factor is an integer, and the output size
+ * is the input size times the scale factor, and CWInterpEx otherwise, so
+ * the result is the same as computing the interpolation locally.  The
+ * daemon ignores Param.Verbose and prints nothing.
+ */
+int CWInterpRemote(uint32_t *Output, int OutputWidth, int OutputHeight,
+    const uint32_t *Input, int InputWidth, int InputHeight,
+    cwparams Param, int TestFlag, const char *SocketPath)
+{
+    struct sockaddr_un Address;
+    cwdrequest Request;
+    cwdreply Reply;
+    int Socket = -1, Success = 0;
+    
+    
+    if(!Output || !Input || !SocketPath
+        || strlen(SocketPath) >= sizeof(Address.sun_path))
+    {
+        ErrorMessage("Invalid daemon socket path.\n");
+        return 0;
+    }
+    
+    memset(&Address, 0, sizeof(Address));
+    Address.sun_family = AF_UNIX;
+    strcpy(Address.sun_path, SocketPath);
+    
+    memset(&Request, 0, sizeof(Request));
+    Request.Magic = CWD_MAGIC;
+    Request.InputWidth = InputWidth;
+    Request.InputHeight = InputHeight;
+    Request.OutputWidth = OutputWidth;
+    Request.OutputHeight = OutputHeight;
+    Request.TestFlag = TestFlag;
+    Request.Param = Param;
+    
+    if((Socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+        || connect(Socket, (struct sockaddr *)&Address, sizeof(Address)))
+    {
+        ErrorMessage("Unable to connect to daemon at \"%s\".\n", SocketPath);
+        goto Catch;
+    }
+    
+    if(!CwdWriteAll(Socket, &Request, sizeof(Request))
+        || !CwdWriteAll(Socket, Input,
+            sizeof(uint32_t)*((size_t)InputWidth)*((size_t)InputHeight))
+        || !CwdReadAll(Socket, &Reply, sizeof(Reply)))
+    {
+        ErrorMessage("Lost connection to daemon.\n");
+        goto Catch;
+    }
+    else if(Reply.Status != 1)
+    {
+        ErrorMessage("Daemon failed to interpolate the image.\n");
+        goto Catch;
+    }
+    else if(!CwdReadAll(Socket, Output,
+        sizeof(uint32_t)*((size_t)OutputWidth)*((size_t)OutputHeight)))
+    {
+        ErrorMessage("Lost connection to daemon.\n");
+        goto Catch;
+    }
+    
+    Success = 1;
+Catch:
+    if(Socket >= 0)
+        close(Socket);
+    return Success;
+}
+#else
+int CwdReadAll(int Socket, void *Data, size_t Size)
+{
+    (void)Socket;
+    (void)Data;
+    (void)Size;
+    return 0;
+}
+
+
+int CwdWriteAll(int Socket, const void *Data, size_t Size)
+{
+    (void)Socket;
+    (void)Data;
+    (void)Size;
+    return 0;
+}
+
+
+int CWInterpRemote(uint32_t *Output, int OutputWidth, int OutputHeight,
+    const uint32_t *Input, int InputWidth, int InputHeight,
+    cwparams Param, int TestFlag, const char *SocketPath)
+{
+    (void)Output;
+    (void)OutputWidth;
+    (void)OutputHeight;
+    (void)Input;
+    (void)InputWidth;
+    (void)InputHeight;
+    (void)Param;
+    (void)TestFlag;
+    (void)SocketPath;
+    ErrorMessage("The daemon requires Unix domain sockets.\n");
+    return 0;
+}
+#endif
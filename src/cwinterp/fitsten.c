@@ -52,6 +52,8 @@ static int Dist(int32_t *A, int32_t *B)
 * @param Image the input RGB image
 * @param Width, Height image dimensions
 * @param StencilMul multiply the stencil index by this factor
+* @param Workspace array with space for 8*Width*Height ints, or NULL to
+*        allocate it internally
 *
 * \c FitStencils finds the best-fitting stencil at each pixel of the input
 * image
@@ -67,7 +69,8 @@ static int Dist(int32_t *A, int32_t *B)
 * indices are multiplied by \c StencilMul (so that the index may be used
 * directly as an offset into the samples table).
 */
-int FitStencils(int *Stencil, int32_t *Image, int Width, int Height, int StencilMul)
+int FitStencils(int *Stencil, int32_t *Image, int Width, int Height,
+    int StencilMul, int *Workspace)
 {
     const int Stride = PIXEL_STRIDE*Width;
     const int TVStride = 8*Width;
@@ -80,7 +83,8 @@ int FitStencils(int *Stencil, int32_t *Image, int Width, int Height, int Stencil
     int x, y, k, S;
 
     
-    if(!(StencilTv = (int *)malloc(sizeof(int)*8*Width*Height)))
+    if(!(StencilTv = Workspace)
+        && !(StencilTv = (int *)malloc(sizeof(int)*8*Width*Height)))
         return 0;
     
     TvPtr = StencilTv;
@@ -217,6 +221,7 @@ int FitStencils(int *Stencil, int32_t *Image, int Width, int Height, int Stencil
         }
     }
     
-    free(StencilTv);
+    if(!Workspace)
+        free(StencilTv);
     return 1;
 }
@@ -18,6 +18,7 @@
 
 #include <ipol/basic.h>
 
-int FitStencils(int *Stencil, int32_t *Image, int Width, int Height, int StencilMul);
+int FitStencils(int *Stencil, int32_t *Image, int Width, int Height,
+    int StencilMul, int *Workspace);
 
 #endif /* _FITSTEN_H_ */
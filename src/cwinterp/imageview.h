@@ -0,0 +1,55 @@
+/**
+ * @file imageview.h
+ * @brief Strided views of float images
+ *
+ * This program only uses the view struct, the functions for making and
+ * allocating views are not included.
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _IMAGEVIEW_H_
+#define _IMAGEVIEW_H_
+
+/**
+ * @brief struct representing a strided view of a float image
+ *
+ * Channel c of pixel (x,y) is located at
+ *     Data[PixelStride*x + RowStride*y + ChannelStride*c],
+ * so that the same type describes the planar layout
+ *     PixelStride = 1, RowStride = Width, ChannelStride = Width*Height,
+ * the interleaved layout
+ *     PixelStride = NumChannels, RowStride = NumChannels*Width,
+ *     ChannelStride = 1,
+ * padded rows (RowStride larger than the row), and crops of a larger image
+ * (Data pointing into the larger image and the strides of the larger image).
+ * A view does not own its data.
+ */
+typedef struct
+{
+    /** @brief Pointer to channel 0 of pixel (0,0) */
+    float *Data;
+    /** @brief Image width */
+    int Width;
+    /** @brief Image height */
+    int Height;
+    /** @brief Number of channels */
+    int NumChannels;
+    /** @brief Step between horizontally adjacent pixels */
+    int PixelStride;
+    /** @brief Step between vertically adjacent pixels */
+    int RowStride;
+    /** @brief Step between channels of the same pixel */
+    int ChannelStride;
+    /** @brief Memory block owned by the view, NULL in this program */
+    void *Base;
+} imageview;
+
+/** @brief Pointer to channel c of pixel (x,y) of a view */
+#define IMAGEVIEW_PTR(View, x, y, c) ((View).Data + (View).PixelStride*(x) \
+    + (View).RowStride*(y) + (View).ChannelStride*(c))
+
+#endif /* _IMAGEVIEW_H_ */
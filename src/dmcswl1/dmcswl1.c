@@ -18,6 +18,7 @@
  */
 
 #include <math.h>
+#include <stdio.h>
 #include <string.h>
 #include <ipol/basic.h>
 #include "conv.h"
@@ -45,6 +46,11 @@
 /** @brief mu = gamma_2 / (2 NUMNEIGH gamma_1) */
 #define MU        (GAMMA2/(2*NUMNEIGH*GAMMA1))
 
+/** @brief Identifies a CSWL1Demosaic checkpoint file */
+#define CHECKPOINT_MAGIC        "CSWL1CP1"
+/** @brief Number of unsigned long fields in a checkpoint file header */
+#define CHECKPOINT_NUMFIELDS    4
+
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 
@@ -524,6 +530,8 @@ static int ConstantExtension(int n, int N)
  * @param RedX, RedY the coordinates of the upper-leftmost red pixel
  * @param Epsilon edge weight for weak links in the graph
  * @param Sigma graph filtering parameter
+ * @param ConvTemp workspace with space for Width*Height floats
+ * @param Stencil workspace with space for Width*Height ints
  *
  * This function constructs the weighted graph that will be used for the graph
  * regularization in the contour stencil demosaicking.
@@ -543,19 +551,14 @@ static int ConstantExtension(int n, int N)
  * orientations are stored in NeighWeights.
  */
 int ConstructGraph(float (*Weight)[NUMNEIGH], const float *Mosaic,
-    int Width, int Height, int RedX, int RedY, float Epsilon, float Sigma)
+    int Width, int Height, int RedX, int RedY, float Epsilon, float Sigma,
+    float *ConvTemp, int *Stencil)
 {
-    const int NumPixels = Width*Height;
     boundaryext Boundary = GetBoundaryExt("wsym");
     filter SmoothFilter = {NULL, 0, 0};
-    float *ConvTemp = NULL;
-    int *Stencil = NULL;
     int i, j, n, x, y, Success = 0;
     
-    if(!(ConvTemp = (float *)Malloc(sizeof(float)*NumPixels))
-        || !(Stencil = (int *)Malloc(sizeof(int)*NumPixels))
-        || IsNullFilter(SmoothFilter
-            = GaussianFilter(Sigma, (int)ceil(4*Sigma))))
+    if(IsNullFilter(SmoothFilter = GaussianFilter(Sigma, (int)ceil(4*Sigma))))
         goto Catch;
     
     /* Estimate the contour orientations using mosaiced contour stencils */
@@ -603,8 +606,6 @@ int ConstructGraph(float (*Weight)[NUMNEIGH], const float *Mosaic,
     Success = 1;
 Catch:
     FreeFilter(SmoothFilter);
-    Free(Stencil);
-    Free(ConvTemp);
     return Success;
 }
 
@@ -721,6 +722,175 @@ float EvaluateCSWL1Energy(const float *Image, int Width, int Height,
 }
 
 
+/** @brief Update a 32-bit FNV-1a hash with Size bytes of Data */
+static uint32_t HashBytes(uint32_t Hash, const void *Data, long Size)
+{
+    const unsigned char *Bytes = (const unsigned char *)Data;
+    long i;
+    
+    for(i = 0; i < Size; i++)
+        Hash = (uint32_t)((Hash ^ Bytes[i]) * 16777619UL);
+    
+    return Hash;
+}
+
+
+/**
+ * @brief Save the demosaicing state to a checkpoint file
+ * @param CheckpointFile the file name
+ * @param Hash hash of the mosaiced image and parameters
+ * @param Iter number of completed iterations
+ * @param Image, d, dtilde, b the solver state
+ * @param Width, Height the image dimensions
+ * @return 1 on success, 0 on failure
+ *
+ * The state is written to CheckpointFile.tmp, which is then renamed to
+ * CheckpointFile, so that the file always holds a complete checkpoint.
+ */
+static int SaveCheckpoint(const char *CheckpointFile, uint32_t Hash,
+    int Iter, const float *Image, float (*d)[NUMNEIGH][3],
+    float (*dtilde)[NUMNEIGH][3], const float *b, int Width, int Height)
+{
+    const size_t NumPixels = ((size_t)Width)*((size_t)Height);
+    unsigned long Header[CHECKPOINT_NUMFIELDS];
+    char *TempFile = NULL;
+    FILE *File = NULL;
+    int Closed, Success = 0;
+    
+    Header[0] = Width;
+    Header[1] = Height;
+    Header[2] = Hash;
+    Header[3] = Iter;
+    
+    if(!(TempFile = (char *)Malloc(strlen(CheckpointFile) + 5)))
+        goto Catch;
+    
+    sprintf(TempFile, "%s.tmp", CheckpointFile);
+    
+    if(!(File = fopen(TempFile, "wb"))
+        || fwrite(CHECKPOINT_MAGIC, 1, 8, File) != 8
+        || fwrite(Header, sizeof(unsigned long), CHECKPOINT_NUMFIELDS, File)
+            != CHECKPOINT_NUMFIELDS
+        || fwrite(Image, sizeof(float), 3*NumPixels, File) != 3*NumPixels
+        || fwrite(d, sizeof(float)*NUMNEIGH*3, NumPixels, File) != NumPixels
+        || fwrite(dtilde, sizeof(float)*NUMNEIGH*3, NumPixels, File)
+            != NumPixels
+        || fwrite(b, sizeof(float), NumPixels, File) != NumPixels)
+        goto Catch;
+    
+    Closed = !fclose(File);
+    File = NULL;
+    
+    /* Replace the previous checkpoint.  Where rename does not overwrite an
+       existing file, remove the old checkpoint first. */
+    if(!Closed || (rename(TempFile, CheckpointFile)
+        && (remove(CheckpointFile) || rename(TempFile, CheckpointFile))))
+        goto Catch;
+    
+    Success = 1;
+Catch:
+    if(File)
+        fclose(File);
+    if(!Success)
+    {
+        ErrorMessage("Warning: unable to write checkpoint \"%s\".\n",
+            CheckpointFile);
+        
+        if(TempFile)
+            remove(TempFile);
+    }
+    Free(TempFile);
+    return Success;
+}
+
+
+/**
+ * @brief Restore the demosaicing state from a checkpoint file
+ * @param MaxIter maximum number of iterations
+ * @param Iter set to the number of completed iterations
+ * @return 1 if the state was restored, 0 otherwise
+ *
+ * If CheckpointFile does not exist, is for a different image or different
+ * parameters, is beyond MaxIter, or is truncated, it is ignored and 0 is
+ * returned.  The state may then be partly overwritten and must be
+ * initialized again.  The other parameters are as in SaveCheckpoint().
+ */
+static int LoadCheckpoint(const char *CheckpointFile, uint32_t Hash,
+    int MaxIter, int *Iter, float *Image, float (*d)[NUMNEIGH][3],
+    float (*dtilde)[NUMNEIGH][3], float *b, int Width, int Height)
+{
+    const size_t NumPixels = ((size_t)Width)*((size_t)Height);
+    unsigned long Header[CHECKPOINT_NUMFIELDS];
+    char Magic[8];
+    FILE *File;
+    int Success = 0;
+    
+    if(!(File = fopen(CheckpointFile, "rb")))
+        return 0;
+    
+    if(fread(Magic, 1, 8, File) != 8
+        || memcmp(Magic, CHECKPOINT_MAGIC, 8)
+        || fread(Header, sizeof(unsigned long), CHECKPOINT_NUMFIELDS, File)
+            != CHECKPOINT_NUMFIELDS
+        || Header[0] != (unsigned long)Width
+        || Header[1] != (unsigned long)Height || Header[2] != Hash)
+        ErrorMessage("Ignoring checkpoint \"%s\", "
+            "which is for a different problem.\n", CheckpointFile);
+    else if(Header[3] > (unsigned long)MaxIter)
+        ErrorMessage("Ignoring checkpoint \"%s\", "
+            "which exceeds the iteration limit.\n", CheckpointFile);
+    else if(fread(Image, sizeof(float), 3*NumPixels, File) != 3*NumPixels
+        || fread(d, sizeof(float)*NUMNEIGH*3, NumPixels, File) != NumPixels
+        || fread(dtilde, sizeof(float)*NUMNEIGH*3, NumPixels, File)
+            != NumPixels
+        || fread(b, sizeof(float), NumPixels, File) != NumPixels)
+        ErrorMessage("Ignoring checkpoint \"%s\", which is truncated.\n",
+            CheckpointFile);
+    else
+    {
+        *Iter = (int)Header[3];
+        Success = 1;
+    }
+    
+    fclose(File);
+    return Success;
+}
+
+
+/**
+ * @brief Set the initial demosaicing state
+ *
+ * The initial solution is bilinear demosaicing of Mosaic, and d, dtilde,
+ * and b are zero.
+ */
+static void InitState(float *Image, float (*d)[NUMNEIGH][3],
+    float (*dtilde)[NUMNEIGH][3], float *b, const float *Mosaic,
+    int Width, int Height, int RedX, int RedY)
+{
+    const int NumPixels = Width*Height;
+    int Channel, i, n;
+    
+    /* Use bilinear demosaicking as the initial solution */
+    BilinearDemosaic(Image, Mosaic, Width, Height, RedX, RedY);
+    
+    /* Initialize d, dtilde, and b to zero.  Note that it is not safely
+       portable to use calloc or memset for this purpose.
+       http://c-faq.com/malloc/calloc.html  */
+    for(i = 0; i < NumPixels; i++)
+        for(n = 0; n < NUMNEIGH; n++)
+            for(Channel = 0; Channel < 3; Channel++)
+                d[i][n][Channel] = 0;
+            
+    for(i = 0; i < NumPixels; i++)
+        for(n = 0; n < NUMNEIGH; n++)
+            for(Channel = 0; Channel < 3; Channel++)
+                dtilde[i][n][Channel] = 0;
+            
+    for(i = 0; i < NumPixels; i++)
+        b[i] = 0;
+}
+
+
 /**
  * @brief Contour stencils weighted L1 demosaicing
  * @param Image the input RGB image in planar row-major order
@@ -750,63 +920,123 @@ float EvaluateCSWL1Energy(const float *Image, int Width, int Height,
 int CSWL1Demosaic(float *Image, int Width, int Height,
     int RedX, int RedY, float Alpha, float Epsilon, float Sigma,
     float Tol, int MaxIter, int ShowEnergy)
+{
+    return CSWL1DemosaicEx(Image, Width, Height, RedX, RedY, Alpha, Epsilon,
+        Sigma, Tol, MaxIter, ShowEnergy, NULL, 0, 0, NULL, NULL);
+}
+
+
+/**
+ * @brief Workspace size needed for CSWL1DemosaicEx()
+ * @param Width, Height the image dimensions
+ * @return required workspace size in units of floats
+ *
+ * The workspace is also large enough for any smaller image.
+ */
+long CSWL1DemosaicWorkspaceSize(int Width, int Height)
+{
+    /* Weight, d, dtilde, b, Mosaic */
+    return (NUMNEIGH + 2*3*NUMNEIGH + 2)*((long)Width)*((long)Height);
+}
+
+
+/**
+ * @brief Contour stencils weighted L1 demosaicing with checkpointing and a
+ *        time limit
+ * @param CheckpointFile checkpoint file name, or NULL
+ * @param CheckpointInterval number of iterations between checkpoints
+ * @param TimeLimit time limit in milliseconds, or 0 for no limit
+ * @param DiffNorm if non-NULL, set to the relative change in the last
+ *        iteration, the quantity compared with Tol
+ * @param Workspace array with space for CSWL1DemosaicWorkspaceSize() floats,
+ *        or NULL to allocate the workspace internally
+ * @return 0 on failure, 1 on success, 2 if stopped by the time limit
+ *
+ * This is CSWL1Demosaic() with the solver state (u, d, dtilde, and b) saved
+ * to CheckpointFile every CheckpointInterval iterations.  If CheckpointFile
+ * exists when the routine starts and is for the same mosaiced image and
+ * parameters, the iterations continue from the saved state, exactly as the
+ * interrupted run would have.  Otherwise it is ignored with a warning.  The
+ * file is deleted when the demosaicing completes.
+ *
+ * With a positive TimeLimit, the iterations stop once TimeLimit milliseconds
+ * have passed since the start of the computation, and the current iterate
+ * is returned.  The clock is checked between iterations, so the limit may be
+ * exceeded by about one iteration.  The state is then saved to
+ * CheckpointFile, if set, so that a later call continues the computation.
+ *
+ * The file is in the machine's native byte order and is meant for resuming
+ * on the same system, for example after a batch job is preempted.
+ *
+ * The arrays of the computation are carved from Workspace, so that a caller
+ * demosaicing many images can allocate it once and reuse it.  Its contents
+ * on entry do not matter and are overwritten.  The other parameters are as
+ * in CSWL1Demosaic().
+ */
+int CSWL1DemosaicEx(float *Image, int Width, int Height,
+    int RedX, int RedY, float Alpha, float Epsilon, float Sigma,
+    float Tol, int MaxIter, int ShowEnergy,
+    const char *CheckpointFile, int CheckpointInterval,
+    unsigned long TimeLimit, float *DiffNorm, float *Workspace)
 {
     const int NumPixels = Width*Height;
-    const int NumEl = 3*NumPixels;
-    float *Mosaic = NULL, (*Weight)[NUMNEIGH] = NULL, *b = NULL;
-    float (*d)[NUMNEIGH][3] = NULL, (*dtilde)[NUMNEIGH][3] = NULL;
+    float *Mosaic, (*Weight)[NUMNEIGH], *b;
+    float (*d)[NUMNEIGH][3], (*dtilde)[NUMNEIGH][3];
+    float *OwnWorkspace = NULL;
     double InputNorm;
     unsigned long StartTime;
-    float DiffNorm = 0;
-    int *Stencil = NULL;
-    int Iter, Channel, i, n, Success = 0;
-    
-    /* Allocate memory */
-    if(!(Weight = (float (*)[NUMNEIGH])
-            Malloc(sizeof(float)*NUMNEIGH*NumPixels))
-        || !(d = (float (*)[NUMNEIGH][3])
-            Malloc(sizeof(float)*NUMNEIGH*NumEl))
-        || !(dtilde = (float (*)[NUMNEIGH][3])
-            Malloc(sizeof(float)*NUMNEIGH*NumEl))
-        || !(b = (float *)Malloc(sizeof(float)*NumPixels))
-        || !(Mosaic = (float *)Malloc(sizeof(float)*NumPixels)))
+    uint32_t Hash = 0;
+    float Diff = 0, TolScale;
+    int Iter, FirstIter = 0, TimedOut = 0, i, Success = 0;
+    
+    /* Allocate memory, unless the caller did */
+    if(!Workspace && !(Workspace = OwnWorkspace = (float *)Malloc(
+        sizeof(float)*CSWL1DemosaicWorkspaceSize(Width, Height))))
         goto Catch;
     
+    /* Partition the workspace */
+    Weight = (float (*)[NUMNEIGH])Workspace;
+    d = (float (*)[NUMNEIGH][3])(Workspace + NUMNEIGH*NumPixels);
+    dtilde = d + NumPixels;
+    b = (float *)(dtilde + NumPixels);
+    Mosaic = b + NumPixels;
+    
     /* Start the timer */
     StartTime = Clock();
     
     /* Flatten the input mosaiced image into a 2D array */
     CfaFlatten(Mosaic, Image, Width, Height, RedX, RedY);
     
-    /* Build the graph */
+    /* Build the graph, using d and dtilde as scratch space before they are
+       initialized */
     if(!ConstructGraph(Weight, Mosaic, Width, Height,
-        RedX, RedY, Epsilon, Sigma))
+        RedX, RedY, Epsilon, Sigma, (float *)d, (int *)dtilde))
         goto Catch;
     
     /* Scale Tol by the norm of the mosaiced image */
     for(i = 0, InputNorm = 0; i < NumPixels; i++)
         InputNorm += Mosaic[i]*Mosaic[i];
     
-    Tol *= (float)sqrt(InputNorm);
+    TolScale = (float)sqrt(InputNorm);
+    Tol *= TolScale;
     
-    /* Use bilinear demosaicking as the initial solution */
-    BilinearDemosaic(Image, Mosaic, Width, Height, RedX, RedY);
+    /* Resume from the checkpoint file if it is for this problem,
+       otherwise start from the initial state */
+    if(CheckpointFile)
+    {
+        Hash = HashBytes((uint32_t)2166136261UL,
+            Mosaic, sizeof(float)*NumPixels);
+        Hash = HashBytes(Hash, &RedX, sizeof(int));
+        Hash = HashBytes(Hash, &RedY, sizeof(int));
+        Hash = HashBytes(Hash, &Alpha, sizeof(float));
+        Hash = HashBytes(Hash, &Epsilon, sizeof(float));
+        Hash = HashBytes(Hash, &Sigma, sizeof(float));
+        Hash = HashBytes(Hash, &Tol, sizeof(float));
+    }
     
-    /* Initialize d, dtilde, and b to zero.  Note that it is not safely
-       portable to use calloc or memset for this purpose.
-       http://c-faq.com/malloc/calloc.html  */
-    for(i = 0; i < NumPixels; i++)
-        for(n = 0; n < NUMNEIGH; n++)
-            for(Channel = 0; Channel < 3; Channel++)
-                d[i][n][Channel] = 0;
-            
-    for(i = 0; i < NumPixels; i++)
-        for(n = 0; n < NUMNEIGH; n++)
-            for(Channel = 0; Channel < 3; Channel++)
-                dtilde[i][n][Channel] = 0;
-            
-    for(i = 0; i < NumPixels; i++)
-        b[i] = 0;
+    if(!CheckpointFile || !LoadCheckpoint(CheckpointFile, Hash, MaxIter,
+        &FirstIter, Image, d, dtilde, b, Width, Height))
+        InitState(Image, d, dtilde, b, Mosaic, Width, Height, RedX, RedY);
     
     /* If the ShowEnergy flag is nonzero, we display a table with the
      * iteration count in the first column and energy in the second column.
@@ -823,12 +1053,12 @@ int CSWL1Demosaic(float *Image, int Width, int Height,
     }
     
     /* Bregman iterations */
-    for(Iter = 1; Iter <= MaxIter; Iter++)
+    for(Iter = FirstIter + 1; Iter <= MaxIter; Iter++)
     {
         /* Solve the D-subproblem (updates d and dtilde) */
         DShrink(d, dtilde, Image, Weight, Width, Height, Alpha);
         /* Solve the U-subproblem (updates u and b) */
-        DiffNorm = UGaussSeidel(Image, b, dtilde, Mosaic,
+        Diff = UGaussSeidel(Image, b, dtilde, Mosaic,
             Width, Height, RedX, RedY);
         
         if(ShowEnergy)
@@ -836,29 +1066,50 @@ int CSWL1Demosaic(float *Image, int Width, int Height,
                 EvaluateCSWL1Energy(Image, Width, Height,
                     RedX, RedY, Alpha, Weight, Mosaic));
         
-        if(DiffNorm <= Tol && Iter > 2)
+        if(Diff <= Tol && Iter > 2)
         {
             printf("Converged in %d iterations.\n", Iter);
             break;
         }
+        
+        if(CheckpointFile && CheckpointInterval > 0
+            && (Iter - FirstIter) % CheckpointInterval == 0)
+            SaveCheckpoint(CheckpointFile, Hash, Iter,
+                Image, d, dtilde, b, Width, Height);
+        
+        if(TimeLimit > 0 && Clock() - StartTime >= TimeLimit)
+        {
+            printf("Time limit reached after %d iterations.\n", Iter);
+            TimedOut = 1;
+            break;
+        }
     }
     
-    if(Iter > MaxIter && !(DiffNorm <= Tol))
+    if(Iter > MaxIter && !(Diff <= Tol))
         printf("Maximum number of iterations exceeded.\n");
     
+    if(DiffNorm)
+        *DiffNorm = (TolScale > 0) ? Diff / TolScale : Diff;
+    
+    /* The computation is complete, the checkpoint is no longer needed.  If
+       it was stopped by the time limit, save the state for continuing. */
+    if(CheckpointFile)
+    {
+        if(!TimedOut)
+            remove(CheckpointFile);
+        else
+            SaveCheckpoint(CheckpointFile, Hash, Iter,
+                Image, d, dtilde, b, Width, Height);
+    }
+    
     /* Ensure that final solution matches input data on the CFA. */
     CopyCfaValues(Image, Mosaic, Width, Height, RedX, RedY);
     
     /* Print the time it took to perform the demosaicking */
     printf("CPU Time: %.3f s\n", 0.001f*(Clock() - StartTime));
     
-    Success = 1;
+    Success = (TimedOut) ? 2 : 1;
 Catch:
-    Free(Stencil);
-    Free(b);
-    Free(Mosaic);
-    Free(dtilde);
-    Free(d);
-    Free(Weight);
+    Free(OwnWorkspace);
     return Success;
 }
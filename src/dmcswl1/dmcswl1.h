@@ -19,6 +19,12 @@
 int CSWL1Demosaic(float *Image, int Width, int Height,
     int RedX, int RedY, float Alpha, float Epsilon, float Sigma,
     float Tol, int MaxIter, int ShowEnergy);
+int CSWL1DemosaicEx(float *Image, int Width, int Height,
+    int RedX, int RedY, float Alpha, float Epsilon, float Sigma,
+    float Tol, int MaxIter, int ShowEnergy,
+    const char *CheckpointFile, int CheckpointInterval,
+    unsigned long TimeLimit, float *DiffNorm, float *Workspace);
+long CSWL1DemosaicWorkspaceSize(int Width, int Height);
 
 int DisplayContours(const float *Image, int Width, int Height,
     int RedX, int RedY, const char *OutputFile);
@@ -31,6 +31,7 @@
 #define DEFAULT_SIGMA           0.6
 #define DEFAULT_TOL             0.001
 #define DEFAULT_MAXITER         250
+#define CHECKPOINT_INTERVAL     10
 
 /* Print verbose information if nonzero */
 #define VERBOSE 1
@@ -63,6 +64,8 @@ typedef struct
     float Tol;
     /** @brief Maximum number of iterations */
     int MaxIter;
+    /** @brief Checkpoint file name, or NULL for no checkpointing */
+    char *CheckpointFile;
 } programparams;
 
 
@@ -88,7 +91,9 @@ static void PrintHelpMessage()
     printf("   -e <number>   epsilon, graph weight (default 0.15)\n");
     printf("   -f <number>   sigma, graph spatial filtering parameter (default 0.6)\n");
     printf("   -t <number>   convergence tolerance (default 0.001)\n");
-    printf("   -m <number>   maximum number of iterations (default 250)\n\n");
+    printf("   -m <number>   maximum number of iterations (default 250)\n");
+    printf("   -c <file>     save progress to <file> every 10 iterations and\n"
+           "                 resume from it if it exists\n\n");
 #ifdef USE_LIBJPEG
     printf("   -q <number>   Quality for saving JPEG images (0 to 100)\n\n");
 #endif
@@ -131,9 +136,10 @@ int main(int argc, char *argv[])
     else
     {
         /* Perform demosaicing */
-        if(!(CSWL1Demosaic(Image, Width, Height, Param.RedX, Param.RedY,
-            Param.Alpha, Param.Epsilon, Param.Sigma,
-            Param.Tol, Param.MaxIter, Param.ShowEnergy)))
+        if(!(CSWL1DemosaicEx(Image, Width, Height,
+            Param.RedX, Param.RedY, Param.Alpha, Param.Epsilon, Param.Sigma,
+            Param.Tol, Param.MaxIter, Param.ShowEnergy,
+            Param.CheckpointFile, CHECKPOINT_INTERVAL, 0, NULL, NULL)))
         {
             ErrorMessage("Error in computation.\n");
             goto Catch;
@@ -186,6 +192,7 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->Sigma = (float)DEFAULT_SIGMA;
     Param->Tol = (float)DEFAULT_TOL;
     Param->MaxIter = DEFAULT_MAXITER;
+    Param->CheckpointFile = NULL;
     
     for(i = 1; i < argc;)
     {
@@ -290,6 +297,9 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
                     return 0;
                 }
                 break;
+            case 'c':
+                Param->CheckpointFile = OptionString;
+                break;
                 
 #ifdef USE_LIBJPEG
             case 'q':
@@ -25,3 +25,10 @@ opts="-N $N -s $sigma -a $algo -K $K -t $tol -r $runs"
 ./gaussian_bench impulse $opts
 # Plot the response with Gnuplot
 gnuplot plotimpulse.gp
+
+# Compare direct and FFT-based FIR filtering over sigma to find the radius
+# where FFT becomes faster (the default FIR_FFT_RADIUS is an estimate)
+for s in 4 8 12 16 24 32; do
+    ./gaussian_bench speed -N 10000 -s $s -a fir_direct -t $tol -r 1000
+    ./gaussian_bench speed -N 10000 -s $s -a fir_fft -t $tol -r 1000
+done
@@ -0,0 +1,119 @@
+/**
+ * \file cpu_dispatch.c
+ * \brief Runtime selection of instruction set specific kernels
+ *
+ * The interior loops of the recursive filters are compiled once per
+ * instruction set level, and get_cpu_level() selects the variant to run,
+ * so that a build without -m or -march flags still uses AVX2 or AVX-512
+ * where the CPU has them.
+ *
+ * For benchmarking, the level can be lowered by setting the environment
+ * variable CPU_DISPATCH to "baseline", "sse2", "avx2", or "avx512". A
+ * level above the detected one is clamped to it, and an unknown value is
+ * reported and ignored.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include "cpu_dispatch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** \brief Number of instruction set levels */
+#define NUM_CPU_LEVELS      4
+
+static const char *cpu_level_names[NUM_CPU_LEVELS] =
+    {"baseline", "sse2", "avx2", "avx512"};
+
+/* The cached level is accessed atomically, so that threads calling
+   get_cpu_level() concurrently agree on it and only one of them reports an
+   unknown CPU_DISPATCH value. */
+#if defined(__clang__) || (defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define LOAD_LEVEL(ptr)     __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define CAS_LEVEL(ptr, expected, desired) \
+    __atomic_compare_exchange_n(ptr, &(expected), desired, 0, \
+    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define LOAD_LEVEL(ptr)     _InterlockedCompareExchange(ptr, -1, -1)
+#define CAS_LEVEL(ptr, expected, desired) \
+    (_InterlockedCompareExchange(ptr, desired, expected) == (expected))
+#else
+/* Without atomics, get_cpu_level() should be called before starting
+   threads. */
+#define LOAD_LEVEL(ptr)     (*(ptr))
+#define CAS_LEVEL(ptr, expected, desired) \
+    ((*(ptr) == (expected)) ? (*(ptr) = (desired), 1) : 0)
+#endif
+
+/** \brief Detect the instruction set level of the running CPU */
+static cpu_level detect_cpu_level(void)
+{
+#ifdef CPU_DISPATCH_TARGETS
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return CPU_AVX512;
+    else if (__builtin_cpu_supports("avx2"))
+        return CPU_AVX2;
+    else if (__builtin_cpu_supports("sse2"))
+        return CPU_SSE2;
+#endif
+    return CPU_BASELINE;
+}
+
+/**
+ * \brief Instruction set level for selecting kernel variants
+ * \return the detected level, or the CPU_DISPATCH override if lower
+ *
+ * The level is determined on the first call and cached. The function may
+ * be called from several threads.
+ */
+cpu_level get_cpu_level(void)
+{
+    static volatile long level = -1;
+    const char *override;
+    long cached = LOAD_LEVEL(&level), expected = -1;
+    int detected, i;
+
+    if (cached >= 0)
+        return (cpu_level)cached;
+
+    if ((override = getenv("CPU_DISPATCH")) && !*override)
+        override = NULL;
+
+    detected = detect_cpu_level();
+
+    for (i = 0; i < NUM_CPU_LEVELS; ++i)
+        if (override && !strcmp(override, cpu_level_names[i]))
+            break;
+
+    cached = (i < detected) ? i : detected;
+
+    if (!CAS_LEVEL(&level, expected, cached))
+        return (cpu_level)LOAD_LEVEL(&level);
+
+    if (override && i == NUM_CPU_LEVELS)
+        fprintf(stderr, "Warning: Unknown CPU_DISPATCH value \"%s\" "
+            "ignored, expected baseline, sse2, avx2, or avx512.\n",
+            override);
+
+    return (cpu_level)cached;
+}
+
+/** \brief Name of an instruction set level, as accepted by CPU_DISPATCH */
+const char *cpu_level_name(cpu_level level)
+{
+    return ((int)level >= 0 && level < NUM_CPU_LEVELS) ?
+        cpu_level_names[level] : "unknown";
+}
@@ -0,0 +1,44 @@
+/**
+ * \file cpu_dispatch.h
+ * \brief Runtime selection of instruction set specific kernels
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _CPU_DISPATCH_H_
+#define _CPU_DISPATCH_H_
+
+/* Compilers that can build a function for a given x86 instruction set with
+   __attribute__((target)) and detect the running CPU with
+   __builtin_cpu_supports. Otherwise only the baseline kernels are built. */
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+/** \brief Defined if kernels are built for several instruction sets */
+#define CPU_DISPATCH_TARGETS
+/** \brief Attribute building a function for the specified instruction set */
+#define ATTRIBUTE_TARGET(isa)   __attribute__((target(isa)))
+#else
+#define ATTRIBUTE_TARGET(isa)
+#endif
+
+/** \brief Instruction set levels, in increasing order of capability */
+typedef enum
+{
+    CPU_BASELINE = 0,
+    CPU_SSE2 = 1,
+    CPU_AVX2 = 2,
+    CPU_AVX512 = 3
+} cpu_level;
+
+cpu_level get_cpu_level(void);
+const char *cpu_level_name(cpu_level level);
+
+#endif /* _CPU_DISPATCH_H_ */
@@ -0,0 +1,143 @@
+/**
+ * \file deriche_conv_inc.c
+ * \brief Interior of Deriche's recursive filtering
+ *
+ * This file is included by gaussian_conv_deriche.c once for each
+ * instruction set level, with DERICHE_CONV_FUNC defined as the name of the
+ * function to define and DERICHE_CONV_ISA as the target, or not defined
+ * for the baseline.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * \brief Deriche Gaussian convolution of a signal with N > 4
+ * \param c         coefficients precomputed by deriche_precomp()
+ * \param dest      output convolved data
+ * \param buffer    workspace array with space for at least 2 * N elements
+ * \param src       input, overwritten if src = dest
+ * \param N         number of samples
+ * \param stride    stride between successive samples
+ * \ingroup deriche_gaussian
+ *
+ * This is the body of deriche_gaussian_conv(), see there.
+ */
+static
+#ifdef DERICHE_CONV_ISA
+ATTRIBUTE_TARGET(DERICHE_CONV_ISA)
+#endif
+void DERICHE_CONV_FUNC(deriche_coeffs c,
+    num *dest, num *buffer, const num *src, long N, long stride)
+{
+    const long stride_2 = stride * 2;
+    const long stride_3 = stride * 3;
+    const long stride_4 = stride * 4;
+    const long stride_N = stride * N;
+    num *y_causal, *y_anticausal;
+    long i, n;
+    
+    /* Divide buffer into two buffers each of length N. */
+    y_causal = buffer;
+    y_anticausal = buffer + N;
+    
+    /* Initialize the causal filter on the left boundary. */
+    init_recursive_filter(y_causal, src, N, stride,
+        c.b_causal, c.K - 1, c.a, c.K, c.sum_causal, c.tol, c.max_iter);
+    
+    /* The following filters the interior samples according to the filter
+       order c.K. The loops below implement the pseudocode
+       
+       For n = K, ..., N - 1,
+           y^+(n) = \sum_{k=0}^{K-1} b^+_k src(n - k)
+                    - \sum_{k=1}^K a_k y^+(n - k)
+       
+       Variable i tracks the offset to the nth sample of src, it is
+       updated together with n such that i = stride * n. */
+    switch (c.K)
+    {
+    case 2:
+        for (n = 2, i = stride_2; n < N; ++n, i += stride)
+            y_causal[n] = c.b_causal[0] * src[i]
+                + c.b_causal[1] * src[i - stride]
+                - c.a[1] * y_causal[n - 1]
+                - c.a[2] * y_causal[n - 2];
+        break;
+    case 3:
+        for (n = 3, i = stride_3; n < N; ++n, i += stride)
+            y_causal[n] = c.b_causal[0] * src[i]
+                + c.b_causal[1] * src[i - stride]
+                + c.b_causal[2] * src[i - stride_2]
+                - c.a[1] * y_causal[n - 1]
+                - c.a[2] * y_causal[n - 2]
+                - c.a[3] * y_causal[n - 3];
+        break;
+    case 4:
+        for (n = 4, i = stride_4; n < N; ++n, i += stride)
+            y_causal[n] = c.b_causal[0] * src[i]
+                + c.b_causal[1] * src[i - stride]
+                + c.b_causal[2] * src[i - stride_2]
+                + c.b_causal[3] * src[i - stride_3]
+                - c.a[1] * y_causal[n - 1]
+                - c.a[2] * y_causal[n - 2]
+                - c.a[3] * y_causal[n - 3]
+                - c.a[4] * y_causal[n - 4];
+        break;
+    }
+    
+    /* Initialize the anticausal filter on the right boundary. */
+    init_recursive_filter(y_anticausal, src + stride_N - stride, N, -stride,
+        c.b_anticausal, c.K, c.a, c.K, c.sum_anticausal, c.tol, c.max_iter);
+    
+    /* Similar to the causal filter code above, the following implements
+       the pseudocode
+       
+       For n = K, ..., N - 1,
+           y^-(n) = \sum_{k=1}^K b^-_k src(N - n - 1 - k)
+                    - \sum_{k=1}^K a_k y^-(n - k)
+     
+       Variable i is updated such that i = stride * (N - n - 1). */
+    switch (c.K)
+    {
+    case 2:
+        for (n = 2, i = stride_N - stride_3; n < N; ++n, i -= stride)
+            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
+                + c.b_anticausal[2] * src[i + stride_2]
+                - c.a[1] * y_anticausal[n - 1]
+                - c.a[2] * y_anticausal[n - 2];
+        break;
+    case 3:
+        for (n = 3, i = stride_N - stride_4; n < N; ++n, i -= stride)
+            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
+                + c.b_anticausal[2] * src[i + stride_2]
+                + c.b_anticausal[3] * src[i + stride_3]
+                - c.a[1] * y_anticausal[n - 1]
+                - c.a[2] * y_anticausal[n - 2]
+                - c.a[3] * y_anticausal[n - 3];
+        break;
+    case 4:
+        for (n = 4, i = stride_N - stride * 5; n < N; ++n, i -= stride)
+            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
+                + c.b_anticausal[2] * src[i + stride_2]
+                + c.b_anticausal[3] * src[i + stride_3]
+                + c.b_anticausal[4] * src[i + stride_4]
+                - c.a[1] * y_anticausal[n - 1]
+                - c.a[2] * y_anticausal[n - 2]
+                - c.a[3] * y_anticausal[n - 3]
+                - c.a[4] * y_anticausal[n - 4];
+        break;
+    }
+    
+    /* Sum the causal and anticausal responses to obtain the final result. */
+    for (n = 0, i = 0; n < N; ++n, i += stride)
+        dest[i] = y_causal[n] + y_anticausal[N - n - 1];
+    
+    return;
+}
@@ -103,6 +103,8 @@ gaussian_demo [options] <input> <output>
  * | `<algo>`      | Description                                         |
  * |---------------|-----------------------------------------------------|
  * | `fir`         | FIR approximation, tol = kernel accuracy            |
+ * | `fir_direct`  | FIR, always filtering directly                      |
+ * | `fir_fft`     | FIR, always filtering by overlap-save FFT           |
  * | `dct`         | DCT-based convolution                               |
  * | `box`         | box filtering, K = # passes                         |
  * | `ebox`        | extended box filtering, K = # passes                |
@@ -127,6 +129,9 @@ gaussian_bench [bench type] [options]
  * | `speed`       | measure computation time                            |
  * | `accuracy`    | measure \f$ \ell^\infty \f$ operator norm error     |
  * | `impulse`     | compute impulse response, written to bench.out      |
+ * | `speed3d`     | time 3D filtering of an N x N x N volume            |
+ * | `stream`      | latency and error of streaming deriche or vyv       |
+ * | `integer`     | time 8-bit filtering of an N x N image              |
  *
  * The algorithm and Gaussian standard deviation are specified using the same
  * options as with the gaussian_demo program. Additionally, the following
@@ -134,9 +139,11 @@ gaussian_bench [bench type] [options]
  *
  * | Option        | Description                                         |
  * |---------------|-----------------------------------------------------|
- * | `-N <number>` | signal length                                       |
+ * | `-N <number>` | signal length, or side length for speed3d, integer  |
  * | `-r <number>` | (for speed bench) number of runs                    |
  * | `-n <number>` | (for impulse bench) position of the impulse         |
+ * | `-b <number>` | (for stream bench) block size                       |
+ * | `-p <prec>`   | (speed, accuracy) precision, `single` or `double`   |
  *
  * \subsection Examples
 \verbatim
@@ -157,6 +164,10 @@ demo.sh and bench.sh.
 #include <math.h>
 #include <ipol/basic.h>
 #include "strategy_gaussian_conv.h"
+#include "gaussian_conv_volume.h"
+#include "gaussian_conv_deriche.h"
+#include "gaussian_conv_vyv.h"
+#include "gaussian_conv_int.h"
 #include "filter_util.h"
 
 /** \brief Output file for impulse test */
@@ -181,10 +192,18 @@ void print_usage()
     puts("Bench type:");
     puts("   speed         measure computation time");
     puts("   accuracy      measure L^infty operator norm error");
-    puts("   impulse       impulse response, written to " OUTPUT_FILE "\n");
+    puts("   impulse       impulse response, written to " OUTPUT_FILE);
+    puts("   speed3d       measure computation time of 3D filtering of an");
+    puts("                 N x N x N volume (sii, deriche, vyv)");
+    puts("   stream        latency and error of streaming filtering versus");
+    puts("                 lookahead (deriche, vyv)");
+    puts("   integer       measure computation time of 8-bit filtering of");
+    puts("                 an N x N image (box, ebox, sii)\n");
     puts("Options:");
     puts("   -a <algo>     algorithm to use, choices are");
     puts("                 fir     FIR approximation, tol = kernel accuracy");
+    puts("                 fir_direct  FIR, always direct filtering");
+    puts("                 fir_fft     FIR, always overlap-save FFT filtering");
     puts("                 dct     DCT-based convolution");
     puts("                 box     box filtering, K = # passes");
     puts("                 sii     stacked integral images, K = # boxes");
@@ -199,9 +218,15 @@ void print_usage()
     puts("   -s <number>   sigma, standard deviation of the Gaussian");
     puts("   -K <number>   specifies number of steps (box, sii, am)");
     puts("   -t <number>   accuracy tolerance (fir, am, deriche, vyv)");
-    puts("   -N <number>   signal length\n");
+    puts("   -N <number>   signal length (speed3d, integer: side length)\n");
     puts("   -r <number>   (speed bench) number of runs");
-    puts("   -n <number>   (impulse bench) position of the impulse\n");
+    puts("   -n <number>   (impulse bench) position of the impulse");
+    puts("   -b <number>   (stream bench) block size");
+#ifndef NUM_SINGLE
+    puts("   -p <prec>     (speed, accuracy bench) precision, single or");
+    puts("                 double (default)");
+#endif
+    puts("");
 }
 
 /** \brief struct of program parameters */
@@ -215,16 +240,68 @@ typedef struct
     double sigma;               /**< sigma parameter of the Gaussian       */
     int K;                      /**< Parameter K                           */
     double tol;                 /**< Tolerance                             */
+    long block_size;            /**< Block size for stream bench           */
+    int single;                 /**< Filter with gconv_plan_f()            */
 } program_params;
 
 int parse_params(program_params *param, int argc, char **argv);
 
+int speed_test(program_params p, num *output, num *input);
+int speed3d_test(program_params p);
+int stream_test(program_params p, num *output, num *input);
+int integer_test(program_params p);
+
+#ifndef NUM_SINGLE
+/** \brief Speed test of the single-precision half of the library */
+static int speed_test_single(program_params p)
+{
+    gconv_f *g = NULL;
+    float *output = NULL, *input = NULL;
+    unsigned long time_start, time_stop;
+    long run, n;
+    int success = 0;
+    
+    if (!(output = (float *)malloc(sizeof(float) * p.N))
+        || !(input = (float *)malloc(sizeof(float) * p.N)))
+        goto fail;
+    
+    for (n = 0; n < p.N; ++n)
+        input[n] = (float)rand() / RAND_MAX;
+    
+    if (!(g = gconv_plan_f(output, input, p.N, 1,
+        p.algo, p.sigma, p.K, (float)p.tol)))
+        goto fail;
+    
+    time_start = Clock();
+    
+    for (run = 0; run < p.num_runs; ++run)
+        gconv_execute_f(g);
+        
+    time_stop = Clock();
+    printf("%.5e\n",
+        ((double)(time_stop - time_start)) / p.num_runs);
+    success = 1;
+fail:
+    gconv_free_f(g);
+    if (input)
+        free(input);
+    if (output)
+        free(output);
+    return success;
+}
+#endif
+
 int speed_test(program_params p, num *output, num *input)
 {
     gconv *g = NULL;
     unsigned long time_start, time_stop;
     long run;
     
+#ifndef NUM_SINGLE
+    if (p.single)
+        return speed_test_single(p);
+#endif
+    
     if (!(g = gconv_plan(output, input, p.N, 1,
         p.algo, p.sigma, p.K, p.tol)))
         return 0;
@@ -241,6 +318,309 @@ int speed_test(program_params p, num *output, num *input)
     return 1;
 }
 
+/**
+ * \brief Time 3D filtering of an N x N x N volume
+ *
+ * The same sigma is used along all three axes. The volume is filtered in
+ * place, after a first untimed run that touches the memory.
+ */
+int speed3d_test(program_params p)
+{
+    const long num_samples = p.N * p.N * p.N;
+    unsigned long time_start = 0, time_stop;
+    num *volume = NULL, *buffer = NULL;
+    long run, i;
+    int algo, success = 0;
+    deriche_coeffs dc;
+    vyv_coeffs vc;
+    sii_coeffs sc;
+    
+    if (!strcmp(p.algo, "deriche") && DERICHE_VALID_K(p.K))
+    {
+        algo = 0;
+        deriche_precomp(&dc, p.sigma, p.K, p.tol);
+        buffer = (num *)malloc(sizeof(num)
+            * deriche_volume_buffer_size(p.N, p.N, p.N));
+    }
+    else if (!strcmp(p.algo, "vyv") && VYV_VALID_K(p.K))
+    {
+        algo = 1;
+        vyv_precomp(&vc, p.sigma, p.K, p.tol);
+        buffer = (num *)malloc(sizeof(num)
+            * vyv_volume_buffer_size(p.N, p.N, p.N));
+    }
+    else if (!strcmp(p.algo, "sii") && SII_VALID_K(p.K))
+    {
+        algo = 2;
+        sii_precomp(&sc, p.sigma, p.K);
+        buffer = (num *)malloc(sizeof(num)
+            * sii_volume_buffer_size(sc, sc, sc, p.N, p.N, p.N));
+    }
+    else
+    {
+        fprintf(stderr, "speed3d requires -a sii, deriche, or vyv"
+            " with a valid K\n");
+        return 0;
+    }
+    
+    if (!buffer || !(volume = (num *)malloc(sizeof(num) * num_samples)))
+    {
+        fprintf(stderr, "Out of memory\n");
+        goto fail;
+    }
+    
+    for (i = 0; i < num_samples; ++i)
+        volume[i] = (num)rand() / RAND_MAX;
+    
+    for (run = -1; run < p.num_runs; ++run)
+    {
+        if (run == 0)
+            time_start = Clock();
+        
+        switch (algo)
+        {
+        case 0:
+            deriche_gaussian_conv_volume(dc, dc, dc, volume, buffer, volume,
+                p.N, p.N, p.N, 1);
+            break;
+        case 1:
+            vyv_gaussian_conv_volume(vc, vc, vc, volume, buffer, volume,
+                p.N, p.N, p.N, 1);
+            break;
+        case 2:
+            sii_gaussian_conv_volume(sc, sc, sc, volume, buffer, volume,
+                p.N, p.N, p.N, 1);
+            break;
+        }
+    }
+    
+    time_stop = Clock();
+    printf("%.5e\n",
+        ((double)(time_stop - time_start)) / p.num_runs);
+    success = 1;
+fail:
+    if (volume)
+        free(volume);
+    if (buffer)
+        free(buffer);
+    return success;
+}
+
+/* Stream a signal in pieces of random size and flush, using ds for deriche
+   or else vs. */
+static void stream_signal(deriche_stream *ds, vyv_stream *vs,
+    num *dest, const num *src, long N, long block_size)
+{
+    long num_in, num_out, piece;
+    
+    for (num_in = num_out = 0; num_in < N; num_in += piece)
+    {
+        piece = 1 + rand() % (2 * block_size);
+        
+        if (piece > N - num_in)
+            piece = N - num_in;
+        
+        num_out += (ds)
+            ? deriche_stream_process(ds, dest + num_out, src + num_in, piece)
+            : vyv_stream_process(vs, dest + num_out, src + num_in, piece);
+    }
+    
+    if (ds)
+        deriche_stream_flush(ds, dest + num_out);
+    else
+        vyv_stream_flush(vs, dest + num_out);
+}
+
+/**
+ * \brief Latency and accuracy of streaming filtering versus lookahead
+ *
+ * A random signal of length N is streamed in pieces of random size, and the
+ * result is compared to filtering the whole signal at once. For lookaheads
+ * of 0, 1, ..., 8 sigma, the maximum latency in samples and the maximum
+ * absolute error are printed.
+ *
+ * The stream is then reused, first for a prefix of the signal whose length
+ * is a multiple of the block size and then for the whole signal again. The
+ * reuse error is the maximum difference from the first result, and is zero
+ * if flushing resets the stream.
+ */
+int stream_test(program_params p, num *output, num *input)
+{
+    num *stream_output = NULL, *reuse_output = NULL, *buffer = NULL;
+    deriche_coeffs dc;
+    vyv_coeffs vc;
+    deriche_stream ds;
+    vyv_stream vs;
+    deriche_stream *dsp = NULL;
+    vyv_stream *vsp = NULL;
+    double max_error, reuse_error;
+    const long output_size = p.N + p.block_size + (long)(8 * p.sigma) + 1;
+    long lookahead, prefix_length, n;
+    int m, is_deriche = !strcmp(p.algo, "deriche");
+    
+    if (!(is_deriche && DERICHE_VALID_K(p.K))
+        && !(!strcmp(p.algo, "vyv") && VYV_VALID_K(p.K)))
+    {
+        fprintf(stderr, "stream requires -a deriche or vyv"
+            " with a valid K\n");
+        return 0;
+    }
+    
+    if (!(stream_output = (num *)malloc(sizeof(num) * output_size))
+        || !(reuse_output = (num *)malloc(sizeof(num) * output_size))
+        || !(buffer = (num *)malloc(sizeof(num) * 2 * p.N)))
+        goto fail;
+    
+    for (n = 0; n < p.N; ++n)
+        input[n] = (num)rand() / RAND_MAX;
+    
+    if (!(prefix_length = (p.N / p.block_size) * p.block_size))
+        prefix_length = p.N;
+    
+    if (is_deriche)
+    {
+        deriche_precomp(&dc, p.sigma, p.K, p.tol);
+        deriche_gaussian_conv(dc, output, buffer, input, p.N, 1);
+        dsp = &ds;
+    }
+    else
+    {
+        vyv_precomp(&vc, p.sigma, p.K, p.tol);
+        vyv_gaussian_conv(vc, output, input, p.N, 1);
+        vsp = &vs;
+    }
+    
+    printf("# lookahead\tlatency\tmax error\treuse error\n");
+    
+    for (m = 0; m <= 8; ++m)
+    {
+        lookahead = (long)(m * p.sigma + 0.5);
+        
+        if ((is_deriche && !deriche_stream_init(&ds,
+            dc, p.block_size, lookahead))
+            || (!is_deriche && !vyv_stream_init(&vs,
+            vc, p.block_size, lookahead)))
+            goto fail;
+        
+        stream_signal(dsp, vsp, stream_output, input, p.N, p.block_size);
+        stream_signal(dsp, vsp, reuse_output, input,
+            prefix_length, p.block_size);
+        stream_signal(dsp, vsp, reuse_output, input, p.N, p.block_size);
+        
+        if (is_deriche)
+            deriche_stream_free(&ds);
+        else
+            vyv_stream_free(&vs);
+        
+        for (n = 0, max_error = reuse_error = 0; n < p.N; ++n)
+        {
+            if (fabs(stream_output[n] - output[n]) > max_error)
+                max_error = fabs(stream_output[n] - output[n]);
+            if (fabs(reuse_output[n] - stream_output[n]) > reuse_error)
+                reuse_error = fabs(reuse_output[n] - stream_output[n]);
+        }
+        
+        printf("%ld\t%ld\t%.8e\t%.8e\n", lookahead,
+            lookahead + p.block_size - 1, max_error, reuse_error);
+    }
+    
+    free(buffer);
+    free(reuse_output);
+    free(stream_output);
+    return 1;
+fail:
+    fprintf(stderr, "Out of memory\n");
+    if (buffer)
+        free(buffer);
+    if (reuse_output)
+        free(reuse_output);
+    if (stream_output)
+        free(stream_output);
+    return 0;
+}
+
+/**
+ * \brief Time 8-bit filtering of an N x N image
+ *
+ * The image is filtered in place with box_gaussian_conv_image_u8(),
+ * ebox_gaussian_conv_image_u8(), or sii_gaussian_conv_image_u8().
+ */
+int integer_test(program_params p)
+{
+    const long num_pixels = p.N * p.N;
+    unsigned long time_start, time_stop;
+    unsigned char *image = NULL;
+    ebox_coeffs ec;
+    sii_coeffs sc;
+    long run, i;
+    int algo, success = 0;
+    
+    if (!strcmp(p.algo, "box"))
+        algo = 0;
+    else if (!strcmp(p.algo, "ebox"))
+    {
+        algo = 1;
+        ebox_precomp(&ec, p.sigma, p.K);
+    }
+    else if (!strcmp(p.algo, "sii") && SII_VALID_K(p.K))
+    {
+        algo = 2;
+        sii_precomp(&sc, p.sigma, p.K);
+    }
+    else
+    {
+        fprintf(stderr, "integer requires -a box, ebox, or sii"
+            " with a valid K\n");
+        return 0;
+    }
+    
+    if (!(image = (unsigned char *)malloc(num_pixels)))
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 0;
+    }
+    
+    for (i = 0; i < num_pixels; ++i)
+        image[i] = (unsigned char)(rand() & 255);
+    
+    time_start = Clock();
+    
+    for (run = 0; run < p.num_runs; ++run)
+    {
+        int ok = 0;
+        
+        switch (algo)
+        {
+        case 0:
+            ok = box_gaussian_conv_image_u8(image, image,
+                p.N, p.N, 1, p.sigma, p.K);
+            break;
+        case 1:
+            ok = ebox_gaussian_conv_image_u8(ec, image, image,
+                p.N, p.N, 1);
+            break;
+        case 2:
+            ok = sii_gaussian_conv_image_u8(sc, image, image,
+                p.N, p.N, 1);
+            break;
+        }
+        
+        if (!ok)
+        {
+            fprintf(stderr, "Out of memory\n");
+            goto fail;
+        }
+    }
+    
+    time_stop = Clock();
+    printf("%.5e\n",
+        ((double)(time_stop - time_start)) / p.num_runs);
+    success = 1;
+fail:
+    free(image);
+    return success;
+}
+
 void make_impulse_signal(num *signal, long N, long n0)
 {
     long n;
@@ -251,11 +631,22 @@ void make_impulse_signal(num *signal, long N, long n0)
     signal[n0] = 1;
 }
 
+/**
+ * \brief Accuracy test
+ *
+ * The reference is always the double-precision FIR filter with tolerance
+ * 1e-15, so that with `-p single`, the error includes the rounding of the
+ * single-precision computation.
+ */
 int accuracy_test(program_params p, num *output, num *input)
 {
     double *error_sums = NULL;
     num *output0 = NULL;
     gconv *g0 = NULL, *g = NULL;
+#ifndef NUM_SINGLE
+    float *output_f = NULL, *input_f = NULL;
+    gconv_f *g_f = NULL;
+#endif
     double linf_norm = 0.0;
     long m, n;
     int success = 0;
@@ -263,9 +654,22 @@ int accuracy_test(program_params p, num *output, num *input)
     if (!(error_sums = (double *)malloc(sizeof(double) * p.N))
         || !(output0 = (num *)malloc(sizeof(num) * p.N))
         || !(g0 = gconv_plan(output0, input, p.N, 1,
-            "fir", p.sigma, p.K, 1e-15))
-        || !(g = gconv_plan(output, input, p.N, 1,
-            p.algo, p.sigma, p.K, p.tol)))
+            "fir", p.sigma, p.K, 1e-15)))
+        goto fail;
+    
+#ifndef NUM_SINGLE
+    if (p.single)
+    {
+        if (!(output_f = (float *)malloc(sizeof(float) * p.N))
+            || !(input_f = (float *)malloc(sizeof(float) * p.N))
+            || !(g_f = gconv_plan_f(output_f, input_f, p.N, 1,
+                p.algo, p.sigma, p.K, (float)p.tol)))
+            goto fail;
+    }
+    else
+#endif
+    if (!(g = gconv_plan(output, input, p.N, 1,
+        p.algo, p.sigma, p.K, p.tol)))
         goto fail;
     
     for (n = 0; n < p.N; ++n)
@@ -275,6 +679,20 @@ int accuracy_test(program_params p, num *output, num *input)
     {
         make_impulse_signal(input, p.N, n);
         gconv_execute(g0);
+        
+#ifndef NUM_SINGLE
+        if (p.single)
+        {
+            for (m = 0; m < p.N; ++m)
+                input_f[m] = (float)input[m];
+            
+            gconv_execute_f(g_f);
+            
+            for (m = 0; m < p.N; ++m)
+                output[m] = output_f[m];
+        }
+        else
+#endif
         gconv_execute(g);
         
         for (m = 0; m < p.N; ++m)
@@ -290,6 +708,13 @@ int accuracy_test(program_params p, num *output, num *input)
 fail:
     gconv_free(g0);
     gconv_free(g);
+#ifndef NUM_SINGLE
+    gconv_free_f(g_f);
+    if (input_f)
+        free(input_f);
+    if (output_f)
+        free(output_f);
+#endif
     if (output0)
         free(output0);
     if (error_sums)
@@ -376,6 +801,21 @@ int main(int argc, char **argv)
         if (!impulse_test(param, output, input))
             goto fail;
     }
+    else if (!strcmp(param.bench_type, "stream"))
+    {
+        if (!stream_test(param, output, input))
+            goto fail;
+    }
+    else if (!strcmp(param.bench_type, "integer"))
+    {
+        if (!integer_test(param))
+            goto fail;
+    }
+    else if (!strcmp(param.bench_type, "speed3d"))
+    {
+        if (!speed3d_test(param))
+            goto fail;
+    }
     else
     {
         fprintf(stderr, "Invalid bench type \"%s\"\n", param.bench_type);
@@ -417,6 +857,8 @@ int parse_params(program_params *param, int argc, char **argv)
     param->algo = default_algo;
     param->K = 3;
     param->tol = 1e-2;
+    param->block_size = 64;
+    param->single = 0;
     
     for (i = 2; i < argc;)
     {
@@ -491,6 +933,28 @@ int parse_params(program_params *param, int argc, char **argv)
             case 'n':   /* Impulse position. */
                 param->n0 = atoi(option_string);
                 break;
+            case 'b':   /* Block size for stream bench. */
+                param->block_size = atol(option_string);
+                
+                if (param->block_size < 5)
+                {
+                    fprintf(stderr, "Block size must be at least 5.\n");
+                    return 0;
+                }
+                break;
+#ifndef NUM_SINGLE
+            case 'p':   /* Precision of speed and accuracy benches. */
+                if (!strcmp(option_string, "single"))
+                    param->single = 1;
+                else if (!strcmp(option_string, "double"))
+                    param->single = 0;
+                else
+                {
+                    fprintf(stderr, "Precision must be single or double.\n");
+                    return 0;
+                }
+                break;
+#endif
             case '-':
                 print_usage();
                 return 0;
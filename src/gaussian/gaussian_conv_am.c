@@ -161,33 +161,71 @@ void am_gaussian_conv_image(num *dest, const num *src,
     num sigma, int K, num tol, int use_adjusted_q)
 {
     const long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && src && num_pixels > 0 && sigma > 0
         && K > 0 && tol > 0);
     
+    am_gaussian_conv_view(dest_view, src_view, sigma, K, tol, use_adjusted_q);
+    return;
+}
+
+/**
+ * \brief Alvarez-Mazorra Gaussian 2D convolution of an image_view
+ * \param dest          output image_view
+ * \param src           input image_view, with the same dimensions as dest
+ * \param sigma         Gaussian standard deviation
+ * \param K             number of passes (larger implies better accuracy)
+ * \param tol           accuracy in evaluating left boundary sum
+ * \param use_adjusted_q    if nonzero, use proposed regression for q
+ * \ingroup am_gaussian
+ *
+ * Same as am_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void am_gaussian_conv_view(image_view dest, image_view src, num sigma, int K,
+    num tol, int use_adjusted_q)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
     /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
+    for (channel = 0; channel < dest.num_channels; ++channel)
     {
-        num *dest_y = dest;
-        const num *src_y = src;
+        num *dest_c = dest.data + dest.channel_stride * channel;
+        const num *src_c = src.data + src.channel_stride * channel;
         
         /* Filter each row of the channel. */
-        for (y = 0; y < height; ++y)
+        for (y = 0; y < dest.height; ++y)
         {
-            am_gaussian_conv(dest_y, src_y, width, 1,
+            num *dest_y = dest_c + dest.row_stride * y;
+            const num *src_y = src_c + src.row_stride * y;
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
+            am_gaussian_conv(dest_y, src_y, dest.width, dest.pixel_stride,
                 sigma, K, tol, use_adjusted_q);
-            dest_y += width;
-            src_y += width;
         }
         
         /* Filter each column of the channel. */
-        for (x = 0; x < width; ++x)
-            am_gaussian_conv(dest + x, dest + x, height, width,
+        for (x = 0; x < dest.width; ++x)
+        {
+            num *dest_x = dest_c + dest.pixel_stride * x;
+            am_gaussian_conv(dest_x, dest_x, dest.height, dest.row_stride,
                 sigma, K, tol, use_adjusted_q);
-        
-        dest += num_pixels;
-        src += num_pixels;
+        }
     }
     
     return;
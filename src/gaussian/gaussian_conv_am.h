@@ -38,6 +38,7 @@
 #define _GAUSSIAN_CONV_AM_H_
 
 #include "num.h"
+#include "image_view.h"
 
 void am_gaussian_conv(num *dest, const num *src, long N, long stride,
     double sigma, int K, num tol, int use_adjusted_q);
@@ -45,6 +46,8 @@ void am_gaussian_conv(num *dest, const num *src, long N, long stride,
 void am_gaussian_conv_image(num *dest, const num *src,
     int width, int height, int num_channels,
     num sigma, int K, num tol, int use_adjusted_q);
+void am_gaussian_conv_view(image_view dest, image_view src, num sigma, int K,
+    num tol, int use_adjusted_q);
 
 /** \} */
 #endif /* _GAUSSIAN_CONV_AM_H_ */
@@ -67,6 +67,118 @@ static void box_filter(num *dest, long dest_stride,
     return;
 }
 
+/* Update the running sum of box_filter_fused() at a sample m near the
+   boundaries, where the ring is indexed through extension(). */
+static num box_fused_edge(const num *in, long mask, long N, long r, long m,
+    num accum)
+{
+    long n;
+    
+    if (m == 0)
+    {
+        accum = 0;
+        
+        for (n = -r; n <= r; ++n)
+            accum += in[extension(N, n) & mask];
+    }
+    else
+        accum += in[extension(N, m + r) & mask]
+            - in[extension(N, m - r - 1) & mask];
+    
+    return accum;
+}
+
+/**
+ * \brief Perform all K passes of box filtering in one sweep
+ * \param dest          destination array
+ * \param stride        stride between successive samples of src and dest
+ * \param src           input, overwritten if src = dest
+ * \param N             number of samples
+ * \param r             radius of the box filter
+ * \param K             number of passes
+ * \param scale         factor applied to the output
+ * \param ring          array with space for K (L + 1) samples
+ * \param L             power of two, at least
+ *                      min(N, #BOX_FUSED_BLOCK + 2r + 2)
+ * \ingroup box_gaussian
+ *
+ * The passes are cascaded block by block: for input samples t, ...,
+ * t + #BOX_FUSED_BLOCK - 1, pass k produces its samples t - k r, ...,
+ * which need only samples up to t + #BOX_FUSED_BLOCK - 1 - (k - 1) r of
+ * pass k - 1. The last L outputs of each pass are kept in a ring, which
+ * holds every sample still needed by the next pass, including those reached
+ * by boundary extension. Each pass performs the same operations in the same
+ * order as box_filter(), so the result is identical to K calls of
+ * box_filter(), but `src` and `dest` are each accessed only once per
+ * sample.
+ */
+static void box_filter_fused(num *dest, long stride, const num *src,
+    long N, long r, int K, num scale, num *ring, long L)
+{
+    num *accum = ring + K * L;
+    const long mask = L - 1;
+    long t, m, m_end;
+    num a;
+    int k;
+    
+    assert(dest && src && ring && N > 0 && r >= 0 && K > 0);
+    
+    for (t = 0; t < N + K * r; t += BOX_FUSED_BLOCK)
+    {
+        /* The input samples of the block enter ring 0. */
+        for (m = t; m < t + BOX_FUSED_BLOCK && m < N; ++m)
+            ring[m & mask] = src[stride * m];
+        
+        for (k = 1; k <= K; ++k)
+        {
+            const num *in = ring + (k - 1) * L;
+            num *out = ring + k * L;
+            
+            m = (t - k * r > 0) ? t - k * r : 0;
+            m_end = (t + BOX_FUSED_BLOCK - k * r < N)
+                ? t + BOX_FUSED_BLOCK - k * r : N;
+            a = accum[k - 1];
+            
+            /* Samples near the left boundary. */
+            for (; m < m_end && !(m > r && m + r < N); ++m)
+            {
+                a = box_fused_edge(in, mask, N, r, m, a);
+                
+                if (k < K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a * scale;
+            }
+            
+            /* Interior samples, where no extension is needed. */
+            for (; m < m_end && m + r < N; ++m)
+            {
+                a += in[(m + r) & mask] - in[(m - r - 1) & mask];
+                
+                if (k < K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a * scale;
+            }
+            
+            /* Samples near the right boundary. */
+            for (; m < m_end; ++m)
+            {
+                a = box_fused_edge(in, mask, N, r, m, a);
+                
+                if (k < K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a * scale;
+            }
+            
+            accum[k - 1] = a;
+        }
+    }
+    
+    return;
+}
+
 /**
  * \brief Box filtering approximation of Gaussian convolution
  * \param dest_data     destination array
@@ -97,6 +209,10 @@ static void box_filter(num *dest, long dest_stride,
     dest   <- box_filter(buffer)
     dest   <- dest * scale
 \endverbatim
+ *
+ * When N is large enough for `buffer_data` to hold a ring of recent samples
+ * per pass, the K passes are instead performed in a single sweep by
+ * box_filter_fused(), with an identical result.
  *
  * The convolution can be performed in-place by setting `src` = `dest` (the
  * source array is overwritten with the result). However, `buffer_data` must
@@ -111,7 +227,7 @@ void box_gaussian_conv(num *dest_data, num *buffer_data, const num *src,
         long stride;
     } dest, buffer, cur, next;
     num scale;
-    long r;
+    long r, ring_size;
     int step;
     
     assert(dest_data && buffer_data && src && dest_data != buffer_data
@@ -121,6 +237,19 @@ void box_gaussian_conv(num *dest_data, num *buffer_data, const num *src,
     r = (long)(0.5 * sqrt((12.0 * sigma * sigma) / K + 1.0));
     scale = (num)(1.0 / pow(2*r + 1, K));
     
+    /* If the buffer has room for the rings, perform all passes in one
+       sweep. Otherwise, alternate between dest and buffer as below. */
+    for (ring_size = 1; ring_size < N
+        && ring_size < BOX_FUSED_BLOCK + 2*r + 2;)
+        ring_size *= 2;
+    
+    if (K * (ring_size + 1) <= N)
+    {
+        box_filter_fused(dest_data, stride, src, N, r, K, scale,
+            buffer_data, ring_size);
+        return;
+    }
+    
     dest.data = dest_data;
     dest.stride = stride;
     buffer.data = buffer_data;
@@ -196,34 +325,101 @@ void box_gaussian_conv_image(num *dest, num *buffer, const num *src,
     int width, int height, int num_channels, num sigma, int K)
 {
     const long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && buffer && src && dest != buffer
         && num_pixels > 0 && sigma > 0 && K > 0);
     
-    /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
-    {
-        num *dest_y = dest;
-        const num *src_y = src;
-        
-        /* Filter each column of the channel. */
-        for (y = 0; y < height; ++y)
+    box_gaussian_conv_view(dest_view, buffer, src_view, sigma, K);
+    return;
+}
+
+/**
+ * \brief Box filtering Gaussian 2D convolution of an image_view
+ * \param dest          output image_view
+ * \param buffer        workspace, as for box_gaussian_conv_image()
+ * \param src           input image_view, with the same dimensions as dest
+ * \param sigma         Gaussian standard deviation
+ * \param K             number of box filter passes
+ * \ingroup box_gaussian
+ *
+ * Same as box_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void box_gaussian_conv_view(image_view dest, num *buffer, image_view src,
+    num sigma, int K)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
+    /* Filter each row. All channels of a row are filtered together so that
+       interleaved data is reused while it is in cache. */
+    for (y = 0; y < dest.height; ++y)
+        for (channel = 0; channel < dest.num_channels; ++channel)
         {
+            num *dest_y = IMAGE_VIEW_PTR(dest, 0, y, channel);
+            const num *src_y = IMAGE_VIEW_PTR(src, 0, y, channel);
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
             box_gaussian_conv(dest_y, buffer, src_y,
-                width, 1, sigma, K);
-            dest_y += width;
-            src_y += width;
+                dest.width, dest.pixel_stride, sigma, K);
+        }
+    
+    /* Filter each column, likewise all channels of a column together. */
+    for (x = 0; x < dest.width; ++x)
+        for (channel = 0; channel < dest.num_channels; ++channel)
+        {
+            num *dest_x = IMAGE_VIEW_PTR(dest, x, 0, channel);
+            box_gaussian_conv(dest_x, buffer, dest_x,
+                dest.height, dest.row_stride, sigma, K);
         }
-        
-        /* Filter each row of the channel. */
-        for (x = 0; x < width; ++x)
-            box_gaussian_conv(dest + x, buffer, dest + x,
-                height, width, sigma, K);
-        
-        dest += num_pixels;
-        src += num_pixels;
-    }
     
     return;
 }
+
+/**
+ * \brief Normalized (mask-aware) box filter Gaussian convolution
+ * \param dest          output image in planar order
+ * \param buffer        array with at least max(width,height) elements
+ * \param src           input image in planar order, may contain NaNs
+ * \param mask          nonnegative weight per pixel, or NULL
+ * \param width         image width
+ * \param height        image height
+ * \param num_channels  number of image channels
+ * \param sigma         Gaussian standard deviation
+ * \param K             number of box filter passes
+ * \return 1 on success, 0 on failure
+ * \ingroup box_gaussian
+ *
+ * Computes conv(mask*src)/conv(mask), filling in pixels with zero weight
+ * or NaN samples from their neighbors. The weighted values and the
+ * weights are interleaved in one work image and filtered in a single
+ * pass, see normalized_conv_init(). `dest` may equal `src`.
+ */
+int box_gaussian_conv_normalized(num *dest, num *buffer, const num *src,
+    const num *mask, int width, int height, int num_channels,
+    num sigma, int K)
+{
+    image_view work;
+    
+    if (!normalized_conv_init(&work, src, mask,
+        width, height, num_channels))
+        return 0;
+    
+    box_gaussian_conv_view(work, buffer, work, sigma, K);
+    normalized_conv_finish(dest, &work);
+    return 1;
+}
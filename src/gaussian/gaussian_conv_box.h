@@ -53,11 +53,20 @@
 #define _GAUSSIAN_CONV_BOX_H_
 
 #include "num.h"
+#include "image_view.h"
+
+/** \brief Number of samples per block in fused box filtering */
+#define BOX_FUSED_BLOCK     128
 
 void box_gaussian_conv(num *dest, num *buffer, const num *src,
     long N, long stride, num sigma, int K);
 void box_gaussian_conv_image(num *dest, num *buffer, const num *src,
     int width, int height, int num_channels, num sigma, int K);
+void box_gaussian_conv_view(image_view dest, num *buffer, image_view src,
+    num sigma, int K);
+int box_gaussian_conv_normalized(num *dest, num *buffer, const num *src,
+    const num *mask, int width, int height, int num_channels,
+    num sigma, int K);
 
 /** \} */
 #endif /* _GAUSSIAN_CONV_BOX_H_ */
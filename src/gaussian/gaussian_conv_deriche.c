@@ -25,6 +25,7 @@
 #include "filter_util.h"
 #include "complex_arith.h"
 #include "gaussian_short_conv.h"
+#include "cpu_dispatch.h"
 
 #ifndef M_SQRT2PI
 /** \brief The constant sqrt(2 pi) */
@@ -178,6 +179,31 @@ static void make_filter(num *result_b, num *result_a,
     return;
 }
 
+/* Instances of deriche_conv for each instruction set level */
+#define DERICHE_CONV_FUNC    deriche_conv_baseline
+#include "deriche_conv_inc.c"
+#undef DERICHE_CONV_FUNC
+
+#ifdef CPU_DISPATCH_TARGETS
+#define DERICHE_CONV_FUNC    deriche_conv_sse2
+#define DERICHE_CONV_ISA     "sse2"
+#include "deriche_conv_inc.c"
+#undef DERICHE_CONV_FUNC
+#undef DERICHE_CONV_ISA
+
+#define DERICHE_CONV_FUNC    deriche_conv_avx2
+#define DERICHE_CONV_ISA     "avx2"
+#include "deriche_conv_inc.c"
+#undef DERICHE_CONV_FUNC
+#undef DERICHE_CONV_ISA
+
+#define DERICHE_CONV_FUNC    deriche_conv_avx512
+#define DERICHE_CONV_ISA     "avx512f"
+#include "deriche_conv_inc.c"
+#undef DERICHE_CONV_FUNC
+#undef DERICHE_CONV_ISA
+#endif
+
 /**
  * \brief Deriche Gaussian convolution
  * \param c         coefficients precomputed by deriche_precomp()
@@ -205,19 +231,15 @@ static void make_filter(num *result_b, num *result_a,
  * source array is overwritten with the result). However, the `buffer` array
  * must be distinct from `src`.
  *
+ * The filtering loops in deriche_conv_inc.c are built for each instruction
+ * set level, and get_cpu_level() selects the variant that runs.
+ *
  * \note When the #num typedef is set to single-precision arithmetic,
  * results may be inaccurate for large values of sigma.
  */
 void deriche_gaussian_conv(deriche_coeffs c,
     num *dest, num *buffer, const num *src, long N, long stride)
 {
-    const long stride_2 = stride * 2;
-    const long stride_3 = stride * 3;
-    const long stride_4 = stride * 4;
-    const long stride_N = stride * N;
-    num *y_causal, *y_anticausal;
-    long i, n;
-    
     assert(dest && buffer && src && buffer != src && N > 0 && stride != 0);
     
     if (N <= 4)
@@ -226,101 +248,24 @@ void deriche_gaussian_conv(deriche_coeffs c,
         return;
     }
     
-    /* Divide buffer into two buffers each of length N. */
-    y_causal = buffer;
-    y_anticausal = buffer + N;
-    
-    /* Initialize the causal filter on the left boundary. */
-    init_recursive_filter(y_causal, src, N, stride,
-        c.b_causal, c.K - 1, c.a, c.K, c.sum_causal, c.tol, c.max_iter);
-    
-    /* The following filters the interior samples according to the filter
-       order c.K. The loops below implement the pseudocode
-       
-       For n = K, ..., N - 1,
-           y^+(n) = \sum_{k=0}^{K-1} b^+_k src(n - k)
-                    - \sum_{k=1}^K a_k y^+(n - k)
-       
-       Variable i tracks the offset to the nth sample of src, it is
-       updated together with n such that i = stride * n. */
-    switch (c.K)
+    switch (get_cpu_level())
     {
-    case 2:
-        for (n = 2, i = stride_2; n < N; ++n, i += stride)
-            y_causal[n] = c.b_causal[0] * src[i]
-                + c.b_causal[1] * src[i - stride]
-                - c.a[1] * y_causal[n - 1]
-                - c.a[2] * y_causal[n - 2];
+#ifdef CPU_DISPATCH_TARGETS
+    case CPU_AVX512:
+        deriche_conv_avx512(c, dest, buffer, src, N, stride);
         break;
-    case 3:
-        for (n = 3, i = stride_3; n < N; ++n, i += stride)
-            y_causal[n] = c.b_causal[0] * src[i]
-                + c.b_causal[1] * src[i - stride]
-                + c.b_causal[2] * src[i - stride_2]
-                - c.a[1] * y_causal[n - 1]
-                - c.a[2] * y_causal[n - 2]
-                - c.a[3] * y_causal[n - 3];
+    case CPU_AVX2:
+        deriche_conv_avx2(c, dest, buffer, src, N, stride);
         break;
-    case 4:
-        for (n = 4, i = stride_4; n < N; ++n, i += stride)
-            y_causal[n] = c.b_causal[0] * src[i]
-                + c.b_causal[1] * src[i - stride]
-                + c.b_causal[2] * src[i - stride_2]
-                + c.b_causal[3] * src[i - stride_3]
-                - c.a[1] * y_causal[n - 1]
-                - c.a[2] * y_causal[n - 2]
-                - c.a[3] * y_causal[n - 3]
-                - c.a[4] * y_causal[n - 4];
+    case CPU_SSE2:
+        deriche_conv_sse2(c, dest, buffer, src, N, stride);
         break;
-    }
-    
-    /* Initialize the anticausal filter on the right boundary. */
-    init_recursive_filter(y_anticausal, src + stride_N - stride, N, -stride,
-        c.b_anticausal, c.K, c.a, c.K, c.sum_anticausal, c.tol, c.max_iter);
-    
-    /* Similar to the causal filter code above, the following implements
-       the pseudocode
-       
-       For n = K, ..., N - 1,
-           y^-(n) = \sum_{k=1}^K b^-_k src(N - n - 1 - k)
-                    - \sum_{k=1}^K a_k y^-(n - k)
-     
-       Variable i is updated such that i = stride * (N - n - 1). */
-    switch (c.K)
-    {
-    case 2:
-        for (n = 2, i = stride_N - stride_3; n < N; ++n, i -= stride)
-            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
-                + c.b_anticausal[2] * src[i + stride_2]
-                - c.a[1] * y_anticausal[n - 1]
-                - c.a[2] * y_anticausal[n - 2];
-        break;
-    case 3:
-        for (n = 3, i = stride_N - stride_4; n < N; ++n, i -= stride)
-            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
-                + c.b_anticausal[2] * src[i + stride_2]
-                + c.b_anticausal[3] * src[i + stride_3]
-                - c.a[1] * y_anticausal[n - 1]
-                - c.a[2] * y_anticausal[n - 2]
-                - c.a[3] * y_anticausal[n - 3];
-        break;
-    case 4:
-        for (n = 4, i = stride_N - stride * 5; n < N; ++n, i -= stride)
-            y_anticausal[n] = c.b_anticausal[1] * src[i + stride]
-                + c.b_anticausal[2] * src[i + stride_2]
-                + c.b_anticausal[3] * src[i + stride_3]
-                + c.b_anticausal[4] * src[i + stride_4]
-                - c.a[1] * y_anticausal[n - 1]
-                - c.a[2] * y_anticausal[n - 2]
-                - c.a[3] * y_anticausal[n - 3]
-                - c.a[4] * y_anticausal[n - 4];
+#endif
+    default:
+        deriche_conv_baseline(c, dest, buffer, src, N, stride);
         break;
     }
     
-    /* Sum the causal and anticausal responses to obtain the final result. */
-    for (n = 0, i = 0; n < N; ++n, i += stride)
-        dest[i] = y_causal[n] + y_anticausal[N - n - 1];
-    
     return;
 }
 
@@ -348,34 +293,287 @@ void deriche_gaussian_conv_image(deriche_coeffs c,
     num *dest, num *buffer, const num *src,
     int width, int height, int num_channels)
 {
-    long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    const long num_pixels = ((long)width) * ((long)height);
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && buffer && src && num_pixels > 0);
     
-    /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
-    {
-        num *dest_y = dest;
-        const num *src_y = src;
-        
-        /* Filter each row of the channel. */
-        for (y = 0; y < height; ++y)
+    deriche_gaussian_conv_view(c, dest_view, buffer, src_view);
+    return;
+}
+
+/**
+ * \brief Deriche Gaussian 2D convolution of an image_view
+ * \param c             precomputed coefficients
+ * \param dest          output image_view
+ * \param buffer        workspace, as for deriche_gaussian_conv_image()
+ * \param src           input image_view, with the same dimensions as dest
+ * \ingroup deriche_gaussian
+ *
+ * Same as deriche_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void deriche_gaussian_conv_view(deriche_coeffs c, image_view dest,
+    num *buffer, image_view src)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
+    /* Filter each row. All channels of a row are filtered together so that
+       interleaved data is reused while it is in cache. */
+    for (y = 0; y < dest.height; ++y)
+        for (channel = 0; channel < dest.num_channels; ++channel)
         {
+            num *dest_y = IMAGE_VIEW_PTR(dest, 0, y, channel);
+            const num *src_y = IMAGE_VIEW_PTR(src, 0, y, channel);
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
             deriche_gaussian_conv(c,
-                dest_y, buffer, src_y, width, 1);
-            dest_y += width;
-            src_y += width;
+                dest_y, buffer, src_y, dest.width, dest.pixel_stride);
         }
-        
-        /* Filter each column of the channel. */
-        for (x = 0; x < width; ++x)
+    
+    /* Filter each column, likewise all channels of a column together. */
+    for (x = 0; x < dest.width; ++x)
+        for (channel = 0; channel < dest.num_channels; ++channel)
+        {
+            num *dest_x = IMAGE_VIEW_PTR(dest, x, 0, channel);
             deriche_gaussian_conv(c,
-                dest + x, buffer, dest + x, height, width);
+                dest_x, buffer, dest_x, dest.height, dest.row_stride);
+        }
+    
+    return;
+}
+
+/**
+ * \brief Normalized (mask-aware) Deriche Gaussian convolution
+ * \param c             coefficients precomputed by deriche_precomp()
+ * \param dest          output image in planar order
+ * \param buffer        workspace, as for deriche_gaussian_conv_image()
+ * \param src           input image in planar order, may contain NaNs
+ * \param mask          nonnegative weight per pixel, or NULL
+ * \param width         image width
+ * \param height        image height
+ * \param num_channels  number of image channels
+ * \return 1 on success, 0 on failure
+ * \ingroup deriche_gaussian
+ *
+ * Computes conv(mask*src)/conv(mask), filling in pixels with zero weight
+ * or NaN samples from their neighbors. The weighted values and the
+ * weights are interleaved in one work image and filtered in a single
+ * pass, see normalized_conv_init(). `dest` may equal `src`.
+ */
+int deriche_gaussian_conv_normalized(deriche_coeffs c,
+    num *dest, num *buffer, const num *src, const num *mask,
+    int width, int height, int num_channels)
+{
+    image_view work;
+    
+    if (!normalized_conv_init(&work, src, mask,
+        width, height, num_channels))
+        return 0;
+    
+    deriche_gaussian_conv_view(c, work, buffer, work);
+    normalized_conv_finish(dest, &work);
+    return 1;
+}
+
+/**
+ * \brief Start a streaming Deriche Gaussian convolution
+ * \param s             deriche_stream to initialize
+ * \param c             coefficients precomputed by deriche_precomp()
+ * \param block_size    samples output at a time, at least c.K
+ * \param lookahead     future samples used by the anticausal filter
+ * \return 1 on success, 0 on failure
+ * \ingroup deriche_gaussian
+ *
+ * The state should be released with deriche_stream_free().
+ */
+int deriche_stream_init(deriche_stream *s, deriche_coeffs c,
+    long block_size, long lookahead)
+{
+    const long window = block_size + 2 * lookahead + 2 * c.K;
+    
+    s->x = NULL;
+    
+    if (block_size < c.K || lookahead < 0
+        || !(s->x = (num *)malloc(sizeof(num) * 3 * window)))
+        return 0;
+    
+    s->y_causal = s->x + window;
+    s->y_anticausal = s->y_causal + window;
+    s->c = c;
+    s->block_size = block_size;
+    s->lookahead = lookahead;
+    s->count = 0;
+    s->started = 0;
+    return 1;
+}
+
+/* Output the first n_out buffered samples, using avail samples of input
+   for the anticausal filter. */
+static void deriche_stream_emit(deriche_stream *s, num *dest,
+    long n_out, long avail)
+{
+    const deriche_coeffs *c = &s->c;
+    num *x = s->x + c->K;      /* x[n] is the nth buffered sample, n >= -K */
+    num *y_causal = s->y_causal + c->K;
+    num *y_anticausal = s->y_anticausal;
+    num accum;
+    long n;
+    int k;
+    
+    /* Continue the causal filter from the previous block, or initialize it
+       on the left boundary of the signal. */
+    n = 0;
+    
+    if (!s->started)
+    {
+        init_recursive_filter(y_causal, x, s->count, 1, c->b_causal,
+            c->K - 1, c->a, c->K, c->sum_causal, c->tol, c->max_iter);
+        n = c->K;
+        s->started = 1;
+    }
+    
+    for (; n < n_out; ++n)
+    {
+        for (accum = 0, k = 0; k < c->K; ++k)
+            accum += c->b_causal[k] * x[n - k];
+        for (k = 1; k <= c->K; ++k)
+            accum -= c->a[k] * y_causal[n - k];
         
-        dest += num_pixels;
-        src += num_pixels;
+        y_causal[n] = accum;
+    }
+    
+    /* Run the anticausal filter backward over the window, started from the
+       steady state of a constant extension of the last sample. */
+    for (k = 0; k < c->K; ++k)
+    {
+        x[avail + k] = x[avail - 1];
+        y_anticausal[avail + k] = c->sum_anticausal * x[avail - 1];
     }
     
+    for (n = avail - 1; n >= 0; --n)
+    {
+        for (accum = 0, k = 1; k <= c->K; ++k)
+            accum += c->b_anticausal[k] * x[n + k]
+                - c->a[k] * y_anticausal[n + k];
+        
+        y_anticausal[n] = accum;
+    }
+    
+    for (n = 0; n < n_out; ++n)
+        dest[n] = y_causal[n] + y_anticausal[n];
+    
+    /* Shift out the output samples, keeping K samples of history. */
+    memmove(s->x, s->x + n_out, sizeof(num) * (c->K + s->count - n_out));
+    
+    for (k = 0; k < c->K; ++k)
+        s->y_causal[k] = y_causal[n_out - c->K + k];
+    
+    s->count -= n_out;
+    return;
+}
+
+/**
+ * \brief Filter the next piece of a streamed signal
+ * \param s         deriche_stream created by deriche_stream_init()
+ * \param dest      output, with space for N + block_size - 1 samples
+ * \param src       next N input samples
+ * \param N         number of input samples
+ * \return number of samples written to dest
+ * \ingroup deriche_gaussian
+ *
+ * Output is written in blocks of `block_size` samples. Each block is output
+ * once `lookahead` samples following it have been input, so the output
+ * lags the input by `lookahead` to `lookahead + block_size - 1` samples.
+ */
+long deriche_stream_process(deriche_stream *s,
+    num *dest, const num *src, long N)
+{
+    const long window = s->block_size + s->lookahead;
+    long num_out = 0, take;
+    
+    assert(s && s->x && dest && src && N >= 0);
+    
+    while (N > 0)
+    {
+        take = (window - s->count < N) ? window - s->count : N;
+        memcpy(s->x + s->c.K + s->count, src, sizeof(num) * take);
+        s->count += take;
+        src += take;
+        N -= take;
+        
+        if (s->count == window)
+        {
+            deriche_stream_emit(s, dest + num_out, s->block_size, window);
+            num_out += s->block_size;
+        }
+    }
+    
+    return num_out;
+}
+
+/**
+ * \brief End a streamed signal
+ * \param s         deriche_stream created by deriche_stream_init()
+ * \param dest      output, with space for block_size + lookahead samples
+ * \return number of samples written to dest
+ * \ingroup deriche_gaussian
+ *
+ * Outputs the remaining buffered samples, applying half-sample symmetric
+ * extension on the right boundary as deriche_gaussian_conv() does. The
+ * stream is then ready to filter a new signal.
+ */
+long deriche_stream_flush(deriche_stream *s, num *dest)
+{
+    num *x = s->x + s->c.K;
+    const long count = s->count;
+    long n;
+    
+    assert(s && s->x && dest);
+    
+    if (count == 0)
+        ;   /* Nothing is buffered, only the state is reset. */
+    else if (!s->started && count <= 4)
+    {   /* Special case for very short signals. */
+        gaussian_short_conv(dest, x, count, 1, s->c.sigma);
+        s->count = 0;
+    }
+    else
+    {
+        for (n = 0; n < s->lookahead; ++n)
+            x[count + n] = x[extension(count, count + n)];
+        
+        deriche_stream_emit(s, dest, count, count + s->lookahead);
+    }
+    
+    s->started = 0;
+    return count;
+}
+
+/**
+ * \brief Release memory of a deriche_stream
+ * \param s     deriche_stream created by deriche_stream_init()
+ * \ingroup deriche_gaussian
+ */
+void deriche_stream_free(deriche_stream *s)
+{
+    if (s->x)
+        free(s->x);
+    
+    s->x = NULL;
     return;
 }
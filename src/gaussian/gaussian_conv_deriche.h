@@ -44,6 +44,25 @@
     buffer = (num *)malloc(sizeof(num) * 2 * N);
     deriche_gaussian_conv(c, dest, buffer, src, N, stride);
     free(buffer);
+\endcode
+ *
+ * \par Streaming
+ * deriche_stream_process() filters an unbounded signal that arrives in
+ * pieces. The causal filter continues from one block to the next, and the
+ * anticausal filter of each block runs over `lookahead` future samples,
+ * started from the steady state of a constant extension. An output sample
+ * is thus available `lookahead` samples after it is input (plus the wait
+ * for the block to fill), with error on the order of the Gaussian tail
+ * beyond `lookahead`; about 4 sigma is enough for most uses.
+ * deriche_stream_flush() ends the signal with symmetric extension.
+\code
+    deriche_stream s;
+    
+    deriche_stream_init(&s, c, block_size, lookahead);
+    while (...)
+        num_out = deriche_stream_process(&s, dest, src, N);
+    num_out = deriche_stream_flush(&s, dest);
+    deriche_stream_free(&s);
 \endcode
  *
  * \note When the #num typedef is set to single-precision arithmetic,
@@ -61,6 +80,7 @@
 #define _GAUSSIAN_CONV_DERICHE_H_
 
 #include "num.h"
+#include "image_view.h"
 
 /** \brief Minimum Deriche filter order */
 #define DERICHE_MIN_K       2
@@ -100,6 +120,31 @@ void deriche_gaussian_conv(deriche_coeffs c,
 void deriche_gaussian_conv_image(deriche_coeffs c,
     num *dest, num *buffer, const num *src,
     int width, int height, int num_channels);
+void deriche_gaussian_conv_view(deriche_coeffs c, image_view dest,
+    num *buffer, image_view src);
+int deriche_gaussian_conv_normalized(deriche_coeffs c,
+    num *dest, num *buffer, const num *src, const num *mask,
+    int width, int height, int num_channels);
+
+/** \brief State of a streaming Deriche Gaussian convolution */
+typedef struct deriche_stream_
+{
+    deriche_coeffs c;       /**< Filter coefficients                       */
+    num *x;                 /**< Buffered input, after K history samples   */
+    num *y_causal;          /**< Causal response, after K history samples  */
+    num *y_anticausal;      /**< Anticausal response of the current window */
+    long block_size;        /**< Samples output at a time                  */
+    long lookahead;         /**< Future samples used by the anticausal pass */
+    long count;             /**< Buffered samples not yet output           */
+    int started;            /**< Nonzero once the left boundary is done    */
+} deriche_stream;
+
+int deriche_stream_init(deriche_stream *s, deriche_coeffs c,
+    long block_size, long lookahead);
+long deriche_stream_process(deriche_stream *s,
+    num *dest, const num *src, long N);
+long deriche_stream_flush(deriche_stream *s, num *dest);
+void deriche_stream_free(deriche_stream *s);
 
 /** \} */
 #endif /* _GAUSSIAN_CONV_DERICHE_H_ */
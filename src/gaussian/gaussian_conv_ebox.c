@@ -93,6 +93,120 @@ static void ebox_filter(num *dest, long dest_stride,
     return;
 }
 
+/* Update the running sum of ebox_filter_fused() at a sample m near the
+   boundaries, where the ring is indexed through extension(). */
+static num ebox_fused_edge(const num *in, long mask, long N, long r,
+    num c_1, num c_2, long m, num accum)
+{
+    long n;
+    
+    if (m == 0)
+    {
+        accum = 0;
+        
+        for (n = -r; n <= r; ++n)
+            accum += in[extension(N, n) & mask];
+        
+        accum = c_1 * (in[extension(N, r + 1) & mask]
+            + in[extension(N, -r - 1) & mask])
+            + (c_1 + c_2) * accum;
+    }
+    else
+        accum += c_1 * (in[extension(N, m + r + 1) & mask]
+            - in[extension(N, m - r - 2) & mask])
+            + c_2 * (in[extension(N, m + r) & mask]
+            - in[extension(N, m - r - 1) & mask]);
+    
+    return accum;
+}
+
+/**
+ * \brief Perform all K passes of extended box filtering in one sweep
+ * \param c             ebox_coeffs created by ebox_precomp()
+ * \param dest          destination array
+ * \param stride        stride between successive samples of src and dest
+ * \param src           input, overwritten if src = dest
+ * \param N             number of samples
+ * \param ring          array with space for K (L + 1) samples
+ * \param L             power of two, at least
+ *                      min(N, #EBOX_FUSED_BLOCK + 2r + 4)
+ * \ingroup ebox_gaussian
+ *
+ * The passes are cascaded block by block as in box_filter_fused(), with a
+ * delay of r + 1 samples per pass. Each pass performs the same operations
+ * in the same order as ebox_filter(), so the result is identical to K calls
+ * of ebox_filter().
+ */
+static void ebox_filter_fused(ebox_coeffs c, num *dest, long stride,
+    const num *src, long N, num *ring, long L)
+{
+    num *accum = ring + c.K * L;
+    const long mask = L - 1, r = c.r, delay = c.r + 1;
+    long t, m, m_end;
+    num a;
+    int k;
+    
+    assert(dest && src && ring && N > 0 && r >= 0 && c.K > 0);
+    
+    for (t = 0; t < N + c.K * delay; t += EBOX_FUSED_BLOCK)
+    {
+        /* The input samples of the block enter ring 0. */
+        for (m = t; m < t + EBOX_FUSED_BLOCK && m < N; ++m)
+            ring[m & mask] = src[stride * m];
+        
+        for (k = 1; k <= c.K; ++k)
+        {
+            const num *in = ring + (k - 1) * L;
+            num *out = ring + k * L;
+            
+            m = (t - k * delay > 0) ? t - k * delay : 0;
+            m_end = (t + EBOX_FUSED_BLOCK - k * delay < N)
+                ? t + EBOX_FUSED_BLOCK - k * delay : N;
+            a = accum[k - 1];
+            
+            /* Samples near the left boundary. */
+            for (; m < m_end && !(m > r + 1 && m + r + 1 < N); ++m)
+            {
+                a = ebox_fused_edge(in, mask, N, r, c.c_1, c.c_2, m, a);
+                
+                if (k < c.K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a;
+            }
+            
+            /* Interior samples, where no extension is needed. */
+            for (; m < m_end && m + r + 1 < N; ++m)
+            {
+                a += c.c_1 * (in[(m + r + 1) & mask]
+                    - in[(m - r - 2) & mask])
+                    + c.c_2 * (in[(m + r) & mask]
+                    - in[(m - r - 1) & mask]);
+                
+                if (k < c.K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a;
+            }
+            
+            /* Samples near the right boundary. */
+            for (; m < m_end; ++m)
+            {
+                a = ebox_fused_edge(in, mask, N, r, c.c_1, c.c_2, m, a);
+                
+                if (k < c.K)
+                    out[m & mask] = a;
+                else
+                    dest[stride * m] = a;
+            }
+            
+            accum[k - 1] = a;
+        }
+    }
+    
+    return;
+}
+
 /**
  * \brief Extended box filtering approximation of Gaussian convolution
  * \param c             ebox_coeffs created by ebox_precomp()
@@ -110,6 +224,10 @@ static void ebox_filter(num *dest, long dest_stride,
  * the iteration alternates the roles of two arrays. See box_gaussian_conv()
  * for more detailed discussion.
  *
+ * When N is large enough for `buffer_data` to hold a ring of recent samples
+ * per pass, the K passes are instead performed in a single sweep by
+ * ebox_filter_fused(), with an identical result.
+ *
  * The convolution can be performed in-place by setting `src` = `dest_data`
  * (the source array is overwritten with the result). However, `buffer_data`
  * must be distinct from `dest_data`.
@@ -122,11 +240,25 @@ void ebox_gaussian_conv(ebox_coeffs c, num *dest_data, num *buffer_data,
         num *data;
         long stride;
     } dest, buffer, cur, next;
+    long ring_size;
     int step;
     
     assert(dest_data && buffer_data && src
         && dest_data != buffer_data && N > 0);
     
+    /* If the buffer has room for the rings, perform all passes in one
+       sweep. Otherwise, alternate between dest and buffer as below. */
+    for (ring_size = 1; ring_size < N
+        && ring_size < EBOX_FUSED_BLOCK + 2 * c.r + 4;)
+        ring_size *= 2;
+    
+    if (c.K * (ring_size + 1) <= N)
+    {
+        ebox_filter_fused(c, dest_data, stride, src, N,
+            buffer_data, ring_size);
+        return;
+    }
+    
     dest.data = dest_data;
     dest.stride = stride;
     buffer.data = buffer_data;
@@ -186,30 +318,68 @@ void ebox_gaussian_conv_image(ebox_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels)
 {
     const long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && buffer && src && dest != buffer && num_pixels > 0);
     
+    ebox_gaussian_conv_view(c, dest_view, buffer, src_view);
+    return;
+}
+
+/**
+ * \brief Extended box Gaussian 2D convolution of an image_view
+ * \param c             precomputed coefficients
+ * \param dest          output image_view
+ * \param buffer        workspace, as for ebox_gaussian_conv_image()
+ * \param src           input image_view, with the same dimensions as dest
+ * \ingroup ebox_gaussian
+ *
+ * Same as ebox_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void ebox_gaussian_conv_view(ebox_coeffs c, image_view dest, num *buffer,
+    image_view src)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
     /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
+    for (channel = 0; channel < dest.num_channels; ++channel)
     {
-        num *dest_y = dest;
-        const num *src_y = src;
+        num *dest_c = dest.data + dest.channel_stride * channel;
+        const num *src_c = src.data + src.channel_stride * channel;
         
         /* Filter each row of the channel. */
-        for (y = 0; y < height; ++y)
+        for (y = 0; y < dest.height; ++y)
         {
-            ebox_gaussian_conv(c, dest_y, buffer, src_y, width, 1);
-            dest_y += width;
-            src_y += width;
+            num *dest_y = dest_c + dest.row_stride * y;
+            const num *src_y = src_c + src.row_stride * y;
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
+            ebox_gaussian_conv(c, dest_y, buffer, src_y,
+                dest.width, dest.pixel_stride);
         }
         
         /* Filter each column of the channel. */
-        for (x = 0; x < width; ++x)
-            ebox_gaussian_conv(c, dest + x, buffer, dest + x, height, width);
-        
-        dest += num_pixels;
-        src += num_pixels;
+        for (x = 0; x < dest.width; ++x)
+        {
+            num *dest_x = dest_c + dest.pixel_stride * x;
+            ebox_gaussian_conv(c, dest_x, buffer, dest_x,
+                dest.height, dest.row_stride);
+        }
     }
     
     return;
@@ -56,6 +56,10 @@
 #define _GAUSSIAN_CONV_EBOX_H_
 
 #include "num.h"
+#include "image_view.h"
+
+/** \brief Number of samples per block in fused extended box filtering */
+#define EBOX_FUSED_BLOCK    128
 
 /** \brief Coefficients for extended box filter Gaussian approximation */
 typedef struct ebox_coeffs_
@@ -71,6 +75,8 @@ void ebox_gaussian_conv(ebox_coeffs c, num *dest, num *buffer,
     const num *src, long N, long stride);
 void ebox_gaussian_conv_image(ebox_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels);
+void ebox_gaussian_conv_view(ebox_coeffs c, image_view dest, num *buffer,
+    image_view src);
 
 /** \} */
 #endif /* _GAUSSIAN_CONV_EBOX_H_ */
@@ -21,7 +21,6 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
-#include <string.h>
 #include "filter_util.h"
 #include "inverfc_acklam.h"
 
@@ -64,37 +63,309 @@ static num *make_g_trunc(num sigma, long r)
     return g_trunc;
 }
 
+/**
+ * \brief Symmetric filtering of samples whose taps are all in bounds
+ * \param dest      destination (must be distinct from src)
+ * \param src       source signal
+ * \param n0, n1    range of samples to filter, r <= n0 and n1 <= N - r
+ * \param dest_stride   stride between successive dest samples
+ * \param src_stride    stride between successive src samples
+ * \param h         symmetric filter, an array of length r + 1
+ * \param r         radius of filter h
+ * \ingroup fir_gaussian
+ *
+ * Since no boundary extension is needed, the filters of radius 1 to 4 (3
+ * to 9 taps), which are those of small sigma, have unrolled loops that
+ * fold the symmetric taps. The sums are formed in the same order as by the
+ * general loop, so the results are the same.
+ */
+static void conv_sym_interior(num *dest, const num *src, long n0, long n1,
+    long dest_stride, long src_stride, const num *h, long r)
+{
+    const long s1 = src_stride, s2 = 2 * src_stride;
+    const long s3 = 3 * src_stride, s4 = 4 * src_stride;
+    long n;
+    
+    switch (r)
+    {
+    case 1:
+        for (n = n0; n < n1; ++n)
+        {
+            const num *x = src + src_stride * n;
+            dest[dest_stride * n] = h[0] * x[0] + h[1] * (x[-s1] + x[s1]);
+        }
+        break;
+    case 2:
+        for (n = n0; n < n1; ++n)
+        {
+            const num *x = src + src_stride * n;
+            dest[dest_stride * n] = h[0] * x[0] + h[1] * (x[-s1] + x[s1])
+                + h[2] * (x[-s2] + x[s2]);
+        }
+        break;
+    case 3:
+        for (n = n0; n < n1; ++n)
+        {
+            const num *x = src + src_stride * n;
+            dest[dest_stride * n] = h[0] * x[0] + h[1] * (x[-s1] + x[s1])
+                + h[2] * (x[-s2] + x[s2]) + h[3] * (x[-s3] + x[s3]);
+        }
+        break;
+    case 4:
+        for (n = n0; n < n1; ++n)
+        {
+            const num *x = src + src_stride * n;
+            dest[dest_stride * n] = h[0] * x[0] + h[1] * (x[-s1] + x[s1])
+                + h[2] * (x[-s2] + x[s2]) + h[3] * (x[-s3] + x[s3])
+                + h[4] * (x[-s4] + x[s4]);
+        }
+        break;
+    default:
+        for (n = n0; n < n1; ++n)
+        {
+            const num *x = src + src_stride * n;
+            num accum = h[0] * x[0];
+            long m;
+            
+            for (m = 1; m <= r; ++m)
+                accum += h[m] * (x[-src_stride * m] + x[src_stride * m]);
+            
+            dest[dest_stride * n] = accum;
+        }
+        break;
+    }
+    
+    return;
+}
+
 /**
  * \brief Convolution with a symmetric filter
  * \param dest      destination (must be distinct from src)
  * \param src       source signal
  * \param N         signal length
- * \param stride    stride between successive src and dest samples
+ * \param dest_stride   stride between successive dest samples
+ * \param src_stride    stride between successive src samples
  * \param h         symmetric filter, an array of length r + 1
  * \param r         radius of filter h
  * \ingroup fir_gaussian
  *
  * This routine computes the convolution of \c src and \c h according to
- * \f[ \mathrm{dest[stride*n]} = \sum_{|m| \le r} h_{|m|} \,
- \mathrm{src[stride*(n-m)]}, \f]
- * where \c src is extrapolated with half-sample symmetry.
+ * \f[ \mathrm{dest[dest\_stride*n]} = \sum_{|m| \le r} h_{|m|} \,
+ \mathrm{src[src\_stride*(n-m)]}, \f]
+ * where \c src is extrapolated with half-sample symmetry. Boundary
+ * extension is only applied to the r samples at either end, the interior
+ * is computed by conv_sym_interior().
  */
-static void conv_sym(num *dest, const num *src, long N, long stride,
-    const num *h, long r)
+static void conv_sym(num *dest, const num *src, long N,
+    long dest_stride, long src_stride, const num *h, long r)
 {
+    const long left = (r < N) ? r : N;
+    const long right = (N - r > left) ? N - r : left;
     long n;
     
-    for (n = 0; n < N; ++n)
+    for (n = 0; n < N; n = (n + 1 == left) ? right : n + 1)
     {
-        num accum = h[0] * src[stride * n];
+        num accum = h[0] * src[src_stride * n];
         long m;
         
         /* Compute \sum_m h_m ( src(n - m) + src(n + m) ). */
         for (m = 1; m <= r; ++m)
-            accum += h[m] * (src[stride * extension(N, n - m)]
-                + src[stride * extension(N, n + m)]);
+            accum += h[m] * (src[src_stride * extension(N, n - m)]
+                + src[src_stride * extension(N, n + m)]);
         
-        dest[stride * n] = accum;
+        dest[dest_stride * n] = accum;
+    }
+    
+    conv_sym_interior(dest, src, left, right,
+        dest_stride, src_stride, h, r);
+    return;
+}
+
+/**
+ * \brief Convolution of the columns of an image with a symmetric filter
+ * \param dest      destination (must be distinct from src)
+ * \param src       source image
+ * \param width     image width
+ * \param height    image height
+ * \param dest_pixel_stride, dest_row_stride    strides of dest
+ * \param src_pixel_stride, src_row_stride      strides of src
+ * \param h         symmetric filter, an array of length r + 1
+ * \param r         radius of filter h
+ * \ingroup fir_gaussian
+ *
+ * Same as calling conv_sym() on each column, but the image is traversed
+ * row by row: each output row is a weighted sum of 2r + 1 input rows,
+ * whose addresses are found once per row with extension(). This avoids
+ * striding down the columns and has no boundary tests in the inner loops.
+ * Filters of radius up to 4 are unrolled.
+ */
+static void conv_sym_columns(num *dest, const num *src,
+    long width, long height, long dest_pixel_stride, long dest_row_stride,
+    long src_pixel_stride, long src_row_stride, const num *h, long r)
+{
+    const long ds = dest_pixel_stride, ss = src_pixel_stride;
+    long x, y, m;
+    
+    for (y = 0; y < height; ++y)
+    {
+        num *d = dest + dest_row_stride * y;
+        const num *x0 = src + src_row_stride * y;
+        const num *a[4], *b[4];
+        
+        for (m = 1; m <= r && m <= 4; ++m)
+        {
+            a[m - 1] = src + src_row_stride * extension(height, y - m);
+            b[m - 1] = src + src_row_stride * extension(height, y + m);
+        }
+        
+        switch (r)
+        {
+        case 1:
+            for (x = 0; x < width; ++x)
+                d[ds * x] = h[0] * x0[ss * x]
+                    + h[1] * (a[0][ss * x] + b[0][ss * x]);
+            break;
+        case 2:
+            for (x = 0; x < width; ++x)
+                d[ds * x] = h[0] * x0[ss * x]
+                    + h[1] * (a[0][ss * x] + b[0][ss * x])
+                    + h[2] * (a[1][ss * x] + b[1][ss * x]);
+            break;
+        case 3:
+            for (x = 0; x < width; ++x)
+                d[ds * x] = h[0] * x0[ss * x]
+                    + h[1] * (a[0][ss * x] + b[0][ss * x])
+                    + h[2] * (a[1][ss * x] + b[1][ss * x])
+                    + h[3] * (a[2][ss * x] + b[2][ss * x]);
+            break;
+        case 4:
+            for (x = 0; x < width; ++x)
+                d[ds * x] = h[0] * x0[ss * x]
+                    + h[1] * (a[0][ss * x] + b[0][ss * x])
+                    + h[2] * (a[1][ss * x] + b[1][ss * x])
+                    + h[3] * (a[2][ss * x] + b[2][ss * x])
+                    + h[4] * (a[3][ss * x] + b[3][ss * x]);
+            break;
+        default:
+            /* Accumulate one pair of rows at a time in dest. */
+            for (x = 0; x < width; ++x)
+                d[ds * x] = h[0] * x0[ss * x];
+            
+            for (m = 1; m <= r; ++m)
+            {
+                const num *am = src
+                    + src_row_stride * extension(height, y - m);
+                const num *bm = src
+                    + src_row_stride * extension(height, y + m);
+                
+                for (x = 0; x < width; ++x)
+                    d[ds * x] += h[m] * (am[ss * x] + bm[ss * x]);
+            }
+            break;
+        }
+    }
+    
+    return;
+}
+
+/**
+ * \brief Prepare overlap-save FFT convolution
+ * \param c         fir_coeffs with g_trunc and radius set
+ * \return 1 on success, 0 on failure
+ * \ingroup fir_gaussian
+ *
+ * The block length is the smallest power of two of at least 8r (and at
+ * least 64), so that three quarters or more of each block are outputs.
+ * The filter is placed with zero phase, wrapping around the end of the
+ * block, and its DFT, which is real since the filter is symmetric, is
+ * divided by the block length to normalize FFTW's inverse transform.
+ */
+static int fir_fft_precomp(fir_coeffs *c)
+{
+    const long r = c->radius;
+    long L, m;
+    
+    for (L = 64; L < 8 * r; L *= 2)
+        ;
+    
+    c->block = L;
+    
+    if (!(c->filter_hat = (num *)malloc(sizeof(num) * (L / 2 + 1)))
+        || !(c->work = (num *)FFT(malloc)(sizeof(num) * L))
+        || !(c->work_hat = (FFT(complex) *)FFT(malloc)(
+            sizeof(FFT(complex)) * (L / 2 + 1)))
+        || !(c->forward_plan = FFT(plan_dft_r2c_1d)((int)L,
+            c->work, c->work_hat, FFTW_ESTIMATE))
+        || !(c->inverse_plan = FFT(plan_dft_c2r_1d)((int)L,
+            c->work_hat, c->work, FFTW_ESTIMATE)))
+        return 0;
+    
+    for (m = 0; m < L; ++m)
+        c->work[m] = 0;
+    
+    c->work[0] = c->g_trunc[0];
+    
+    for (m = 1; m <= r; ++m)
+        c->work[m] = c->work[L - m] = c->g_trunc[m];
+    
+    FFT(execute)(c->forward_plan);
+    
+    for (m = 0; m <= L / 2; ++m)
+        c->filter_hat[m] = c->work_hat[m][0] / L;
+    
+    return 1;
+}
+
+/**
+ * \brief Overlap-save FFT convolution with a symmetric filter
+ * \param c         fir_coeffs prepared by fir_fft_precomp()
+ * \param dest      destination (must be distinct from src)
+ * \param dest_stride   stride between successive dest samples
+ * \param src       source signal
+ * \param src_stride    stride between successive src samples
+ * \param N         signal length
+ * \ingroup fir_gaussian
+ *
+ * Computes the same convolution as conv_sym(). Each block of
+ * M = block - 2r outputs is found from the M + 2r input samples around
+ * it, extended with half-sample symmetry at the ends of the signal, as
+ * the middle part of their circular convolution with the filter.
+ */
+static void fir_fft_conv(fir_coeffs c, num *dest, long dest_stride,
+    const num *src, long src_stride, long N)
+{
+    const long r = c.radius;
+    const long L = c.block;
+    const long M = L - 2 * r;
+    long n0, j;
+    
+    for (n0 = 0; n0 < N; n0 += M)
+    {
+        const long count = (N - n0 < M) ? N - n0 : M;
+        
+        for (j = 0; j < count + 2 * r; ++j)
+        {
+            const long n = n0 - r + j;
+            
+            c.work[j] = src[src_stride
+                * ((0 <= n && n < N) ? n : extension(N, n))];
+        }
+        
+        for (; j < L; ++j)
+            c.work[j] = 0;
+        
+        FFT(execute)(c.forward_plan);
+        
+        for (j = 0; j <= L / 2; ++j)
+        {
+            c.work_hat[j][0] *= c.filter_hat[j];
+            c.work_hat[j][1] *= c.filter_hat[j];
+        }
+        
+        FFT(execute)(c.inverse_plan);
+        
+        for (j = 0; j < count; ++j)
+            dest[dest_stride * (n0 + j)] = c.work[r + j];
     }
     
     return;
@@ -113,12 +384,44 @@ static void conv_sym(num *dest, const num *src, long N, long stride,
  * FIR filter and exact Gaussian convolution is bounded,
  * \f[ \lVert g * \Tilde{f} - g^\text{trunc} * \Tilde{f} \rVert_\infty
        \le \mathit{tol} \lVert f \rVert_\infty. \f]
+ *
+ * If the radius is at least #FIR_FFT_RADIUS, FFTW plans for overlap-save
+ * convolution are also prepared by fir_fft_precomp().
  */
 int fir_precomp(fir_coeffs *c, double sigma, num tol)
+{
+    return fir_precomp_ex(c, sigma, tol, FIR_FFT_RADIUS);
+}
+
+/**
+ * \brief Precompute FIR filtering with a given FFT radius threshold
+ * \param c             fir_coeffs pointer to hold precomputed coefficients
+ * \param sigma         Gaussian standard deviation
+ * \param tol           filter accuracy (smaller tol implies larger filter)
+ * \param fft_radius    smallest radius to filter by FFT, or 0 for never
+ *
+ * Same as fir_precomp(), but overlap-save FFT convolution is used if the
+ * radius is at least fft_radius instead of #FIR_FFT_RADIUS. A fft_radius
+ * of 1 always uses FFT convolution.
+ */
+int fir_precomp_ex(fir_coeffs *c, double sigma, num tol, long fft_radius)
 {
     assert(c && sigma > 0.0 && 0.0 < tol && tol < 1.0);
     c->radius = (long)ceil(M_SQRT2 * sigma * inverfc(0.5 * tol));
-    return (c->g_trunc = make_g_trunc(sigma, c->radius)) ? 1 : 0;
+    c->block = 0;
+    c->forward_plan = c->inverse_plan = NULL;
+    c->filter_hat = c->work = NULL;
+    c->work_hat = NULL;
+    
+    if (!(c->g_trunc = make_g_trunc(sigma, c->radius))
+        || (fft_radius > 0 && c->radius >= fft_radius
+            && !fir_fft_precomp(c)))
+    {
+        fir_free(c);
+        return 0;
+    }
+    
+    return 1;
 }
 
 /**
@@ -130,7 +433,8 @@ int fir_precomp(fir_coeffs *c, double sigma, num tol)
  * \param stride    stride between successive samples
  *
  * This routine approximates 1D Gaussian convolution with the FIR filter. The
- * computation itself is performed by conv_sym().
+ * computation itself is performed by conv_sym(), or by fir_fft_conv() for
+ * long filters.
  *
  * \note The computation is out-of-place, `src` and `dest` must be distinct.
  */
@@ -138,7 +442,12 @@ void fir_gaussian_conv(fir_coeffs c, num *dest, const num *src,
     long N, long stride)
 {
     assert(c.g_trunc && dest && src && dest != src && N > 0 && stride != 0);
-    conv_sym(dest, src, N, stride, c.g_trunc, c.radius);
+    
+    if (c.block)
+        fir_fft_conv(c, dest, stride, src, stride, N);
+    else
+        conv_sym(dest, src, N, stride, stride, c.g_trunc, c.radius);
+    
     return;
 }
 
@@ -159,32 +468,70 @@ void fir_gaussian_conv_image(fir_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels)
 {
     const long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(c.g_trunc && dest && buffer
         && src && dest != src && num_pixels > 0);
     
+    fir_gaussian_conv_view(c, dest_view, buffer, src_view);
+    return;
+}
+
+/**
+ * \brief FIR Gaussian 2D convolution of an image_view
+ * \param c             fir_coeffs created by fir_precomp()
+ * \param dest          output image_view (must not overlap src)
+ * \param buffer        array with at least max(width,height) elements
+ * \param src           input image_view, with the same dimensions as dest
+ * \ingroup fir_gaussian
+ *
+ * Same as fir_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image.
+ */
+void fir_gaussian_conv_view(fir_coeffs c, image_view dest, num *buffer,
+    image_view src)
+{
+    long x, y, channel;
+    
+    assert(c.g_trunc && dest.data && buffer && src.data
+        && dest.data != src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
     /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
+    for (channel = 0; channel < dest.num_channels; ++channel)
     {
-        num *dest_y = dest;
-        const num *src_y = src;
+        num *dest_c = dest.data + dest.channel_stride * channel;
+        const num *src_c = src.data + src.channel_stride * channel;
         
-        /* Filter each column of the channel. */
-        for (x = 0; x < width; ++x)
-            conv_sym(dest + x, src + x, height, width, c.g_trunc, c.radius);
+        /* Filter the columns of the channel. */
+        if (c.block)
+            for (x = 0; x < dest.width; ++x)
+                fir_fft_conv(c, dest_c + dest.pixel_stride * x,
+                    dest.row_stride, src_c + src.pixel_stride * x,
+                    src.row_stride, dest.height);
+        else
+            conv_sym_columns(dest_c, src_c, dest.width, dest.height,
+                dest.pixel_stride, dest.row_stride,
+                src.pixel_stride, src.row_stride, c.g_trunc, c.radius);
         
         /* Filter each row of the channel. */
-        for (y = 0; y < height; ++y)
+        for (y = 0; y < dest.height; ++y)
         {
-            conv_sym(buffer, dest_y, width, 1, c.g_trunc, c.radius);
-            memcpy(dest_y, buffer, sizeof(num) * width);
-            dest_y += width;
-            src_y += width;
+            num *dest_y = dest_c + dest.row_stride * y;
+            
+            if (c.block)
+                fir_fft_conv(c, buffer, 1,
+                    dest_y, dest.pixel_stride, dest.width);
+            else
+                conv_sym(buffer, dest_y, dest.width,
+                    1, dest.pixel_stride, c.g_trunc, c.radius);
+            
+            copy_strided(dest_y, dest.pixel_stride, buffer, 1, dest.width);
         }
-        
-        dest += num_pixels;
-        src += num_pixels;
     }
     
     return;
@@ -196,11 +543,25 @@ void fir_gaussian_conv_image(fir_coeffs c, num *dest, num *buffer,
  */
 void fir_free(fir_coeffs *c)
 {
-    if (c && c->g_trunc)
-    {
+    if (!c)
+        return;
+    
+    if (c->inverse_plan)
+        FFT(destroy_plan)(c->inverse_plan);
+    if (c->forward_plan)
+        FFT(destroy_plan)(c->forward_plan);
+    if (c->work_hat)
+        FFT(free)(c->work_hat);
+    if (c->work)
+        FFT(free)(c->work);
+    if (c->filter_hat)
+        free(c->filter_hat);
+    if (c->g_trunc)
         free(c->g_trunc);
-        c->g_trunc = NULL;
-    }
     
+    c->inverse_plan = c->forward_plan = NULL;
+    c->work_hat = NULL;
+    c->work = c->filter_hat = c->g_trunc = NULL;
+    c->block = 0;
     return;
 }
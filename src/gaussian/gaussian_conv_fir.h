@@ -33,6 +33,22 @@
  *       the convolution itself (may be called multiple times if desired)
  *    -# fir_free() to clean up
  *
+ * Boundary extension is only evaluated near the ends of the signal, and
+ * filters of radius up to 4 (3 to 9 taps, as for sigma below about 2)
+ * have unrolled kernels. The vertical pass of the 2D convolution computes
+ * each output row from whole input rows rather than striding down columns.
+ *
+ * The cost of direct filtering grows linearly with the radius, which is
+ * large when sigma is large or tol is small. For radius #FIR_FFT_RADIUS
+ * or more (or the threshold passed to fir_precomp_ex()), fir_precomp()
+ * instead prepares overlap-save convolution: the
+ * signal is processed in blocks of fir_coeffs::block samples, each
+ * transformed with FFTW, multiplied with the transformed filter, and
+ * transformed back, at a cost per sample that grows only logarithmically
+ * with the radius. The results agree with direct filtering up to rounding.
+ * The FFTW plans and work arrays are kept in the fir_coeffs, so the same
+ * fir_coeffs must not be used by several threads at once.
+ *
  * \par Example
 \code
     fir_coeffs c;
@@ -48,20 +64,42 @@
 #ifndef _GAUSSIAN_CONV_FIR_H_
 #define _GAUSSIAN_CONV_FIR_H_
 
+#include <fftw3.h>
 #include "num.h"
+#include "image_view.h"
+
+/**
+ * \brief Default smallest radius filtered by overlap-save FFT convolution
+ *
+ * This default is an estimate from operation counts and has not been
+ * measured against FFTW; the actual crossover depends on the machine and
+ * the FFTW build. To find it, compare `gaussian_bench speed -a fir_direct`
+ * with `-a fir_fft` over a range of sigma, and pass the radius where FFT
+ * becomes faster to fir_precomp_ex().
+ */
+#define FIR_FFT_RADIUS  48
 
 /** \brief Coefficients for FIR Gaussian approximation */
 typedef struct fir_coeffs_
 {
     num *g_trunc;   /**< FIR filter coefficients            */
     long radius;    /**< The radius of the filter's support */
+    long block;     /**< FFT block length, or 0 for direct filtering */
+    FFT(plan) forward_plan;     /**< forward real DFT of work      */
+    FFT(plan) inverse_plan;     /**< inverse real DFT of work_hat  */
+    num *filter_hat;            /**< DFT of the filter, divided by block */
+    num *work;                  /**< block of signal samples       */
+    FFT(complex) *work_hat;     /**< DFT of the block              */
 } fir_coeffs;
 
 int fir_precomp(fir_coeffs *c, double sigma, num tol);
+int fir_precomp_ex(fir_coeffs *c, double sigma, num tol, long fft_radius);
 void fir_gaussian_conv(fir_coeffs c, num *dest, const num *src,
     long N, long stride);
 void fir_gaussian_conv_image(fir_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels);
+void fir_gaussian_conv_view(fir_coeffs c, image_view dest, num *buffer,
+    image_view src);
 void fir_free(fir_coeffs *c);
 
 /** \} */
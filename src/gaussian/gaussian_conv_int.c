@@ -0,0 +1,510 @@
+/**
+ * \file gaussian_conv_int.c
+ * \brief Box, extended box, and SII Gaussian convolution of integer images
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include "gaussian_conv_int.h"
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include "filter_util.h"
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/* Accumulator type, only 32 bits are assumed. */
+#if UINT_MAX >= 0xFFFFFFFFUL
+typedef unsigned int int_acc;
+#else
+typedef unsigned long int_acc;
+#endif
+
+/* Largest accumulator value allowed, leaving a bit for rounding. */
+#define INT_ACC_LIMIT   0x7FFFFFFFUL
+/* Largest sample value after promotion to 16-bit fixed point. */
+#define INT_SAMPLE_MAX  0xFFFFUL
+/* Largest gain of a pass with rounded weights (ebox, sii). */
+#define INT_GAIN_MAX    0x8000L
+
+/* Integer 1D filter, applied to every line of the image. */
+typedef struct int_filter_
+{
+    enum {INT_BOX, INT_EBOX, INT_SII} algo;
+    int num_passes;         /* Number of passes (box, ebox)         */
+    int K;                  /* Number of boxes (sii)                */
+    long radii[SII_MAX_K];  /* Box radii, radii[0] for box and ebox */
+    int_acc weights[SII_MAX_K]; /* Integer weights                  */
+    int_acc gain;           /* Sum of the weights of one pass       */
+    long pad;               /* Padding needed on each side          */
+} int_filter;
+
+/* Fill the padding of a strip by half-sample symmetric extension. */
+static void int_reflect(int_acc *line, long N, long pad)
+{
+    long n;
+    int i;
+
+    for (n = 1; n <= pad; ++n)
+    {
+        int_acc *left = line - INT_CONV_STRIP * n;
+        int_acc *right = line + INT_CONV_STRIP * (N - 1 + n);
+        const int_acc *left_src = line + INT_CONV_STRIP * extension(N, -n);
+        const int_acc *right_src =
+            line + INT_CONV_STRIP * extension(N, N - 1 + n);
+
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+        {
+            left[i] = left_src[i];
+            right[i] = right_src[i];
+        }
+    }
+
+    return;
+}
+
+/* Divide samples 0, ..., N - 1 of a strip by scale, with rounding.
+
+   The rounded quotient (v + floor(scale/2)) / scale is computed by
+   multiplying with the reciprocal in double, which compilers vectorize
+   unlike integer division. It is exact: for v < 2^32, the product is
+   within 2^-20/scale of the true quotient, less than the added margin of
+   0.5/scale, which in turn is less than the distance 1/scale from the
+   next integer. */
+static void int_renormalize(int_acc *line, long N, int_acc scale)
+{
+    const double half = scale / 2 + 0.5, inv = 1.0 / scale;
+    long n;
+
+    for (n = 0; n < INT_CONV_STRIP * N; ++n)
+        line[n] = (int_acc)((line[n] + half) * inv);
+
+    return;
+}
+
+/* Box filter pass of radius r, dest(n) = src(n - r) + ... + src(n + r). */
+static void int_box_pass(int_acc *dest, const int_acc *src, long N, long r)
+{
+    long n;
+    int i;
+
+    for (i = 0; i < INT_CONV_STRIP; ++i)
+        dest[i] = 0;
+
+    for (n = -r; n <= r; ++n)
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+            dest[i] += src[INT_CONV_STRIP * n + i];
+
+    for (n = 1; n < N; ++n)
+    {
+        const int_acc *add = src + INT_CONV_STRIP * (n + r);
+        const int_acc *sub = src + INT_CONV_STRIP * (n - r - 1);
+        const int_acc *prev = dest + INT_CONV_STRIP * (n - 1);
+        int_acc *cur = dest + INT_CONV_STRIP * n;
+
+        /* Unsigned arithmetic wraps, so add - sub is exact mod 2^32. */
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+            cur[i] = prev[i] + add[i] - sub[i];
+    }
+
+    return;
+}
+
+/* Extended box filter pass, inner weight a on src(n - r), ..., src(n + r)
+   and outer weight b on src(n - r - 1) and src(n + r + 1). */
+static void int_ebox_pass(int_acc *dest, const int_acc *src, long N, long r,
+    int_acc a, int_acc b)
+{
+    int_acc accum[INT_CONV_STRIP];
+    long n;
+    int i;
+
+    for (i = 0; i < INT_CONV_STRIP; ++i)
+        accum[i] = 0;
+
+    for (n = -r - 1; n < r; ++n)
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+            accum[i] += src[INT_CONV_STRIP * n + i];
+
+    for (n = 0; n < N; ++n)
+    {
+        const int_acc *add = src + INT_CONV_STRIP * (n + r);
+        const int_acc *sub = src + INT_CONV_STRIP * (n - r - 1);
+        const int_acc *outer_left = sub;
+        const int_acc *outer_right = src + INT_CONV_STRIP * (n + r + 1);
+        int_acc *cur = dest + INT_CONV_STRIP * n;
+
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+        {
+            accum[i] += add[i] - sub[i];
+            cur[i] = a * accum[i] + b * (outer_left[i] + outer_right[i]);
+        }
+    }
+
+    return;
+}
+
+/* SII pass, src is replaced by its cumulative sum. */
+static void int_sii_pass(const int_filter *f, int_acc *dest, int_acc *src,
+    long N)
+{
+    long n;
+    int i, k;
+
+    for (n = -f->pad + 1; n < N + f->pad; ++n)
+    {
+        const int_acc *prev = src + INT_CONV_STRIP * (n - 1);
+        int_acc *cur = src + INT_CONV_STRIP * n;
+
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+            cur[i] += prev[i];
+    }
+
+    for (n = 0; n < N; ++n)
+    {
+        int_acc *cur = dest + INT_CONV_STRIP * n;
+
+        for (i = 0; i < INT_CONV_STRIP; ++i)
+            cur[i] = 0;
+
+        for (k = 0; k < f->K; ++k)
+        {
+            const int_acc w = f->weights[k];
+            const int_acc *add = src + INT_CONV_STRIP * (n + f->radii[k]);
+            const int_acc *sub =
+                src + INT_CONV_STRIP * (n - f->radii[k] - 1);
+
+            for (i = 0; i < INT_CONV_STRIP; ++i)
+                cur[i] += w * (add[i] - sub[i]);
+        }
+    }
+
+    return;
+}
+
+/* Filter a strip of lines in place, returning the scale of the result. */
+static int_acc int_filter_strip(const int_filter *f, int_acc **cur,
+    int_acc **next, long N)
+{
+    int_acc scale = 1, *swap;
+    int pass;
+
+    if (f->algo == INT_SII)
+    {
+        int_reflect(*cur, N, f->pad);
+        int_sii_pass(f, *next, *cur, N);
+        swap = *cur;
+        *cur = *next;
+        *next = swap;
+        return f->gain;
+    }
+
+    for (pass = 0; pass < f->num_passes; ++pass)
+    {
+        /* Renormalize if the next pass could overflow. */
+        if (scale > INT_ACC_LIMIT / (INT_SAMPLE_MAX * f->gain))
+        {
+            int_renormalize(*cur, N, scale);
+            scale = 1;
+        }
+
+        int_reflect(*cur, N, f->pad);
+
+        if (f->algo == INT_BOX)
+            int_box_pass(*next, *cur, N, f->radii[0]);
+        else
+            int_ebox_pass(*next, *cur, N, f->radii[0],
+                f->weights[0], f->weights[1]);
+
+        swap = *cur;
+        *cur = *next;
+        *next = swap;
+        scale *= f->gain;
+    }
+
+    return scale;
+}
+
+/* Filter num_lines lines of N samples of one channel, reading sample n of
+   line m at src[sample_stride * n + line_stride * m]. */
+static void int_filter_lines(const int_filter *f, void *dest,
+    const void *src, int is_u16, long N, long num_lines,
+    long sample_stride, long line_stride, int_acc *buffer)
+{
+    const int shift = (is_u16) ? 0 : 8;
+    const long strip_size = INT_CONV_STRIP * (N + 2 * f->pad);
+    long m, n;
+    int i;
+
+    for (m = 0; m < num_lines; m += INT_CONV_STRIP)
+    {
+        const int count = (num_lines - m < INT_CONV_STRIP)
+            ? (int)(num_lines - m) : INT_CONV_STRIP;
+        int_acc *cur = buffer + INT_CONV_STRIP * f->pad;
+        int_acc *next = cur + strip_size;
+        int_acc scale;
+        double half, inv;
+
+        /* Gather the strip, promoting samples to 16-bit fixed point. */
+        for (n = 0; n < N; ++n)
+        {
+            int_acc *line = cur + INT_CONV_STRIP * n;
+            const long offset = sample_stride * n + line_stride * m;
+
+            if (is_u16)
+                for (i = 0; i < count; ++i)
+                    line[i] = ((const unsigned short *)src)
+                        [offset + line_stride * i];
+            else
+                for (i = 0; i < count; ++i)
+                    line[i] = ((int_acc)((const unsigned char *)src)
+                        [offset + line_stride * i]) << 8;
+
+            for (; i < INT_CONV_STRIP; ++i)
+                line[i] = 0;
+        }
+
+        scale = int_filter_strip(f, &cur, &next, N) << shift;
+        half = scale / 2 + 0.5;     /* As in int_renormalize(). */
+        inv = 1.0 / scale;
+
+        /* Scatter the strip, dividing out the scale with rounding. */
+        for (n = 0; n < N; ++n)
+        {
+            const int_acc *line = cur + INT_CONV_STRIP * n;
+            const long offset = sample_stride * n + line_stride * m;
+
+            if (is_u16)
+                for (i = 0; i < count; ++i)
+                    ((unsigned short *)dest)[offset + line_stride * i] =
+                        (unsigned short)((line[i] + half) * inv);
+            else
+                for (i = 0; i < count; ++i)
+                    ((unsigned char *)dest)[offset + line_stride * i] =
+                        (unsigned char)((line[i] + half) * inv);
+        }
+    }
+
+    return;
+}
+
+/* Filter the rows, then the columns, of each channel of a planar image. */
+static int int_filter_image(const int_filter *f, void *dest,
+    const void *src, int is_u16, int width, int height, int num_channels)
+{
+    const long num_pixels = ((long)width) * ((long)height);
+    const long sample_size = (is_u16) ? sizeof(unsigned short) : 1;
+    const long N = (width > height) ? width : height;
+    int_acc *buffer;
+    int channel;
+
+    assert(dest && src && width > 0 && height > 0 && num_channels > 0);
+
+    if (!(buffer = (int_acc *)malloc(sizeof(int_acc)
+        * 2 * INT_CONV_STRIP * (N + 2 * f->pad))))
+        return 0;
+
+    for (channel = 0; channel < num_channels; ++channel)
+    {
+        char *dest_c = (char *)dest + sample_size * num_pixels * channel;
+        const char *src_c =
+            (const char *)src + sample_size * num_pixels * channel;
+
+        int_filter_lines(f, dest_c, src_c, is_u16,
+            width, height, 1, width, buffer);
+        int_filter_lines(f, dest_c, dest_c, is_u16,
+            height, width, width, 1, buffer);
+    }
+
+    free(buffer);
+    return 1;
+}
+
+/* Set up integer box filtering with Wells' radius. */
+static void int_box_setup(int_filter *f, double sigma, int K)
+{
+    assert(sigma > 0 && K > 0);
+
+    f->algo = INT_BOX;
+    f->num_passes = K;
+    f->radii[0] = (long)(0.5 * sqrt((12.0 * sigma * sigma) / K + 1.0));
+    f->gain = 2 * f->radii[0] + 1;
+    assert(f->gain <= INT_GAIN_MAX);
+    f->pad = f->radii[0] + 1;
+    return;
+}
+
+/* Set up integer extended box filtering with rounded weights. */
+static void int_ebox_setup(int_filter *f, ebox_coeffs c)
+{
+    const double q = INT_GAIN_MAX - (2 * c.r + 3);
+
+    f->algo = INT_EBOX;
+    f->num_passes = c.K;
+    f->radii[0] = c.r;
+    f->weights[0] = (int_acc)((c.c_1 + c.c_2) * q + 0.5);
+    f->weights[1] = (int_acc)(c.c_1 * q + 0.5);
+    f->gain = (2 * c.r + 1) * f->weights[0] + 2 * f->weights[1];
+    f->pad = c.r + 1;
+    return;
+}
+
+/* Set up integer SII filtering with rounded weights. */
+static void int_sii_setup(int_filter *f, sii_coeffs c)
+{
+    double q = INT_GAIN_MAX;
+    int k;
+
+    for (k = 0; k < c.K; ++k)
+        q -= 2 * c.radii[k] + 1;
+
+    f->algo = INT_SII;
+    f->K = c.K;
+    f->gain = 0;
+
+    for (k = 0; k < c.K; ++k)
+    {
+        f->radii[k] = c.radii[k];
+        f->weights[k] = (int_acc)(c.weights[k] * q + 0.5);
+        f->gain += (2 * c.radii[k] + 1) * f->weights[k];
+    }
+
+    f->pad = c.radii[0] + 1;
+    return;
+}
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/**
+ * \brief Box filtering Gaussian convolution of an 8-bit image
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \param sigma         Gaussian standard deviation
+ * \param K             number of box filter passes
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ *
+ * Same as box_gaussian_conv_image() with exact integer running sums. The
+ * image is planar, sample (x, y, channel) is at
+ * `src[x + width * (y + height * channel)]`.
+ */
+int box_gaussian_conv_image_u8(unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels,
+    double sigma, int K)
+{
+    int_filter f;
+
+    int_box_setup(&f, sigma, K);
+    return int_filter_image(&f, dest, src, 0,
+        width, height, num_channels);
+}
+
+/**
+ * \brief Box filtering Gaussian convolution of a 16-bit image
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \param sigma         Gaussian standard deviation
+ * \param K             number of box filter passes
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ */
+int box_gaussian_conv_image_u16(unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels,
+    double sigma, int K)
+{
+    int_filter f;
+
+    int_box_setup(&f, sigma, K);
+    return int_filter_image(&f, dest, src, 1,
+        width, height, num_channels);
+}
+
+/**
+ * \brief Extended box filtering Gaussian convolution of an 8-bit image
+ * \param c             coefficients precomputed by ebox_precomp()
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ *
+ * Same as ebox_gaussian_conv_image() with the weights rounded to integers.
+ */
+int ebox_gaussian_conv_image_u8(ebox_coeffs c, unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels)
+{
+    int_filter f;
+
+    int_ebox_setup(&f, c);
+    return int_filter_image(&f, dest, src, 0,
+        width, height, num_channels);
+}
+
+/**
+ * \brief Extended box filtering Gaussian convolution of a 16-bit image
+ * \param c             coefficients precomputed by ebox_precomp()
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ */
+int ebox_gaussian_conv_image_u16(ebox_coeffs c, unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels)
+{
+    int_filter f;
+
+    int_ebox_setup(&f, c);
+    return int_filter_image(&f, dest, src, 1,
+        width, height, num_channels);
+}
+
+/**
+ * \brief SII Gaussian convolution of an 8-bit image
+ * \param c             coefficients precomputed by sii_precomp()
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ *
+ * Same as sii_gaussian_conv_image() with the weights rounded to integers.
+ * The cumulative sums wrap modulo 2^32, which leaves the box sums exact.
+ */
+int sii_gaussian_conv_image_u8(sii_coeffs c, unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels)
+{
+    int_filter f;
+
+    int_sii_setup(&f, c);
+    return int_filter_image(&f, dest, src, 0,
+        width, height, num_channels);
+}
+
+/**
+ * \brief SII Gaussian convolution of a 16-bit image
+ * \param c             coefficients precomputed by sii_precomp()
+ * \param dest          output image
+ * \param src           input image, overwritten if src = dest
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup int_gaussian
+ */
+int sii_gaussian_conv_image_u16(sii_coeffs c, unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels)
+{
+    int_filter f;
+
+    int_sii_setup(&f, c);
+    return int_filter_image(&f, dest, src, 1,
+        width, height, num_channels);
+}
@@ -0,0 +1,93 @@
+/**
+ * \file gaussian_conv_int.h
+ * \brief Box, extended box, and SII Gaussian convolution of integer images
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * \defgroup int_gaussian Integer-domain Gaussian convolution
+ * \brief Box, extended box, and SII filtering of 8-bit and 16-bit images.
+ *
+ * These routines filter planar images of unsigned char or unsigned short
+ * samples directly, without converting them to #num. Samples are promoted
+ * to 16-bit fixed point (8-bit samples are shifted left by 8 bits) and
+ * filtered with running sums in unsigned 32-bit arithmetic. The filter
+ * weights are integers: for box filtering the sums are exact, and for
+ * extended box and SII filtering the weights are rounded to integers whose
+ * total is the exact normalization, so constant images are reproduced
+ * exactly.
+ *
+ * The lines of an image are filtered #INT_CONV_STRIP at a time. A strip is
+ * stored with the samples of its lines interleaved, so that every step of
+ * the running sums is an independent operation on #INT_CONV_STRIP
+ * contiguous accumulators, a loop that compilers vectorize. This applies
+ * to both the row and column passes.
+ *
+ * \par Error bound
+ * Let u be the result of the #num routine (box_gaussian_conv_image(),
+ * ebox_gaussian_conv_image(), or sii_gaussian_conv_image()) on the same
+ * image, before any rounding to integers. Then in units of the integer
+ * sample type, the result of these routines differs from u by at most
+ *  - box: 1, due to the rounding of the intermediate image after the row
+ *    pass and of the output. The sums are exact, but when the product of
+ *    2^16 and (2r+1)^K exceeds 2^31, they are renormalized between passes,
+ *    adding 2^-9 (8-bit) or 1/2 (16-bit) per renormalization.
+ *  - ebox: 1 + M K (2r+3) / 2^14 plus the same term per renormalization,
+ *    which happens before every pass after the first. Here M is the
+ *    largest sample value, and the middle term bounds the effect of
+ *    rounding the weights.
+ *  - sii: 1 + M (2r_1+1 + ... + 2r_K+1) / 2^14, the second term again
+ *    bounding the effect of rounding the weights.
+ *
+ * In practice the error is below 1 for 8-bit images and a few units for
+ * 16-bit images.
+ *
+ * \par Example
+\code
+    sii_coeffs c;
+
+    sii_precomp(&c, sigma, K);
+
+    if (!sii_gaussian_conv_image_u8(c, dest, src,
+        width, height, num_channels))
+        fprintf(stderr, "Out of memory\n");
+\endcode
+ *
+ * \{
+ */
+#ifndef _GAUSSIAN_CONV_INT_H_
+#define _GAUSSIAN_CONV_INT_H_
+
+#include "num.h"
+#include "gaussian_conv_ebox.h"
+#include "gaussian_conv_sii.h"
+
+/** \brief Number of lines filtered together */
+#define INT_CONV_STRIP  16
+
+int box_gaussian_conv_image_u8(unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels,
+    double sigma, int K);
+int box_gaussian_conv_image_u16(unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels,
+    double sigma, int K);
+int ebox_gaussian_conv_image_u8(ebox_coeffs c, unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels);
+int ebox_gaussian_conv_image_u16(ebox_coeffs c, unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels);
+int sii_gaussian_conv_image_u8(sii_coeffs c, unsigned char *dest,
+    const unsigned char *src, int width, int height, int num_channels);
+int sii_gaussian_conv_image_u16(sii_coeffs c, unsigned short *dest,
+    const unsigned short *src, int width, int height, int num_channels);
+
+/** \} */
+#endif /* _GAUSSIAN_CONV_INT_H_ */
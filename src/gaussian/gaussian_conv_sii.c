@@ -20,8 +20,17 @@
 #include "gaussian_conv_sii.h"
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "filter_util.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+/** \brief Index of the calling thread, for selecting its buffer */
+#define THREAD_NUM      omp_get_thread_num()
+#else
+#define THREAD_NUM      0
+#endif
+
 #ifndef M_PI
 /** \brief The constant pi */
 #define M_PI        3.14159265358979323846264338327950288
@@ -162,33 +171,308 @@ void sii_gaussian_conv(sii_coeffs c, num *dest, num *buffer,
 void sii_gaussian_conv_image(sii_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels)
 {
-    long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    const long num_pixels = ((long)width) * ((long)height);
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && buffer && src && num_pixels > 0);
     
+    sii_gaussian_conv_view(c, dest_view, buffer, src_view);
+    return;
+}
+
+/**
+ * \brief SII Gaussian 2D convolution of an image_view
+ * \param c             precomputed coefficients
+ * \param dest          output image_view
+ * \param buffer        workspace, as for sii_gaussian_conv_image()
+ * \param src           input image_view, with the same dimensions as dest
+ * \ingroup sii_gaussian
+ *
+ * Same as sii_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void sii_gaussian_conv_view(sii_coeffs c, image_view dest, num *buffer,
+    image_view src)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
+    /* Filter each row. All channels of a row are filtered together so that
+       interleaved data is reused while it is in cache. */
+    for (y = 0; y < dest.height; ++y)
+        for (channel = 0; channel < dest.num_channels; ++channel)
+        {
+            num *dest_y = IMAGE_VIEW_PTR(dest, 0, y, channel);
+            const num *src_y = IMAGE_VIEW_PTR(src, 0, y, channel);
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
+            sii_gaussian_conv(c,
+                dest_y, buffer, src_y, dest.width, dest.pixel_stride);
+        }
+    
+    /* Filter each column, likewise all channels of a column together. */
+    for (x = 0; x < dest.width; ++x)
+        for (channel = 0; channel < dest.num_channels; ++channel)
+        {
+            num *dest_x = IMAGE_VIEW_PTR(dest, x, 0, channel);
+            sii_gaussian_conv(c,
+                dest_x, buffer, dest_x, dest.height, dest.row_stride);
+        }
+    
+    return;
+}
+
+/**
+ * \brief Normalized (mask-aware) SII Gaussian convolution
+ * \param c             coefficients precomputed by sii_precomp()
+ * \param dest          output image in planar order
+ * \param buffer        workspace, as for sii_gaussian_conv_image()
+ * \param src           input image in planar order, may contain NaNs
+ * \param mask          nonnegative weight per pixel, or NULL
+ * \param width         image width
+ * \param height        image height
+ * \param num_channels  number of image channels
+ * \return 1 on success, 0 on failure
+ * \ingroup sii_gaussian
+ *
+ * Computes conv(mask*src)/conv(mask), filling in pixels with zero weight
+ * or NaN samples from their neighbors. The weighted values and the
+ * weights are interleaved in one work image and filtered in a single
+ * pass, see normalized_conv_init(). `dest` may equal `src`.
+ */
+int sii_gaussian_conv_normalized(sii_coeffs c, num *dest, num *buffer,
+    const num *src, const num *mask, int width, int height, int num_channels)
+{
+    image_view work;
+    
+    if (!normalized_conv_init(&work, src, mask,
+        width, height, num_channels))
+        return 0;
+    
+    sii_gaussian_conv_view(c, work, buffer, work);
+    normalized_conv_finish(dest, &work);
+    return 1;
+}
+
+/**
+ * \brief Precompute a table of SII coefficients indexed by sigma
+ * \param t             sii_table pointer to hold the table
+ * \param sigma_max     largest standard deviation in the table
+ * \param num_levels    number of levels, at least 2
+ * \param K             number of boxes = 3, 4, or 5
+ * \return 1 on success, 0 on failure
+ * \ingroup sii_gaussian
+ *
+ * Level i holds the coefficients of sii_precomp() for sigma = i * step,
+ * where step = sigma_max / (num_levels - 1). Level 0 is the identity
+ * (all radii zero). A step of about 0.25 or less makes the interpolation
+ * between levels visually seamless. The table should be released with
+ * sii_table_free().
+ */
+int sii_table_precomp(sii_table *t, double sigma_max, int num_levels, int K)
+{
+    int i, k;
+    
+    assert(t && sigma_max > 0 && num_levels >= 2 && SII_VALID_K(K));
+    
+    if (!(t->levels = (sii_coeffs *)malloc(sizeof(sii_coeffs) * num_levels)))
+        return 0;
+    
+    t->num_levels = num_levels;
+    t->sigma_step = sigma_max / (num_levels - 1);
+    t->levels[0].K = K;
+    
+    for (k = 0; k < K; ++k)
+    {
+        t->levels[0].radii[k] = 0;
+        t->levels[0].weights[k] = (num)(1.0 / K);
+    }
+    
+    for (i = 1; i < num_levels; ++i)
+        sii_precomp(&t->levels[i], i * t->sigma_step, K);
+    
+    /* The first box of each level has the largest radius. */
+    t->max_radius = t->levels[num_levels - 1].radii[0];
+    return 1;
+}
+
+/**
+ * \brief Release memory of an sii_table
+ * \param t     sii_table created by sii_table_precomp()
+ * \ingroup sii_gaussian
+ */
+void sii_table_free(sii_table *t)
+{
+    if (t->levels)
+        free(t->levels);
+    
+    t->levels = NULL;
+    return;
+}
+
+/**
+ * \brief Buffer size needed for spatially varying SII convolution
+ * \param t     sii_table created by sii_table_precomp()
+ * \param N     number of samples (in 2D, max(width, height))
+ * \return required buffer size in units of num samples
+ * \ingroup sii_gaussian
+ *
+ * When compiled with OpenMP, space is included for a separate buffer for
+ * each thread used by sii_variable_conv_image().
+ */
+long sii_variable_buffer_size(sii_table t, long N)
+{
+    long size = N + 2 * (t.max_radius + 1);
+    
+#ifdef _OPENMP
+    size *= omp_get_max_threads();
+#endif
+    return size;
+}
+
+/**
+ * \brief Spatially varying Gaussian convolution SII approximation
+ * \param t             sii_table created by sii_table_precomp()
+ * \param dest          output convolved data
+ * \param buffer        array with space for N + 2 (t.max_radius + 1) samples
+ * \param src           input, modified in-place if src = dest
+ * \param sigma         standard deviation at each sample
+ * \param N             number of samples
+ * \param stride        stride between successive samples of src and dest
+ * \param sigma_stride  stride between successive samples of sigma
+ * \ingroup sii_gaussian
+ *
+ * Sample n of the output is the SII approximation of Gaussian convolution
+ * with standard deviation sigma[sigma_stride * n], linearly interpolated
+ * between the two nearest levels of the table. Values of sigma beyond the
+ * range of the table are clamped. Boundaries are handled with half-sample
+ * symmetric extension, as in sii_gaussian_conv().
+ */
+void sii_variable_conv(sii_table t, num *dest, num *buffer,
+    const num *src, const num *sigma, long N, long stride, long sigma_stride)
+{
+    const sii_coeffs *c0, *c1;
+    num accum, accum0, accum1, frac, s;
+    long pad, n;
+    int i, k;
+    
+    assert(dest && buffer && src && sigma && dest != buffer
+        && src != buffer && N > 0 && stride != 0);
+    
+    pad = t.max_radius + 1;
+    buffer += pad;
+    
+    /* Compute cumulative sum of src over n = -pad,..., N + pad - 1. */
+    for (n = -pad, accum = 0; n < N + pad; ++n)
+    {
+        accum += src[stride * extension(N, n)];
+        buffer[n] = accum;
+    }
+    
+    /* Compute stacked box filters of the two nearest levels. */
+    for (n = 0; n < N; ++n, dest += stride, sigma += sigma_stride)
+    {
+        s = (num)(*sigma / t.sigma_step);
+        
+        if (s <= 0)
+        {
+            i = 0;
+            frac = 0;
+        }
+        else if (s >= t.num_levels - 1)
+        {
+            i = t.num_levels - 2;
+            frac = 1;
+        }
+        else
+        {
+            i = (int)s;
+            frac = s - i;
+        }
+        
+        c0 = &t.levels[i];
+        c1 = &t.levels[i + 1];
+        accum0 = accum1 = 0;
+        
+        for (k = 0; k < c0->K; ++k)
+        {
+            accum0 += c0->weights[k] * (buffer[n + c0->radii[k]]
+                - buffer[n - c0->radii[k] - 1]);
+            accum1 += c1->weights[k] * (buffer[n + c1->radii[k]]
+                - buffer[n - c1->radii[k] - 1]);
+        }
+        
+        *dest = accum0 + frac * (accum1 - accum0);
+    }
+    
+    return;
+}
+
+/**
+ * \brief Spatially varying 2D Gaussian convolution SII approximation
+ * \param t             sii_table created by sii_table_precomp()
+ * \param dest          output convolved data
+ * \param buffer        array with space for sii_variable_buffer_size()
+ *                      samples, where N = max(width, height)
+ * \param src           image to be convolved, overwritten if src = dest
+ * \param sigma         width x height array of standard deviations
+ * \param width         image width
+ * \param height        image height
+ * \param num_channels  number of image channels
+ * \ingroup sii_gaussian
+ *
+ * The image is filtered separably with sii_variable_conv(), first along
+ * rows and then along columns, using the standard deviation of each pixel
+ * in both passes. With OpenMP, rows and columns are distributed over
+ * threads, each using its own part of the buffer.
+ */
+void sii_variable_conv_image(sii_table t, num *dest, num *buffer,
+    const num *src, const num *sigma, int width, int height,
+    int num_channels)
+{
+    const long num_pixels = ((long)width) * ((long)height);
+    const long thread_size = ((width >= height) ? width : height)
+        + 2 * (t.max_radius + 1);
+    long x, y, channel;
+    
+    assert(dest && buffer && src && sigma && num_pixels > 0);
+    
     /* Loop over the image channels. */
     for (channel = 0; channel < num_channels; ++channel)
     {
-        num *dest_y = dest;
-        const num *src_y = src;
+        num *dest_c = dest + num_pixels * channel;
+        const num *src_c = src + num_pixels * channel;
         
         /* Filter each row of the channel. */
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
         for (y = 0; y < height; ++y)
-        {
-            sii_gaussian_conv(c,
-                dest_y, buffer, src_y, width, 1);
-            dest_y += width;
-            src_y += width;
-        }
+            sii_variable_conv(t, dest_c + width * y,
+                buffer + thread_size * THREAD_NUM,
+                src_c + width * y, sigma + width * y, width, 1, 1);
         
         /* Filter each column of the channel. */
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
         for (x = 0; x < width; ++x)
-            sii_gaussian_conv(c,
-                dest + x, buffer, dest + x, height, width);
-        
-        dest += num_pixels;
-        src += num_pixels;
+            sii_variable_conv(t, dest_c + x,
+                buffer + thread_size * THREAD_NUM,
+                dest_c + x, sigma + x, height, width, width);
     }
     
     return;
@@ -37,6 +37,15 @@
  * The function sii_buffer_size() should be used to determine the minimum
  * required buffer size.
  *
+ * \par Spatially varying blur
+ * For a blur whose sigma varies per pixel (e.g., depth of field or foveated
+ * rendering), sii_table_precomp() tabulates coefficients over a range of
+ * sigma. sii_variable_conv() and sii_variable_conv_image() then evaluate at
+ * each sample the boxes of the two table levels nearest to the local sigma
+ * against the same cumulative sum, interpolating linearly between them. The
+ * cost is O(K) per sample regardless of sigma. With OpenMP, rows and columns
+ * of an image are filtered in parallel.
+ *
  * \par Example
 \code
     sii_coeffs c;
@@ -63,6 +72,7 @@
 #define GAUSSIAN_CONV_SII_H
 
 #include "num.h"
+#include "image_view.h"
 
 /** \brief Minimum SII filter order */
 #define SII_MIN_K       3
@@ -79,12 +89,34 @@ typedef struct sii_coeffs_
     int K;                      /**< Number of boxes */
 } sii_coeffs;
 
+/** \brief Table of SII coefficients for uniformly spaced sigma values */
+typedef struct sii_table_
+{
+    sii_coeffs *levels;         /**< Coefficients for each sigma level   */
+    double sigma_step;          /**< Spacing, level i has sigma i*step   */
+    long max_radius;            /**< Largest box radius over all levels  */
+    int num_levels;             /**< Number of levels                    */
+} sii_table;
+
 void sii_precomp(sii_coeffs *c, double sigma, int K);
 long sii_buffer_size(sii_coeffs c, long N);
 void sii_gaussian_conv(sii_coeffs c, num *dest, num *buffer,
     const num *src, long N, long stride);
 void sii_gaussian_conv_image(sii_coeffs c, num *dest, num *buffer,
     const num *src, int width, int height, int num_channels);
+void sii_gaussian_conv_view(sii_coeffs c, image_view dest, num *buffer,
+    image_view src);
+int sii_gaussian_conv_normalized(sii_coeffs c, num *dest, num *buffer,
+    const num *src, const num *mask, int width, int height, int num_channels);
+
+int sii_table_precomp(sii_table *t, double sigma_max, int num_levels, int K);
+void sii_table_free(sii_table *t);
+long sii_variable_buffer_size(sii_table t, long N);
+void sii_variable_conv(sii_table t, num *dest, num *buffer,
+    const num *src, const num *sigma, long N, long stride, long sigma_stride);
+void sii_variable_conv_image(sii_table t, num *dest, num *buffer,
+    const num *src, const num *sigma, int width, int height,
+    int num_channels);
 
 /** \} */
 #endif /* GAUSSIAN_CONV_SII_H */
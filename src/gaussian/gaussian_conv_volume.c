@@ -0,0 +1,271 @@
+/**
+ * \file gaussian_conv_volume.c
+ * \brief 3D Gaussian convolution of volumes and image stacks
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include "gaussian_conv_volume.h"
+#include <assert.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+/** \brief Index of the calling thread, for selecting its buffer */
+#define THREAD_NUM      omp_get_thread_num()
+/** \brief Number of threads that may share the buffer */
+#define NUM_THREADS     omp_get_max_threads()
+#else
+#define THREAD_NUM      0
+#define NUM_THREADS     1
+#endif
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+/* 1D filter used along each of the three axes. */
+typedef struct volume_filter_
+{
+    enum {VOLUME_DERICHE, VOLUME_VYV, VOLUME_SII} algo;
+    union
+    {
+        deriche_coeffs deriche;
+        vyv_coeffs vyv;
+        sii_coeffs sii;
+    } axis[3];
+} volume_filter;
+
+static void volume_conv_line(const volume_filter *f, int axis,
+    num *dest, num *buffer, const num *src, long N, long stride)
+{
+    switch (f->algo)
+    {
+    case VOLUME_DERICHE:
+        deriche_gaussian_conv(f->axis[axis].deriche,
+            dest, buffer, src, N, stride);
+        break;
+    case VOLUME_VYV:
+        vyv_gaussian_conv(f->axis[axis].vyv, dest, src, N, stride);
+        break;
+    case VOLUME_SII:
+        sii_gaussian_conv(f->axis[axis].sii,
+            dest, buffer, src, N, stride);
+        break;
+    }
+}
+
+/* Separable 3D filtering, thread_size is the buffer size per thread. */
+static void volume_conv(const volume_filter *f, num *dest, num *buffer,
+    long thread_size, const num *src,
+    long width, long height, long depth, long num_channels)
+{
+    const long plane = width * height;
+    const long num_blocks = (plane + VOLUME_BLOCK - 1) / VOLUME_BLOCK;
+    long z, b, channel;
+
+    assert(dest && buffer && src
+        && width > 0 && height > 0 && depth > 0 && num_channels > 0);
+
+    for (channel = 0; channel < num_channels; ++channel)
+    {
+        num *dest_c = dest + plane * depth * channel;
+        const num *src_c = src + plane * depth * channel;
+
+        /* Filter each xy plane along x and y, threading over slabs. */
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (z = 0; z < depth; ++z)
+        {
+            num *line_buffer = buffer + thread_size * THREAD_NUM;
+            num *dest_z = dest_c + plane * z;
+            const num *src_z = src_c + plane * z;
+            long x, y;
+
+            for (y = 0; y < height; ++y)
+                volume_conv_line(f, 0, dest_z + width * y, line_buffer,
+                    src_z + width * y, width, 1);
+
+            for (x = 0; x < width; ++x)
+                volume_conv_line(f, 1, dest_z + x, line_buffer,
+                    dest_z + x, height, width);
+        }
+
+        /* Filter along z. Each block of VOLUME_BLOCK neighboring lines is
+           transposed into contiguous lines, filtered, and written back. */
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (b = 0; b < num_blocks; ++b)
+        {
+            num *block = buffer + thread_size * THREAD_NUM;
+            num *line_buffer = block + VOLUME_BLOCK * depth;
+            num *dest_b = dest_c + VOLUME_BLOCK * b;
+            const long count = (plane - VOLUME_BLOCK * b < VOLUME_BLOCK)
+                ? plane - VOLUME_BLOCK * b : VOLUME_BLOCK;
+            long i, k;
+
+            for (k = 0; k < depth; ++k)
+                for (i = 0; i < count; ++i)
+                    block[k + depth * i] = dest_b[i + plane * k];
+
+            for (i = 0; i < count; ++i)
+                volume_conv_line(f, 2, block + depth * i, line_buffer,
+                    block + depth * i, depth, 1);
+
+            for (k = 0; k < depth; ++k)
+                for (i = 0; i < count; ++i)
+                    dest_b[i + plane * k] = block[k + depth * i];
+        }
+    }
+
+    return;
+}
+
+/* Largest of three sizes. */
+static long max3(long a, long b, long c)
+{
+    if (b > a)
+        a = b;
+    return (c > a) ? c : a;
+}
+#endif /* DOXYGEN_SHOULD_SKIP_THIS */
+
+/**
+ * \brief Buffer size needed for deriche_gaussian_conv_volume()
+ * \param width, height, depth  volume dimensions
+ * \return required buffer size in units of num samples
+ * \ingroup volume_gaussian
+ *
+ * When compiled with OpenMP, space is included for a separate buffer for
+ * each thread.
+ */
+long deriche_volume_buffer_size(long width, long height, long depth)
+{
+    return (VOLUME_BLOCK * depth + 2 * max3(width, height, depth))
+        * NUM_THREADS;
+}
+
+/**
+ * \brief Deriche Gaussian 3D convolution
+ * \param cx, cy, cz    coefficients precomputed by deriche_precomp() for
+ *                      filtering along x, y, and z
+ * \param dest          output convolved data
+ * \param buffer        array with space for deriche_volume_buffer_size()
+ *                      samples
+ * \param src           input volume, overwritten if src = dest
+ * \param width, height, depth  volume dimensions
+ * \param num_channels  number of channels
+ * \ingroup volume_gaussian
+ */
+void deriche_gaussian_conv_volume(deriche_coeffs cx, deriche_coeffs cy,
+    deriche_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels)
+{
+    volume_filter f;
+
+    f.algo = VOLUME_DERICHE;
+    f.axis[0].deriche = cx;
+    f.axis[1].deriche = cy;
+    f.axis[2].deriche = cz;
+    volume_conv(&f, dest, buffer,
+        deriche_volume_buffer_size(width, height, depth) / NUM_THREADS,
+        src, width, height, depth, num_channels);
+    return;
+}
+
+/**
+ * \brief Buffer size needed for vyv_gaussian_conv_volume()
+ * \param width, height, depth  volume dimensions
+ * \return required buffer size in units of num samples
+ * \ingroup volume_gaussian
+ *
+ * When compiled with OpenMP, space is included for a separate buffer for
+ * each thread.
+ */
+long vyv_volume_buffer_size(long width, long height, long depth)
+{
+    (void)width;
+    (void)height;
+    return VOLUME_BLOCK * depth * NUM_THREADS;
+}
+
+/**
+ * \brief Vliet-Young-Verbeek Gaussian 3D convolution
+ * \param cx, cy, cz    coefficients precomputed by vyv_precomp() for
+ *                      filtering along x, y, and z
+ * \param dest          output convolved data
+ * \param buffer        array with space for vyv_volume_buffer_size()
+ *                      samples
+ * \param src           input volume, overwritten if src = dest
+ * \param width, height, depth  volume dimensions
+ * \param num_channels  number of channels
+ * \ingroup volume_gaussian
+ */
+void vyv_gaussian_conv_volume(vyv_coeffs cx, vyv_coeffs cy,
+    vyv_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels)
+{
+    volume_filter f;
+
+    f.algo = VOLUME_VYV;
+    f.axis[0].vyv = cx;
+    f.axis[1].vyv = cy;
+    f.axis[2].vyv = cz;
+    volume_conv(&f, dest, buffer,
+        vyv_volume_buffer_size(width, height, depth) / NUM_THREADS,
+        src, width, height, depth, num_channels);
+    return;
+}
+
+/**
+ * \brief Buffer size needed for sii_gaussian_conv_volume()
+ * \param cx, cy, cz    coefficients precomputed by sii_precomp()
+ * \param width, height, depth  volume dimensions
+ * \return required buffer size in units of num samples
+ * \ingroup volume_gaussian
+ *
+ * When compiled with OpenMP, space is included for a separate buffer for
+ * each thread.
+ */
+long sii_volume_buffer_size(sii_coeffs cx, sii_coeffs cy, sii_coeffs cz,
+    long width, long height, long depth)
+{
+    return (VOLUME_BLOCK * depth + max3(sii_buffer_size(cx, width),
+        sii_buffer_size(cy, height), sii_buffer_size(cz, depth)))
+        * NUM_THREADS;
+}
+
+/**
+ * \brief SII Gaussian 3D convolution
+ * \param cx, cy, cz    coefficients precomputed by sii_precomp() for
+ *                      filtering along x, y, and z
+ * \param dest          output convolved data
+ * \param buffer        array with space for sii_volume_buffer_size()
+ *                      samples
+ * \param src           input volume, overwritten if src = dest
+ * \param width, height, depth  volume dimensions
+ * \param num_channels  number of channels
+ * \ingroup volume_gaussian
+ */
+void sii_gaussian_conv_volume(sii_coeffs cx, sii_coeffs cy,
+    sii_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels)
+{
+    volume_filter f;
+
+    f.algo = VOLUME_SII;
+    f.axis[0].sii = cx;
+    f.axis[1].sii = cy;
+    f.axis[2].sii = cz;
+    volume_conv(&f, dest, buffer,
+        sii_volume_buffer_size(cx, cy, cz, width, height, depth)
+        / NUM_THREADS, src, width, height, depth, num_channels);
+    return;
+}
@@ -0,0 +1,80 @@
+/**
+ * \file gaussian_conv_volume.h
+ * \brief 3D Gaussian convolution of volumes and image stacks
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * \defgroup volume_gaussian 3D Gaussian convolution
+ * \brief Separable Gaussian filtering of volumes and image stacks.
+ *
+ * These routines filter a volume of width x height x depth samples (or a
+ * video, with time as the third dimension) separably along x, y, and z with
+ * the Deriche, Vliet-Young-Verbeek, or SII 1D filters. A different set of
+ * coefficients is used for each axis, so that the three standard deviations
+ * are independent. Sample (x, y, z) of channel c is at
+\code
+    data[x + width * (y + height * (z + depth * c))]
+\endcode
+ *
+ * The x and y passes filter each xy plane. The z pass gathers blocks of
+ * #VOLUME_BLOCK neighboring z lines into contiguous memory, filters them
+ * there, and scatters them back, so that the recursions do not stride
+ * through a full plane per sample. With OpenMP, the planes and the blocks
+ * are distributed over threads, each with its own part of the buffer.
+ *
+ * \par Example
+\code
+    deriche_coeffs cx, cy, cz;
+    num *buffer;
+
+    deriche_precomp(&cx, sigma_x, K, tol);
+    deriche_precomp(&cy, sigma_y, K, tol);
+    deriche_precomp(&cz, sigma_z, K, tol);
+    buffer = (num *)malloc(sizeof(num)
+        * deriche_volume_buffer_size(width, height, depth));
+    deriche_gaussian_conv_volume(cx, cy, cz, dest, buffer, src,
+        width, height, depth, num_channels);
+    free(buffer);
+\endcode
+ *
+ * \{
+ */
+#ifndef _GAUSSIAN_CONV_VOLUME_H_
+#define _GAUSSIAN_CONV_VOLUME_H_
+
+#include "num.h"
+#include "gaussian_conv_deriche.h"
+#include "gaussian_conv_vyv.h"
+#include "gaussian_conv_sii.h"
+
+/** \brief Number of z lines filtered together in the z pass */
+#define VOLUME_BLOCK    64
+
+long deriche_volume_buffer_size(long width, long height, long depth);
+void deriche_gaussian_conv_volume(deriche_coeffs cx, deriche_coeffs cy,
+    deriche_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels);
+
+long vyv_volume_buffer_size(long width, long height, long depth);
+void vyv_gaussian_conv_volume(vyv_coeffs cx, vyv_coeffs cy,
+    vyv_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels);
+
+long sii_volume_buffer_size(sii_coeffs cx, sii_coeffs cy, sii_coeffs cz,
+    long width, long height, long depth);
+void sii_gaussian_conv_volume(sii_coeffs cx, sii_coeffs cy,
+    sii_coeffs cz, num *dest, num *buffer, const num *src,
+    long width, long height, long depth, long num_channels);
+
+/** \} */
+#endif /* _GAUSSIAN_CONV_VOLUME_H_ */
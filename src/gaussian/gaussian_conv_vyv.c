@@ -20,11 +20,13 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include "filter_util.h"
 #include "complex_arith.h"
 #include "invert_matrix.h"
 #include "gaussian_short_conv.h"
 #include "gaussian_conv_vyv.h"
+#include "cpu_dispatch.h"
 
 /** \brief Number of newton iterations used to determine q */
 #define YVY_NUM_NEWTON_ITERATIONS       6
@@ -233,6 +235,31 @@ void vyv_precomp(vyv_coeffs *c, double sigma, int K, num tol)
     return;
 }
 
+/* Instances of vyv_conv for each instruction set level */
+#define VYV_CONV_FUNC    vyv_conv_baseline
+#include "vyv_conv_inc.c"
+#undef VYV_CONV_FUNC
+
+#ifdef CPU_DISPATCH_TARGETS
+#define VYV_CONV_FUNC    vyv_conv_sse2
+#define VYV_CONV_ISA     "sse2"
+#include "vyv_conv_inc.c"
+#undef VYV_CONV_FUNC
+#undef VYV_CONV_ISA
+
+#define VYV_CONV_FUNC    vyv_conv_avx2
+#define VYV_CONV_ISA     "avx2"
+#include "vyv_conv_inc.c"
+#undef VYV_CONV_FUNC
+#undef VYV_CONV_ISA
+
+#define VYV_CONV_FUNC    vyv_conv_avx512
+#define VYV_CONV_ISA     "avx512f"
+#include "vyv_conv_inc.c"
+#undef VYV_CONV_FUNC
+#undef VYV_CONV_ISA
+#endif
+
 /**
  * \brief Gaussian convolution Vliet-Young-Verbeek approximation
  * \param c         vyv_coeffs created by vyv_precomp()
@@ -253,21 +280,15 @@ void vyv_precomp(vyv_coeffs *c, double sigma, int K, num tol)
  * The convolution can be performed in-place by setting `src` = `dest` (the
  * source array is overwritten with the result).
  *
+ * As for deriche_gaussian_conv(), the filtering loops (vyv_conv_inc.c) are
+ * built for each instruction set level and selected by get_cpu_level().
+ *
  * \note When the #num typedef is set to single-precision arithmetic,
  * results may be inaccurate for large values of sigma.
  */
 void vyv_gaussian_conv(vyv_coeffs c,
     num *dest, const num *src, long N, long stride)
 {
-    const long stride_2 = stride * 2;
-    const long stride_3 = stride * 3;
-    const long stride_4 = stride * 4;
-    const long stride_5 = stride * 5;
-    const long stride_N = stride * N;
-    num q[VYV_MAX_K];
-    long i;
-    int m, n;
-    
     assert(dest && src && N > 0 && stride != 0);
     
     if (N <= 4)
@@ -275,104 +296,25 @@ void vyv_gaussian_conv(vyv_coeffs c,
         gaussian_short_conv(dest, src, N, stride, c.sigma);
         return;
     }
-
-    /* Handle the left boundary. */
-    init_recursive_filter(q, src, N, stride,
-        c.filter, 0, c.filter, c.K, 1.0f, c.tol, c.max_iter);
-
-    for (m = 0; m < c.K; ++m)
-        dest[stride * m] = q[m];
-    
-    /* The following applies the causal recursive filter according to the
-       filter order c.K. The loops implement the pseudocode
-     
-       For n = K, ..., N - 1,
-          dest(n) = filter(0) src(n) - \sum_{k=1}^K dest(n - k)
-      
-       Variable i = stride * n is the offset to the nth sample. */
-    
-    switch (c.K)
-    {
-    case 3:
-        for (i = stride_3; i < stride_N; i += stride)
-            dest[i] = c.filter[0] * src[i]
-                    - c.filter[1] * dest[i - stride]
-                    - c.filter[2] * dest[i - stride_2]
-                    - c.filter[3] * dest[i - stride_3];
-        break;
-    case 4:
-        for (i = stride_4; i < stride_N; i += stride)
-            dest[i] = c.filter[0] * src[i]
-                    - c.filter[1] * dest[i - stride]
-                    - c.filter[2] * dest[i - stride_2]
-                    - c.filter[3] * dest[i - stride_3]
-                    - c.filter[4] * dest[i - stride_4];
-        break;
-    case 5:
-        for (i = stride_5; i < stride_N; i += stride)
-            dest[i] = c.filter[0] * src[i]
-                    - c.filter[1] * dest[i - stride]
-                    - c.filter[2] * dest[i - stride_2]
-                    - c.filter[3] * dest[i - stride_3]
-                    - c.filter[4] * dest[i - stride_4]
-                    - c.filter[5] * dest[i - stride_5];
-        break;
-    }
-    
-    /* Handle the right boundary by multiplying matrix c.M with last K
-       samples dest(N - K - m), m = 0, ..., K - 1. */
-    
-    /* Copy last K samples into array q, q(m) = dest(N - K + m). */
-    for (m = 0; m < c.K; ++m)
-        q[m] = dest[stride_N - stride * (c.K - m)];
-    
-    /* Perform matrix multiplication,
-       dest(N - K + m) = \sum_{n=0}^{K-1} M(m, n) q(n). */
-    for (m = 0; m < c.K; ++m)
-    {
-        num accum = (num)0;
-        
-        for (n = 0; n < c.K; ++n)
-            accum += c.M[m + c.K*n] * q[n];
-        
-        dest[stride_N - stride * (c.K - m)] = accum;
-    }
     
-    /* The following applies the anticausal filter, implementing the
-       pseudocode
-       
-       For n = N - K - 1, ..., 0,
-          dest(n) = filter(0) dest(n) - \sum_{k=1}^K dest(n + k)
-      
-       Variable i = stride * n is the offset to the nth sample. */
-    switch (c.K)
+    switch (get_cpu_level())
     {
-    case 3:
-        for (i = stride_N - stride_4; i >= 0; i -= stride)
-            dest[i] = c.filter[0] * dest[i]
-                    - c.filter[1] * dest[i + stride]
-                    - c.filter[2] * dest[i + stride_2]
-                    - c.filter[3] * dest[i + stride_3];
+#ifdef CPU_DISPATCH_TARGETS
+    case CPU_AVX512:
+        vyv_conv_avx512(c, dest, src, N, stride);
         break;
-    case 4:
-        for (i = stride_N - stride_5; i >= 0; i -= stride)
-            dest[i] = c.filter[0] * dest[i]
-                    - c.filter[1] * dest[i + stride]
-                    - c.filter[2] * dest[i + stride_2]
-                    - c.filter[3] * dest[i + stride_3]
-                    - c.filter[4] * dest[i + stride_4];
+    case CPU_AVX2:
+        vyv_conv_avx2(c, dest, src, N, stride);
         break;
-    case 5:
-        for (i = stride_N - stride * 6; i >= 0; i -= stride)
-            dest[i] = c.filter[0] * dest[i]
-                    - c.filter[1] * dest[i + stride]
-                    - c.filter[2] * dest[i + stride_2]
-                    - c.filter[3] * dest[i + stride_3]
-                    - c.filter[4] * dest[i + stride_4]
-                    - c.filter[5] * dest[i + stride_5];
+    case CPU_SSE2:
+        vyv_conv_sse2(c, dest, src, N, stride);
+        break;
+#endif
+    default:
+        vyv_conv_baseline(c, dest, src, N, stride);
         break;
     }
-
+    
     return;
 }
 
@@ -398,31 +340,292 @@ void vyv_gaussian_conv_image(vyv_coeffs c, num *dest, const num *src,
     int width, int height, int num_channels)
 {
     const long num_pixels = ((long)width) * ((long)height);
-    int x, y, channel;
+    image_view dest_view = make_image_view(dest, width, height, num_channels);
+    image_view src_view =
+        make_image_view((num *)src, width, height, num_channels);
     
     assert(dest && src && num_pixels > 0);
     
-    /* Loop over the image channels. */
-    for (channel = 0; channel < num_channels; ++channel)
-    {
-        num *dest_y = dest;
-        const num *src_y = src;
-        
-        /* Filter each row of the channel. */
-        for (y = 0; y < height; ++y)
+    vyv_gaussian_conv_view(c, dest_view, src_view);
+    return;
+}
+
+/**
+ * \brief Vliet-Young-Verbeek Gaussian 2D convolution of an image_view
+ * \param c             precomputed coefficients
+ * \param dest          output image_view
+ * \param src           input image_view, with the same dimensions as dest
+ * \ingroup vyv_gaussian
+ *
+ * Same as vyv_gaussian_conv_image(), but `dest` and `src` may have any
+ * pixel, row, and channel strides, e.g. interleaved channels, padded rows,
+ * or crops of a larger image. If the pixel strides of `dest` and `src`
+ * differ, rows are copied into `dest` and filtered in place there.
+ */
+void vyv_gaussian_conv_view(vyv_coeffs c, image_view dest, image_view src)
+{
+    long x, y, channel;
+    
+    assert(dest.data && src.data && dest.width == src.width
+        && dest.height == src.height && dest.num_channels == src.num_channels
+        && dest.width > 0 && dest.height > 0);
+    
+    /* Filter each row. All channels of a row are filtered together so that
+       interleaved data is reused while it is in cache. */
+    for (y = 0; y < dest.height; ++y)
+        for (channel = 0; channel < dest.num_channels; ++channel)
         {
-            vyv_gaussian_conv(c, dest_y, src_y, width, 1);
-            dest_y += width;
-            src_y += width;
+            num *dest_y = IMAGE_VIEW_PTR(dest, 0, y, channel);
+            const num *src_y = IMAGE_VIEW_PTR(src, 0, y, channel);
+            
+            if (src.pixel_stride != dest.pixel_stride)
+            {
+                copy_strided(dest_y, dest.pixel_stride,
+                    src_y, src.pixel_stride, dest.width);
+                src_y = dest_y;
+            }
+            
+            vyv_gaussian_conv(c, dest_y, src_y,
+                dest.width, dest.pixel_stride);
         }
+    
+    /* Filter each column, likewise all channels of a column together. */
+    for (x = 0; x < dest.width; ++x)
+        for (channel = 0; channel < dest.num_channels; ++channel)
+        {
+            num *dest_x = IMAGE_VIEW_PTR(dest, x, 0, channel);
+            vyv_gaussian_conv(c, dest_x, dest_x,
+                dest.height, dest.row_stride);
+        }
+    
+    return;
+}
+
+/**
+ * \brief Normalized (mask-aware) VYV Gaussian convolution
+ * \param c             coefficients precomputed by vyv_precomp()
+ * \param dest          output image in planar order
+ * \param src           input image in planar order, may contain NaNs
+ * \param mask          nonnegative weight per pixel, or NULL
+ * \param width         image width
+ * \param height        image height
+ * \param num_channels  number of image channels
+ * \return 1 on success, 0 on failure
+ * \ingroup vyv_gaussian
+ *
+ * Computes conv(mask*src)/conv(mask), filling in pixels with zero weight
+ * or NaN samples from their neighbors. The weighted values and the
+ * weights are interleaved in one work image and filtered in a single
+ * pass, see normalized_conv_init(). `dest` may equal `src`.
+ */
+int vyv_gaussian_conv_normalized(vyv_coeffs c, num *dest, const num *src,
+    const num *mask, int width, int height, int num_channels)
+{
+    image_view work;
+    
+    if (!normalized_conv_init(&work, src, mask,
+        width, height, num_channels))
+        return 0;
+    
+    vyv_gaussian_conv_view(c, work, work);
+    normalized_conv_finish(dest, &work);
+    return 1;
+}
+
+/**
+ * \brief Start a streaming VYV Gaussian convolution
+ * \param s             vyv_stream to initialize
+ * \param c             coefficients precomputed by vyv_precomp()
+ * \param block_size    samples output at a time, at least c.K
+ * \param lookahead     future samples used by the anticausal filter
+ * \return 1 on success, 0 on failure
+ * \ingroup vyv_gaussian
+ *
+ * The state should be released with vyv_stream_free().
+ */
+int vyv_stream_init(vyv_stream *s, vyv_coeffs c,
+    long block_size, long lookahead)
+{
+    const long window = block_size + lookahead + 2 * c.K;
+    num denom = 1;
+    int k;
+    
+    s->x = NULL;
+    
+    if (block_size < c.K || lookahead < 0
+        || !(s->x = (num *)malloc(sizeof(num) * 3 * window)))
+        return 0;
+    
+    for (k = 1; k <= c.K; ++k)
+        denom += c.filter[k];
+    
+    s->w = s->x + window;
+    s->y = s->w + window;
+    s->c = c;
+    s->gain = c.filter[0] / denom;
+    s->block_size = block_size;
+    s->lookahead = lookahead;
+    s->count = 0;
+    s->num_causal = 0;
+    s->started = 0;
+    return 1;
+}
+
+/* Output the first n_out buffered samples. If at_end is nonzero, the
+   buffered samples end the signal. */
+static void vyv_stream_emit(vyv_stream *s, num *dest,
+    long n_out, int at_end)
+{
+    const vyv_coeffs *c = &s->c;
+    const long count = s->count;
+    num *w = s->w + c->K;       /* w[n] is the causal response, n >= -K */
+    num *y = s->y + c->K;
+    num q[VYV_MAX_K];
+    num accum;
+    long n;
+    int m, k;
+    
+    /* Continue the causal filter over the newly buffered samples, or
+       initialize it on the left boundary of the signal. */
+    if (!s->started)
+    {
+        init_recursive_filter(q, s->x, count, 1,
+            c->filter, 0, c->filter, c->K, 1.0f, c->tol, c->max_iter);
+        
+        for (m = 0; m < c->K; ++m)
+            w[m] = q[m];
+        
+        s->num_causal = c->K;
+        s->started = 1;
+    }
+    
+    for (n = s->num_causal; n < count; ++n)
+    {
+        for (accum = c->filter[0] * s->x[n], k = 1; k <= c->K; ++k)
+            accum -= c->filter[k] * w[n - k];
+        
+        w[n] = accum;
+    }
+    
+    s->num_causal = count;
+    
+    /* Start the anticausal filter with the exact right boundary handling
+       of vyv_gaussian_conv() at the end of the signal, otherwise with the
+       steady state of a constant extension of the window. */
+    if (at_end)
+    {
+        for (m = 0; m < c->K; ++m)
+            for (y[count - c->K + m] = 0, k = 0; k < c->K; ++k)
+                y[count - c->K + m] += c->M[m + c->K * k]
+                    * w[count - c->K + k];
+        
+        n = count - c->K - 1;
+    }
+    else
+    {
+        for (k = 0; k < c->K; ++k)
+            y[count + k] = s->gain * w[count - 1];
         
-        /* Filter each column of the channel. */
-        for (x = 0; x < width; ++x)
-            vyv_gaussian_conv(c, dest + x, dest + x, height, width);
+        n = count - 1;
+    }
+    
+    for (; n >= 0; --n)
+    {
+        for (accum = c->filter[0] * w[n], k = 1; k <= c->K; ++k)
+            accum -= c->filter[k] * y[n + k];
+        
+        y[n] = accum;
+    }
+    
+    for (n = 0; n < n_out; ++n)
+        dest[n] = y[n];
+    
+    /* Shift out the output samples, keeping K samples of causal history. */
+    memmove(s->x, s->x + n_out, sizeof(num) * (count - n_out));
+    memmove(s->w, s->w + n_out, sizeof(num) * (c->K + count - n_out));
+    s->count -= n_out;
+    s->num_causal -= n_out;
+    return;
+}
+
+/**
+ * \brief Filter the next piece of a streamed signal
+ * \param s         vyv_stream created by vyv_stream_init()
+ * \param dest      output, with space for N + block_size - 1 samples
+ * \param src       next N input samples
+ * \param N         number of input samples
+ * \return number of samples written to dest
+ * \ingroup vyv_gaussian
+ *
+ * Same as deriche_stream_process(), the output lags the input by
+ * `lookahead` to `lookahead + block_size - 1` samples.
+ */
+long vyv_stream_process(vyv_stream *s, num *dest, const num *src, long N)
+{
+    const long window = s->block_size + s->lookahead;
+    long num_out = 0, take;
+    
+    assert(s && s->x && dest && src && N >= 0);
+    
+    while (N > 0)
+    {
+        take = (window - s->count < N) ? window - s->count : N;
+        memcpy(s->x + s->count, src, sizeof(num) * take);
+        s->count += take;
+        src += take;
+        N -= take;
         
-        dest += num_pixels;
-        src += num_pixels;
+        if (s->count == window)
+        {
+            vyv_stream_emit(s, dest + num_out, s->block_size, 0);
+            num_out += s->block_size;
+        }
+    }
+    
+    return num_out;
+}
+
+/**
+ * \brief End a streamed signal
+ * \param s         vyv_stream created by vyv_stream_init()
+ * \param dest      output, with space for block_size + lookahead samples
+ * \return number of samples written to dest
+ * \ingroup vyv_gaussian
+ *
+ * Outputs the remaining buffered samples with the right boundary handling
+ * of vyv_gaussian_conv(). The stream is then ready to filter a new signal.
+ */
+long vyv_stream_flush(vyv_stream *s, num *dest)
+{
+    const long count = s->count;
+    
+    assert(s && s->x && dest);
+    
+    if (count == 0)
+        ;   /* Nothing is buffered, only the state is reset. */
+    else if (!s->started && count <= 4)
+    {   /* Special case for very short signals. */
+        gaussian_short_conv(dest, s->x, count, 1, s->c.sigma);
+        s->count = 0;
     }
+    else
+        vyv_stream_emit(s, dest, count, 1);
+    
+    s->started = 0;
+    s->num_causal = 0;
+    return count;
+}
+
+/**
+ * \brief Release memory of a vyv_stream
+ * \param s     vyv_stream created by vyv_stream_init()
+ * \ingroup vyv_gaussian
+ */
+void vyv_stream_free(vyv_stream *s)
+{
+    if (s->x)
+        free(s->x);
     
+    s->x = NULL;
     return;
 }
@@ -39,6 +39,12 @@
     vyv_precomp(&c, sigma, K, tol);
     vyv_gaussian_conv(c, dest, src, N, stride);
 \endcode
+ *
+ * \par Streaming
+ * vyv_stream_process() and vyv_stream_flush() filter an unbounded signal
+ * that arrives in pieces, with the same latency and accuracy trade-off as
+ * the Deriche streaming functions: the anticausal pass of each block runs
+ * over `lookahead` future samples of the causal response.
  *
  * \note When the #num typedef is set to single-precision arithmetic,
  * vyv_gaussian_conv() may be inaccurate for large values of sigma.
@@ -59,6 +65,7 @@
 #define _GAUSSIAN_CONV_VYV_H_
 
 #include "num.h"
+#include "image_view.h"
 
 /** \brief Minimum valid VYV filter order. */
 #define VYV_MIN_K       3
@@ -93,6 +100,30 @@ void vyv_gaussian_conv(vyv_coeffs c,
     num *dest, const num *src, long N, long stride);
 void vyv_gaussian_conv_image(vyv_coeffs c, num *dest, const num *src,
     int width, int height, int num_channels);
+void vyv_gaussian_conv_view(vyv_coeffs c, image_view dest, image_view src);
+int vyv_gaussian_conv_normalized(vyv_coeffs c, num *dest, const num *src,
+    const num *mask, int width, int height, int num_channels);
+
+/** \brief State of a streaming VYV Gaussian convolution */
+typedef struct vyv_stream_
+{
+    vyv_coeffs c;           /**< Filter coefficients                       */
+    num *x;                 /**< Buffered input                            */
+    num *w;                 /**< Causal response, after K history samples  */
+    num *y;                 /**< Anticausal response of the current window */
+    num gain;               /**< DC gain of the anticausal pass            */
+    long block_size;        /**< Samples output at a time                  */
+    long lookahead;         /**< Future samples used by the anticausal pass */
+    long count;             /**< Buffered samples not yet output           */
+    long num_causal;        /**< Buffered samples with causal response     */
+    int started;            /**< Nonzero once the left boundary is done    */
+} vyv_stream;
+
+int vyv_stream_init(vyv_stream *s, vyv_coeffs c,
+    long block_size, long lookahead);
+long vyv_stream_process(vyv_stream *s, num *dest, const num *src, long N);
+long vyv_stream_flush(vyv_stream *s, num *dest);
+void vyv_stream_free(vyv_stream *s);
 
 /** \} */
 #endif /* _GAUSSIAN_CONV_VYV_H_ */
@@ -32,6 +32,9 @@
 #include "gaussian_conv_deriche.h"
 #include "gaussian_conv_vyv.h"
 
+/** \brief Sigma spacing of the SII table used with a sigma map */
+#define SIGMA_MAP_STEP  0.25
+
 /** \brief Print program usage help message */
 void print_usage()
 {
@@ -57,7 +60,13 @@ void print_usage()
     puts("                         K = order, tol = boundary accuracy");
     puts("   -s <number>   sigma, standard deviation of the Gaussian");
     puts("   -K <number>   specifies number of steps (box, sii, am)");
-    puts("   -t <number>   accuracy tolerance (fir, am, deriche, yv)\n");
+    puts("   -t <number>   accuracy tolerance (fir, am, deriche, yv)");
+    puts("   -m <file>     sigma map for spatially varying blur (sii only),");
+    puts("                 each pixel is blurred with sigma times the map");
+    puts("                 value in [0,1]");
+    puts("   -w <file>     weight mask for normalized convolution (box, sii,");
+    puts("                 deriche, vyv), pixels with weight 0 are filled in");
+    puts("                 from their neighbors\n");
 }
 
 /** \brief struct of program parameters */
@@ -76,6 +85,10 @@ typedef struct
     int K;
     /** \brief Tolerance */
     double tol;
+    /** \brief Sigma map file for spatially varying blur, or NULL */
+    const char *sigma_map_file;
+    /** \brief Weight mask file for normalized convolution, or NULL */
+    const char *mask_file;
 } program_params;
 
 int parse_params(program_params *param, int argc, char **argv);
@@ -104,6 +117,8 @@ int main(int argc, char **argv)
     program_params param;
     num *input_image = NULL;
     num *output_image = NULL;
+    num *sigma_map = NULL;
+    num *mask = NULL;
     unsigned long time_start;
     long num_pixels;
     int width, height, num_channels, success = 0;
@@ -119,6 +134,52 @@ int main(int argc, char **argv)
     num_pixels = ((long)width) * ((long)height);
     num_channels = is_grayscale(input_image, num_pixels) ? 1 : 3;
     
+    if (param.sigma_map_file)
+    {   /* Read the sigma map and scale it by sigma. */
+        int map_width, map_height;
+        long i;
+        
+        if (!(sigma_map = (num *)ReadImage(&map_width, &map_height,
+            param.sigma_map_file, IMAGEIO_NUM | IMAGEIO_GRAYSCALE)))
+            goto fail;
+        if (map_width != width || map_height != height)
+        {
+            fprintf(stderr, "Error: Sigma map must be %dx%d\n",
+                width, height);
+            goto fail;
+        }
+        
+        for (i = 0; i < num_pixels; ++i)
+            sigma_map[i] *= param.sigma;
+    }
+    
+    if (param.mask_file)
+    {   /* Read the weight mask. */
+        int mask_width, mask_height;
+        
+        if (!(mask = (num *)ReadImage(&mask_width, &mask_height,
+            param.mask_file, IMAGEIO_NUM | IMAGEIO_GRAYSCALE)))
+            goto fail;
+        if (mask_width != width || mask_height != height)
+        {
+            fprintf(stderr, "Error: Weight mask must be %dx%d\n",
+                width, height);
+            goto fail;
+        }
+        if (sigma_map)
+        {
+            fprintf(stderr, "Error: -m and -w cannot be combined\n");
+            goto fail;
+        }
+        if (strcmp(param.algo, "box") && strcmp(param.algo, "sii")
+            && strcmp(param.algo, "deriche") && strcmp(param.algo, "vyv"))
+        {
+            fprintf(stderr, "Error: A weight mask requires -a box, sii,"
+                " deriche, or vyv\n");
+            goto fail;
+        }
+    }
+    
     /* Allocate the output image. */
     if (!(output_image = (num *)malloc(sizeof(num)
         * num_channels * num_pixels)))
@@ -175,8 +236,20 @@ int main(int argc, char **argv)
             goto fail;
         }
         
-        box_gaussian_conv_image(output_image, buffer, input_image,
-            width, height, num_channels, param.sigma, param.K);
+        if (mask)
+        {
+            if (!box_gaussian_conv_normalized(output_image, buffer,
+                input_image, mask, width, height, num_channels,
+                param.sigma, param.K))
+            {
+                free(buffer);
+                goto fail;
+            }
+        }
+        else
+            box_gaussian_conv_image(output_image, buffer, input_image,
+                width, height, num_channels, param.sigma, param.K);
+        
         free(buffer);
     }
     else if (!strcmp(param.algo, "ebox"))
@@ -199,6 +272,42 @@ int main(int argc, char **argv)
             width, height, num_channels);
         free(buffer);
     }
+    else if (!strcmp(param.algo, "sii") && sigma_map)
+    {   /* Spatially varying stacked integral images. */
+        num *buffer = NULL;
+        sii_table t;
+        
+        if (!SII_VALID_K(param.K) || param.sigma <= 0)
+        {
+            fprintf(stderr, "Error: K=%d, sigma=%g is invalid for SII\n",
+                param.K, param.sigma);
+            goto fail;
+        }
+        
+        printf("Spatially varying stacked integral images, K=%d boxes\n",
+            param.K);
+        
+        if (!sii_table_precomp(&t, param.sigma,
+            (int)ceil(param.sigma / SIGMA_MAP_STEP) + 1, param.K))
+            goto fail;
+        
+        if (!(buffer = (num *)malloc(sizeof(num) * sii_variable_buffer_size(
+            t, ((width >= height) ? width : height)))))
+        {
+            sii_table_free(&t);
+            goto fail;
+        }
+        
+        sii_variable_conv_image(t, output_image, buffer, input_image,
+            sigma_map, width, height, num_channels);
+        sii_table_free(&t);
+        free(buffer);
+    }
+    else if (sigma_map)
+    {
+        fprintf(stderr, "Error: A sigma map requires -a sii\n");
+        goto fail;
+    }
     else if (!strcmp(param.algo, "sii"))
     {   /* Stacked integral images. */
         num *buffer = NULL;
@@ -217,8 +326,19 @@ int main(int argc, char **argv)
             ((width >= height) ? width : height)))))
             goto fail;
         
-        sii_gaussian_conv_image(c, output_image, buffer, input_image,
-            width, height, num_channels);
+        if (mask)
+        {
+            if (!sii_gaussian_conv_normalized(c, output_image, buffer,
+                input_image, mask, width, height, num_channels))
+            {
+                free(buffer);
+                goto fail;
+            }
+        }
+        else
+            sii_gaussian_conv_image(c, output_image, buffer, input_image,
+                width, height, num_channels);
+        
         free(buffer);
     }
     else if (!strcmp(param.algo, "am"))
@@ -252,8 +372,19 @@ int main(int argc, char **argv)
         }
         
         deriche_precomp(&c, param.sigma, param.K, param.tol);
-        deriche_gaussian_conv_image(c, output_image, buffer, input_image,
-            width, height, num_channels);
+        if (mask)
+        {
+            if (!deriche_gaussian_conv_normalized(c, output_image, buffer,
+                input_image, mask, width, height, num_channels))
+            {
+                free(buffer);
+                goto fail;
+            }
+        }
+        else
+            deriche_gaussian_conv_image(c, output_image, buffer,
+                input_image, width, height, num_channels);
+        
         free(buffer);
     }
     else if (!strcmp(param.algo, "vyv"))
@@ -269,8 +400,15 @@ int main(int argc, char **argv)
         printf("Vliet-Young-Verbeek recursive filtering,"
             " K=%d, tol=%g left boundary accuracy\n", param.K, param.tol);
         vyv_precomp(&c, param.sigma, param.K, param.tol);
-        vyv_gaussian_conv_image(c, output_image, input_image,
-            width, height, num_channels);
+        if (mask)
+        {
+            if (!vyv_gaussian_conv_normalized(c, output_image, input_image,
+                mask, width, height, num_channels))
+                goto fail;
+        }
+        else
+            vyv_gaussian_conv_image(c, output_image, input_image,
+                width, height, num_channels);
     }
     else
     {
@@ -290,6 +428,10 @@ int main(int argc, char **argv)
     
     success = 1;
 fail:
+    if (mask)
+        free(mask);
+    if (sigma_map)
+        free(sigma_map);
     if (output_image)
         free(output_image);
     if (input_image)
@@ -339,6 +481,8 @@ int parse_params(program_params *param, int argc, char **argv)
     param->algo = default_algo;
     param->K = 3;
     param->tol = 1e-2;
+    param->sigma_map_file = NULL;
+    param->mask_file = NULL;
     
     for (i = 1; i < argc;)
     {
@@ -392,6 +536,12 @@ int parse_params(program_params *param, int argc, char **argv)
                     return 0;
                 }
                 break;
+            case 'm':   /* Read sigma map file. */
+                param->sigma_map_file = option_string;
+                break;
+            case 'w':   /* Read weight mask file. */
+                param->mask_file = option_string;
+                break;
             case '-':
                 print_usage();
                 return 0;
@@ -0,0 +1,288 @@
+/**
+ * \file image_view.c
+ * \brief Strided image views
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include "image_view.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+/**
+ * \brief View of a planar image with packed rows
+ * \param data          image data, channel after channel
+ * \param width, height, num_channels   image dimensions
+ * \return image_view of the data
+ * \ingroup image_view
+ *
+ * This is the layout used by the `*_gaussian_conv_image()` functions.
+ */
+image_view make_image_view(num *data,
+    long width, long height, long num_channels)
+{
+    image_view view;
+
+    view.data = data;
+    view.width = width;
+    view.height = height;
+    view.num_channels = num_channels;
+    view.pixel_stride = 1;
+    view.row_stride = width;
+    view.channel_stride = width * height;
+    view.base = NULL;
+    return view;
+}
+
+/**
+ * \brief View of an interleaved image
+ * \param data          image data, data[num_channels*(x + width*y) + channel]
+ * \param width, height, num_channels   image dimensions
+ * \return image_view of the data
+ * \ingroup image_view
+ */
+image_view make_interleaved_image_view(num *data,
+    long width, long height, long num_channels)
+{
+    image_view view;
+
+    view.data = data;
+    view.width = width;
+    view.height = height;
+    view.num_channels = num_channels;
+    view.pixel_stride = num_channels;
+    view.row_stride = num_channels * width;
+    view.channel_stride = 1;
+    view.base = NULL;
+    return view;
+}
+
+/**
+ * \brief Crop a view without copying
+ * \param view      the view to crop
+ * \param x, y      upper-left corner of the crop
+ * \param width, height     crop dimensions
+ * \return cropped view, clipped to the extent of `view`
+ * \ingroup image_view
+ *
+ * The returned view shares memory with `view` and never owns it.
+ */
+image_view crop_image_view(image_view view,
+    long x, long y, long width, long height)
+{
+    image_view crop = view;
+
+    if (x < 0)
+    {
+        width += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        height += y;
+        y = 0;
+    }
+    if (x + width > view.width)
+        width = view.width - x;
+    if (y + height > view.height)
+        height = view.height - y;
+
+    crop.width = (width > 0) ? width : 0;
+    crop.height = (height > 0) ? height : 0;
+    crop.data = IMAGE_VIEW_PTR(view, x, y, 0);
+    crop.base = NULL;
+    return crop;
+}
+
+/**
+ * \brief Allocate a planar image with aligned rows
+ * \param view      image_view to initialize
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup image_view
+ *
+ * The row stride is rounded up so that every row begins on an
+ * #IMAGE_VIEW_ALIGN-byte boundary. The view should be released with
+ * free_image_view().
+ */
+int alloc_image_view(image_view *view,
+    long width, long height, long num_channels)
+{
+    const long align = IMAGE_VIEW_ALIGN / sizeof(num);
+    long row_stride;
+
+    assert(view && width > 0 && height > 0 && num_channels > 0);
+    row_stride = ((width + align - 1) / align) * align;
+
+    if (!(view->base = malloc(sizeof(num)
+        * row_stride * height * num_channels + IMAGE_VIEW_ALIGN)))
+    {
+        view->data = NULL;
+        return 0;
+    }
+
+    view->data = (num *)(((size_t)view->base + IMAGE_VIEW_ALIGN - 1)
+        & ~((size_t)IMAGE_VIEW_ALIGN - 1));
+    view->width = width;
+    view->height = height;
+    view->num_channels = num_channels;
+    view->pixel_stride = 1;
+    view->row_stride = row_stride;
+    view->channel_stride = row_stride * height;
+    return 1;
+}
+
+/**
+ * \brief Release memory owned by a view
+ * \param view      image_view allocated by alloc_image_view()
+ * \ingroup image_view
+ */
+void free_image_view(image_view *view)
+{
+    if (view->base)
+        free(view->base);
+
+    view->base = NULL;
+    view->data = NULL;
+    return;
+}
+
+/**
+ * \brief Test whether a view has the planar packed layout
+ * \param view      image_view
+ * \return 1 if `view` has the layout of make_image_view()
+ * \ingroup image_view
+ */
+int is_packed_image_view(image_view view)
+{
+    return view.pixel_stride == 1 && view.row_stride == view.width
+        && (view.num_channels <= 1
+        || view.channel_stride == view.width * view.height);
+}
+
+/**
+ * \brief Strided copy of a 1D signal
+ * \param dest          destination
+ * \param dest_stride   stride between successive dest samples
+ * \param src           source
+ * \param src_stride    stride between successive src samples
+ * \param N             number of samples
+ * \ingroup image_view
+ */
+void copy_strided(num *dest, long dest_stride,
+    const num *src, long src_stride, long N)
+{
+    long n;
+
+    for (n = 0; n < N; ++n)
+        dest[dest_stride * n] = src[src_stride * n];
+
+    return;
+}
+
+/**
+ * \brief Set up the work image of a normalized convolution
+ * \param work          image_view to initialize
+ * \param src           input image in planar order
+ * \param mask          nonnegative weight per pixel, or NULL
+ * \param width, height, num_channels   image dimensions
+ * \return 1 on success, 0 on failure
+ * \ingroup image_view
+ *
+ * Allocates an interleaved image with num_channels + 1 channels holding
+ * (mask*src, mask) per pixel, so that a single in-place filtering of `work`
+ * smooths the weighted values and the weights together. Pixels where any
+ * channel of `src` is NaN get weight zero. If `mask` is NULL, the weight is
+ * 1 elsewhere. The result is obtained with normalized_conv_finish().
+ */
+int normalized_conv_init(image_view *work, const num *src, const num *mask,
+    long width, long height, long num_channels)
+{
+    const long num_pixels = width * height;
+    const long pixel_stride = num_channels + 1;
+    long row_stride = pixel_stride * width;
+    num *data, weight;
+    long x, y, i, channel;
+
+    assert(work && src && width > 0 && height > 0 && num_channels > 0);
+
+    /* Pad rows whose size is a multiple of the page size, otherwise every
+       sample of a column maps to the same cache set in the column pass. */
+    if ((row_stride * sizeof(num)) % NORMALIZED_CONV_PAGE == 0)
+        row_stride += pixel_stride * (IMAGE_VIEW_ALIGN / sizeof(num));
+
+    if (!(data = (num *)malloc(sizeof(num) * row_stride * height)))
+    {
+        work->data = NULL;
+        work->base = NULL;
+        return 0;
+    }
+
+    *work = make_interleaved_image_view(data, width, height, pixel_stride);
+    work->row_stride = row_stride;
+    work->base = data;
+
+    for (y = 0, i = 0; y < height; ++y, data += row_stride)
+        for (x = 0; x < width; ++x, ++i)
+        {
+            num *pixel = data + pixel_stride * x;
+
+            weight = (mask) ? mask[i] : 1;
+
+            for (channel = 0; channel < num_channels; ++channel)
+            {
+                pixel[channel] = src[i + num_pixels * channel];
+
+                if (pixel[channel] != pixel[channel])
+                    weight = 0;     /* NaN sample, treat as missing. */
+            }
+
+            for (channel = 0; channel < num_channels; ++channel)
+                pixel[channel] = (weight != 0) ? weight * pixel[channel] : 0;
+
+            pixel[num_channels] = weight;
+        }
+
+    return 1;
+}
+
+/**
+ * \brief Divide by the smoothed weights and release the work image
+ * \param dest      output image in planar order
+ * \param work      work image set up by normalized_conv_init() and filtered
+ * \ingroup image_view
+ *
+ * Pixels whose smoothed weight is not positive, i.e., farther than the
+ * filter support from any pixel with weight, are set to zero.
+ */
+void normalized_conv_finish(num *dest, image_view *work)
+{
+    const long num_channels = work->num_channels - 1;
+    const long num_pixels = work->width * work->height;
+    const num *data = work->data;
+    num scale;
+    long x, y, i, channel;
+
+    for (y = 0, i = 0; y < work->height; ++y, data += work->row_stride)
+        for (x = 0; x < work->width; ++x, ++i)
+        {
+            const num *pixel = data + work->pixel_stride * x;
+
+            scale = (pixel[num_channels] > 0) ? 1 / pixel[num_channels] : 0;
+
+            for (channel = 0; channel < num_channels; ++channel)
+                dest[i + num_pixels * channel] = scale * pixel[channel];
+        }
+
+    free_image_view(work);
+    return;
+}
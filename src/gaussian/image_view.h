@@ -0,0 +1,90 @@
+/**
+ * \file image_view.h
+ * \brief Strided image views
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * \defgroup image_view Image views
+ * \brief Describing image memory by explicit strides.
+ *
+ * An image_view addresses sample (x, y, channel) as
+\code
+    view.data[view.pixel_stride * x + view.row_stride * y
+        + view.channel_stride * channel]
+\endcode
+ * so that planar images, interleaved images, images with padded rows, and
+ * crops of any of these are all described without copying. The
+ * `*_gaussian_conv_view()` functions filter between arbitrary views; the
+ * `*_gaussian_conv_image()` functions are wrappers for the planar packed
+ * case.
+ *
+ * alloc_image_view() allocates a planar image whose rows begin on
+ * #IMAGE_VIEW_ALIGN-byte boundaries, which is favorable for the column
+ * passes of the filters.
+ *
+ * normalized_conv_init() and normalized_conv_finish() implement normalized
+ * (mask-aware) convolution on top of the views: values premultiplied by the
+ * mask and the mask itself are interleaved in one work image, filtered
+ * together in a single pass, and divided on output. The
+ * `*_gaussian_conv_normalized()` functions use them.
+ *
+ * \{
+ */
+#ifndef _IMAGE_VIEW_H_
+#define _IMAGE_VIEW_H_
+
+#include "num.h"
+
+/** \brief Alignment in bytes of rows allocated by alloc_image_view() */
+#define IMAGE_VIEW_ALIGN    64
+
+/** \brief Page size in bytes assumed by normalized_conv_init() */
+#define NORMALIZED_CONV_PAGE    4096
+
+/** \brief Pointer to sample (x, y, channel) of an image_view */
+#define IMAGE_VIEW_PTR(view,x,y,channel)    ((view).data        \
+    + (view).pixel_stride * ((long)(x))                          \
+    + (view).row_stride * ((long)(y))                            \
+    + (view).channel_stride * ((long)(channel)))
+
+/** \brief Strided view into image memory */
+typedef struct image_view_
+{
+    num *data;              /**< Pointer to sample (0, 0, 0)              */
+    long width;             /**< Image width                              */
+    long height;            /**< Image height                             */
+    long num_channels;      /**< Number of channels                       */
+    long pixel_stride;      /**< Step between horizontal neighbors        */
+    long row_stride;        /**< Step between vertical neighbors          */
+    long channel_stride;    /**< Step between channels                    */
+    void *base;             /**< Allocation owned by the view, or NULL    */
+} image_view;
+
+image_view make_image_view(num *data,
+    long width, long height, long num_channels);
+image_view make_interleaved_image_view(num *data,
+    long width, long height, long num_channels);
+image_view crop_image_view(image_view view,
+    long x, long y, long width, long height);
+int alloc_image_view(image_view *view,
+    long width, long height, long num_channels);
+void free_image_view(image_view *view);
+int is_packed_image_view(image_view view);
+void copy_strided(num *dest, long dest_stride,
+    const num *src, long src_stride, long N);
+int normalized_conv_init(image_view *work, const num *src, const num *mask,
+    long width, long height, long num_channels);
+void normalized_conv_finish(num *dest, image_view *work);
+
+/** \} */
+#endif /* _IMAGE_VIEW_H_ */
@@ -55,4 +55,10 @@ typedef double num;
 #define IMAGEIO_NUM     IMAGEIO_DOUBLE
 #endif
 
+/* In the single-precision half of a dual-precision build, external names
+   get an _f suffix. */
+#if defined(NUM_SINGLE) && defined(NUM_DUAL)
+#include "num_dual.h"
+#endif
+
 #endif
@@ -0,0 +1,139 @@
+/**
+ * \file num_dual.h
+ * \brief Names of the single-precision half of a dual-precision build
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/*
+ * To have both precisions in one program, the library sources are compiled
+ * twice: once as usual with #num = double, and once with the symbols
+ * `NUM_SINGLE` and `NUM_DUAL` defined. In the second compilation, num.h
+ * includes this file, which appends `_f` to every external name so that
+ * the two halves link together, e.g., deriche_gaussian_conv_f() is the
+ * single-precision deriche_gaussian_conv(). Programs built with #num =
+ * double reach the single-precision half through gconv_plan_f(), declared
+ * in strategy_gaussian_conv.h.
+ *
+ * erfc_cody(), inverfc_acklam(), and invert_matrix() compute in double
+ * regardless of #num, and are shared by both halves, as is get_cpu_level().
+ */
+#ifndef _NUM_DUAL_H_
+#define _NUM_DUAL_H_
+
+/* filter_util.c */
+#define recursive_filter_impulse        recursive_filter_impulse_f
+#define init_recursive_filter           init_recursive_filter_f
+
+/* gaussian_short_conv.c */
+#define gaussian_short_conv             gaussian_short_conv_f
+
+/* image_view.c */
+#define make_image_view                 make_image_view_f
+#define make_interleaved_image_view     make_interleaved_image_view_f
+#define crop_image_view                 crop_image_view_f
+#define alloc_image_view                alloc_image_view_f
+#define free_image_view                 free_image_view_f
+#define is_packed_image_view            is_packed_image_view_f
+#define copy_strided                    copy_strided_f
+#define normalized_conv_init            normalized_conv_init_f
+#define normalized_conv_finish          normalized_conv_finish_f
+
+/* gaussian_conv_fir.c */
+#define fir_precomp                     fir_precomp_f
+#define fir_precomp_ex                  fir_precomp_ex_f
+#define fir_gaussian_conv               fir_gaussian_conv_f
+#define fir_gaussian_conv_image         fir_gaussian_conv_image_f
+#define fir_gaussian_conv_view          fir_gaussian_conv_view_f
+#define fir_free                        fir_free_f
+
+/* gaussian_conv_dct.c */
+#define dct_precomp                     dct_precomp_f
+#define dct_precomp_image               dct_precomp_image_f
+#define dct_gaussian_conv               dct_gaussian_conv_f
+#define dct_free                        dct_free_f
+
+/* gaussian_conv_box.c */
+#define box_gaussian_conv               box_gaussian_conv_f
+#define box_gaussian_conv_image         box_gaussian_conv_image_f
+#define box_gaussian_conv_view          box_gaussian_conv_view_f
+#define box_gaussian_conv_normalized    box_gaussian_conv_normalized_f
+
+/* gaussian_conv_ebox.c */
+#define ebox_precomp                    ebox_precomp_f
+#define ebox_gaussian_conv              ebox_gaussian_conv_f
+#define ebox_gaussian_conv_image        ebox_gaussian_conv_image_f
+#define ebox_gaussian_conv_view         ebox_gaussian_conv_view_f
+
+/* gaussian_conv_sii.c */
+#define sii_precomp                     sii_precomp_f
+#define sii_buffer_size                 sii_buffer_size_f
+#define sii_gaussian_conv               sii_gaussian_conv_f
+#define sii_gaussian_conv_image         sii_gaussian_conv_image_f
+#define sii_gaussian_conv_view          sii_gaussian_conv_view_f
+#define sii_gaussian_conv_normalized    sii_gaussian_conv_normalized_f
+#define sii_table_precomp               sii_table_precomp_f
+#define sii_table_free                  sii_table_free_f
+#define sii_variable_buffer_size        sii_variable_buffer_size_f
+#define sii_variable_conv               sii_variable_conv_f
+#define sii_variable_conv_image         sii_variable_conv_image_f
+
+/* gaussian_conv_am.c */
+#define am_gaussian_conv                am_gaussian_conv_f
+#define am_gaussian_conv_image          am_gaussian_conv_image_f
+#define am_gaussian_conv_view           am_gaussian_conv_view_f
+
+/* gaussian_conv_deriche.c */
+#define deriche_precomp                 deriche_precomp_f
+#define deriche_gaussian_conv           deriche_gaussian_conv_f
+#define deriche_gaussian_conv_image     deriche_gaussian_conv_image_f
+#define deriche_gaussian_conv_view      deriche_gaussian_conv_view_f
+#define deriche_gaussian_conv_normalized deriche_gaussian_conv_normalized_f
+#define deriche_stream_init             deriche_stream_init_f
+#define deriche_stream_process          deriche_stream_process_f
+#define deriche_stream_flush            deriche_stream_flush_f
+#define deriche_stream_free             deriche_stream_free_f
+
+/* gaussian_conv_vyv.c */
+#define vyv_precomp                     vyv_precomp_f
+#define vyv_gaussian_conv               vyv_gaussian_conv_f
+#define vyv_gaussian_conv_image         vyv_gaussian_conv_image_f
+#define vyv_gaussian_conv_view          vyv_gaussian_conv_view_f
+#define vyv_gaussian_conv_normalized    vyv_gaussian_conv_normalized_f
+#define vyv_stream_init                 vyv_stream_init_f
+#define vyv_stream_process              vyv_stream_process_f
+#define vyv_stream_flush                vyv_stream_flush_f
+#define vyv_stream_free                 vyv_stream_free_f
+
+/* gaussian_conv_volume.c */
+#define deriche_volume_buffer_size      deriche_volume_buffer_size_f
+#define deriche_gaussian_conv_volume    deriche_gaussian_conv_volume_f
+#define vyv_volume_buffer_size          vyv_volume_buffer_size_f
+#define vyv_gaussian_conv_volume        vyv_gaussian_conv_volume_f
+#define sii_volume_buffer_size          sii_volume_buffer_size_f
+#define sii_gaussian_conv_volume        sii_gaussian_conv_volume_f
+
+/* gaussian_conv_int.c */
+#define box_gaussian_conv_image_u8      box_gaussian_conv_image_u8_f
+#define box_gaussian_conv_image_u16     box_gaussian_conv_image_u16_f
+#define ebox_gaussian_conv_image_u8     ebox_gaussian_conv_image_u8_f
+#define ebox_gaussian_conv_image_u16    ebox_gaussian_conv_image_u16_f
+#define sii_gaussian_conv_image_u8      sii_gaussian_conv_image_u8_f
+#define sii_gaussian_conv_image_u16     sii_gaussian_conv_image_u16_f
+
+/* strategy_gaussian_conv.c */
+#define gconv_                          gconv_f_
+#define gconv                           gconv_f
+#define gconv_plan                      gconv_plan_f
+#define gconv_execute                   gconv_execute_f
+#define gconv_free                      gconv_free_f
+
+#endif /* _NUM_DUAL_H_ */
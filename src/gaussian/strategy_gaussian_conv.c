@@ -47,6 +47,8 @@ struct gconv_
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 static int gconv_fir_plan(gconv *g);
+static int gconv_fir_direct_plan(gconv *g);
+static int gconv_fir_fft_plan(gconv *g);
 static int gconv_dct_plan(gconv *g);
 static int gconv_box_plan(gconv *g);
 static int gconv_ebox_plan(gconv *g);
@@ -78,6 +80,8 @@ gconv* gconv_plan(num *dest, const num *src, long N, long stride,
         int (*plan)(gconv*);
     } algos[] = {
         {"fir",         gconv_fir_plan},
+        {"fir_direct",  gconv_fir_direct_plan},
+        {"fir_fft",     gconv_fir_fft_plan},
         {"dct",         gconv_dct_plan},
         {"box",         gconv_box_plan},
         {"ebox",        gconv_ebox_plan},
@@ -147,12 +151,29 @@ void gconv_free(gconv *g)
 static void gconv_fir_execute(gconv *g);
 static void gconv_fir_free(gconv *g);
 
-static int gconv_fir_plan(gconv *g)
+static int gconv_fir_plan_radius(gconv *g, long fft_radius)
 {
     g->execute = gconv_fir_execute;
     g->free = gconv_fir_free;
     return (g->coeffs = malloc(sizeof(fir_coeffs)))
-        && fir_precomp((fir_coeffs *)g->coeffs, g->sigma, g->tol);
+        && fir_precomp_ex((fir_coeffs *)g->coeffs, g->sigma, g->tol,
+            fft_radius);
+}
+
+static int gconv_fir_plan(gconv *g)
+{
+    return gconv_fir_plan_radius(g, FIR_FFT_RADIUS);
+}
+
+/* FIR filtering, always direct or always FFT, to compare the two. */
+static int gconv_fir_direct_plan(gconv *g)
+{
+    return gconv_fir_plan_radius(g, 0);
+}
+
+static int gconv_fir_fft_plan(gconv *g)
+{
+    return gconv_fir_plan_radius(g, 1);
 }
 
 static void gconv_fir_execute(gconv *g)
@@ -58,4 +58,21 @@ gconv* gconv_plan(num *dest, const num *src, long N, long stride,
 void gconv_execute(gconv *g);
 void gconv_free(gconv *g);
 
+#ifndef NUM_SINGLE
+/**
+ * \brief Single-precision plan of a dual-precision build
+ *
+ * When the library is also compiled with `NUM_SINGLE` and `NUM_DUAL` (see
+ * num_dual.h), gconv_plan_f(), gconv_execute_f(), and gconv_free_f() are
+ * the single-precision counterparts of gconv_plan(), gconv_execute(), and
+ * gconv_free(), so that the precision is chosen per plan at run time.
+ */
+typedef struct gconv_f_ gconv_f;
+
+gconv_f* gconv_plan_f(float *dest, const float *src, long N, long stride,
+    const char *algo, double sigma, int K, float tol);
+void gconv_execute_f(gconv_f *g);
+void gconv_free_f(gconv_f *g);
+#endif
+
 #endif /* _STRATEGY_GAUSSIAN_CONV_H_ */
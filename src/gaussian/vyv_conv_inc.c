@@ -0,0 +1,145 @@
+/**
+ * \file vyv_conv_inc.c
+ * \brief Interior of Vliet-Young-Verbeek recursive filtering
+ *
+ * This file is included by gaussian_conv_vyv.c once for each instruction
+ * set level, with VYV_CONV_FUNC defined as the name of the function to
+ * define and VYV_CONV_ISA as the target, or not defined for the baseline.
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under, at your option, the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version, or the terms of the
+ * simplified BSD license.
+ *
+ * You should have received a copy of these licenses along with this program.
+ * If not, see <http://www.gnu.org/licenses/> and
+ * <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * \brief Vliet-Young-Verbeek Gaussian convolution of a signal with N > 4
+ * \param c         vyv_coeffs created by vyv_precomp()
+ * \param dest      output convolved data
+ * \param src       data to be convolved, modified in-place if src = dest
+ * \param N         number of samples
+ * \param stride    stride between successive samples
+ * \ingroup vyv_gaussian
+ *
+ * This is the body of vyv_gaussian_conv(), see there.
+ */
+static
+#ifdef VYV_CONV_ISA
+ATTRIBUTE_TARGET(VYV_CONV_ISA)
+#endif
+void VYV_CONV_FUNC(vyv_coeffs c,
+    num *dest, const num *src, long N, long stride)
+{
+    const long stride_2 = stride * 2;
+    const long stride_3 = stride * 3;
+    const long stride_4 = stride * 4;
+    const long stride_5 = stride * 5;
+    const long stride_N = stride * N;
+    num q[VYV_MAX_K];
+    long i;
+    int m, n;
+    
+    /* Handle the left boundary. */
+    init_recursive_filter(q, src, N, stride,
+        c.filter, 0, c.filter, c.K, 1.0f, c.tol, c.max_iter);
+
+    for (m = 0; m < c.K; ++m)
+        dest[stride * m] = q[m];
+    
+    /* The following applies the causal recursive filter according to the
+       filter order c.K. The loops implement the pseudocode
+     
+       For n = K, ..., N - 1,
+          dest(n) = filter(0) src(n) - \sum_{k=1}^K dest(n - k)
+      
+       Variable i = stride * n is the offset to the nth sample. */
+    
+    switch (c.K)
+    {
+    case 3:
+        for (i = stride_3; i < stride_N; i += stride)
+            dest[i] = c.filter[0] * src[i]
+                    - c.filter[1] * dest[i - stride]
+                    - c.filter[2] * dest[i - stride_2]
+                    - c.filter[3] * dest[i - stride_3];
+        break;
+    case 4:
+        for (i = stride_4; i < stride_N; i += stride)
+            dest[i] = c.filter[0] * src[i]
+                    - c.filter[1] * dest[i - stride]
+                    - c.filter[2] * dest[i - stride_2]
+                    - c.filter[3] * dest[i - stride_3]
+                    - c.filter[4] * dest[i - stride_4];
+        break;
+    case 5:
+        for (i = stride_5; i < stride_N; i += stride)
+            dest[i] = c.filter[0] * src[i]
+                    - c.filter[1] * dest[i - stride]
+                    - c.filter[2] * dest[i - stride_2]
+                    - c.filter[3] * dest[i - stride_3]
+                    - c.filter[4] * dest[i - stride_4]
+                    - c.filter[5] * dest[i - stride_5];
+        break;
+    }
+    
+    /* Handle the right boundary by multiplying matrix c.M with last K
+       samples dest(N - K - m), m = 0, ..., K - 1. */
+    
+    /* Copy last K samples into array q, q(m) = dest(N - K + m). */
+    for (m = 0; m < c.K; ++m)
+        q[m] = dest[stride_N - stride * (c.K - m)];
+    
+    /* Perform matrix multiplication,
+       dest(N - K + m) = \sum_{n=0}^{K-1} M(m, n) q(n). */
+    for (m = 0; m < c.K; ++m)
+    {
+        num accum = (num)0;
+        
+        for (n = 0; n < c.K; ++n)
+            accum += c.M[m + c.K*n] * q[n];
+        
+        dest[stride_N - stride * (c.K - m)] = accum;
+    }
+    
+    /* The following applies the anticausal filter, implementing the
+       pseudocode
+       
+       For n = N - K - 1, ..., 0,
+          dest(n) = filter(0) dest(n) - \sum_{k=1}^K dest(n + k)
+      
+       Variable i = stride * n is the offset to the nth sample. */
+    switch (c.K)
+    {
+    case 3:
+        for (i = stride_N - stride_4; i >= 0; i -= stride)
+            dest[i] = c.filter[0] * dest[i]
+                    - c.filter[1] * dest[i + stride]
+                    - c.filter[2] * dest[i + stride_2]
+                    - c.filter[3] * dest[i + stride_3];
+        break;
+    case 4:
+        for (i = stride_N - stride_5; i >= 0; i -= stride)
+            dest[i] = c.filter[0] * dest[i]
+                    - c.filter[1] * dest[i + stride]
+                    - c.filter[2] * dest[i + stride_2]
+                    - c.filter[3] * dest[i + stride_3]
+                    - c.filter[4] * dest[i + stride_4];
+        break;
+    case 5:
+        for (i = stride_N - stride * 6; i >= 0; i -= stride)
+            dest[i] = c.filter[0] * dest[i]
+                    - c.filter[1] * dest[i + stride]
+                    - c.filter[2] * dest[i + stride_2]
+                    - c.filter[3] * dest[i + stride_3]
+                    - c.filter[4] * dest[i + stride_4]
+                    - c.filter[5] * dest[i + stride_5];
+        break;
+    }
+
+    return;
+}
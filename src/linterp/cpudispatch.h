@@ -0,0 +1,39 @@
+/**
+ * @file cpudispatch.h
+ * @brief Runtime selection of instruction set specific kernels
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _CPUDISPATCH_H_
+#define _CPUDISPATCH_H_
+
+/* Compilers that can build a function for a given x86 instruction set with
+   __attribute__((target)) and detect the running CPU with
+   __builtin_cpu_supports.  Otherwise only the baseline kernels are built. */
+#if (defined(__x86_64__) || defined(__i386__)) \
+    && (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+/** @brief Defined if kernels are built for several instruction sets */
+#define CPUDISPATCH_TARGETS
+/** @brief Attribute building a function for the specified instruction set */
+#define ATTRIBUTE_TARGET(Isa)   __attribute__((target(Isa)))
+#else
+#define ATTRIBUTE_TARGET(Isa)
+#endif
+
+/** @brief Instruction set levels, in increasing order of capability */
+typedef enum
+{
+    CPU_BASELINE = 0,
+    CPU_SSE2 = 1,
+    CPU_AVX2 = 2,
+    CPU_AVX512 = 3
+} cpulevel;
+
+cpulevel GetCpuLevel();
+const char *CpuLevelName(cpulevel Level);
+
+#endif /* _CPUDISPATCH_H_ */
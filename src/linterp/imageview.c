@@ -0,0 +1,161 @@
+/**
+ * @file imageview.c
+ * @brief Strided views of float images
+ *
+ * A view describes where the samples of an image are in memory without
+ * assuming that they are tightly packed.  Routines accepting views can then
+ * operate on a crop of a larger image or on an image with padded rows in
+ * place, without first copying it into a packed buffer.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include <stddef.h>
+#include <ipol/basic.h>
+#include "imageview.h"
+
+
+/**
+ * @brief Make a view of a packed planar image
+ * @param Data the image in planar row-major order
+ * @param Width, Height, NumChannels image dimensions
+ * @return view of the image
+ */
+imageview MakeImageView(float *Data, int Width, int Height, int NumChannels)
+{
+    imageview View;
+
+    View.Data = Data;
+    View.Width = Width;
+    View.Height = Height;
+    View.NumChannels = NumChannels;
+    View.PixelStride = 1;
+    View.RowStride = Width;
+    View.ChannelStride = Width*Height;
+    View.Base = NULL;
+    return View;
+}
+
+
+/**
+ * @brief Make a view of a packed image with interleaved channels
+ * @param Data the image in interleaved row-major order
+ * @param Width, Height, NumChannels image dimensions
+ * @return view of the image
+ */
+imageview MakeInterleavedImageView(float *Data,
+    int Width, int Height, int NumChannels)
+{
+    imageview View;
+
+    View.Data = Data;
+    View.Width = Width;
+    View.Height = Height;
+    View.NumChannels = NumChannels;
+    View.PixelStride = NumChannels;
+    View.RowStride = NumChannels*Width;
+    View.ChannelStride = 1;
+    View.Base = NULL;
+    return View;
+}
+
+
+/**
+ * @brief Make a view of a rectangle of another view without copying
+ * @param View the view to crop
+ * @param x, y upper-left corner of the rectangle
+ * @param Width, Height dimensions of the rectangle
+ * @return view of the rectangle
+ *
+ * The rectangle is clipped to the bounds of View.  The returned view shares
+ * the data of View and does not own it.
+ */
+imageview CropImageView(imageview View, int x, int y, int Width, int Height)
+{
+    if(x < 0)
+    {
+        Width += x;
+        x = 0;
+    }
+    if(y < 0)
+    {
+        Height += y;
+        y = 0;
+    }
+    if(Width > View.Width - x)
+        Width = View.Width - x;
+    if(Height > View.Height - y)
+        Height = View.Height - y;
+
+    View.Data = IMAGEVIEW_PTR(View, x, y, 0);
+    View.Width = (Width > 0) ? Width : 0;
+    View.Height = (Height > 0) ? Height : 0;
+    View.Base = NULL;
+    return View;
+}
+
+
+/**
+ * @brief Allocate a planar image with aligned rows
+ * @param View the view to initialize
+ * @param Width, Height, NumChannels image dimensions
+ * @return 1 on success, 0 on failure.
+ *
+ * The first sample of every row is aligned to IMAGEVIEW_ALIGN bytes, so that
+ * rows can be processed with aligned vector loads.  It is the responsibility
+ * of the caller to call FreeImageView when done.
+ */
+int AllocImageView(imageview *View, int Width, int Height, int NumChannels)
+{
+    const int AlignNumEl = IMAGEVIEW_ALIGN / sizeof(float);
+    size_t Address;
+
+    View->Data = NULL;
+    View->Base = NULL;
+    View->Width = View->Height = View->NumChannels = 0;
+
+    if(Width <= 0 || Height <= 0 || NumChannels <= 0)
+        return 0;
+
+    View->PixelStride = 1;
+    View->RowStride = ((Width + AlignNumEl - 1) / AlignNumEl) * AlignNumEl;
+    View->ChannelStride = View->RowStride*Height;
+
+    if(!(View->Base = Malloc(sizeof(float)*View->ChannelStride*NumChannels
+        + IMAGEVIEW_ALIGN)))
+        return 0;
+
+    Address = (size_t)View->Base;
+    Address = ((Address + IMAGEVIEW_ALIGN - 1) / IMAGEVIEW_ALIGN)
+        * IMAGEVIEW_ALIGN;
+    View->Data = (float *)((char *)View->Base
+        + (Address - (size_t)View->Base));
+    View->Width = Width;
+    View->Height = Height;
+    View->NumChannels = NumChannels;
+    return 1;
+}
+
+
+/** @brief Free the memory owned by a view */
+void FreeImageView(imageview *View)
+{
+    if(View->Base)
+        Free(View->Base);
+
+    View->Data = NULL;
+    View->Base = NULL;
+}
+
+
+/** @brief Test whether a view is a packed planar image */
+int IsPackedImageView(imageview View)
+{
+    return View.PixelStride == 1 && View.RowStride == View.Width
+        && (View.NumChannels == 1
+        || View.ChannelStride == View.Width*View.Height);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file imageview.h
+ * @brief Strided views of float images
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _IMAGEVIEW_H_
+#define _IMAGEVIEW_H_
+
+/** @brief Row pitch alignment in bytes for images made by AllocImageView */
+#define IMAGEVIEW_ALIGN     64
+
+/**
+ * @brief struct representing a strided view of a float image
+ *
+ * Channel c of pixel (x,y) is located at
+ *     Data[PixelStride*x + RowStride*y + ChannelStride*c],
+ * so that the same type describes the planar layout
+ *     PixelStride = 1, RowStride = Width, ChannelStride = Width*Height,
+ * the interleaved layout
+ *     PixelStride = NumChannels, RowStride = NumChannels*Width,
+ *     ChannelStride = 1,
+ * padded rows (RowStride larger than the row), and crops of a larger image
+ * (Data pointing into the larger image and the strides of the larger image).
+ * A view does not own its data unless it was made with AllocImageView.
+ */
+typedef struct
+{
+    /** @brief Pointer to channel 0 of pixel (0,0) */
+    float *Data;
+    /** @brief Image width */
+    int Width;
+    /** @brief Image height */
+    int Height;
+    /** @brief Number of channels */
+    int NumChannels;
+    /** @brief Step between horizontally adjacent pixels */
+    int PixelStride;
+    /** @brief Step between vertically adjacent pixels */
+    int RowStride;
+    /** @brief Step between channels of the same pixel */
+    int ChannelStride;
+    /** @brief Memory block owned by the view, or NULL */
+    void *Base;
+} imageview;
+
+/** @brief Pointer to channel c of pixel (x,y) of a view */
+#define IMAGEVIEW_PTR(View, x, y, c) ((View).Data + (View).PixelStride*(x) \
+    + (View).RowStride*(y) + (View).ChannelStride*(c))
+
+imageview MakeImageView(float *Data, int Width, int Height, int NumChannels);
+imageview MakeInterleavedImageView(float *Data,
+    int Width, int Height, int NumChannels);
+imageview CropImageView(imageview View, int x, int y, int Width, int Height);
+int AllocImageView(imageview *View, int Width, int Height, int NumChannels);
+void FreeImageView(imageview *View);
+int IsPackedImageView(imageview View);
+
+#endif /* _IMAGEVIEW_H_ */
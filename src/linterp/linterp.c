@@ -29,9 +29,14 @@
 #include <ipol/basic.h>
 #include "linterp.h"
 #include "lkernels.h"
+#include "padimage.h"
+#include "imageview.h"
+#include "cpudispatch.h"
 
 /** @brief Clamp X to [A, B] */
 #define CLAMP(X,A,B)    (((X) < (A)) ? (A) : (((X) > (B)) ? (B) : (X)))
+/** @brief The larger of A and B */
+#define MAX(A,B)        (((A) >= (B)) ? (A) : (B))
 
 
 /**
@@ -96,6 +101,47 @@ int (*ExtensionMethod[3])(int, int) =
     {ConstExtension, HSymExtension, WSymExtension};
 
 
+/**
+ * @brief Move a far sampling coordinate near the image
+ * @param x the coordinate
+ * @param N the data length
+ * @param KernelWidth the number of taps
+ * @param Boundary boundary handling
+ * @return a coordinate where the kernel support sees the same extended data
+ *
+ * When x is more than 2*(N + KernelWidth + 1) away from the origin, it is
+ * shifted by a whole number of periods of the symmetric extension, or for
+ * constant extension moved by a whole number of pixels to just outside the
+ * same edge.  The shifted value has a smaller magnitude and the same
+ * fractional part, so it is exact and the kernel weights do not change.
+ * This keeps the tap indices small for any finite x.  NaN and infinite x
+ * become NaN.
+ */
+static float ReduceCoordinate(float x, int N, int KernelWidth,
+    boundaryhandling Boundary)
+{
+    double Period;
+
+    if(!(fabs(x) > 2.0*(N + KernelWidth + 1)))
+        return x;
+
+    switch(Boundary)
+    {
+    case BOUNDARY_HSYMMETRIC:
+        Period = 2.0*N;
+        break;
+    case BOUNDARY_WSYMMETRIC:
+        Period = (N > 1) ? 2.0*N - 2 : 1;
+        break;
+    default:
+        return (float)(fmod(x, 1.0)
+            + ((x < 0) ? -(KernelWidth + 1.0) : (double)(N + KernelWidth)));
+    }
+
+    return (float)fmod(x, Period);
+}
+
+
 /**
  * @brief 2D linear interpolation (arbitrary resampling)
  * @param Dest pointer to destination array
@@ -122,7 +168,10 @@ int (*ExtensionMethod[3])(int, int) =
  * corresponding to (0,0).  In other words, if X[k] = m and Y[k] = n, then
  *     Dest[k] = Src[m + SrcWidth*n].
  * If (X[k],Y[k]) is outside of [0,SrcWidth-1] x [0,SrcHeight-1], then Src is
- * extrapolated with half-sample even symmetry.
+ * extrapolated according to Boundary.  The extension is materialized once in
+ * a halo, as wide as the kernel, around a padded copy of Src, so that samples
+ * whose support lies within it need no boundary handling.  The taps of
+ * samples farther out are extended one by one.
  *
  * Kernel should be a function with the calling syntax
  *     float Kernel(float x).
@@ -148,83 +197,108 @@ int LinInterp2d(float *Dest, const float *Src, int SrcWidth, int SrcHeight,
     float (*Kernel)(float), float KernelRadius, int KernelNormalize,
     boundaryhandling Boundary)
 {
-    int (*Extension)(int, int) = ExtensionMethod[Boundary];
     const int KernelWidth = (int)ceil(2*KernelRadius);
-    float *KernelXBuf = NULL, *KernelYBuf = NULL;
-    float Weight, Sum, DenomSum;
-    int IndexX0, IndexY0, IndexX, IndexY, SrcRowOffset;
+    const int Pad = KernelWidth;
+    paddedimage Padded = {NULL, NULL, 0, 0, 0, 0, 0};
+    float *KernelXBuf = NULL, *KernelYBuf = NULL, *TapBuf = NULL;
+    const float *SrcBase, *SrcRow;
+    float Weight, Sum, DenomSum, Xk, Yk;
+    double X0, Y0;
+    int IndexX0, IndexY0, SrcStride;
     int k, m, n, Success = 0;
 
     if(!Dest || !Src || SrcWidth <= 0 || SrcHeight <= 0 || !X || !Y
         || NumSamples < 0 || !Kernel || KernelRadius < 0
         || !(KernelXBuf = (float *)Malloc(sizeof(float)*(KernelWidth)))
-        || !(KernelYBuf = (float *)Malloc(sizeof(float)*(KernelWidth))))
+        || !(KernelYBuf = (float *)Malloc(sizeof(float)*(KernelWidth)))
+        || !(TapBuf = (float *)Malloc(sizeof(float)
+            *KernelWidth*KernelWidth)))
         goto Catch;
 
-    if(!KernelNormalize)
-        for(k = 0; k < NumSamples; k++)
-        {
-            IndexX0 = (int)ceil(X[k] - KernelRadius);
-            IndexY0 = (int)ceil(Y[k] - KernelRadius);
-            Sum = 0.0f;
-
-            /* Evaluate the kernel */
-            for(m = 0; m < KernelWidth; m++)
-                KernelXBuf[m] = Kernel(X[k] - (IndexX0 + m));
+    /* Extend Src once into a halo as wide as the kernel */
+    if(!MakePaddedImage(&Padded, Src, SrcWidth, SrcHeight, 1, Pad,
+        (padmethod)Boundary))
+        goto Catch;
 
-            for(n = 0; n < KernelWidth; n++)
-                KernelYBuf[n] = Kernel(Y[k] - (IndexY0 + n));
+    for(k = 0; k < NumSamples; k++)
+    {
+        X0 = ceil(X[k] - KernelRadius);
+        Y0 = ceil(Y[k] - KernelRadius);
+
+        if(X0 >= -Pad && X0 <= SrcWidth + Pad - KernelWidth
+            && Y0 >= -Pad && Y0 <= SrcHeight + Pad - KernelWidth)
+        {   /* The kernel support is within the halo */
+            Xk = X[k];
+            Yk = Y[k];
+            IndexX0 = (int)X0;
+            IndexY0 = (int)Y0;
+            SrcBase = PADPIXEL(Padded, IndexX0, IndexY0);
+            SrcStride = Padded.Stride;
+        }
+        else
+        {   /* Otherwise extend each tap, and for a NaN coordinate only
+               avoid converting it to int */
+            Xk = ReduceCoordinate(X[k], SrcWidth, KernelWidth, Boundary);
+            Yk = ReduceCoordinate(Y[k], SrcHeight, KernelWidth, Boundary);
+            IndexX0 = (Xk == Xk) ? (int)ceil(Xk - KernelRadius) : 0;
+            IndexY0 = (Yk == Yk) ? (int)ceil(Yk - KernelRadius) : 0;
 
-            /* Compute the interpolated value at (X[k], Y[k]) */
             for(n = 0; n < KernelWidth; n++)
             {
-                IndexY = Extension(SrcHeight, IndexY0 + n);
-                SrcRowOffset = SrcWidth*IndexY;
+                SrcRow = Src + SrcWidth*PadExtension(SrcHeight,
+                    IndexY0 + n, (padmethod)Boundary);
 
                 for(m = 0; m < KernelWidth; m++)
-                {
-                    IndexX = Extension(SrcWidth, IndexX0 + m);
-                    Sum += Src[IndexX + SrcRowOffset]
-                        * KernelXBuf[m] * KernelYBuf[n];
-                }
+                    TapBuf[m + KernelWidth*n] = SrcRow[PadExtension(
+                        SrcWidth, IndexX0 + m, (padmethod)Boundary)];
             }
 
-            Dest[k] = Sum;
+            SrcBase = TapBuf;
+            SrcStride = KernelWidth;
         }
-    else
-        for(k = 0; k < NumSamples; k++)
-        {
-            IndexX0 = (int)ceil(X[k] - KernelRadius);
-            IndexY0 = (int)ceil(Y[k] - KernelRadius);
-            Sum = DenomSum = 0.0f;
 
-            /* Evaluate the kernel */
-            for(m = 0; m < KernelWidth; m++)
-                KernelXBuf[m] = Kernel(X[k] - (IndexX0 + m));
+        /* Evaluate the kernel */
+        for(m = 0; m < KernelWidth; m++)
+            KernelXBuf[m] = Kernel(Xk - (IndexX0 + m));
 
-            for(n = 0; n < KernelWidth; n++)
-                KernelYBuf[n] = Kernel(Y[k] - (IndexY0 + n));
+        for(n = 0; n < KernelWidth; n++)
+            KernelYBuf[n] = Kernel(Yk - (IndexY0 + n));
 
-            /* Compute the interpolated value at (X[k], Y[k]) */
-            for(n = 0; n < KernelWidth; n++)
+        /* Compute the interpolated value at (X[k], Y[k]) */
+        if(!KernelNormalize)
+        {
+            for(n = 0, Sum = 0.0f; n < KernelWidth; n++)
+            {
+                SrcRow = SrcBase + SrcStride*n;
+
+                for(m = 0; m < KernelWidth; m++)
+                    Sum += SrcRow[m] * KernelXBuf[m] * KernelYBuf[n];
+            }
+
+            Dest[k] = Sum;
+        }
+        else
+        {
+            for(n = 0, Sum = DenomSum = 0.0f; n < KernelWidth; n++)
             {
-                IndexY = Extension(SrcHeight, IndexY0 + n);
-                SrcRowOffset = SrcWidth*IndexY;
+                SrcRow = SrcBase + SrcStride*n;
 
                 for(m = 0; m < KernelWidth; m++)
                 {
-                    IndexX = Extension(SrcWidth, IndexX0 + m);
                     Weight = KernelXBuf[m] * KernelYBuf[n];
-                    Sum += Src[IndexX + SrcRowOffset] * Weight;
+                    Sum += SrcRow[m] * Weight;
                     DenomSum += Weight;
                 }
             }
 
             Dest[k] = Sum / DenomSum;
         }
+    }
 
     Success = 1;
 Catch:
+    FreePaddedImage(&Padded);
+    Free(TapBuf);
     Free(KernelYBuf);
     Free(KernelXBuf);
     return Success;
@@ -310,25 +384,90 @@ typedef struct
 } scalescanfilter;
 
 
-static void ScaleScan(float *Dest, int DestStride, int DestWidth,
-    const float *Src, int SrcStride,
-    scalescanfilter Filter)
-{
-    float Sum;
-    int x, k, SrcIndex;
+/** @brief Number of rows filtered together by ScaleScan */
+#define SCALESCAN_BLOCK 32
+
+/* Instances of the row kernels ScaleScan and ScaleRows for each
+   instruction set level */
+#define SCALESCAN_FUNC  ScaleScanBaseline
+#define SCALEROWS_FUNC  ScaleRowsBaseline
+#include "scalescan_inc.c"
+#include "scalerows_inc.c"
+#undef SCALESCAN_FUNC
+#undef SCALEROWS_FUNC
+
+#ifdef CPUDISPATCH_TARGETS
+#define SCALESCAN_FUNC  ScaleScanSse2
+#define SCALEROWS_FUNC  ScaleRowsSse2
+#define SCALESCAN_ISA   "sse2"
+#define SCALEROWS_ISA   "sse2"
+#include "scalescan_inc.c"
+#include "scalerows_inc.c"
+#undef SCALESCAN_FUNC
+#undef SCALEROWS_FUNC
+#undef SCALESCAN_ISA
+#undef SCALEROWS_ISA
+
+#define SCALESCAN_FUNC  ScaleScanAvx2
+#define SCALEROWS_FUNC  ScaleRowsAvx2
+#define SCALESCAN_ISA   "avx2"
+#define SCALEROWS_ISA   "avx2"
+#include "scalescan_inc.c"
+#include "scalerows_inc.c"
+#undef SCALESCAN_FUNC
+#undef SCALEROWS_FUNC
+#undef SCALESCAN_ISA
+#undef SCALEROWS_ISA
+
+#define SCALESCAN_FUNC  ScaleScanAvx512
+#define SCALEROWS_FUNC  ScaleRowsAvx512
+#define SCALESCAN_ISA   "avx512f"
+#define SCALEROWS_ISA   "avx512f"
+#include "scalescan_inc.c"
+#include "scalerows_inc.c"
+#undef SCALESCAN_FUNC
+#undef SCALEROWS_FUNC
+#undef SCALESCAN_ISA
+#undef SCALEROWS_ISA
+#endif
+
+/** @brief typedef for the ScaleScan kernel variants */
+typedef void (*scalescanfunc)(float *, int, int, int, int,
+    const float *, const float *, const int16_t *, int);
+
+/** @brief typedef for the ScaleRows kernel variants */
+typedef void (*scalerowsfunc)(float *, const float *,
+    int, int, int, const float *, int);
 
 
-    for(x = 0; x < DestWidth; x++)
+/**
+ * @brief Select the ScaleScan and ScaleRows variants for the CPU
+ * @param ScaleScan set to the horizontal row kernel
+ * @param ScaleRows set to the vertical row kernel
+ */
+static void GetScaleKernels(scalescanfunc *ScaleScan,
+    scalerowsfunc *ScaleRows)
+{
+    switch(GetCpuLevel())
     {
-        SrcIndex = Filter.Pos[x] * SrcStride;
-        Sum = 0;
-
-        for(k = 0; k < Filter.Width; k++, SrcIndex += SrcStride)
-            Sum += Filter.Coeff[k] * Src[SrcIndex];
-
-        *Dest = Sum;
-        Dest += DestStride;
-        Filter.Coeff += Filter.Width;
+#ifdef CPUDISPATCH_TARGETS
+    case CPU_AVX512:
+        *ScaleScan = ScaleScanAvx512;
+        *ScaleRows = ScaleRowsAvx512;
+        break;
+    case CPU_AVX2:
+        *ScaleScan = ScaleScanAvx2;
+        *ScaleRows = ScaleRowsAvx2;
+        break;
+    case CPU_SSE2:
+        *ScaleScan = ScaleScanSse2;
+        *ScaleRows = ScaleRowsSse2;
+        break;
+#endif
+    default:
+        *ScaleScan = ScaleScanBaseline;
+        *ScaleRows = ScaleRowsBaseline;
+        break;
     }
 }
 
@@ -336,7 +475,8 @@ static void ScaleScan(float *Dest, int DestStride, int DestWidth,
 /**
  * @brief Create scanline interpolation filter to be applied with ScaleScan
  * @param Filter pointer to scalescanfilter struct
- * @param DestWidth width after interpolation
+ * @param DestOffset index of the first sample to compute
+ * @param DestWidth number of samples to compute
  * @param XStart leftmost sampling location (in input coordinates)
  * @param XStep the length between successive samples (in input coordinates)
  * @param SrcWidth width of the input
@@ -348,11 +488,11 @@ static void ScaleScan(float *Dest, int DestStride, int DestWidth,
  *
  * This routine creates a scalescanfilter for 1-D interpolation of samples at
  * the locations
- *    XStart + n*XStep, n = 0, ..., DestWidth - 1,
+ *    XStart + n*XStep, n = DestOffset, ..., DestOffset + DestWidth - 1,
  * where the pixels of the source are logically located at the integers.  Half-
  * sample even symmetric extension is used to handle the boundaries.
  */
-static int MakeScaleScanFilter(scalescanfilter *Filter,
+static int MakeScaleScanFilter(scalescanfilter *Filter, int DestOffset,
     int DestWidth, float XStart, float XStep, int SrcWidth,
     float (*Kernel)(float), float KernelRadius, int KernelNormalize,
     boundaryhandling Boundary)
@@ -383,7 +523,7 @@ static int MakeScaleScanFilter(scalescanfilter *Filter,
 
     for(DestX = 0; DestX < DestWidth; DestX++)
     {
-        SrcX = XStart + XStep*DestX;
+        SrcX = XStart + XStep*(DestOffset + DestX);
         Pos = (int)ceil(SrcX - KernelRadius);
 
         if(Pos < 0 || MaxPos < Pos)
@@ -466,37 +606,152 @@ int LinScale2d(float *Dest, int DestWidth, float XStart, float XStep,
     float (*Kernel)(float), float KernelRadius, int KernelNormalize,
     boundaryhandling Boundary)
 {
-    const int SrcNumPixels = SrcWidth*SrcHeight;
-    const int DestNumPixels = DestWidth*DestHeight;
+    return LinScale2dRoi(Dest, 0, 0, DestWidth, DestHeight,
+        XStart, XStep, YStart, YStep, Src, SrcWidth, SrcHeight, NumChannels,
+        Kernel, KernelRadius, KernelNormalize, Boundary);
+}
+
+
+/**
+ * @brief Scale a rectangular region of an image with a compact support kernel
+ *
+ * @param Dest pointer to memory for holding the interpolated region
+ * @param RoiX, RoiY upper-left corner of the region (in output coordinates)
+ * @param RoiWidth, RoiHeight dimensions of the region
+ * @param XStart leftmost sampling location (in input coordinates)
+ * @param XStep the length between successive samples (in input coordinates)
+ * @param YStart uppermost sampling location (in input coordinates)
+ * @param YStep the length between successive samples (in input coordinates)
+ * @param Src the input image
+ * @param SrcWidth, SrcHeight, NumChannels input image dimensions
+ * @param Kernel interpolation kernel function to use
+ * @param KernelRadius kernel support radius
+ * @param KernelNormalize if nonzero, filter rows are normalized to sum to 1
+ * @param Boundary boundary handling
+ *
+ * @return 1 on success, 0 on failure.
+ *
+ * This routine computes the same samples as \c LinScale2d, but only within
+ * the output rectangle [RoiX, RoiX + RoiWidth) x [RoiY, RoiY + RoiHeight),
+ * so that Dest[m + RoiWidth*n] is the interpolation of Src at
+ *     (XStart + (RoiX + m)*XStep, YStart + (RoiY + n)*YStep)
+ * for m = 0, ..., RoiWidth - 1, n = 0, ..., RoiHeight - 1.  Dest should have
+ * space for RoiWidth*RoiHeight*NumChannels elements.
+ *
+ * Only the source columns within the footprint of the horizontal scanline
+ * filter are passed through the vertical filter, and the vertical filter only
+ * reads the source rows within its own footprint, so the cost is proportional
+ * to the size of the region rather than to the size of the full output.  The
+ * result is identical to cropping the output of \c LinScale2d.
+ */
+int LinScale2dRoi(float *Dest, int RoiX, int RoiY, int RoiWidth, int RoiHeight,
+    float XStart, float XStep, float YStart, float YStep,
+    const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
+    float (*Kernel)(float), float KernelRadius, int KernelNormalize,
+    boundaryhandling Boundary)
+{
+    if(!Dest || !Src)
+        return 0;
+
+    return LinScale2dView(MakeImageView(Dest, RoiWidth, RoiHeight, NumChannels),
+        RoiX, RoiY, XStart, XStep, YStart, YStep,
+        MakeImageView((float *)Src, SrcWidth, SrcHeight, NumChannels),
+        Kernel, KernelRadius, KernelNormalize, Boundary);
+}
+
+
+/**
+ * @brief Scale a region of a strided image view
+ *
+ * @param Dest view of the output region, Dest.Width by Dest.Height
+ * @param RoiX, RoiY upper-left corner of the region (in output coordinates)
+ * @param XStart leftmost sampling location (in input coordinates)
+ * @param XStep the length between successive samples (in input coordinates)
+ * @param YStart uppermost sampling location (in input coordinates)
+ * @param YStep the length between successive samples (in input coordinates)
+ * @param Src view of the input image
+ * @param Kernel interpolation kernel function to use
+ * @param KernelRadius kernel support radius
+ * @param KernelNormalize if nonzero, filter rows are normalized to sum to 1
+ * @param Boundary boundary handling
+ *
+ * @return 1 on success, 0 on failure.
+ *
+ * This is \c LinScale2dRoi for images described by views, so that the input
+ * may be a crop of a larger image and either image may have padded rows or
+ * interleaved channels.  Dest and Src must have the same number of channels.
+ */
+int LinScale2dView(imageview Dest, int RoiX, int RoiY,
+    float XStart, float XStep, float YStart, float YStep, imageview Src,
+    float (*Kernel)(float), float KernelRadius, int KernelNormalize,
+    boundaryhandling Boundary)
+{
     scalescanfilter HFilter = {NULL, 0, 0}, VFilter = {NULL, 0, 0};
-    float *Buf = NULL;
-    int x, y, Channel, Success = 0;
+    scalescanfunc ScaleScan;
+    scalerowsfunc ScaleRows;
+    float *Buf = NULL, *BufT;
+    int x, y, y0, NumRows, SrcX0, SrcX1, BufWidth, Channel, Success = 0;
 
 
-    if(!Dest || DestWidth <= 0 || DestHeight <= 0 || !Src
-        || SrcWidth <= 0 || SrcHeight <= 0 || NumChannels <= 0
+    if(!Dest.Data || RoiX < 0 || RoiY < 0 || Dest.Width <= 0
+        || Dest.Height <= 0 || !Src.Data || Src.Width <= 0 || Src.Height <= 0
+        || Src.NumChannels <= 0 || Dest.NumChannels != Src.NumChannels
         || !Kernel || KernelRadius < 0)
         return 0;
-    if(!(Buf = (float *)Malloc(sizeof(float)*SrcWidth*DestHeight))
-        || !MakeScaleScanFilter(&HFilter, DestWidth, XStart, XStep,
-            SrcWidth, Kernel, KernelRadius, KernelNormalize, Boundary)
-        || !MakeScaleScanFilter(&VFilter, DestHeight, YStart, YStep,
-            SrcHeight, Kernel, KernelRadius, KernelNormalize, Boundary))
+
+    GetScaleKernels(&ScaleScan, &ScaleRows);
+
+    if(!MakeScaleScanFilter(&HFilter, RoiX, Dest.Width, XStart, XStep,
+            Src.Width, Kernel, KernelRadius, KernelNormalize, Boundary)
+        || !MakeScaleScanFilter(&VFilter, RoiY, Dest.Height, YStart, YStep,
+            Src.Height, Kernel, KernelRadius, KernelNormalize, Boundary))
         goto Catch;
 
-    for(Channel = 0; Channel < NumChannels; Channel++)
-    {
-        for(x = 0; x < SrcWidth; x++)
-            ScaleScan(Buf + x, SrcWidth, DestHeight,
-                Src + x, SrcWidth, VFilter);
+    /* Determine the source columns needed by the horizontal filter */
+    SrcX0 = SrcX1 = HFilter.Pos[0];
 
-        for(y = 0; y < DestHeight; y++)
-            ScaleScan(Dest + y*DestWidth, 1, DestWidth,
-                Buf + y*SrcWidth, 1, HFilter);
+    for(x = 1; x < Dest.Width; x++)
+        if(HFilter.Pos[x] < SrcX0)
+            SrcX0 = HFilter.Pos[x];
+        else if(HFilter.Pos[x] > SrcX1)
+            SrcX1 = HFilter.Pos[x];
 
-        Src += SrcNumPixels;
-        Dest += DestNumPixels;
-    }
+    BufWidth = SrcX1 + HFilter.Width - SrcX0;
+
+    /* Make the horizontal filter positions relative to Buf */
+    for(x = 0; x < Dest.Width; x++)
+        HFilter.Pos[x] -= SrcX0;
+
+    if(!(Buf = (float *)Malloc(sizeof(float)*2*SCALESCAN_BLOCK*BufWidth)))
+        goto Catch;
+
+    BufT = Buf + SCALESCAN_BLOCK*BufWidth;
+
+    for(Channel = 0; Channel < Src.NumChannels; Channel++)
+        for(y0 = 0; y0 < Dest.Height; y0 += NumRows)
+        {
+            NumRows = (Dest.Height - y0 < SCALESCAN_BLOCK)
+                ? Dest.Height - y0 : SCALESCAN_BLOCK;
+
+            /* Vertical pass by rows, so that the kernel runs along
+               contiguous memory and vectorizes */
+            for(y = 0; y < NumRows; y++)
+                ScaleRows(Buf + y*BufWidth,
+                    IMAGEVIEW_PTR(Src, SrcX0, VFilter.Pos[y0 + y], Channel),
+                    Src.PixelStride, Src.RowStride, BufWidth,
+                    VFilter.Coeff + (y0 + y)*VFilter.Width, VFilter.Width);
+
+            /* Transpose the block, so that the horizontal pass filters its
+               rows together along contiguous memory */
+            for(x = 0; x < BufWidth; x++)
+                for(y = 0; y < SCALESCAN_BLOCK; y++)
+                    BufT[SCALESCAN_BLOCK*x + y] =
+                        (y < NumRows) ? Buf[x + BufWidth*y] : 0;
+
+            ScaleScan(IMAGEVIEW_PTR(Dest, 0, y0, Channel), Dest.PixelStride,
+                Dest.RowStride, Dest.Width, NumRows, BufT,
+                HFilter.Coeff, HFilter.Pos, HFilter.Width);
+        }
 
     Success = 1;
 Catch:
@@ -511,6 +766,7 @@ Catch:
 
 static int FourierScaleScan(float *Dest,
     int DestStride, int DestScanStride, int DestChannelStride, int DestScanSize,
+    int DestScanOffset, int DestScanCount,
     const float *Src,
     int SrcStride, int SrcScanStride, int SrcChannelStride, int SrcScanSize,
     int NumScans, int NumChannels, float XStart, double PsfSigma,
@@ -654,15 +910,16 @@ static int FourierScaleScan(float *Dest,
     fftwf_execute(Plan);
     fftwf_destroy_plan(Plan);
 
-    /* Fill Dest with the result (and trim padding) */
+    /* Fill Dest with the requested samples (and trim padding) */
     for(Channel = 0; Channel < NumChannels; Channel++)
     {
         for(Scan = 0; Scan < NumScans; Scan++)
         {
-            for(i = 0; i < DestScanSize; i++)
+            for(i = 0; i < DestScanCount; i++)
                 Dest[DestStride*i + DestScanStride*Scan
                     + DestChannelStride*Channel]
-                    = BufSpatial[i + DestPadScanSize*(Scan + NumScans*Channel)];
+                    = BufSpatial[DestScanOffset + i
+                    + DestPadScanSize*(Scan + NumScans*Channel)];
         }
     }
 
@@ -706,35 +963,84 @@ int FourierScale2d(float *Dest, int DestWidth, float XStart,
     int DestHeight, float YStart,
     const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
     double PsfSigma, boundaryhandling Boundary)
+{
+    unsigned long StartTime, StopTime;
+    int Success;
+
+
+    StartTime = Clock();
+    Success = FourierScale2dRoi(Dest, 0, 0, DestWidth, DestHeight,
+        DestWidth, XStart, DestHeight, YStart,
+        Src, SrcWidth, SrcHeight, NumChannels, PsfSigma, Boundary);
+    StopTime = Clock();
+
+    if(Success)
+        printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+
+    return Success;
+}
+
+
+/**
+ * @brief Scale a rectangular region of an image with Fourier zero padding
+ *
+ * @param Dest pointer to memory for holding the interpolated region
+ * @param RoiX, RoiY upper-left corner of the region (in output coordinates)
+ * @param RoiWidth, RoiHeight dimensions of the region
+ * @param DestWidth width of the full interpolated image
+ * @param XStart leftmost sample location (in input coordinates)
+ * @param DestHeight height of the full interpolated image
+ * @param YStart uppermost sample location (in input coordinates)
+ * @param Src the input image
+ * @param SrcWidth, SrcHeight, NumChannels input image dimensions
+ * @param PsfSigma Gaussian PSF standard deviation
+ * @param Boundary boundary handling
+ *
+ * @return 1 on success, 0 on failure.
+ *
+ * This routine computes the same samples as \c FourierScale2d, but only
+ * within the output rectangle [RoiX, RoiX + RoiWidth) x [RoiY, RoiY +
+ * RoiHeight) of the DestWidth by DestHeight interpolation.  Dest should have
+ * space for RoiWidth*RoiHeight*NumChannels elements.
+ *
+ * Fourier interpolation is global, so every source column is still
+ * transformed in the vertical pass.  But only the RoiHeight interpolated rows
+ * within the region are kept, and only those rows are transformed in the
+ * horizontal pass, so that the cost and the intermediate memory of the second
+ * pass scale with the region rather than with the full output.
+ */
+int FourierScale2dRoi(float *Dest, int RoiX, int RoiY,
+    int RoiWidth, int RoiHeight, int DestWidth, float XStart,
+    int DestHeight, float YStart,
+    const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
+    double PsfSigma, boundaryhandling Boundary)
 {
     float *Buf = NULL;
     int Success = 0;
 
-    unsigned long StartTime, StopTime;
-
 
     if(!Dest || DestWidth < SrcWidth || DestHeight < SrcHeight || !Src
+        || RoiX < 0 || RoiY < 0 || RoiWidth <= 0 || RoiHeight <= 0
+        || RoiX + RoiWidth > DestWidth || RoiY + RoiHeight > DestHeight
         || SrcWidth <= 0 || SrcHeight <= 0 || NumChannels <= 0 || PsfSigma < 0
-        || !(Buf = (float *)Malloc(sizeof(float)*SrcWidth*DestHeight*3)))
+        || !(Buf = (float *)Malloc(sizeof(float)
+            *SrcWidth*RoiHeight*NumChannels)))
         return 0;
 
-    StartTime = Clock();
-
-    /* Scale the image vertically */
-    if(!FourierScaleScan(Buf, SrcWidth, 1, SrcWidth*DestHeight, DestHeight,
+    /* Scale the image vertically, keeping only rows RoiY to RoiY + RoiHeight */
+    if(!FourierScaleScan(Buf, SrcWidth, 1, SrcWidth*RoiHeight, DestHeight,
+        RoiY, RoiHeight,
         Src, SrcWidth, 1, SrcWidth*SrcHeight, SrcHeight,
-        SrcWidth, 3, YStart, PsfSigma, Boundary))
+        SrcWidth, NumChannels, YStart, PsfSigma, Boundary))
         goto Catch;
 
-    /* Scale the image horizontally */
-    if(!FourierScaleScan(Dest, 1, DestWidth, DestWidth*DestHeight, DestWidth,
-        Buf, 1, SrcWidth, SrcWidth*DestHeight, SrcWidth,
-        DestHeight, 3, XStart, PsfSigma, Boundary))
+    /* Scale the kept rows horizontally */
+    if(!FourierScaleScan(Dest, 1, RoiWidth, RoiWidth*RoiHeight, DestWidth,
+        RoiX, RoiWidth,
+        Buf, 1, SrcWidth, SrcWidth*RoiHeight, SrcWidth,
+        RoiHeight, NumChannels, XStart, PsfSigma, Boundary))
         goto Catch;
 
-    StopTime = Clock();
-    printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
-
     Success = 1;
 Catch:
     Free(Buf);
@@ -16,6 +16,9 @@
 #ifndef _LINTERP_H_
 #define _LINTERP_H_
 
+#include "imageview.h"
+
+/** @brief Boundary handling (values agree with padmethod in padimage.h) */
 typedef enum
 {
     BOUNDARY_CONSTANT = 0,
@@ -29,11 +32,28 @@ int LinScale2d(float *Dest, int DestWidth, float XStart, float XStep,
     float (*Kernel)(float), float KernelRadius, int KernelNormalize,
     boundaryhandling Boundary);
 
+int LinScale2dRoi(float *Dest, int RoiX, int RoiY, int RoiWidth, int RoiHeight,
+    float XStart, float XStep, float YStart, float YStep,
+    const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
+    float (*Kernel)(float), float KernelRadius, int KernelNormalize,
+    boundaryhandling Boundary);
+
+int LinScale2dView(imageview Dest, int RoiX, int RoiY,
+    float XStart, float XStep, float YStart, float YStep, imageview Src,
+    float (*Kernel)(float), float KernelRadius, int KernelNormalize,
+    boundaryhandling Boundary);
+
 int FourierScale2d(float *Dest, int DestWidth, float XStart,
     int DestHeight, float YStart,
     const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
     double PsfSigma, boundaryhandling Boundary);
 
+int FourierScale2dRoi(float *Dest, int RoiX, int RoiY,
+    int RoiWidth, int RoiHeight, int DestWidth, float XStart,
+    int DestHeight, float YStart,
+    const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
+    double PsfSigma, boundaryhandling Boundary);
+
 int LinInterp2d(float *Dest, const float *Src, int SrcWidth, int SrcHeight,
     float *X, float *Y, int NumSamples,
     float (*Kernel)(float), float KernelRadius, int KernelNormalize,
@@ -71,6 +71,14 @@ typedef struct
     char *Method;
     /** @brief Gaussian point spread function standard deviation */
     float PsfSigma;
+    /** @brief Left edge of the output region to compute */
+    int RoiX;
+    /** @brief Top edge of the output region to compute */
+    int RoiY;
+    /** @brief Width of the output region, or 0 to compute the full output */
+    int RoiWidth;
+    /** @brief Height of the output region */
+    int RoiHeight;
 } programparams;
 
 
@@ -111,7 +119,9 @@ static void PrintHelpMessage()
     printf("                wsym         whole-sample symmetric\n");
     printf("   -g <grid>    grid to use for resampling, choices for <grid> are\n"
            "                centered     grid with centered alignment (default)\n"
-           "                topleft      the top-left anchored grid\n\n");
+           "                topleft      the top-left anchored grid\n");
+    printf("   -c <x>,<y>,<width>x<height>  compute only this region of the\n"
+           "                interpolated image (not supported with -r)\n\n");
 #ifdef USE_LIBJPEG
     printf("   -q <number>  quality for saving JPEG images (0 to 100)\n\n");
 #endif
@@ -185,8 +195,16 @@ imagef ScaleRotateImage(imagef v, programparams Param)
 
     if(Theta == 0)  /* Scaling without rotation */
     {
-        u.Width = Param.InterpWidth;
-        u.Height = Param.InterpHeight;
+        if(Param.RoiWidth)
+        {
+            u.Width = Param.RoiWidth;
+            u.Height = Param.RoiHeight;
+        }
+        else
+        {
+            u.Width = Param.InterpWidth;
+            u.Height = Param.InterpHeight;
+        }
 
 #if VERBOSE > 0
         printf("Scaling %dx%d -> %dx%d\n",
@@ -207,8 +225,9 @@ imagef ScaleRotateImage(imagef v, programparams Param)
         else
             XStart = YStart = 0;
 
-        if(!LinScale2d(u.Data, u.Width, XStart, XStep, u.Height, YStart, YStep,
-            v.Data, v.Width, v.Height, 3, Method->Kernel, Method->KernelRadius,
+        if(!LinScale2dRoi(u.Data, Param.RoiX, Param.RoiY, u.Width, u.Height,
+            XStart, XStep, YStart, YStep, v.Data, v.Width, v.Height, 3,
+            Method->Kernel, Method->KernelRadius,
             Method->KernelNormalize, Param.Boundary))
             goto Catch;
     }
@@ -279,6 +298,18 @@ int main(int argc, char *argv[])
 
     if(!ParseScaling(&Param, v.Width, v.Height))
         goto Catch;
+    else if(Param.RoiWidth && (Param.RoiX + Param.RoiWidth > Param.InterpWidth
+        || Param.RoiY + Param.RoiHeight > Param.InterpHeight))
+    {
+        fprintf(stderr, "Region exceeds the interpolated image (%dx%d).\n",
+            Param.InterpWidth, Param.InterpHeight);
+        goto Catch;
+    }
+    else if(Param.RoiWidth && Param.Rotation != 0)
+    {
+        fprintf(stderr, "Region selection is not supported with rotation.\n");
+        goto Catch;
+    }
 
     StartTime = Clock();
 
@@ -298,8 +329,16 @@ int main(int argc, char *argv[])
             goto Catch;
         }
 
-        u.Width = Param.InterpWidth;
-        u.Height = Param.InterpHeight;
+        if(Param.RoiWidth)
+        {
+            u.Width = Param.RoiWidth;
+            u.Height = Param.RoiHeight;
+        }
+        else
+        {
+            u.Width = Param.InterpWidth;
+            u.Height = Param.InterpHeight;
+        }
 
 #if VERBOSE > 0
         printf("Fourier scaling %dx%d -> %dx%d\n",
@@ -311,13 +350,15 @@ int main(int argc, char *argv[])
 
         if(Param.CenteredGrid)
         {
-            XStart = v.Width/(2.0f*u.Width) - 0.5f;
-            YStart = v.Height/(2.0f*u.Height) - 0.5f;
+            XStart = v.Width/(2.0f*Param.InterpWidth) - 0.5f;
+            YStart = v.Height/(2.0f*Param.InterpHeight) - 0.5f;
         }
         else
             XStart = YStart = 0;
 
-        if(!FourierScale2d(u.Data, u.Width, XStart, u.Height, YStart,
+        if(!FourierScale2dRoi(u.Data, Param.RoiX, Param.RoiY,
+            u.Width, u.Height, Param.InterpWidth, XStart,
+            Param.InterpHeight, YStart,
             v.Data, v.Width, v.Height, 3, Param.PsfSigma, Param.Boundary))
             goto Catch;
     }
@@ -368,6 +409,8 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->Method = (char *)"bspline3";
     Param->PsfSigma = 0;
     Param->JpegQuality = 80;
+    Param->RoiX = Param->RoiY = 0;
+    Param->RoiWidth = Param->RoiHeight = 0;
 
     for(i = 1; i < argc;)
     {
@@ -420,6 +463,16 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
             case 'x':
                 Param->ScaleStr = OptionString;
                 break;
+            case 'c':
+                if(sscanf(OptionString, "%d,%d,%dx%d", &Param->RoiX,
+                    &Param->RoiY, &Param->RoiWidth, &Param->RoiHeight) != 4
+                    || Param->RoiX < 0 || Param->RoiY < 0
+                    || Param->RoiWidth <= 0 || Param->RoiHeight <= 0)
+                {
+                    fprintf(stderr, "Invalid region \"%s\".\n", OptionString);
+                    return 0;
+                }
+                break;
             case 'r':
                 Param->Rotation = atof(OptionString);
                 break;
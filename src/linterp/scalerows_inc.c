@@ -0,0 +1,60 @@
+/**
+ * @file scalerows_inc.c
+ * @brief Row kernel of the vertical scanline filter
+ *
+ * This file is included by linterp.c once for each instruction set level,
+ * with SCALEROWS_FUNC defined as the name of the function to define and
+ * SCALEROWS_ISA as the target, or not defined for the baseline.  The
+ * inner loops are simple enough that the compiler vectorizes them for
+ * each target.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * @brief Weighted sum of consecutive source rows
+ * @param Dest output row of Width samples, contiguous
+ * @param Src first source row
+ * @param SrcPixelStride step between samples in a source row
+ * @param SrcRowStride step between source rows
+ * @param Width number of samples
+ * @param Coeff the FilterWidth weights
+ * @param FilterWidth number of rows to sum
+ *
+ * Each sample is summed in the same order as in ScaleScan.  With the -ansi
+ * build, where the compiler does not contract multiplies and adds into
+ * fused multiply-adds, the result is then the same for every instruction
+ * set.
+ */
+static
+#ifdef SCALEROWS_ISA
+ATTRIBUTE_TARGET(SCALEROWS_ISA)
+#endif
+void SCALEROWS_FUNC(float *Dest, const float *Src,
+    int SrcPixelStride, int SrcRowStride, int Width,
+    const float *Coeff, int FilterWidth)
+{
+    const float *SrcRow;
+    float c;
+    int x, k;
+    
+    
+    for(x = 0; x < Width; x++)
+        Dest[x] = 0;
+    
+    for(k = 0, SrcRow = Src; k < FilterWidth; k++, SrcRow += SrcRowStride)
+    {
+        c = Coeff[k];
+        
+        if(SrcPixelStride == 1)
+            for(x = 0; x < Width; x++)
+                Dest[x] += c * SrcRow[x];
+        else
+            for(x = 0; x < Width; x++)
+                Dest[x] += c * SrcRow[SrcPixelStride*x];
+    }
+}
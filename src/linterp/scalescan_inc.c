@@ -0,0 +1,67 @@
+/**
+ * @file scalescan_inc.c
+ * @brief Block kernel of the horizontal scanline filter
+ *
+ * This file is included by linterp.c once for each instruction set level,
+ * with SCALESCAN_FUNC defined as the name of the function to define and
+ * SCALESCAN_ISA as the target, or not defined for the baseline.  The
+ * inner loop runs across SCALESCAN_BLOCK rows, so that the compiler
+ * vectorizes it for each target.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * @brief Horizontally filter a block of rows
+ * @param Dest first output sample of the block
+ * @param DestPixelStride step between output samples in a row
+ * @param DestRowStride step between output rows
+ * @param DestWidth number of output samples per row
+ * @param NumRows number of rows to output, at most SCALESCAN_BLOCK
+ * @param BufT the source rows, transposed so that sample x of row y is
+ *        BufT[SCALESCAN_BLOCK*x + y]
+ * @param Coeff the DestWidth x FilterWidth filter weights
+ * @param Pos index of the first tap of each output sample
+ * @param FilterWidth number of taps
+ *
+ * Each sample is summed in the same order as a direct dot product along
+ * the row.  With the -ansi build, where the compiler does not contract
+ * multiplies and adds into fused multiply-adds, the result is then the
+ * same for every instruction set.
+ */
+static
+#ifdef SCALESCAN_ISA
+ATTRIBUTE_TARGET(SCALESCAN_ISA)
+#endif
+void SCALESCAN_FUNC(float *Dest, int DestPixelStride, int DestRowStride,
+    int DestWidth, int NumRows, const float *BufT,
+    const float *Coeff, const int16_t *Pos, int FilterWidth)
+{
+    const float *Src;
+    float Sum[SCALESCAN_BLOCK], c;
+    int x, y, k;
+
+
+    for(x = 0; x < DestWidth;
+        x++, Dest += DestPixelStride, Coeff += FilterWidth)
+    {
+        for(y = 0; y < SCALESCAN_BLOCK; y++)
+            Sum[y] = 0;
+
+        for(k = 0, Src = BufT + SCALESCAN_BLOCK*Pos[x]; k < FilterWidth;
+            k++, Src += SCALESCAN_BLOCK)
+        {
+            c = Coeff[k];
+
+            for(y = 0; y < SCALESCAN_BLOCK; y++)
+                Sum[y] += c * Src[y];
+        }
+
+        for(y = 0; y < NumRows; y++)
+            Dest[DestRowStride*y] = Sum[y];
+    }
+}
@@ -0,0 +1,187 @@
+/**
+ * @file padimage.c
+ * @brief Images with a materialized boundary halo
+ *
+ * Boundary handling inside filtering loops is usually done per tap, by
+ * mapping each out-of-range index back into the image through an extension
+ * function.  This file instead extends the image once into a halo that is
+ * wide enough for the filter, so that the filtering loops can index the
+ * padded image directly.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include <string.h>
+#include <ipol/basic.h>
+#include "padimage.h"
+
+
+/**
+ * @brief Map an index into [0, N - 1] according to a boundary extension
+ * @param N is the data length
+ * @param i is an index into the data
+ * @param Method the boundary extension
+ * @return an index that is always between 0 and N - 1
+ */
+int PadExtension(int N, int i, padmethod Method)
+{
+    switch(Method)
+    {
+    case PAD_HSYMMETRIC:
+        while(1)
+        {
+            if(i < 0)
+                i = -1 - i;
+            else if(i >= N)
+                i = (2*N - 1) - i;
+            else
+                return i;
+        }
+    case PAD_WSYMMETRIC:
+        if(N == 1)
+            return 0;
+
+        while(1)
+        {
+            if(i < 0)
+                i = -i;
+            else if(i >= N)
+                i = (2*N - 2) - i;
+            else
+                return i;
+        }
+    case PAD_PERIODIC:
+        i %= N;
+        return (i < 0) ? (i + N) : i;
+    default:
+        return (i < 0) ? 0 : ((i >= N) ? (N - 1) : i);
+    }
+}
+
+
+/**
+ * @brief Allocate a padded image
+ * @param Image the padded image
+ * @param Width, Height, NumChannels image dimensions
+ * @param Pad halo width in pixels
+ * @return 1 on success, 0 on failure.
+ *
+ * Neither the image nor the halo is initialized.  Write the image through
+ * PADPIXEL, then call \c FillPadding to extend it into the halo.
+ */
+int AllocPaddedImage(paddedimage *Image,
+    int Width, int Height, int NumChannels, int Pad)
+{
+    Image->Data = Image->Base = NULL;
+    Image->Width = Image->Height = Image->NumChannels = 0;
+    Image->Pad = Image->Stride = 0;
+
+    if(Width <= 0 || Height <= 0 || NumChannels <= 0 || Pad < 0)
+        return 0;
+
+    Image->Stride = NumChannels*(Width + 2*Pad);
+
+    if(!(Image->Base = (float *)Malloc(sizeof(float)
+        *Image->Stride*(Height + 2*Pad))))
+        return 0;
+
+    Image->Width = Width;
+    Image->Height = Height;
+    Image->NumChannels = NumChannels;
+    Image->Pad = Pad;
+    Image->Data = Image->Base + Image->Stride*Pad + NumChannels*Pad;
+    return 1;
+}
+
+
+/** @brief Free the memory of a padded image */
+void FreePaddedImage(paddedimage *Image)
+{
+    Free(Image->Base);
+    Image->Data = Image->Base = NULL;
+}
+
+
+/**
+ * @brief Extend a padded image into its halo
+ * @param Image the padded image
+ * @param Method the boundary extension
+ *
+ * The halo columns of each image row are filled first, then the halo rows are
+ * filled by copying whole padded rows, so that the corners are the separable
+ * extension of the image.
+ */
+void FillPadding(paddedimage Image, padmethod Method)
+{
+    const int NumChannels = Image.NumChannels;
+    const size_t RowSize = sizeof(float)*Image.Stride;
+    float *Row;
+    int x, y, c, i;
+
+
+    for(y = 0; y < Image.Height; y++)
+    {
+        Row = PADPIXEL(Image, 0, y);
+
+        for(x = -Image.Pad; x < 0; x++)
+        {
+            i = NumChannels*PadExtension(Image.Width, x, Method);
+
+            for(c = 0; c < NumChannels; c++)
+                Row[NumChannels*x + c] = Row[i + c];
+        }
+
+        for(x = Image.Width; x < Image.Width + Image.Pad; x++)
+        {
+            i = NumChannels*PadExtension(Image.Width, x, Method);
+
+            for(c = 0; c < NumChannels; c++)
+                Row[NumChannels*x + c] = Row[i + c];
+        }
+    }
+
+    for(y = -Image.Pad; y < 0; y++)
+        memcpy(PADPIXEL(Image, -Image.Pad, y),
+            PADPIXEL(Image, -Image.Pad,
+            PadExtension(Image.Height, y, Method)), RowSize);
+
+    for(y = Image.Height; y < Image.Height + Image.Pad; y++)
+        memcpy(PADPIXEL(Image, -Image.Pad, y),
+            PADPIXEL(Image, -Image.Pad,
+            PadExtension(Image.Height, y, Method)), RowSize);
+}
+
+
+/**
+ * @brief Make a padded copy of an image
+ * @param Image the padded image to create
+ * @param Src the input image with interleaved channels in row-major order
+ * @param Width, Height, NumChannels image dimensions
+ * @param Pad halo width in pixels
+ * @param Method the boundary extension
+ * @return 1 on success, 0 on failure.
+ *
+ * It is the responsibility of the caller to call \c FreePaddedImage when
+ * done.
+ */
+int MakePaddedImage(paddedimage *Image, const float *Src,
+    int Width, int Height, int NumChannels, int Pad, padmethod Method)
+{
+    const int RowNumEl = NumChannels*Width;
+    int y;
+
+
+    if(!Src || !AllocPaddedImage(Image, Width, Height, NumChannels, Pad))
+        return 0;
+
+    for(y = 0; y < Height; y++)
+        memcpy(PADPIXEL(*Image, 0, y), Src + RowNumEl*y,
+            sizeof(float)*RowNumEl);
+
+    FillPadding(*Image, Method);
+    return 1;
+}
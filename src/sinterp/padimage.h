@@ -0,0 +1,64 @@
+/**
+ * @file padimage.h
+ * @brief Images with a materialized boundary halo
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#ifndef _PADIMAGE_H_
+#define _PADIMAGE_H_
+
+/** @brief Boundary extensions for filling the halo of a padded image */
+typedef enum
+{
+    PAD_CONSTANT = 0,
+    PAD_HSYMMETRIC = 1,
+    PAD_WSYMMETRIC = 2,
+    PAD_PERIODIC = 3
+} padmethod;
+
+/**
+ * @brief struct representing an image padded with a boundary halo
+ *
+ * The image has Width by Height pixels with NumChannels interleaved channels
+ * per pixel, surrounded by a halo of Pad pixels on each side.  Data points to
+ * the first channel of pixel (0,0), so that channel c of pixel (x,y) is
+ *     Data[c + NumChannels*x + Stride*y]
+ * for -Pad <= x < Width + Pad and -Pad <= y < Height + Pad.  Inner loops can
+ * then index the halo directly without any boundary handling.
+ */
+typedef struct
+{
+    /** @brief Pointer to pixel (0,0) */
+    float *Data;
+    /** @brief Pointer to the allocated memory block */
+    float *Base;
+    /** @brief Image width, not including the halo */
+    int Width;
+    /** @brief Image height, not including the halo */
+    int Height;
+    /** @brief Number of interleaved channels */
+    int NumChannels;
+    /** @brief Halo width in pixels */
+    int Pad;
+    /** @brief Number of floats between successive rows */
+    int Stride;
+} paddedimage;
+
+int AllocPaddedImage(paddedimage *Image,
+    int Width, int Height, int NumChannels, int Pad);
+void FreePaddedImage(paddedimage *Image);
+int MakePaddedImage(paddedimage *Image, const float *Src,
+    int Width, int Height, int NumChannels, int Pad, padmethod Method);
+void FillPadding(paddedimage Image, padmethod Method);
+int PadExtension(int N, int i, padmethod Method);
+
+/** @brief Pointer to the first channel of pixel (x,y) of a padded image */
+#define PADPIXEL(Image, x, y) \
+    ((Image).Data + (Image).NumChannels*(x) + (Image).Stride*(y))
+
+#endif /* _PADIMAGE_H_ */
@@ -8,7 +8,8 @@
  *  - NewSInterp() to compute data to use a stencil set for interpolation,
  *  - Prefilter() to perform iterative refinement,
  *  - IntegerScalePass() for interpolation by an integer scale factor,
- *  - ArbitraryScale() for interpolation by a non-integer scale factor.
+ *  - ArbitraryScale() for interpolation by a non-integer scale factor,
+ *  - ClassifyTiles() to restrict ArbitraryScale() to edge tiles.
  *
  *
  * Copyright (c) 2010-2011, Pascal Getreuer
@@ -22,6 +23,7 @@
 
 #include <string.h>
 #include "invmat.h"
+#include "padimage.h"
 #include "sinterp.h"
 
 
@@ -44,6 +46,9 @@
 /** @brief Number of neighbors in the neighborhood, \f$|\mathcal{N}|\f$ */
 #define NUMNEIGH                (NEIGHDIAMETER*NEIGHDIAMETER)
 
+/** @brief Tile size in input pixels used by ClassifyTiles() */
+#define HYBRID_TILESIZE         8
+
 
 /** @brief Data for interpolating with a contour stencil */
 typedef struct
@@ -146,6 +151,20 @@ static float Window(float x)
 }
 
 
+/** @brief Keys cubic convolution kernel with a = -0.5 */
+static float CubicKernel(float x)
+{
+    x = (float)fabs(x);
+    
+    if(x < 1)
+        return (1.5f*x - 2.5f)*x*x + 1;
+    else if(x < 2)
+        return ((-0.5f*x + 2.5f)*x - 4)*x + 2;
+    else
+        return 0;
+}
+
+
 /**
  * @brief Compute interpolation information for a stencil
  * @param SInterp stencil set interpolation data
@@ -374,6 +393,9 @@ static int ConstExtension(int N, int i)
  * @param InputWidth, InputHeight dimensions of the input image
  * @param ScaleFactor scale factor between input and output images
  * @param CenteredGrid use centered grid if nonzero or top-left otherwise
+ * @param IsEdge edge classification from ClassifyTiles(), or NULL
+ * @param Workspace array with space for ArbitraryScaleWorkspaceSize()
+ *        floats, or NULL to allocate the workspace internally
  * @return 1 on success, 0 on failure
  *
  * This routine implements for a possibly non-integer scale factor the
@@ -396,26 +418,57 @@ static int ConstExtension(int N, int i)
  *
  * For computational efficiency, RhoFast() is used to evaluate \f$\rho\f$
  * instead of Rho(), as \f$\rho\f$ needs to be evaluated here many times.
+ *
+ * If IsEdge is not NULL, the bracketed local reconstruction is only computed
+ * for pixels k with IsEdge[k] nonzero.  For the other pixels it is replaced
+ * by the cubic convolution interpolation \f$\tilde v(x)\f$ of the input,
+ * \f[ u(x) = \sum_{k\,\mathrm{edge}} w(x-k) \bigl[ \cdots \bigr]
+ *     + \sum_{k\,\mathrm{flat}} w(x-k) \, \tilde v(x), \f]
+ * so that the two methods are blended by the window without seams.
+ *
+ * The coefficients and the padded copy of the input are carved from
+ * Workspace, so that a caller scaling many images can allocate it once and
+ * reuse it.  Its contents on entry do not matter and are overwritten.
  */
 int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
     const int *Stencil, const sinterp *SInterp,
     const float *Input, int InputWidth, int InputHeight,
-    float ScaleFactor, int CenteredGrid)
+    float ScaleFactor, int CenteredGrid, const unsigned char *IsEdge,
+    float *Workspace)
 {
-    int (*Extension)(int, int) = ConstExtension;
     const int InputNumEl = 3*InputWidth*InputHeight;
-    float *Coeff = NULL;
-    const float *Matrix, *CoeffPtr;
+    paddedimage PaddedInput;
+    float *Coeff, *OwnWorkspace = NULL;
+    const float *Matrix, *CoeffPtr, *Neigh;
     float u[3], uk[3], v[3], c[3*(NUMNEIGH + 1)], X, Y, Weight, DenomSum;
     float WindowWeightX[2*WINDOWRADIUS], WindowWeightY[2*WINDOWRADIUS];
-    float XStart, YStart, Xp, Yp, WindowWeight;
+    float CubicWeightX[2*WINDOWRADIUS], CubicWeightY[2*WINDOWRADIUS];
+    float XStart, YStart, Xp, Yp, WindowWeight, FlatWeight;
     float RhoSigmaTangent, RhoSigmaNormal;
     int i, ix, iy, k, x, y, m, n, mx, my, nx, ny, S, Success = 0;
     
     
-    if(!(Coeff = (float *)Malloc(sizeof(float)*(NUMNEIGH + 1)*InputNumEl)))
+    if(!Workspace && !(Workspace = OwnWorkspace = (float *)Malloc(
+        sizeof(float)*ArbitraryScaleWorkspaceSize(InputWidth, InputHeight))))
         goto Catch;
     
+    /* Partition the workspace into Coeff and the padded input */
+    Coeff = Workspace;
+    PaddedInput.Width = InputWidth;
+    PaddedInput.Height = InputHeight;
+    PaddedInput.NumChannels = 3;
+    PaddedInput.Pad = NEIGHRADIUS;
+    PaddedInput.Stride = 3*(InputWidth + 2*NEIGHRADIUS);
+    PaddedInput.Base = Coeff + (NUMNEIGH + 1)*InputNumEl;
+    PaddedInput.Data = PaddedInput.Base
+        + PaddedInput.Stride*NEIGHRADIUS + 3*NEIGHRADIUS;
+    
+    for(y = 0; y < InputHeight; y++)
+        memcpy(PADPIXEL(PaddedInput, 0, y), Input + 3*InputWidth*y,
+            sizeof(float)*3*InputWidth);
+    
+    FillPadding(PaddedInput, PAD_CONSTANT);
+    
     if(CenteredGrid)
     {
         XStart = (1/ScaleFactor - 1
@@ -433,6 +486,9 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
     for(y = 0, k = 0; y < InputHeight; y++)
         for(x = 0; x < InputWidth; x++, k++)
         {
+            if(IsEdge && !IsEdge[k])
+                continue;
+            
             S = Stencil[x + InputWidth*y];
             Matrix = SInterp->StencilInterp[S].Matrix;
             c[0] = Input[3*k + 0];
@@ -447,11 +503,10 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
                 {
                     if(nx != 0 || ny != 0)
                     {
-                        i = 3*(Extension(InputWidth, x + nx)
-                            + InputWidth*Extension(InputHeight, y - ny));
-                        v[0] = Input[i + 0] - c[0];
-                        v[1] = Input[i + 1] - c[1];
-                        v[2] = Input[i + 2] - c[2];
+                        Neigh = PADPIXEL(PaddedInput, x + nx, y - ny);
+                        v[0] = Neigh[0] - c[0];
+                        v[1] = Neigh[1] - c[1];
+                        v[2] = Neigh[2] - c[2];
                         
                         /* Compute c_m^k */
                         for(m = 0; m < NUMNEIGH; m++)
@@ -477,6 +532,9 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
         for(n = 0; n < 2*WINDOWRADIUS; n++)
                 WindowWeightY[n] = Window(Y - iy - n);
         
+        for(n = 0; n < 2*WINDOWRADIUS; n++)
+                CubicWeightY[n] = CubicKernel(Y - iy - n);
+        
         for(x = 0; x < OutputWidth; x++, k += 3)
         {
             X = XStart + x/ScaleFactor;
@@ -485,7 +543,7 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
             for(n = 0; n < 2*WINDOWRADIUS; n++)
                 WindowWeightX[n] = Window(X - ix - n);
             
-            DenomSum = 0;
+            DenomSum = FlatWeight = 0;
             u[0] = u[1] = u[2] = 0;
             
             for(my = 0; my < 2*WINDOWRADIUS; my++)
@@ -501,6 +559,15 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
                     if((ix + mx) < 0 || (ix + mx) >= InputWidth)
                         continue;
                     
+                    WindowWeight = WindowWeightX[mx] * WindowWeightY[my];
+                    DenomSum += WindowWeight;
+                    
+                    if(IsEdge && !IsEdge[i])
+                    {
+                        FlatWeight += WindowWeight;
+                        continue;
+                    }
+                    
                     Xp = X - (ix + mx);
                     CoeffPtr = Coeff + i*3*(NUMNEIGH + 1);
                     S = Stencil[i];
@@ -521,13 +588,29 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
                             uk[2] += CoeffPtr[3*(n + 1) + 2] * Weight;
                         }
                     
-                    WindowWeight = WindowWeightX[mx] * WindowWeightY[my];
-                    DenomSum += WindowWeight;
                     u[0] += WindowWeight * uk[0];
                     u[1] += WindowWeight * uk[1];
                     u[2] += WindowWeight * uk[2];
                 }
             }
+            
+            if(FlatWeight > 0)
+            {   /* Add the cubic interpolation weighted by the flat pixels */
+                for(n = 0; n < 2*WINDOWRADIUS; n++)
+                    CubicWeightX[n] = CubicKernel(X - ix - n);
+                
+                for(my = 0; my < 2*WINDOWRADIUS; my++)
+                    for(mx = 0; mx < 2*WINDOWRADIUS; mx++)
+                    {
+                        Neigh = Input + 3*(ConstExtension(InputWidth, ix + mx)
+                            + InputWidth*ConstExtension(InputHeight, iy + my));
+                        Weight = FlatWeight
+                            * CubicWeightX[mx] * CubicWeightY[my];
+                        u[0] += Weight * Neigh[0];
+                        u[1] += Weight * Neigh[1];
+                        u[2] += Weight * Neigh[2];
+                    }
+            }
                 
             Output[k + 0] = u[0] / DenomSum;
             Output[k + 1] = u[1] / DenomSum;
@@ -537,11 +620,93 @@ int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
       
     Success = 1;
 Catch:
-    Free(Coeff);
+    Free(OwnWorkspace);
     return Success;
 }
 
 
+/**
+ * @brief Workspace size needed for ArbitraryScale()
+ * @param InputWidth, InputHeight dimensions of the input image
+ * @return required workspace size in units of floats
+ *
+ * The workspace is also large enough for any smaller input image.
+ */
+long ArbitraryScaleWorkspaceSize(int InputWidth, int InputHeight)
+{
+    /* Coeff, padded input */
+    return 3*(NUMNEIGH + 1)*((long)InputWidth)*((long)InputHeight)
+        + 3*((long)InputWidth + 2*NEIGHRADIUS)
+        *((long)InputHeight + 2*NEIGHRADIUS);
+}
+
+
+/**
+ * @brief Classify input tiles as edge or flat
+ * @param IsEdge array of size InputWidth by InputHeight to be filled with
+ *        the classification of each pixel
+ * @param Input the input image in row-major interleaved order
+ * @param InputWidth, InputHeight dimensions of the input image
+ * @param Threshold threshold on the differences between adjacent pixels
+ * @return fraction of pixels classified as edge
+ *
+ * The image is divided into tiles of HYBRID_TILESIZE x HYBRID_TILESIZE
+ * pixels.  A tile is edge if the absolute difference between horizontally or
+ * vertically adjacent pixels within the tile or within WINDOWRADIUS pixels
+ * of the tile exceeds Threshold in some channel.  The result is used by
+ * ArbitraryScale() to apply contour stencil interpolation only near
+ * contours.
+ */
+double ClassifyTiles(unsigned char *IsEdge, const float *Input,
+    int InputWidth, int InputHeight, float Threshold)
+{
+    const int Margin = WINDOWRADIUS;
+    const int Stride = 3*InputWidth;
+    const float *Ptr;
+    long NumEdge = 0;
+    int x, y, tx, ty, x1, x2, y1, y2, c, Edge;
+    
+    
+    for(ty = 0; ty < InputHeight; ty += HYBRID_TILESIZE)
+        for(tx = 0; tx < InputWidth; tx += HYBRID_TILESIZE)
+        {
+            x1 = (tx - Margin > 0) ? tx - Margin : 0;
+            y1 = (ty - Margin > 0) ? ty - Margin : 0;
+            x2 = (tx + HYBRID_TILESIZE + Margin < InputWidth) ?
+                tx + HYBRID_TILESIZE + Margin : InputWidth;
+            y2 = (ty + HYBRID_TILESIZE + Margin < InputHeight) ?
+                ty + HYBRID_TILESIZE + Margin : InputHeight;
+            
+            for(y = y1, Edge = 0; y < y2 && !Edge; y++)
+                for(x = x1; x < x2 && !Edge; x++)
+                {
+                    Ptr = Input + 3*x + Stride*y;
+                    
+                    for(c = 0; c < 3; c++)
+                        if((x < x2 - 1
+                            && fabs(Ptr[c + 3] - Ptr[c]) > Threshold)
+                            || (y < y2 - 1
+                            && fabs(Ptr[c + Stride] - Ptr[c]) > Threshold))
+                            Edge = 1;
+                }
+            
+            x2 = (tx + HYBRID_TILESIZE < InputWidth) ?
+                tx + HYBRID_TILESIZE : InputWidth;
+            y2 = (ty + HYBRID_TILESIZE < InputHeight) ?
+                ty + HYBRID_TILESIZE : InputHeight;
+            
+            for(y = ty; y < y2; y++)
+                for(x = tx; x < x2; x++)
+                    IsEdge[x + InputWidth*y] = (unsigned char)Edge;
+            
+            if(Edge)
+                NumEdge += ((long)(x2 - tx))*((long)(y2 - ty));
+        }
+    
+    return NumEdge / (((double)InputWidth)*((double)InputHeight));
+}
+
+
 /**
  * @brief Precompute samples of \f$\Tilde\rho\f$ for an integer scale factor
  * @param SInterp stencil interpolation data
@@ -882,26 +1047,19 @@ float DeconvResidual(float *Residual,
     const float *Interp, int InterpWidth, int InterpHeight,
     float ScaleFactor, int CenteredGrid, float PsfSigma)
 {
-    /*int (*Extension)(int, int) = ExtensionMethod[Param.Boundary];*/
-    int (*Extension)(int, int) = ConstExtension;
     const int CoarseStride = 3*CoarseWidth;
     const float PsfRadius = 4*PsfSigma*ScaleFactor;
     const int PsfWidth = (int)ceil(2*PsfRadius);
-    float *Temp = NULL, *PsfBuf = NULL;
-    float ExpDenom, Weight, Sum[3], DenomSum, MaxResidual = 0;
+    paddedimage PaddedInterp = {NULL, NULL, 0, 0, 0, 0, 0};
+    paddedimage Temp = {NULL, NULL, 0, 0, 0, 0, 0};
+    float *PsfBuf = NULL;
+    const float *Src;
+    float ExpDenom, Weight, Sum[3], DenomSum, MaxResidual = -1;
     float XStart, YStart, X, Y;
-    int IndexX0, IndexY0, SrcOffset, DestOffset;
-    int x, y, i, n, c;
+    int IndexX0, IndexY0, PadX, PadY;
+    int x, y, n, c;
     
     
-    if(!(Temp = (float *)Malloc(sizeof(float)*3*CoarseWidth*InterpHeight))
-        || !(PsfBuf = (float *)Malloc(sizeof(float)*PsfWidth)))
-    {
-        free(Temp);
-        free(PsfBuf);
-        return -1;
-    }
-    
     if(CenteredGrid)
     {
         XStart = (1/ScaleFactor - 1
@@ -912,6 +1070,25 @@ float DeconvResidual(float *Residual,
     else
         XStart = YStart = 0;
     
+    /* The PSF support moves monotonically with x and y, so the halo needed
+       is determined by the first and last samples. */
+    PadX = -(int)ceil(-XStart*ScaleFactor - PsfRadius);
+    n = (int)ceil((-XStart + CoarseWidth - 1)*ScaleFactor - PsfRadius)
+        + PsfWidth - InterpWidth;
+    PadX = (PadX < n) ? n : PadX;
+    PadX = (PadX < 0) ? 0 : PadX;
+    PadY = -(int)ceil(-YStart*ScaleFactor - PsfRadius);
+    n = (int)ceil((-YStart + CoarseHeight - 1)*ScaleFactor - PsfRadius)
+        + PsfWidth - InterpHeight;
+    PadY = (PadY < n) ? n : PadY;
+    PadY = (PadY < 0) ? 0 : PadY;
+    
+    if(!(PsfBuf = (float *)Malloc(sizeof(float)*PsfWidth))
+        || !MakePaddedImage(&PaddedInterp, Interp, InterpWidth, InterpHeight,
+            3, PadX, PAD_CONSTANT)
+        || !AllocPaddedImage(&Temp, CoarseWidth, InterpHeight, 3, PadY))
+        goto Catch;
+    
     ExpDenom = 2 * Sqr(PsfSigma*ScaleFactor);
     
     for(x = 0; x < CoarseWidth; x++)
@@ -923,26 +1100,28 @@ float DeconvResidual(float *Residual,
         for(n = 0; n < PsfWidth; n++)
             PsfBuf[n] = (float)exp(-Sqr(X - (IndexX0 + n)) / ExpDenom);
         
-        for(y = 0, SrcOffset = 0, DestOffset = 3*x; y < InterpHeight;
-            y++, SrcOffset += InterpWidth, DestOffset += CoarseStride)
+        for(y = 0; y < InterpHeight; y++)
         {
             Sum[0] = Sum[1] = Sum[2] = DenomSum = 0;
+            Src = PADPIXEL(PaddedInterp, IndexX0, y);
             
-            for(n = 0; n < PsfWidth; n++)
+            for(n = 0; n < PsfWidth; n++, Src += 3)
             {
                 Weight = PsfBuf[n];
                 DenomSum += Weight;
-                i = 3*(Extension(InterpWidth, IndexX0 + n) + SrcOffset);
                 
                 for(c = 0; c < 3; c++)
-                    Sum[c] += Weight * Interp[i + c];
+                    Sum[c] += Weight * Src[c];
             }
             
             for(c = 0; c < 3; c++)
-                Temp[DestOffset + c] = Sum[c] / DenomSum;
+                PADPIXEL(Temp, x, y)[c] = Sum[c] / DenomSum;
         }
     }
     
+    FillPadding(Temp, PAD_CONSTANT);
+    MaxResidual = 0;
+    
     for(y = 0; y < CoarseHeight; y++,
         Residual += CoarseStride, Coarse += CoarseStride)
     {
@@ -956,15 +1135,15 @@ float DeconvResidual(float *Residual,
         for(x = 0; x < CoarseStride; x += 3)
         {
             Sum[0] = Sum[1] = Sum[2] = DenomSum = 0;
+            Src = PADPIXEL(Temp, 0, IndexY0) + x;
             
-            for(n = 0; n < PsfWidth; n++)
+            for(n = 0; n < PsfWidth; n++, Src += Temp.Stride)
             {
-                SrcOffset = x + CoarseStride*Extension(InterpHeight, IndexY0 + n);
                 Weight = PsfBuf[n];
                 DenomSum += Weight;
                 
                 for(c = 0; c < 3; c++)
-                    Sum[c] += Weight * Temp[SrcOffset + c];
+                    Sum[c] += Weight * Src[c];
             }
             
             for(c = 0; c < 3; c++)
@@ -977,8 +1156,10 @@ float DeconvResidual(float *Residual,
         }
     }
     
+Catch:
+    FreePaddedImage(&Temp);
+    FreePaddedImage(&PaddedInterp);
     Free(PsfBuf);
-    Free(Temp);
     return MaxResidual;
 }
 
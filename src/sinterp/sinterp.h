@@ -49,6 +49,11 @@ void IntegerScalePass(float *Output,
 int ArbitraryScale(float *Output, int OutputWidth, int OutputHeight,
     const int *Stencil, const sinterp *SInterp,
     const float *Input, int InputWidth, int InputHeight,
-    float ScaleFactor, int CenteredGrid);
+    float ScaleFactor, int CenteredGrid, const unsigned char *IsEdge,
+    float *Workspace);
+long ArbitraryScaleWorkspaceSize(int InputWidth, int InputHeight);
+
+double ClassifyTiles(unsigned char *IsEdge, const float *Input,
+    int InputWidth, int InputHeight, float Threshold);
 
 #endif /* _SINTERP_H_ */
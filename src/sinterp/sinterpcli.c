@@ -79,6 +79,8 @@ typedef struct
     double RhoSigmaTangent;
     /** @brief Method number of refinement passes */
     int RefinementPasses;
+    /** @brief Edge threshold for hybrid interpolation, or 0 to disable */
+    double EdgeThreshold;
 } programparams;
 
 
@@ -100,7 +102,10 @@ static void PrintHelpMessage()
     printf("   -s           show the estimated contours instead of interpolating\n\n");
     printf("   -t <number>  sigma_tau, spread of rho in the tagential direction\n");
     printf("   -n <number>  sigma_nu, spread of rho in the normal direction\n");
-    printf("   -r <number>  the number of refinement passes\n\n");
+    printf("   -r <number>  the number of refinement passes\n");
+    printf("   -e <number>  edge threshold in [0,255] for hybrid interpolation,\n"
+           "                flat tiles use cubic interpolation (0 disables, default),\n"
+           "                only for non-integer scale factors\n\n");
 #ifdef USE_LIBJPEG
     printf("   -q <number>  quality for saving JPEG images (0 to 100)\n\n");
 #endif
@@ -205,8 +210,10 @@ int Interpolate(programparams Param, const sset *StencilSet)
     float *Input = NULL, *Filtered = NULL, *Output = NULL;
     float *FilterRhoSamples = NULL, *RhoSamples = NULL;
     int *BestStencil = NULL;
+    unsigned char *IsEdge = NULL;
     unsigned long StartTime0, StartTime;
     int IntegerScaleFactor = (int)(Param.ScaleFactor + 0.5);
+    double EdgeFraction;
     int InputWidth, InputHeight, OutputWidth, OutputHeight, OutputNumEl;
     int i, Success = 1;
 
@@ -264,7 +271,9 @@ int Interpolate(programparams Param, const sset *StencilSet)
         
     if(!(Output = (float *)Malloc(sizeof(float)*3*OutputWidth*OutputHeight))
         || !(Filtered = (float *)Malloc(sizeof(float)*3*InputWidth*InputHeight))
-        || !(BestStencil = (int *)Malloc(sizeof(int)*InputWidth*InputHeight)))
+        || !(BestStencil = (int *)Malloc(sizeof(int)*InputWidth*InputHeight))
+        || (Param.EdgeThreshold > 0 && IntegerScaleFactor != Param.ScaleFactor
+        && !(IsEdge = (unsigned char *)Malloc(InputWidth*InputHeight))))
         goto Catch;
         
     StartTime0 = Clock();
@@ -273,6 +282,16 @@ int Interpolate(programparams Param, const sset *StencilSet)
     StartTime = Clock();
     FitStencils(BestStencil, StencilSet, Input, InputWidth, InputHeight);
     printf("%7.3f s\n", (Clock() - StartTime)*0.001f);
+    
+    if(IsEdge)
+    {
+        printf("Classifying tiles... \t");
+        StartTime = Clock();
+        EdgeFraction = ClassifyTiles(IsEdge, Input, InputWidth, InputHeight,
+            (float)(Param.EdgeThreshold/255));
+        printf("%7.3f s, %.1f%% edge pixels\n", (Clock() - StartTime)*0.001f,
+            100*EdgeFraction);
+    }
         
     if(Param.RefinementPasses)
     {
@@ -308,7 +327,7 @@ int Interpolate(programparams Param, const sset *StencilSet)
         ArbitraryScale(Output, OutputWidth, OutputHeight, BestStencil,
             SInterp, (Param.RefinementPasses) ? Filtered : Input,
             InputWidth, InputHeight, (float)Param.ScaleFactor,
-            Param.CenteredGrid);
+            Param.CenteredGrid, IsEdge, NULL);
     }
     
     printf("%7.3f s\n", (Clock() - StartTime)*0.001f);
@@ -322,6 +341,7 @@ int Interpolate(programparams Param, const sset *StencilSet)
     
     Success = 1;
 Catch:
+    Free(IsEdge);
     Free(Filtered);
     Free(Output);
     Free(BestStencil);
@@ -514,6 +534,7 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->RhoSigmaTangent = DEFAULT_RHO_SIGMA_TANGENT;
     Param->RhoSigmaNormal = DEFAULT_RHO_SIGMA_NORMAL;
     Param->RefinementPasses = DEFAULT_REFINEMENT_PASSES;
+    Param->EdgeThreshold = 0;
 
     for(i = 1; i < argc;)
     {
@@ -600,6 +621,15 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
                     return 0;
                 }
                 break;
+            case 'e':
+                Param->EdgeThreshold = atof(OptionString);
+
+                if(Param->EdgeThreshold < 0.0)
+                {
+                    ErrorMessage("Edge threshold must be nonnegative.\n");
+                    return 0;
+                }
+                break;
             case 's':
                 Param->ShowContours = 1;
                 i--;
@@ -15,6 +15,7 @@
 
 #include <string.h>
 #include "conv.h"
+#include "cpudispatch.h"
 
 
 /** @brief Clamp X to [A, B] */
@@ -25,6 +26,32 @@
 const filter NullFilter = {NULL, 0, 0};
 
 
+/* Instances of the convolution kernel for each instruction set level */
+#define SAMPLEDCONV1D_FUNC  SampledConv1DBaseline
+#include "sampledconv1d_inc.c"
+#undef SAMPLEDCONV1D_FUNC
+
+#ifdef CPUDISPATCH_TARGETS
+#define SAMPLEDCONV1D_FUNC  SampledConv1DSse2
+#define SAMPLEDCONV1D_ISA   "sse2"
+#include "sampledconv1d_inc.c"
+#undef SAMPLEDCONV1D_FUNC
+#undef SAMPLEDCONV1D_ISA
+
+#define SAMPLEDCONV1D_FUNC  SampledConv1DAvx2
+#define SAMPLEDCONV1D_ISA   "avx2"
+#include "sampledconv1d_inc.c"
+#undef SAMPLEDCONV1D_FUNC
+#undef SAMPLEDCONV1D_ISA
+
+#define SAMPLEDCONV1D_FUNC  SampledConv1DAvx512
+#define SAMPLEDCONV1D_ISA   "avx512f"
+#include "sampledconv1d_inc.c"
+#undef SAMPLEDCONV1D_FUNC
+#undef SAMPLEDCONV1D_ISA
+#endif
+
+
 /**
  * @brief (Sub)sampled 1D FIR convolution
  *
@@ -36,74 +63,89 @@ const filter NullFilter = {NULL, 0, 0};
  * @param Boundary boundary extension
  * @param N the length of the convolution
  * @param nStart, nStep, nEnd sample the convolution at nStart:nStep:nEnd
+ *
+ * Dest and Src must not overlap.  The kernel variant for the instruction
+ * set level of the CPU is selected with GetCpuLevel().
  */
 void SampledConv1D(float *Dest, int DestStride, const float *Src,
     int SrcStride, filter Filter, boundaryext Boundary, int N,
     int nStart, int nStep, int nEnd)
 {
-    const int SrcStrideStep = SrcStride*nStep;
-    const int LeftmostTap = 1 - Filter.Delay - Filter.Length;
-    const int StartInterior = CLAMP(-LeftmostTap, 0, N - 1);
-    const int EndInterior = (Filter.Delay <  0) ?
-                            (N + Filter.Delay - 1) : (N - 1);
-    const float *SrcN, *SrcK;
-    float Accum;
-    int n, k;
-
-    
-    if(nEnd < nStart || nStep <= 0 || N <= 0)
-        return;
-    
-    /* Handle the left boundary */
-    for(n = nStart; n < StartInterior; n += nStep, Dest += DestStride)
+    switch(GetCpuLevel())
     {
-        for(k = 0, Accum = 0; k < Filter.Length; k++)
-            Accum += Filter.Coeff[k]
-                * Boundary(Src, SrcStride, N, n - Filter.Delay - k);
-        
-        *Dest = Accum;
+#ifdef CPUDISPATCH_TARGETS
+    case CPU_AVX512:
+        SampledConv1DAvx512(Dest, DestStride, Src, SrcStride, Filter,
+            Boundary, N, nStart, nStep, nEnd);
+        break;
+    case CPU_AVX2:
+        SampledConv1DAvx2(Dest, DestStride, Src, SrcStride, Filter,
+            Boundary, N, nStart, nStep, nEnd);
+        break;
+    case CPU_SSE2:
+        SampledConv1DSse2(Dest, DestStride, Src, SrcStride, Filter,
+            Boundary, N, nStart, nStep, nEnd);
+        break;
+#endif
+    default:
+        SampledConv1DBaseline(Dest, DestStride, Src, SrcStride, Filter,
+            Boundary, N, nStart, nStep, nEnd);
+        break;
     }
+}
+
+
+/**
+ * @brief Vertical FIR convolution of one output row
+ *
+ * @param DestRow pointer to the output row
+ * @param DestStride step between successive output pixels
+ * @param Src pointer to the input image, with rows of Width samples
+ * @param Filter the filter
+ * @param Boundary boundary extension
+ * @param Width image width
+ * @param Height image height
+ * @param y the row to compute
+ *
+ * The rows of Src are accumulated across all taps, so that the inner loop
+ * runs along the row.  The taps are summed in the same order as in
+ * SampledConv1D(), so the result is the same as filtering each column.
+ */
+static void VerticalConvRow(float *DestRow, int DestStride, const float *Src,
+    filter Filter, boundaryext Boundary, int Width, int Height, int y)
+{
+    const float *SrcRow;
+    float Accum, c;
+    int x, k;
     
-    /* Compute the convolution on the interior of the signal:
-    
-       In the inner accumulation loop
-       SrcK = &inputdata[n - FilterDelay - k],  k = FilterLength-1, ..., 0.
-       
-       The SrcN pointer is adjusted such that
-       SrcN = &inputdata[n + LeftmostTap].
-       
-       If n == StartInterior, then the loop starts with
-          n = -LeftmostTap, SrcN = &inputdata[0]  if LeftmostTap <= 0
-          n = 0, SrcN = &inputdata[LeftmostTap]   if LeftmostTap >= 0. */
-    SrcN = (LeftmostTap <= 0) ? Src : (Src + SrcStride*LeftmostTap);
-    
-    /* Adjust if n > StartInterior */
-    SrcN += SrcStride*(n - StartInterior);
     
-    for(; n <= EndInterior; n += nStep, SrcN += SrcStrideStep, Dest += DestStride)
+    if(y - Filter.Delay - Filter.Length + 1 >= 0 && y - Filter.Delay < Height)
     {
-        Accum = 0;
-        SrcK = SrcN;
-        k = Filter.Length;
+        for(x = 0; x < Width; x++)
+            DestRow[DestStride*x] = 0;
         
-        while(k)
+        for(k = Filter.Length; k;)
         {
-            Accum += Filter.Coeff[--k] * (*SrcK);
-            SrcK += SrcStride;
+            c = Filter.Coeff[--k];
+            SrcRow = Src + Width*(y - Filter.Delay - k);
+            
+            if(DestStride == 1)
+                for(x = 0; x < Width; x++)
+                    DestRow[x] += c * SrcRow[x];
+            else
+                for(x = 0; x < Width; x++)
+                    DestRow[DestStride*x] += c * SrcRow[x];
         }
-        
-        *Dest = Accum;
-    }
-    
-    /* Handle the right boundary */
-    for(; n <= nEnd; n += nStep, Dest += DestStride)
-    {
-        for(k = 0, Accum = 0; k < Filter.Length; k++)
-            Accum += Filter.Coeff[k]
-                * Boundary(Src, SrcStride, N, n - Filter.Delay - k);
-        
-        *Dest = Accum;
     }
+    else    /* Some taps are outside of the image */
+        for(x = 0; x < Width; x++)
+        {
+            for(k = 0, Accum = 0; k < Filter.Length; k++)
+                Accum += Filter.Coeff[k] * Boundary(Src + x, Width,
+                    Height, y - Filter.Delay - k);
+            
+            DestRow[DestStride*x] = Accum;
+        }
 }
 
 
@@ -124,23 +166,65 @@ void SeparableConv2D(float *Dest, float *Buffer, const float *Src,
     filter FilterX, filter FilterY, boundaryext Boundary,
     int Width, int Height, int NumChannels)
 {
-    const int NumPixels = Width*Height;
+    imageview DestView, SrcView;
+
+    DestView.Data = Dest;
+    DestView.Width = Width;
+    DestView.Height = Height;
+    DestView.NumChannels = NumChannels;
+    DestView.PixelStride = 1;
+    DestView.RowStride = Width;
+    DestView.ChannelStride = Width*Height;
+    DestView.Base = NULL;
+    SrcView = DestView;
+    SrcView.Data = (float *)Src;
+    SeparableConv2DView(DestView, Buffer, SrcView,
+        FilterX, FilterY, Boundary);
+}
+
+
+/**
+ * @brief Separable 2D FIR convolution of strided image views
+ *
+ * @param Dest view of the output image, same dimensions as Src
+ * @param Buffer workspace buffer of size Src.Width*Src.Height
+ * @param Src view of the input image
+ * @param FilterX the horizontal filter
+ * @param FilterY the vertical filter
+ * @param Boundary boundary extension
+ *
+ * Src and Dest may be crops of larger images, have padded rows, or have
+ * interleaved channels.  The image outside of the view is not accessed, the
+ * boundaries of the view are handled with Boundary.
+ *
+ * When called by all threads of an OpenMP parallel region, the rows are
+ * divided among the threads in both passes, so that each thread writes
+ * whole rows of Buffer and Dest.  Otherwise, it runs serially.
+ */
+void SeparableConv2DView(imageview Dest, float *Buffer, imageview Src,
+    filter FilterX, filter FilterY, boundaryext Boundary)
+{
     int i, Channel;
-    
-    for(Channel = 0; Channel < NumChannels; Channel++)
+
+    for(Channel = 0; Channel < Src.NumChannels; Channel++)
     {
         /* Filter Src horizontally and store the result in Buffer */
-        for(i = 0; i < Height; i++)
-            Conv1D(Buffer + Width*i, 1, Src + Width*i, 1,
-                FilterX, Boundary, Width);
-        
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for(i = 0; i < Src.Height; i++)
+            Conv1D(Buffer + Src.Width*i, 1,
+                IMAGEVIEW_PTR(Src, 0, i, Channel), Src.PixelStride,
+                FilterX, Boundary, Src.Width);
+
         /* Filter Buffer vertically and store the result in Dest */
-        for(i = 0; i < Width; i++)
-            Conv1D(Dest + i, Width, Buffer + i, Width, FilterY,
-                Boundary, Height);
-            
-        Src += NumPixels;
-        Dest += NumPixels;
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for(i = 0; i < Src.Height; i++)
+            VerticalConvRow(IMAGEVIEW_PTR(Dest, 0, i, Channel),
+                Dest.PixelStride, Buffer, FilterY, Boundary,
+                Src.Width, Src.Height, i);
     }
 }
 
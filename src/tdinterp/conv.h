@@ -17,6 +17,7 @@
 #define _CONV_H_
 
 #include "basic.h"
+#include "imageview.h"
 
 
 /** @brief struct representing a 1D FIR filter */
@@ -42,6 +43,9 @@ void SeparableConv2D(float *Dest, float *Buffer, const float *Src,
     filter FilterX, filter FilterY, boundaryext Boundary,
     int Width, int Height, int NumChannels);
 
+void SeparableConv2DView(imageview Dest, float *Buffer, imageview Src,
+    filter FilterX, filter FilterY, boundaryext Boundary);
+
 filter MakeFilter(float *Coeff, int Delay, int Length);
 
 filter AllocFilter(int Delay, int Length);
@@ -235,7 +235,6 @@ Catch:
         fftwf_free(BufDft);
     if(BufSpatial)
         fftwf_free(BufSpatial);
-    fftwf_cleanup();
     return Success;
 }
 
@@ -252,6 +251,7 @@ Catch:
  * @param SrcWidth, SrcHeight, NumChannels input image dimensions
  * @param PsfSigma Gaussian PSF standard deviation
  * @param Boundary boundary handling
+ * @param Verbose if nonzero, print the CPU time
  * @return 1 on success, 0 on failure.
  *
  * The image is first mirror folded with half-sample even symmetry to avoid
@@ -266,7 +266,7 @@ Catch:
 int FourierScale2d(float *Dest, int DestWidth, float XStart,
     int DestHeight, float YStart,
     const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
-    double PsfSigma, boundaryhandling Boundary)
+    double PsfSigma, boundaryhandling Boundary, int Verbose)
 {
     float *Buf = NULL;
     unsigned long StartTime, StopTime;
@@ -275,7 +275,8 @@ int FourierScale2d(float *Dest, int DestWidth, float XStart,
     
     if(!Dest || DestWidth < SrcWidth || DestHeight < SrcHeight || !Src
         || SrcWidth <= 0 || SrcHeight <= 0 || NumChannels <= 0 || PsfSigma < 0
-        || !(Buf = (float *)Malloc(sizeof(float)*SrcWidth*DestHeight*3)))
+        || !(Buf = (float *)Malloc(sizeof(float)
+            *SrcWidth*DestHeight*NumChannels)))
         return 0;
 
     StartTime = Clock();
@@ -283,17 +284,19 @@ int FourierScale2d(float *Dest, int DestWidth, float XStart,
     /* Scale the image vertically */
     if(!FourierScaleScan(Buf, SrcWidth, 1, SrcWidth*DestHeight, DestHeight,
         Src, SrcWidth, 1, SrcWidth*SrcHeight, SrcHeight,
-        SrcWidth, 3, YStart, PsfSigma, Boundary))
+        SrcWidth, NumChannels, YStart, PsfSigma, Boundary))
         goto Catch;
     
     /* Scale the image horizontally */
     if(!FourierScaleScan(Dest, 1, DestWidth, DestWidth*DestHeight, DestWidth,
         Buf, 1, SrcWidth, SrcWidth*DestHeight, SrcWidth,
-        DestHeight, 3, XStart, PsfSigma, Boundary))
+        DestHeight, NumChannels, XStart, PsfSigma, Boundary))
         goto Catch;
 
     StopTime = Clock();
-    printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    
+    if(Verbose)
+        printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
     
     Success = 1;
 Catch:
@@ -16,6 +16,6 @@ typedef enum
 int FourierScale2d(float *Dest, int DestWidth, float XStart,
     int DestHeight, float YStart,
     const float *Src, int SrcWidth, int SrcHeight, int NumChannels,
-    double PsfSigma, boundaryhandling Boundary);
+    double PsfSigma, boundaryhandling Boundary, int Verbose);
 
 #endif /* _FINTERP_H_ */
@@ -0,0 +1,118 @@
+/**
+ * @file sampledconv1d_inc.c
+ * @brief (Sub)sampled 1D FIR convolution kernel
+ *
+ * This file is included by conv.c once for each instruction set level,
+ * with SAMPLEDCONV1D_FUNC defined as the name of the function to define
+ * and SAMPLEDCONV1D_ISA as the target, or not defined for the baseline.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+/**
+ * @brief (Sub)sampled 1D FIR convolution
+ *
+ * The parameters are as for SampledConv1D().  Where the input and output
+ * samples are contiguous, the interior is computed with the taps in the
+ * outer loop, so that the inner loop runs over the output samples and the
+ * compiler vectorizes it.  Each sample is still summed in the same order,
+ * so with the -ansi build, where the compiler does not contract
+ * multiplies and adds into fused multiply-adds, the result is the same
+ * for every instruction set.
+ */
+static
+#ifdef SAMPLEDCONV1D_ISA
+ATTRIBUTE_TARGET(SAMPLEDCONV1D_ISA)
+#endif
+void SAMPLEDCONV1D_FUNC(float *Dest, int DestStride, const float *Src,
+    int SrcStride, filter Filter, boundaryext Boundary, int N,
+    int nStart, int nStep, int nEnd)
+{
+    const int SrcStrideStep = SrcStride*nStep;
+    const int LeftmostTap = 1 - Filter.Delay - Filter.Length;
+    const int StartInterior = CLAMP(-LeftmostTap, 0, N - 1);
+    const int EndInterior = (Filter.Delay <  0) ?
+                            (N + Filter.Delay - 1) : (N - 1);
+    const float *SrcN, *SrcK;
+    float Accum, c;
+    int n, k, i, NumInterior;
+
+    
+    if(nEnd < nStart || nStep <= 0 || N <= 0)
+        return;
+    
+    /* Handle the left boundary */
+    for(n = nStart; n < StartInterior; n += nStep, Dest += DestStride)
+    {
+        for(k = 0, Accum = 0; k < Filter.Length; k++)
+            Accum += Filter.Coeff[k]
+                * Boundary(Src, SrcStride, N, n - Filter.Delay - k);
+        
+        *Dest = Accum;
+    }
+    
+    /* Compute the convolution on the interior of the signal:
+    
+       In the inner accumulation loop
+       SrcK = &inputdata[n - FilterDelay - k],  k = FilterLength-1, ..., 0.
+       
+       The SrcN pointer is adjusted such that
+       SrcN = &inputdata[n + LeftmostTap].
+       
+       If n == StartInterior, then the loop starts with
+          n = -LeftmostTap, SrcN = &inputdata[0]  if LeftmostTap <= 0
+          n = 0, SrcN = &inputdata[LeftmostTap]   if LeftmostTap >= 0. */
+    SrcN = (LeftmostTap <= 0) ? Src : (Src + SrcStride*LeftmostTap);
+    
+    /* Adjust if n > StartInterior */
+    SrcN += SrcStride*(n - StartInterior);
+    
+    if(DestStride == 1 && SrcStrideStep == 1)
+    {
+        NumInterior = (n <= EndInterior) ? EndInterior - n + 1 : 0;
+        
+        for(i = 0; i < NumInterior; i++)
+            Dest[i] = 0;
+        
+        for(k = Filter.Length, SrcK = SrcN; k; SrcK++)
+        {
+            c = Filter.Coeff[--k];
+            
+            for(i = 0; i < NumInterior; i++)
+                Dest[i] += c * SrcK[i];
+        }
+        
+        n += NumInterior;
+        Dest += NumInterior;
+    }
+    else
+        for(; n <= EndInterior; n += nStep, SrcN += SrcStrideStep,
+            Dest += DestStride)
+        {
+            Accum = 0;
+            SrcK = SrcN;
+            k = Filter.Length;
+            
+            while(k)
+            {
+                Accum += Filter.Coeff[--k] * (*SrcK);
+                SrcK += SrcStride;
+            }
+            
+            *Dest = Accum;
+        }
+    
+    /* Handle the right boundary */
+    for(; n <= nEnd; n += nStep, Dest += DestStride)
+    {
+        for(k = 0, Accum = 0; k < Filter.Length; k++)
+            Accum += Filter.Coeff[k]
+                * Boundary(Src, SrcStride, N, n - Filter.Delay - k);
+        
+        *Dest = Accum;
+    }
+}
@@ -10,11 +10,23 @@
  * not, see <http://www.opensource.org/licenses/bsd-license.html>.
  */
 
+/* Strict ANSI mode hides the declaration of madvise, request it */
+#if defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <fftw3.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "basic.h"
 #include "finterp.h"
@@ -22,6 +34,45 @@
 #include "conv.h"
 
 
+static int RoussosInterpCore(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    int NumChannels, int Verbose, unsigned long TimeLimit, float *DiffOut,
+    float *Workspace);
+
+/*
+ * Parallelization: the image loops below are split into bands of rows with
+ * orphaned "omp for" directives.  Called from within a parallel region, they
+ * divide the rows among the threads of that region, with the implicit 
+ * barrier at the end of each loop ordering the passes.  Called outside of 
+ * a parallel region, they run serially.  The same OpenMP threads also run 
+ * the FFTs, see RoussosInterpCore().  The computation does not depend on
+ * how the rows are divided, so the result is the same for any number of 
+ * threads.  Work buffers are first touched by the same row bands, so that
+ * on NUMA systems the rows a thread works on are in its local memory.
+ */
+
+/** @brief Set NumPlanes planes of Width x Height to zero */
+static void ZeroPlanes(float *Dest, int Width, int Height, int NumPlanes)
+{
+    const long NumPixels = (long)Width*Height;
+    float *DestRow;
+    int x, y, k;
+    
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(y = 0; y < Height; y++)
+        for(k = 0; k < NumPlanes; k++)
+        {
+            DestRow = Dest + NumPixels*k + (long)Width*y;
+            
+            for(x = 0; x < Width; x++)
+                DestRow[x] = 0.0f;
+        }
+}
+
+
 /** @brief Compute the X-derivative for Weicker-Scharr scheme */
 static void XDerivative(float *Dest, float *ConvTemp, const float *Src,
     int Width, int Height)
@@ -30,24 +81,30 @@ static void XDerivative(float *Dest, float *ConvTemp, const float *Src,
     int iEnd;
     
     
-    for(y = 0, i = 0, iEnd = -1; y < Height; y++)
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(y = 0; y < Height; y++)
     {
+        i = Width*y;
         ConvTemp[i] = Src[i + 1] - Src[i];
         i++;
         
-        for(iEnd += Width; i < iEnd; i++)
+        for(iEnd = Width*(y + 1) - 1; i < iEnd; i++)
             ConvTemp[i] = Src[i + 1] - Src[i - 1];
         
         ConvTemp[i] = Src[i] - Src[i - 1];
-        i++;
     }
     
-    for(y = 0, i = iEnd = 0; y < Height; y++)
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(y = 0; y < Height; y++)
     {
         il = (y > 0) ? -Width : 0;
         ir = (y < Height - 1) ? Width : 0;
         
-        for(iEnd += Width; i < iEnd; i++)
+        for(i = Width*y, iEnd = i + Width; i < iEnd; i++)
             Dest[i] = 0.3125f*ConvTemp[i]
                 + 0.09375f*(ConvTemp[i + ir] + ConvTemp[i + il]);
     }
@@ -61,26 +118,32 @@ static void YDerivative(float *Dest, float *ConvTemp, const float *Src,
     int i, il, ir, iEnd, y;
     
     
-    for(y = 0, i = iEnd = 0; y < Height; y++)
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(y = 0; y < Height; y++)
     {
         il = (y > 0) ? -Width : 0;
         ir = (y < Height - 1) ? Width : 0;
         
-        for(iEnd += Width; i < iEnd; i++)
+        for(i = Width*y, iEnd = i + Width; i < iEnd; i++)
             ConvTemp[i] = Src[i + ir] - Src[i + il];
     }
     
-    for(y = 0, i = 0, iEnd = -1; y < Height; y++)
+#ifdef _OPENMP
+    #pragma omp for schedule(static)
+#endif
+    for(y = 0; y < Height; y++)
     {
+        i = Width*y;
         Dest[i] = 0.40625f*ConvTemp[i] + 0.09375f*ConvTemp[i + 1];
         i++;
         
-        for(iEnd += Width; i < iEnd; i++)
+        for(iEnd = Width*(y + 1) - 1; i < iEnd; i++)
             Dest[i] =  0.3125f*ConvTemp[i]
                 + 0.09375f*(ConvTemp[i + 1] + ConvTemp[i - 1]);
         
         Dest[i] =  0.40625f*ConvTemp[i] + 0.09375f*ConvTemp[i - 1];
-        i++;
     }
 }
 
@@ -88,154 +151,103 @@ static void YDerivative(float *Dest, float *ConvTemp, const float *Src,
 /** @brief Construct the tensor T */
 static void ComputeTensor(float *Txx, float *Txy, float *Tyy,
     float *uSmooth, float *ConvTemp, const float *u, int Width, int Height,
-    filter PreSmooth, filter PostSmooth, double K)
+    int NumChannels, filter PreSmooth, filter PostSmooth, double K)
 {
     const float dt = 2;
     const double KSquared = K*K;
     const int NumPixels = Width*Height;
-    const int NumEl = 3*NumPixels;
+    const int NumEl = NumChannels*NumPixels;
     boundaryext Boundary = GetBoundaryExt("sym");
-    double Tm, SqrtTm, Trace, Lambda1, Lambda2, EigVecX, EigVecY, Temp;
-    float ux, uy;
-    int i, iu, id, il, ir, x, y, Channel;
     
-
-    /* Set the tensor to zero and perform pre-smoothing on u.  Note that it is
-    not safely portable to use memset for this purpose.
-    http://c-faq.com/malloc/calloc.html  */
-#ifdef _OPENMP
-    #pragma omp parallel sections private(i)
-    {	/* The following six operations can run in parallel */
-        #pragma omp section
-        {
-            for(i = 0; i < NumPixels; i++)
-                Txx[i] = 0.0f;
-        }
-        #pragma omp section
-        {
-            for(i = 0; i < NumPixels; i++)
-                Txy[i] = 0.0f;
-        }
-        #pragma omp section
-        {
-            for(i = 0; i < NumPixels; i++)
-                Tyy[i] = 0.0f;
-        }
-        #pragma omp section
-        {
-            SeparableConv2D(uSmooth,
-                ConvTemp, u,
-                PreSmooth, PreSmooth, Boundary, Width, Height, 1);
-        }
-        #pragma omp section
-        {
-            SeparableConv2D(uSmooth + NumPixels,
-                ConvTemp + NumPixels, u + NumPixels,
-                PreSmooth, PreSmooth, Boundary, Width, Height, 1);
-        }
-        #pragma omp section
-        {
-            SeparableConv2D(uSmooth + 2*NumPixels,
-                ConvTemp + 2*NumPixels, u + 2*NumPixels,
-                PreSmooth, PreSmooth, Boundary, Width, Height, 1);
-        }
-    }
-#else
-    for(i = 0; i < NumPixels; i++)
-        Txx[i] = 0.0f;
-    
-    for(i = 0; i < NumPixels; i++)
-        Txy[i] = 0.0f;
     
-    for(i = 0; i < NumPixels; i++)
-        Tyy[i] = 0.0f;
-
-    SeparableConv2D(uSmooth, ConvTemp, u,
-        PreSmooth, PreSmooth, Boundary, Width, Height, 3);
+#ifdef _OPENMP
+    #pragma omp parallel
 #endif
-    
-    /* Compute the structure tensor */
-    for(Channel = 0; Channel < NumEl; Channel += NumPixels)
     {
-        for(y = 0, i = 0; y < Height; y++)
+        double Tm, SqrtTm, Trace, Lambda1, Lambda2, EigVecX, EigVecY, Temp;
+        float ux, uy;
+        int i, iu, id, il, ir, x, y, Channel;
+        
+        /* Set the tensor to zero and perform pre-smoothing on u.  Note that 
+        it is not safely portable to use memset for this purpose.
+        http://c-faq.com/malloc/calloc.html  */
+        ZeroPlanes(Txx, Width, Height, 1);
+        ZeroPlanes(Txy, Width, Height, 1);
+        ZeroPlanes(Tyy, Width, Height, 1);
+        
+        SeparableConv2D(uSmooth, ConvTemp, u,
+            PreSmooth, PreSmooth, Boundary, Width, Height, NumChannels);
+        
+        /* Compute the structure tensor */
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for(y = 0; y < Height; y++)
         {
             iu = (y > 0) ? -Width : 0;
             id = (y < Height - 1) ? Width : 0;
             
-            for(x = 0; x < Width; x++, i++)
+            for(Channel = 0; Channel < NumEl; Channel += NumPixels)
             {
-                il = (x > 0) ? -1 : 0;
-                ir = (x < Width - 1) ? 1 : 0;
-                
-                ux = (uSmooth[i + ir + Channel]
-                    - uSmooth[i + il + Channel]) / 2;
-                uy = (uSmooth[i + id + Channel]
-                    - uSmooth[i + iu + Channel]) / 2;
-                Txx[i] += ux * ux;
-                Txy[i] += ux * uy;
-                Tyy[i] += uy * uy;
+                for(x = 0, i = Width*y; x < Width; x++, i++)
+                {
+                    il = (x > 0) ? -1 : 0;
+                    ir = (x < Width - 1) ? 1 : 0;
+                    
+                    ux = (uSmooth[i + ir + Channel]
+                        - uSmooth[i + il + Channel]) / 2;
+                    uy = (uSmooth[i + id + Channel]
+                        - uSmooth[i + iu + Channel]) / 2;
+                    Txx[i] += ux * ux;
+                    Txy[i] += ux * uy;
+                    Tyy[i] += uy * uy;
+                }
             }
         }
-    }
-    
-    /* Perform the post-smoothing convolution with PostSmooth */
+        
+        /* Perform the post-smoothing convolution with PostSmooth */
+        SeparableConv2D(Txx, ConvTemp, Txx,
+            PostSmooth, PostSmooth, Boundary, Width, Height, 1);
+        SeparableConv2D(Txy, ConvTemp, Txy,
+            PostSmooth, PostSmooth, Boundary, Width, Height, 1);
+        SeparableConv2D(Tyy, ConvTemp, Tyy,
+            PostSmooth, PostSmooth, Boundary, Width, Height, 1);
+        
+        /* Refactor the structure tensor */
 #ifdef _OPENMP
-    #pragma omp parallel sections
-    {
-        #pragma omp section
-        {
-            SeparableConv2D(Txx, ConvTemp, Txx,
-                PostSmooth, PostSmooth, Boundary, Width, Height, 1);
-        }
-        #pragma omp section
-        {
-            SeparableConv2D(Txy, ConvTemp + NumPixels, Txy,
-                PostSmooth, PostSmooth, Boundary, Width, Height, 1);
-        }
-        #pragma omp section
-        {
-            SeparableConv2D(Tyy, ConvTemp + 2*NumPixels, Tyy,
-                PostSmooth, PostSmooth, Boundary, Width, Height, 1);
-        }
-    }
-#else
-    SeparableConv2D(Txx, ConvTemp, Txx,
-        PostSmooth, PostSmooth, Boundary, Width, Height, 1);
-    SeparableConv2D(Txy, ConvTemp, Txy,
-        PostSmooth, PostSmooth, Boundary, Width, Height, 1);
-    SeparableConv2D(Tyy, ConvTemp, Tyy,
-        PostSmooth, PostSmooth, Boundary, Width, Height, 1);
+        #pragma omp for schedule(static)
 #endif
-    
-    /* Refactor the structure tensor */
-    for(i = 0; i < NumPixels; i++)
-    {
-        /* Compute the eigenspectra */
-        Trace = 0.5*(Txx[i] + Tyy[i]);
-        Temp = sqrt(Trace*Trace - Txx[i]*Tyy[i] + Txy[i]*Txy[i]);
-        Lambda1 = Trace - Temp;
-        Lambda2 = Trace + Temp;
-        EigVecX = Txy[i];
-        EigVecY = Lambda1 - Txx[i];
-        Temp = sqrt(EigVecX*EigVecX + EigVecY*EigVecY);
-        
-        if(Temp >= 1e-9)
+        for(i = 0; i < NumPixels; i++)
         {
-            EigVecX /= Temp;
-            EigVecY /= Temp;
-            Tm = KSquared/(KSquared + (Lambda1 + Lambda2));
-            SqrtTm = sqrt(Tm);
+            /* Compute the eigenspectra */
+            Trace = 0.5*(Txx[i] + Tyy[i]);
+            Temp = sqrt(Trace*Trace - Txx[i]*Tyy[i] + Txy[i]*Txy[i]);
+            Lambda1 = Trace - Temp;
+            Lambda2 = Trace + Temp;
+            EigVecX = Txy[i];
+            EigVecY = Lambda1 - Txx[i];
+            Temp = sqrt(EigVecX*EigVecX + EigVecY*EigVecY);
             
-            /* Construct new tensor from the spectra */
-            Txx[i] = (float)(dt*(SqrtTm*EigVecX*EigVecX + Tm*EigVecY*EigVecY));
-            Txy[i] = (float)(dt*((SqrtTm - Tm)*EigVecX*EigVecY));
-            Tyy[i] = (float)(dt*(SqrtTm*EigVecY*EigVecY + Tm*EigVecX*EigVecX));
-        }
-        else
-        {
-            Txx[i] = dt;
-            Txy[i] = 0.0f;
-            Tyy[i] = dt;
+            if(Temp >= 1e-9)
+            {
+                EigVecX /= Temp;
+                EigVecY /= Temp;
+                Tm = KSquared/(KSquared + (Lambda1 + Lambda2));
+                SqrtTm = sqrt(Tm);
+                
+                /* Construct new tensor from the spectra */
+                Txx[i] = (float)(dt*(SqrtTm*EigVecX*EigVecX 
+                    + Tm*EigVecY*EigVecY));
+                Txy[i] = (float)(dt*((SqrtTm - Tm)*EigVecX*EigVecY));
+                Tyy[i] = (float)(dt*(SqrtTm*EigVecY*EigVecY 
+                    + Tm*EigVecX*EigVecX));
+            }
+            else
+            {
+                Txx[i] = dt;
+                Txy[i] = 0.0f;
+                Tyy[i] = dt;
+            }
         }
     }
 }
@@ -245,72 +257,44 @@ static void ComputeTensor(float *Txx, float *Txy, float *Tyy,
 static void DiffuseWithTensor(float *u, float *vx, float *vy,
     float *SumX, float *SumY,
     float *ConvTemp, const float *Txx, const float *Txy, const float *Tyy,
-    int Width, int Height, int DiffIter)
+    int Width, int Height, int NumChannels, int DiffIter)
 {
     const int NumPixels = Width*Height;
-    int i, Channel, Step;
     
     
-    for(Channel = 0; Channel < 3; Channel++, u += NumPixels)
+#ifdef _OPENMP
+    #pragma omp parallel
+#endif
     {
-        for(Step = 0; Step < DiffIter; Step++)
+        float *uChannel = u;
+        int i, Channel, Step;
+        
+        for(Channel = 0; Channel < NumChannels; 
+            Channel++, uChannel += NumPixels)
         {
-#ifdef _OPENMP
-            #pragma omp parallel
+            for(Step = 0; Step < DiffIter; Step++)
             {
-                #pragma omp sections
-                {	/* XDerivative and YDerivative can run in parallel */
-                    #pragma omp section
-                    {
-                        XDerivative(vx, ConvTemp, u, Width, Height);
-                    }
-                    #pragma omp section
-                    {
-                        YDerivative(vy, ConvTemp + NumPixels, u, Width, Height);
-                    }
-                }
+                XDerivative(vx, ConvTemp, uChannel, Width, Height);
+                YDerivative(vy, ConvTemp, uChannel, Width, Height);
                 
+#ifdef _OPENMP
                 #pragma omp for schedule(static)
+#endif
                 for(i = 0; i < NumPixels; i++)
                 {
                     SumX[i] = Txx[i]*vx[i] + Txy[i]*vy[i];
                     SumY[i] = Txy[i]*vx[i] + Tyy[i]*vy[i];
                 }
-
-                #pragma omp sections
-                {	/* XDerivative and YDerivative can run in parallel */
-                    #pragma omp section
-                    {
-                        XDerivative(SumX, ConvTemp,
-                                    SumX, Width, Height);
-                    }
-                    #pragma omp section
-                    {
-                        YDerivative(SumY, ConvTemp + NumPixels,
-                                    SumY, Width, Height);
-                    }
-                }
                 
+                XDerivative(SumX, ConvTemp, SumX, Width, Height);
+                YDerivative(SumY, ConvTemp, SumY, Width, Height);
+                
+#ifdef _OPENMP
                 #pragma omp for schedule(static)
+#endif
                 for(i = 0; i < NumPixels; i++)
-                    u[i] += SumX[i] + SumY[i];
-            }
-#else
-            XDerivative(vx, ConvTemp, u, Width, Height);
-            YDerivative(vy, ConvTemp, u, Width, Height);
-            
-            for(i = 0; i < NumPixels; i++)
-            {
-                SumX[i] = Txx[i]*vx[i] + Txy[i]*vy[i];
-                SumY[i] = Txy[i]*vx[i] + Tyy[i]*vy[i];
+                    uChannel[i] += SumX[i] + SumY[i];
             }
-            
-            XDerivative(SumX, ConvTemp, SumX, Width, Height);
-            YDerivative(SumY, ConvTemp, SumY, Width, Height);
-            
-            for(i = 0; i < NumPixels; i++)
-                u[i] += SumX[i] + SumY[i];
-#endif
         }
     }
 }
@@ -372,7 +356,8 @@ static void SumAliases(float *u, int d, int Width, int Height)
 
 
 /** @brief Precompute the function phi used in projections */
-static void MakePhi(float *Phi, double PsfSigma, int d, int Width, int Height)
+static void MakePhi(float *Phi, float *Temp, double PsfSigma, int d,
+    int Width, int Height)
 {
     /* Number of terms to use in truncated sum, larger is more accurate */
     const int NumOverlaps = 2;
@@ -381,11 +366,6 @@ static void MakePhi(float *Phi, double PsfSigma, int d, int Width, int Height)
     float Sum, Sigma, Denom;
     int i, x, y, t, k;
     
-    float *Temp;
-
-    
-    Temp = (float *)Malloc(sizeof(float)*NumPixels);
-
     /* Construct the Fourier transform of a Gaussian with spatial standard
      * deviation d*PsfSigma.  Using the Gaussian and the transform's
      * separability, the result is formed as the tensor product of the 1D
@@ -441,8 +421,6 @@ static void MakePhi(float *Phi, double PsfSigma, int d, int Width, int Height)
     /* Obtain the projection kernel Phi in the Fourier domain */
     for(i = 0; i < NumPixels; i++)
         Phi[i] /= (float)sqrt(Temp[i] * NumPixels);
-    
-    Free(Temp);
 }
 
 
@@ -517,6 +495,9 @@ static void MultiplyByPhiInterleaved(float *Dest, const float *Phi,
     
     for(Channel = 0; Channel < NumChannels; Channel++, Dest += 2*NumPixels)
     {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
         for(i = 0; i < NumPixels; i++)
         {
             Dest[2*i] *= Phi[i];
@@ -533,13 +514,18 @@ static void MirrorSpectra(float *Dest, int Width, int Height, int NumChannels)
     int i, sx, sy, x, y, Channel;
     
     
-    /* Fill in the redundant spectra */
-    for(Channel = 0, i = 0; Channel < NumChannels; Channel++)
+    /* Fill in the redundant spectra.  Row y is filled from row sy, only 
+       reading the nonredundant half, so the rows can be done in parallel. */
+    for(Channel = 0; Channel < NumChannels; Channel++)
     {
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static) private(i, sx, sy, x)
+#endif
         for(y = 0; y < Height; y++)
         {
             sy = (y > 0) ? Height - y : 0;
             sy = 2*Width*(sy + Height*Channel);
+            i = 2*Width*(y + Height*Channel);
             
             for(x = H, i += 2*H; x < Width; x++, i += 2)
             {
@@ -557,12 +543,10 @@ static void MirrorSpectra(float *Dest, int Width, int Height, int NumChannels)
 static void Project(float *u, float *Temp, float *ConvTemp,
     fftwf_plan ForwardPlan, fftwf_plan InversePlan, const float *u0,
     const float *Phi, int ScaleFactor,
-    int OutputWidth, int OutputHeight, int Padding)
+    int OutputWidth, int OutputHeight, int NumChannels, int Padding)
 {
-    const int OutputNumPixels = OutputWidth*OutputHeight;
-    const int OutputNumEl = 3*OutputNumPixels;
     int TransWidth, TransHeight, TransNumPixels;
-    int i, x, y, sx, sy, OffsetX, OffsetY, Channel;
+    int i, x, y, sx, sy, OffsetX, OffsetY, Channel, Row;
     
     
     TransWidth = OutputWidth + 2*Padding*ScaleFactor;
@@ -579,65 +563,69 @@ static void Project(float *u, float *Temp, float *ConvTemp,
     OffsetX -= OffsetX % ScaleFactor;
     OffsetY -= OffsetY % ScaleFactor;
     
-    for(Channel = 0, i = 0; Channel < OutputNumEl; Channel += OutputNumPixels)
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) private(i, x, y, sx, sy, Channel)
+#endif
+    for(Row = 0; Row < NumChannels*TransHeight; Row++)
     {
-        for(y = 0; y < TransHeight; y++)
+        Channel = OutputWidth*OutputHeight*(Row / TransHeight);
+        y = Row % TransHeight;
+        sy = y - OffsetY;
+        
+        while(1)
         {
-            sy = y - OffsetY;
+            if(sy < 0)
+                sy = -1 - sy;
+            else if(sy >= OutputHeight)
+                sy = 2*OutputHeight - 1 - sy;
+            else
+                break;
+        }
+        
+        for(x = 0, i = TransWidth*Row; x < TransWidth; x++, i++)
+        {
+            sx = x - OffsetX;
             
             while(1)
             {
-                if(sy < 0)
-                    sy = -1 - sy;
-                else if(sy >= OutputHeight)
-                    sy = 2*OutputHeight - 1 - sy;
+                if(sx < 0)
+                    sx = -1 - sx;
+                else if(sx >= OutputWidth)
+                    sx = 2*OutputWidth - 1 - sx;
                 else
                     break;
             }
             
-            for(x = 0; x < TransWidth; x++, i++)
-            {
-                sx = x - OffsetX;
-                
-                while(1)
-                {
-                    if(sx < 0)
-                        sx = -1 - sx;
-                    else if(sx >= OutputWidth)
-                        sx = 2*OutputWidth - 1 - sx;
-                    else
-                        break;
-                }
-                
-                Temp[i] = u[sx + OutputWidth*sy + Channel]
-                    - u0[sx + OutputWidth*sy + Channel];
-            }
+            Temp[i] = u[sx + OutputWidth*sy + Channel]
+                - u0[sx + OutputWidth*sy + Channel];
         }
     }
 
     fftwf_execute(ForwardPlan);
-    MirrorSpectra(ConvTemp, TransWidth, TransHeight, 3);
+    MirrorSpectra(ConvTemp, TransWidth, TransHeight, NumChannels);
     
-    MultiplyByPhiInterleaved(ConvTemp, Phi, TransNumPixels, 3);
-    ImageSumAliases(ConvTemp, ScaleFactor, TransWidth, TransHeight, 3);
-    MultiplyByPhiInterleaved(ConvTemp, Phi, TransNumPixels, 3);
+    MultiplyByPhiInterleaved(ConvTemp, Phi, TransNumPixels, NumChannels);
+    ImageSumAliases(ConvTemp, ScaleFactor, TransWidth, TransHeight,
+        NumChannels);
+    MultiplyByPhiInterleaved(ConvTemp, Phi, TransNumPixels, NumChannels);
     
     fftwf_execute(InversePlan);
     
     /* Subtract a halved version of Temp from u */
     Temp += OffsetX + TransWidth*OffsetY;
     
-    for(Channel = 0, i = 0; Channel < 3; Channel++)
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) private(i, x, y, Channel)
+#endif
+    for(Row = 0; Row < NumChannels*OutputHeight; Row++)
     {
-        for(y = 0; y < OutputHeight; y++)
+        Channel = Row / OutputHeight;
+        y = Row % OutputHeight;
+        
+        for(x = 0, i = OutputWidth*Row; x < OutputWidth; x++, i++)
         {
-            for(x = 0; x < OutputWidth; x++, i++)
-            {
-                u[i] -= Temp[x + TransWidth*y];
-            }
+            u[i] -= Temp[x + TransWidth*y + TransNumPixels*Channel];
         }
-        
-        Temp += TransNumPixels;
     }
 }
 
@@ -686,30 +674,235 @@ static float ComputeDiff(const float *u, const float *uLast,
  * transforms).
  *
  * Beware that this routine is relatively computationally intense, requiring
- * around 2 to 20 seconds for outputs of typical sizes.  Multithreading is
- * applied in some computations if compiling with OpenMP.  Multithreading
- * appears to have little effect for smaller images but reduces run time by
- * about 25% for larger images.
+ * around 2 to 20 seconds for outputs of typical sizes.  If compiling with
+ * OpenMP, the image loops are divided by rows among the OpenMP threads and
+ * the FFTs run on the same threads, linking with the FFTW3 OpenMP library.
+ * The result does not depend on the number of threads.
  */
 int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
     const float *Input, int InputWidth, int InputHeight, double PsfSigma,
     double K, float Tol, int MaxMethodIter, int DiffIter)
+{
+    return RoussosInterpCore(u, OutputWidth, OutputHeight,
+        Input, InputWidth, InputHeight, PsfSigma,
+        K, Tol, MaxMethodIter, DiffIter, 3, 1, 0, NULL, NULL);
+}
+
+
+/**
+ * @brief Roussos-Maragos interpolation with a time limit
+ *
+ * @param TimeLimit time limit in milliseconds, or 0 for no limit
+ * @param Diff if non-NULL, set to the change in the last iteration, the
+ *        quantity compared with Tol
+ *
+ * @return 0 on failure, 1 on success, 2 if stopped by the time limit
+ *
+ * This is RoussosInterp() stopping once TimeLimit milliseconds have passed
+ * since the start of the call.  The clock is checked between iterations,
+ * after the projection, so the returned u is always consistent with the
+ * input image and the limit may be exceeded by about one iteration.  The
+ * other parameters are as in RoussosInterp().
+ */
+int RoussosInterpTimed(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    unsigned long TimeLimit, float *Diff)
+{
+    return RoussosInterpCore(u, OutputWidth, OutputHeight,
+        Input, InputWidth, InputHeight, PsfSigma,
+        K, Tol, MaxMethodIter, DiffIter, 3, 1, TimeLimit, Diff, NULL);
+}
+
+
+/** @brief Number of floats in the ConvTemp part of the workspace */
+static long ConvTempSize(int OutputWidth, int OutputHeight, int NumChannels)
+{
+    return 8L*((NumChannels > 3) ? NumChannels : 3)*OutputWidth*OutputHeight;
+}
+
+
+/** @brief Number of floats in the Temp part of the workspace */
+static long TempSize(int OutputWidth, int OutputHeight, int NumChannels)
+{
+    return 4L*((NumChannels > 1) ? NumChannels : 2)*OutputWidth*OutputHeight;
+}
+
+
+/** @brief Workspace size in floats for RoussosInterpCore() */
+static long CoreWorkspaceSize(int OutputWidth, int OutputHeight,
+    int NumChannels)
+{
+    /* ConvTemp, Temp, Phi, u0, uLast, Txx, Txy, Tyy, vx, vy */
+    return ConvTempSize(OutputWidth, OutputHeight, NumChannels)
+        + TempSize(OutputWidth, OutputHeight, NumChannels)
+        + (4L + 2*NumChannels + 5)*OutputWidth*OutputHeight;
+}
+
+
+/**
+ * @brief Advise the system to back a block of memory with huge pages
+ *
+ * On Linux, transparent huge pages are requested with madvise for the
+ * pages that lie entirely within the block.  Otherwise nothing is done.
+ * This is only a hint, the memory is usable either way.
+ */
+static void AdviseHugePages(void *Ptr, size_t Size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    const unsigned long PageSize = (unsigned long)sysconf(_SC_PAGESIZE);
+    unsigned long Start, End;
+    
+    if(PageSize > 0)
+    {
+        Start = ((unsigned long)Ptr + PageSize - 1) / PageSize * PageSize;
+        End = ((unsigned long)Ptr + Size) / PageSize * PageSize;
+        
+        if(End > Start)
+            madvise((void *)Start, End - Start, MADV_HUGEPAGE);
+    }
+#else
+    (void)Ptr;
+    (void)Size;
+#endif
+}
+
+
+/**
+ * @brief Allocate a workspace for RoussosInterpCore()
+ *
+ * The workspace is backed with huge pages where available.  It is first
+ * touched by the same row bands as the image loops, so that on NUMA systems
+ * each band of each buffer is placed on the node of the thread using it.
+ */
+static float *AllocWorkspace(int OutputWidth, int OutputHeight,
+    int NumChannels)
+{
+    const long Size = CoreWorkspaceSize(OutputWidth, OutputHeight,
+        NumChannels);
+    float *Workspace;
+    
+    if((Workspace = (float *)fftwf_malloc(sizeof(float)*Size)))
+    {
+        AdviseHugePages(Workspace, sizeof(float)*Size);
+#ifdef _OPENMP
+        #pragma omp parallel
+#endif
+        ZeroPlanes(Workspace, OutputWidth, OutputHeight,
+            (int)(Size / ((long)OutputWidth*OutputHeight)));
+    }
+    
+    return Workspace;
+}
+
+
+#ifdef _OPENMP
+/**
+ * @brief Run the FFTs on the OpenMP threads
+ *
+ * The FFTs then use the same threads that run the loops, so that the FFTs
+ * and loops do not oversubscribe the CPU.  FFTW's thread support is
+ * initialized on the first call only.  It is not cleaned up here, since
+ * the calling program may still be using FFTW; the program should call
+ * fftwf_cleanup_threads() when it is done with FFTW.
+ */
+static void InitFftwThreads(void)
+{
+    static int Initialized = 0;
+    
+    if(!Initialized)
+    {
+        Initialized = 1;
+        
+        if(fftwf_init_threads())
+            fftwf_plan_with_nthreads(omp_get_max_threads());
+    }
+}
+#endif
+
+
+/**
+ * @brief Workspace size needed for RoussosInterpEx()
+ *
+ * @param OutputWidth, OutputHeight output image dimensions
+ *
+ * @return required workspace size in units of floats
+ *
+ * The workspace is also large enough for any smaller output size.
+ */
+long RoussosInterpWorkspaceSize(int OutputWidth, int OutputHeight)
+{
+    return CoreWorkspaceSize(OutputWidth, OutputHeight, 3);
+}
+
+
+/**
+ * @brief Roussos-Maragos interpolation with a caller-provided workspace
+ *
+ * @param TimeLimit time limit in milliseconds, or 0 for no limit
+ * @param Diff if non-NULL, set to the change in the last iteration
+ * @param Workspace array of WorkspaceSize floats, or NULL to allocate the
+ *        workspace internally
+ * @param WorkspaceSize number of floats in Workspace, at least
+ *        RoussosInterpWorkspaceSize(OutputWidth, OutputHeight)
+ *
+ * @return 0 on failure, 1 on success, 2 if stopped by the time limit
+ *
+ * This is RoussosInterpTimed() using Workspace for its image buffers, so
+ * that a caller interpolating many images can allocate the workspace once
+ * and reuse it.  The call fails if WorkspaceSize is too small.  For the
+ * fastest DFTs, Workspace should be allocated with fftwf_malloc().  Its
+ * contents on entry do not matter and are overwritten.  The other
+ * parameters are as in RoussosInterp().
+ */
+int RoussosInterpEx(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    unsigned long TimeLimit, float *Diff, float *Workspace,
+    long WorkspaceSize)
+{
+    const long MinWorkspaceSize = RoussosInterpWorkspaceSize(
+        OutputWidth, OutputHeight);
+    
+    if(Workspace && WorkspaceSize < MinWorkspaceSize)
+    {
+        ErrorMessage("Workspace is too small, %ld floats needed.\n",
+            MinWorkspaceSize);
+        return 0;
+    }
+    
+    return RoussosInterpCore(u, OutputWidth, OutputHeight,
+        Input, InputWidth, InputHeight, PsfSigma,
+        K, Tol, MaxMethodIter, DiffIter, 3, 1, TimeLimit, Diff, Workspace);
+}
+
+
+/** @brief RoussosInterpEx() on NumChannels channels, optionally quiet */
+static int RoussosInterpCore(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    int NumChannels, int Verbose, unsigned long TimeLimit, float *DiffOut,
+    float *Workspace)
 {
     const int Padding = 5;
     const int OutputNumPixels = OutputWidth*OutputHeight;
-    const int OutputNumEl = 3*OutputNumPixels;
-    float *u0 = NULL, *Txx = NULL, *Txy = NULL, *Tyy = NULL, *Temp = NULL,
-        *ConvTemp = NULL, *vx = NULL, *vy = NULL, *Phi = NULL, *uLast = NULL;
+    const int OutputNumEl = NumChannels*OutputNumPixels;
+    float *u0, *Txx, *Txy, *Tyy, *Temp, *ConvTemp, *vx, *vy, *Phi, *uLast;
+    float *OwnWorkspace = NULL;
     fftwf_plan ForwardPlan = 0, InversePlan = 0;
     fftw_iodim Dims[2];
     fftw_iodim HowManyDims[1];
     filter PreSmooth = {NULL, 0, 0}, PostSmooth = {NULL, 0, 0};
     float PreSmoothSigma, PostSmoothSigma, Diff;
-    unsigned long StartTime, StopTime;
+    unsigned long CallTime, StartTime, StopTime;
     int TransWidth, TransHeight, TransNumPixels;
-    int Iter, ScaleFactor, Success = 0;
+    int Iter, ScaleFactor, TimedOut = 0, Success = 0;
 
     
+    CallTime = Clock();
+#ifdef _OPENMP
+    InitFftwThreads();
+#endif
     ScaleFactor = OutputWidth / InputWidth;
     PreSmoothSigma = 0.3f * ScaleFactor;
     PostSmoothSigma = 0.4f * ScaleFactor;
@@ -724,10 +917,12 @@ int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
     
     TransNumPixels = TransWidth*TransHeight;
     
-    printf("Initial interpolation\n");
+    if(Verbose)
+        printf("Initial interpolation\n");
     
     if(!FourierScale2d(u, OutputWidth, 0, OutputHeight, 0,
-        Input, InputWidth, InputHeight, 3, PsfSigma, BOUNDARY_HSYMMETRIC))
+        Input, InputWidth, InputHeight, NumChannels, PsfSigma,
+        BOUNDARY_HSYMMETRIC, Verbose))
         goto Catch;
     else if(MaxMethodIter <= 0)
     {
@@ -735,30 +930,35 @@ int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
         goto Catch;
     }
     
-    /* Allocate a fantastic amount of memory */
+    /* Allocate a fantastic amount of memory, unless the caller did */
     if(ScaleFactor <= 1
         || OutputWidth != ScaleFactor*InputWidth
         || OutputHeight != ScaleFactor*InputHeight
-        || !(ConvTemp = (float *)fftwf_malloc(sizeof(float)*24*OutputNumPixels))
-        || !(Temp = (float *)fftwf_malloc(sizeof(float)*12*OutputNumPixels))
-        || !(Phi = (float *)Malloc(sizeof(float)*4*OutputNumPixels))
-        || !(u0 = (float *)Malloc(sizeof(float)*3*OutputNumPixels))
-        || !(uLast = (float *)Malloc(sizeof(float)*3*OutputNumPixels))
-        || !(Txx = (float *)Malloc(sizeof(float)*OutputNumPixels))
-        || !(Txy = (float *)Malloc(sizeof(float)*OutputNumPixels))
-        || !(Tyy = (float *)Malloc(sizeof(float)*OutputNumPixels))
-        || !(vx = (float *)Malloc(sizeof(float)*OutputNumPixels))
-        || !(vy = (float *)Malloc(sizeof(float)*OutputNumPixels))
+        || (!Workspace && !(Workspace = OwnWorkspace =
+            AllocWorkspace(OutputWidth, OutputHeight, NumChannels)))
         || IsNullFilter(PreSmooth = GaussianFilter(PreSmoothSigma,
             (int)ceil(2.5*PreSmoothSigma)))
         || IsNullFilter(PostSmooth = GaussianFilter(PostSmoothSigma,
             (int)ceil(2.5*PostSmoothSigma))))
         goto Catch;
+    
+    /* Partition the workspace.  ConvTemp and Temp are first so that they
+       keep the alignment of the workspace for the DFTs. */
+    ConvTemp = Workspace;
+    Temp = ConvTemp + ConvTempSize(OutputWidth, OutputHeight, NumChannels);
+    Phi = Temp + TempSize(OutputWidth, OutputHeight, NumChannels);
+    u0 = Phi + 4*OutputNumPixels;
+    uLast = u0 + OutputNumEl;
+    Txx = uLast + OutputNumEl;
+    Txy = Txx + OutputNumPixels;
+    Tyy = Txy + OutputNumPixels;
+    vx = Tyy + OutputNumPixels;
+    vy = vx + OutputNumPixels;
 
     /* All arrays in the main computation are in planar order so that data
     access in convolutions and DFTs are more localized. */
 
-    HowManyDims[0].n = 3;
+    HowManyDims[0].n = NumChannels;
     HowManyDims[0].is = TransNumPixels;
     HowManyDims[0].os = TransNumPixels;
     
@@ -781,11 +981,12 @@ int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
         (fftwf_complex *)ConvTemp, Temp, FFTW_ESTIMATE | FFTW_DESTROY_INPUT)))
         goto Catch;
     
-    printf("Roussos-Maragos interpolation\n");
+    if(Verbose)
+        printf("Roussos-Maragos interpolation\n");
     StartTime = Clock();
         
-    MakePhi(Phi, PsfSigma, ScaleFactor, TransWidth, TransHeight);
-    memcpy(u0, u, sizeof(float)*3*OutputNumPixels);
+    MakePhi(Phi, Temp, PsfSigma, ScaleFactor, TransWidth, TransHeight);
+    memcpy(u0, u, sizeof(float)*OutputNumEl);
 
     /* Projected tensor-driven diffusion main loop */
     for(Iter = 1; Iter <= MaxMethodIter; Iter++)
@@ -793,48 +994,363 @@ int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
         memcpy(uLast, u, sizeof(float)*OutputNumEl);
         
         ComputeTensor(Txx, Txy, Tyy, Temp, ConvTemp, u,
-            OutputWidth, OutputHeight, PreSmooth, PostSmooth, K);
+            OutputWidth, OutputHeight, NumChannels, PreSmooth, PostSmooth, K);
         
         DiffuseWithTensor(u, vx, vy, Temp, Temp + OutputNumPixels, ConvTemp,
-            Txx, Txy, Tyy, OutputWidth, OutputHeight, DiffIter);
+            Txx, Txy, Tyy, OutputWidth, OutputHeight, NumChannels, DiffIter);
     
         Project(u, Temp, ConvTemp, ForwardPlan, InversePlan, u0, Phi,
-            ScaleFactor, OutputWidth, OutputHeight, Padding);
+            ScaleFactor, OutputWidth, OutputHeight, NumChannels, Padding);
         
         Diff = ComputeDiff(u, uLast, OutputNumEl);
         
         if(Iter >= 2 && Diff <= Tol)
         {
-            printf("Converged in %d iterations.\n", Iter);
+            if(Verbose)
+                printf("Converged in %d iterations.\n", Iter);
+            break;
+        }
+        
+        if(TimeLimit > 0 && Clock() - CallTime >= TimeLimit)
+        {
+            if(Verbose)
+                printf("Time limit reached after %d iterations.\n", Iter);
+            TimedOut = 1;
             break;
         }
     }
     
     StopTime = Clock();
     
-    if(Diff > Tol)
+    if(Verbose && !TimedOut && Diff > Tol)
         printf("Maximum number of iterations exceeded.\n");
         
-    printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
-    Success = 1;
+    if(Verbose)
+        printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    
+    if(DiffOut)
+        *DiffOut = Diff;
+    
+    Success = (TimedOut) ? 2 : 1;
 Catch:
     fftwf_destroy_plan(InversePlan);
     fftwf_destroy_plan(ForwardPlan);
-    fftwf_cleanup();
     Free(PostSmooth.Coeff);
     Free(PreSmooth.Coeff);
-    Free(vy);
-    Free(vx);
-    Free(Tyy);
-    Free(Txy);
-    Free(Txx);
-    Free(uLast);
-    Free(u0);
-    Free(Phi);
-    
-    if(Temp)
-        fftwf_free(Temp);
-    if(ConvTemp)
-        fftwf_free(ConvTemp);
+    
+    if(OwnWorkspace)
+        fftwf_free(OwnWorkspace);
+    return Success;
+}
+
+
+/** @brief Block size in input pixels for RoussosInterpHybrid() */
+#define HYBRID_BLOCKSIZE    32
+/** @brief Overlap margin in input pixels between hybrid blocks */
+#define HYBRID_MARGIN       6
+
+
+/** @brief Test whether a block of the input has any edge above Threshold */
+static int IsEdgeBlock(const float *Input, int InputWidth, int InputHeight,
+    int x0, int y0, int x1, int y1, float Threshold)
+{
+    const int InputNumPixels = InputWidth*InputHeight;
+    int x, y, k, i;
+    
+    for(k = 0; k < 3; k++, Input += InputNumPixels)
+        for(y = y0; y < y1; y++)
+            for(x = x0; x < x1; x++)
+            {
+                i = x + InputWidth*y;
+                
+                if((x + 1 < InputWidth
+                    && fabs(Input[i + 1] - Input[i]) > Threshold)
+                    || (y + 1 < InputHeight
+                    && fabs(Input[i + InputWidth] - Input[i]) > Threshold))
+                    return 1;
+            }
+    
+    return 0;
+}
+
+
+/**
+ * @brief Blending weight of a hybrid block along one dimension
+ *
+ * @param t output coordinate, Start <= t < End
+ * @param Start, End extent of the block with its margin
+ * @param Ramp length of the linear ramp
+ * @param Width output dimension
+ *
+ * The weight ramps linearly from 0 at the block boundary to 1 at distance
+ * Ramp, except at the image boundary where no ramp is needed.
+ */
+static float BlendRamp(int t, int Start, int End, int Ramp, int Width)
+{
+    float w = 1.0f;
+    
+    if(Start > 0 && t - Start < Ramp)
+        w = (t - Start + 0.5f)/Ramp;
+    if(End < Width && End - t <= Ramp && (End - t - 0.5f)/Ramp < w)
+        w = (End - t - 0.5f)/Ramp;
+    
+    return w;
+}
+
+
+/**
+ * @brief Edge-adaptive hybrid of Fourier and Roussos-Maragos interpolation
+ *
+ * @param u pointer to memory for holding the interpolated image
+ * @param OutputWidth, OutputHeight output image dimensions
+ * @param Input the input image
+ * @param InputWidth, InputHeight input image dimensions
+ * @param PsfSigma Gaussian PSF standard deviation
+ * @param K parameter for constructing the tensor
+ * @param Tol convergence tolerance
+ * @param MaxMethodIter maximum number of iterations
+ * @param DiffIter number of diffusion iterations per method iteration
+ * @param EdgeThreshold difference between neighboring input samples above
+ *        which a block is considered to contain edges
+ *
+ * @return 1 on success, 0 on failure
+ *
+ * The input is divided into blocks of HYBRID_BLOCKSIZE x HYBRID_BLOCKSIZE
+ * pixels.  Blocks without any neighboring difference above EdgeThreshold
+ * keep the Fourier interpolation used to initialize RoussosInterp().  Each
+ * remaining block is extended by HYBRID_MARGIN pixels on each side and
+ * interpolated with RoussosInterp().  The results are blended with weights
+ * that ramp linearly over the margins so that there are no seams between
+ * blocks, and the boundary effects of the block interpolations are hidden
+ * where their weight is small.  Since the DFTs in the projection are over
+ * the blocks rather than the whole image, the computation is proportional
+ * to the number of edge blocks.
+ */
+int RoussosInterpHybrid(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter, float EdgeThreshold)
+{
+    const int OutputNumPixels = OutputWidth*OutputHeight;
+    const int CropSize = HYBRID_BLOCKSIZE + 2*HYBRID_MARGIN;
+    float *Acc = NULL, *WeightSum = NULL, *Crop = NULL, *uCrop = NULL,
+        *Workspace = NULL;
+    float w, Rest;
+    unsigned long StartTime, StopTime;
+    int ScaleFactor, Ramp, bx, by, x0, y0, x1, y1, CropWidth, CropHeight;
+    int x, y, k, i, NumBlocks = 0, NumEdgeBlocks = 0, Success = 0;
+    
+    
+    ScaleFactor = OutputWidth / InputWidth;
+    Ramp = HYBRID_MARGIN*ScaleFactor;
+    
+    printf("Initial interpolation\n");
+    
+    if(!FourierScale2d(u, OutputWidth, 0, OutputHeight, 0,
+        Input, InputWidth, InputHeight, 3, PsfSigma, BOUNDARY_HSYMMETRIC, 1))
+        goto Catch;
+    else if(MaxMethodIter <= 0)
+    {
+        Success = 1;
+        goto Catch;
+    }
+    
+    if(ScaleFactor <= 1
+        || OutputWidth != ScaleFactor*InputWidth
+        || OutputHeight != ScaleFactor*InputHeight
+        || !(Acc = (float *)Malloc(sizeof(float)*3*OutputNumPixels))
+        || !(WeightSum = (float *)Malloc(sizeof(float)*OutputNumPixels))
+        || !(Crop = (float *)Malloc(sizeof(float)*3*CropSize*CropSize))
+        || !(uCrop = (float *)Malloc(sizeof(float)*3
+            *ScaleFactor*ScaleFactor*CropSize*CropSize))
+        || !(Workspace = AllocWorkspace(ScaleFactor*CropSize,
+            ScaleFactor*CropSize, 3)))
+        goto Catch;
+    
+    for(i = 0; i < OutputNumPixels; i++)
+        WeightSum[i] = 0;
+    for(i = 0; i < 3*OutputNumPixels; i++)
+        Acc[i] = 0;
+    
+    printf("Hybrid Roussos-Maragos interpolation\n");
+    StartTime = Clock();
+    
+    for(by = 0; by < InputHeight; by += HYBRID_BLOCKSIZE)
+        for(bx = 0; bx < InputWidth; bx += HYBRID_BLOCKSIZE)
+        {
+            NumBlocks++;
+            x1 = (bx + HYBRID_BLOCKSIZE < InputWidth) ?
+                bx + HYBRID_BLOCKSIZE : InputWidth;
+            y1 = (by + HYBRID_BLOCKSIZE < InputHeight) ?
+                by + HYBRID_BLOCKSIZE : InputHeight;
+            
+            if(!IsEdgeBlock(Input, InputWidth, InputHeight,
+                bx, by, x1, y1, EdgeThreshold))
+                continue;
+            
+            /* Extend the block by the margin */
+            x0 = (bx - HYBRID_MARGIN > 0) ? bx - HYBRID_MARGIN : 0;
+            y0 = (by - HYBRID_MARGIN > 0) ? by - HYBRID_MARGIN : 0;
+            x1 = (x1 + HYBRID_MARGIN < InputWidth) ?
+                x1 + HYBRID_MARGIN : InputWidth;
+            y1 = (y1 + HYBRID_MARGIN < InputHeight) ?
+                y1 + HYBRID_MARGIN : InputHeight;
+            CropWidth = x1 - x0;
+            CropHeight = y1 - y0;
+            
+            if(CropWidth < 3 || CropHeight < 3)
+                continue;
+            
+            NumEdgeBlocks++;
+            
+            for(k = 0; k < 3; k++)
+                for(y = 0; y < CropHeight; y++)
+                    for(x = 0; x < CropWidth; x++)
+                        Crop[x + CropWidth*(y + CropHeight*k)] =
+                            Input[x0 + x + InputWidth*(y0 + y
+                            + InputHeight*k)];
+            
+            if(!RoussosInterpCore(uCrop, ScaleFactor*CropWidth,
+                ScaleFactor*CropHeight, Crop, CropWidth, CropHeight,
+                PsfSigma, K, Tol, MaxMethodIter, DiffIter, 3, 0, 0, NULL,
+                Workspace))
+                goto Catch;
+            
+            /* Accumulate the block into the output with blending weights */
+            for(y = 0; y < ScaleFactor*CropHeight; y++)
+                for(x = 0; x < ScaleFactor*CropWidth; x++)
+                {
+                    w = BlendRamp(ScaleFactor*x0 + x, ScaleFactor*x0,
+                        ScaleFactor*x1, Ramp, OutputWidth)
+                        * BlendRamp(ScaleFactor*y0 + y, ScaleFactor*y0,
+                        ScaleFactor*y1, Ramp, OutputHeight);
+                    i = ScaleFactor*x0 + x
+                        + OutputWidth*(ScaleFactor*y0 + y);
+                    WeightSum[i] += w;
+                    
+                    for(k = 0; k < 3; k++)
+                        Acc[i + OutputNumPixels*k] += w*uCrop[x
+                            + ScaleFactor*CropWidth*(y
+                            + ScaleFactor*CropHeight*k)];
+                }
+        }
+    
+    /* Where the block weights sum to less than one, the remainder is filled
+       with the Fourier interpolation. */
+    for(i = 0; i < OutputNumPixels; i++)
+        if(WeightSum[i] > 0)
+        {
+            Rest = (WeightSum[i] < 1) ? 1 - WeightSum[i] : 0;
+            
+            for(k = 0; k < 3; k++)
+                u[i + OutputNumPixels*k] = (Acc[i + OutputNumPixels*k]
+                    + Rest*u[i + OutputNumPixels*k]) / (WeightSum[i] + Rest);
+        }
+    
+    StopTime = Clock();
+    printf("Interpolated %d of %d blocks.\n", NumEdgeBlocks, NumBlocks);
+    printf("CPU Time: %.3f s\n\n", 0.001*(StopTime - StartTime));
+    Success = 1;
+Catch:
+    if(Workspace)
+        fftwf_free(Workspace);
+    Free(uCrop);
+    Free(Crop);
+    Free(WeightSum);
+    Free(Acc);
+    return Success;
+}
+
+
+/**
+ * @brief Convert a planar RGB image to YCbCr (ITU-R BT.601, zero-centered
+ *        chroma) in place
+ */
+static void RgbToYCbCr(float *Image, int NumPixels)
+{
+    float *Cb = Image + NumPixels, *Cr = Image + 2*NumPixels;
+    float r, g, b;
+    int i;
+    
+    for(i = 0; i < NumPixels; i++)
+    {
+        r = Image[i];
+        g = Cb[i];
+        b = Cr[i];
+        Image[i] = 0.299f*r + 0.587f*g + 0.114f*b;
+        Cb[i] = -0.168736f*r - 0.331264f*g + 0.5f*b;
+        Cr[i] = 0.5f*r - 0.418688f*g - 0.081312f*b;
+    }
+}
+
+
+/** @brief Convert a planar YCbCr image to RGB in place */
+static void YCbCrToRgb(float *Image, int NumPixels)
+{
+    float *Cb = Image + NumPixels, *Cr = Image + 2*NumPixels;
+    float y, cb, cr;
+    int i;
+    
+    for(i = 0; i < NumPixels; i++)
+    {
+        y = Image[i];
+        cb = Cb[i];
+        cr = Cr[i];
+        Image[i] = y + 1.402f*cr;
+        Cb[i] = y - 0.344136f*cb - 0.714136f*cr;
+        Cr[i] = y + 1.772f*cb;
+    }
+}
+
+
+/**
+ * @brief Roussos-Maragos interpolation of luma with Fourier chroma
+ *
+ * @param u pointer to memory for holding the interpolated image
+ * @param OutputWidth, OutputHeight output image dimensions
+ * @param Input the input image
+ * @param InputWidth, InputHeight input image dimensions
+ * @param PsfSigma Gaussian PSF standard deviation
+ * @param K parameter for constructing the tensor
+ * @param Tol convergence tolerance
+ * @param MaxMethodIter maximum number of iterations
+ * @param DiffIter number of diffusion iterations per method iteration
+ *
+ * @return 1 on success, 0 on failure
+ *
+ * The input is converted to YCbCr.  The luma channel is interpolated with
+ * RoussosInterp() while the chroma channels are interpolated with the
+ * Fourier interpolation FourierScale2d() that RoussosInterp() uses for
+ * initialization.  Since the eye is much less sensitive to chroma detail,
+ * the loss in quality is small, while the tensor construction, diffusion,
+ * and projection DFTs are done on one channel instead of three.
+ */
+int RoussosInterpLumaChroma(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter)
+{
+    const int InputNumPixels = InputWidth*InputHeight;
+    const int OutputNumPixels = OutputWidth*OutputHeight;
+    float *InputYCbCr = NULL;
+    int Success = 0;
+    
+    
+    if(!(InputYCbCr = (float *)Malloc(sizeof(float)*3*InputNumPixels)))
+        goto Catch;
+    
+    memcpy(InputYCbCr, Input, sizeof(float)*3*InputNumPixels);
+    RgbToYCbCr(InputYCbCr, InputNumPixels);
+    
+    if(!FourierScale2d(u + OutputNumPixels, OutputWidth, 0, OutputHeight, 0,
+        InputYCbCr + InputNumPixels, InputWidth, InputHeight, 2, PsfSigma,
+        BOUNDARY_HSYMMETRIC, 1)
+        || !RoussosInterpCore(u, OutputWidth, OutputHeight,
+        InputYCbCr, InputWidth, InputHeight, PsfSigma,
+        K, Tol, MaxMethodIter, DiffIter, 1, 1, 0, NULL, NULL))
+        goto Catch;
+    
+    YCbCrToRgb(u, OutputNumPixels);
+    Success = 1;
+Catch:
+    Free(InputYCbCr);
     return Success;
 }
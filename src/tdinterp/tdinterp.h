@@ -9,5 +9,21 @@
 int RoussosInterp(float *u, int OutputWidth, int OutputHeight,
     const float *Input, int InputWidth, int InputHeight, double PsfSigma,
     double K, float Tol, int MaxMethodIter, int DiffIter);
+int RoussosInterpTimed(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    unsigned long TimeLimit, float *Diff);
+long RoussosInterpWorkspaceSize(int OutputWidth, int OutputHeight);
+int RoussosInterpEx(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter,
+    unsigned long TimeLimit, float *Diff, float *Workspace,
+    long WorkspaceSize);
+int RoussosInterpLumaChroma(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter);
+int RoussosInterpHybrid(float *u, int OutputWidth, int OutputHeight,
+    const float *Input, int InputWidth, int InputHeight, double PsfSigma,
+    double K, float Tol, int MaxMethodIter, int DiffIter, float EdgeThreshold);
 
 #endif /* _TDINTERP_H_ */
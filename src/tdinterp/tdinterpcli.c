@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <fftw3.h>
 
 #include "imageio.h"
 #include "tdinterp.h"
@@ -69,6 +70,10 @@ typedef struct
     int MaxMethodIter;
     /** @brief Number of diffusion iterations per method iteration */
     int DiffIter;
+    /** @brief Edge threshold for hybrid interpolation, 0 to disable */
+    double EdgeThreshold;
+    /** @brief Interpolate only luma with the method, chroma with Fourier */
+    int LumaChroma;
 } programparams;
 
 
@@ -86,7 +91,12 @@ static void PrintHelpMessage()
     puts("  -K <number>  K, parameter in constructing the tensor (default 1/255)");
     puts("  -t <number>  tol, convergence tolerance (default 3e-4)");
     puts("  -N <number>  N, maximum number of method iterations (default 50)");
-    puts("  -n <number>  n, number of diffusion steps per method iteration (default 5)\n");
+    puts("  -n <number>  n, number of diffusion steps per method iteration (default 5)");
+    puts("  -e <number>  edge threshold in [0,255] for hybrid interpolation,\n"
+         "               flat blocks use Fourier interpolation (default 0, off)");
+    puts("  -Y <number>  1 to apply the method to luma only and interpolate\n"
+         "               chroma with Fourier interpolation (default 0),\n"
+         "               cannot be combined with -e\n");
 #ifdef USE_LIBJPEG
     puts("  -q <number>  quality for saving JPEG images (0 to 100)\n");
 #endif
@@ -125,7 +135,22 @@ int main(int argc, char *argv[])
         goto Catch;
     
     /* Call the interpolation routine */
-    if(!(RoussosInterp(u.Data, u.Width, u.Height,
+    if(Param.LumaChroma)
+    {
+        if(!(RoussosInterpLumaChroma(u.Data, u.Width, u.Height,
+            v.Data, v.Width, v.Height, Param.PsfSigma, Param.K,
+            Param.Tol, Param.MaxMethodIter, Param.DiffIter)))
+            goto Catch;
+    }
+    else if(Param.EdgeThreshold > 0)
+    {
+        if(!(RoussosInterpHybrid(u.Data, u.Width, u.Height,
+            v.Data, v.Width, v.Height, Param.PsfSigma, Param.K,
+            Param.Tol, Param.MaxMethodIter, Param.DiffIter,
+            (float)(Param.EdgeThreshold/255))))
+            goto Catch;
+    }
+    else if(!(RoussosInterp(u.Data, u.Width, u.Height,
         v.Data, v.Width, v.Height, Param.PsfSigma, Param.K,
         Param.Tol, Param.MaxMethodIter, Param.DiffIter)))
         goto Catch;
@@ -140,6 +165,11 @@ int main(int argc, char *argv[])
 Catch:
     Free(u.Data);
     Free(v.Data);
+#ifdef _OPENMP
+    fftwf_cleanup_threads();
+#else
+    fftwf_cleanup();
+#endif
     return Status;
 }
 
@@ -170,6 +200,8 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
     Param->Tol = (float)DEFAULT_TOL;
     Param->MaxMethodIter = DEFAULT_MAXMETHODITER;
     Param->DiffIter = DEFAULT_DIFFITER;
+    Param->EdgeThreshold = 0;
+    Param->LumaChroma = 0;
 
     for(i = 1; i < argc;)
     {
@@ -252,6 +284,17 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
                     return 0;
                 }
                 break;
+            case 'Y':
+                Param->LumaChroma = atoi(OptionString);
+                break;
+            case 'e':
+                Param->EdgeThreshold = atof(OptionString);
+                if(Param->EdgeThreshold < 0)
+                {
+                    ErrorMessage("Edge threshold must be nonnegative.\n");
+                    return 0;
+                }
+                break;
 #ifdef USE_LIBJPEG
             case 'q':
                 Param->JpegQuality = atoi(OptionString);
@@ -293,6 +336,11 @@ static int ParseParams(programparams *Param, int argc, char *argv[])
         PrintHelpMessage();
         return 0;
     }
+    else if(Param->LumaChroma && Param->EdgeThreshold > 0)
+    {
+        ErrorMessage("Options -Y and -e cannot be combined.\n");
+        return 0;
+    }
     
     return 1;
 }
@@ -14,6 +14,10 @@
 
 #include "tvregopt.h"
 
+#ifndef DSOLVE_BLOCK
+/** @brief Number of pixels per block in the interior of DSolve */
+#define DSOLVE_BLOCK    256
+#endif
 
 /**
  * @brief Solve the d subproblem with vectorial shrinkage
@@ -35,7 +39,7 @@
  * Rather than representing b directly, we use  \f$ \tilde d = d - b \f$,
  * which is algebraically equivalent but requires less arithmetic.
  *
- * To represent the vector field d, we implement d as a numvec2 array of
+ * To represent the vector field d, we implement d as an auxvec2 array of
  * size Width x Height x NumChannels such that
 @code
     d[i + Width*(j + Height*k)].x = x-component at pixel (i,j) channel k,
@@ -43,11 +47,33 @@
 @endcode
  * where i = 0, ..., Width-1, j = 0, ..., Height-1, and k = 0, ...,
  * NumChannels-1.  This structure is also used for \f$ \tilde d \f$.
+ * 
+ * The components are stored as auxnum (see tvregopt.h), loaded and stored
+ * once per update.  The vectorial shrinkage needs the magnitude over all
+ * channels before any channel is updated, so the sum \f$ \nabla u + b \f$
+ * is computed twice rather than kept in d.
+ * 
+ * Interior points are processed in blocks of DSOLVE_BLOCK pixels along a
+ * row.  The magnitudes of a block are accumulated over the channels into
+ * Scale, converted to shrinkage factors, and applied to every channel.
+ * These loops have no branches and unit stride, so that the compiler
+ * vectorizes them.  The right and bottom edges are handled separately.
+ *
+ * This file is included by tvreg.c once for each instruction set level,
+ * with DSOLVE_FUNC defined as the name of the function to define and
+ * DSOLVE_ISA as the target, or not defined for the baseline.  The
+ * arithmetic is the same for every level, so with the -ansi build, where
+ * the compiler does not contract multiplies and adds into fused
+ * multiply-adds, the result does not depend on the level.
  */
-static void DSolve(tvregsolver *S)
+static
+#ifdef DSOLVE_ISA
+ATTRIBUTE_TARGET(DSOLVE_ISA)
+#endif
+void DSOLVE_FUNC(tvregsolver *S)
 {
-    numvec2 *d = S->d;
-    numvec2 *dtilde = S->dtilde;
+    auxvec2 *d = S->d;
+    auxvec2 *dtilde = S->dtilde;
     const num *u = S->u;
     const int Width = S->Width;
     const int Height = S->Height;
@@ -56,71 +82,74 @@ static void DSolve(tvregsolver *S)
     const num ThreshSquared = Thresh * Thresh;
     const long ChannelStride = ((long)Width) * ((long)Height);
     const long NumEl = NumChannels * ChannelStride;
-    numvec2 dnew;
-    num Magnitude;
+    num Scale[DSOLVE_BLOCK];
+    num dx, dy, Magnitude;
     long i;
-    int x, y;
+    int x, y, x0, Count;
     
-    for(y = 0; y < Height - 1; y++, d++, dtilde++, u++)
+    for(y = 0; y < Height - 1; y++, d += Width, dtilde += Width, u += Width)
     {
         /* Perform vectorial shrinkage for interior points */
-        for(x = 0; x < Width - 1; x++, d++, dtilde++, u++)
+        for(x0 = 0; x0 < Width - 1; x0 += Count)
         {
-            for(i = 0, Magnitude = 0; i < NumEl; i += ChannelStride)
-            {
-                d[i].x += (u[i + 1]     - u[i]) - dtilde[i].x;
-                d[i].y += (u[i + Width] - u[i]) - dtilde[i].y;
-                Magnitude += d[i].x*d[i].x + d[i].y*d[i].y;
-            }
+            Count = (Width - 1 - x0 < DSOLVE_BLOCK) 
+                ? Width - 1 - x0 : DSOLVE_BLOCK;
+            
+            for(x = 0; x < Count; x++)
+                Scale[x] = 0;
             
-            if(Magnitude > ThreshSquared)
-            {
-                Magnitude = 1 - Thresh/(num)sqrt(Magnitude);
-                
-                for(i = 0; i < NumEl; i += ChannelStride)
+            for(i = x0; i < NumEl; i += ChannelStride)
+                for(x = 0; x < Count; x++)
                 {
-                    dnew.x = Magnitude*d[i].x;
-                    dnew.y = Magnitude*d[i].y;
-                    dtilde[i].x = 2*dnew.x - d[i].x;
-                    dtilde[i].y = 2*dnew.y - d[i].y;
-                    d[i] = dnew;
+                    dx = AUXLOAD(d[i + x].x)
+                        + (u[i + x + 1] - u[i + x] 
+                        - AUXLOAD(dtilde[i + x].x));
+                    dy = AUXLOAD(d[i + x].y)
+                        + (u[i + x + Width] - u[i + x] 
+                        - AUXLOAD(dtilde[i + x].y));
+                    Scale[x] += dx*dx + dy*dy;
                 }
-            }
-            else
-                for(i = 0; i < NumEl; i += ChannelStride)
+            
+            /* Shrinkage factor, zero where the magnitude is below Thresh */
+            for(x = 0; x < Count; x++)
+                Scale[x] = (Scale[x] > ThreshSquared) 
+                    ? 1 - Thresh/(num)sqrt(Scale[x]) : 0;
+            
+            for(i = x0; i < NumEl; i += ChannelStride)
+                for(x = 0; x < Count; x++)
                 {
-                    dtilde[i].x = -d[i].x;
-                    dtilde[i].y = -d[i].y;
-                    d[i].x = 0;
-                    d[i].y = 0;
+                    dx = AUXLOAD(d[i + x].x)
+                        + (u[i + x + 1] - u[i + x] 
+                        - AUXLOAD(dtilde[i + x].x));
+                    dy = AUXLOAD(d[i + x].y)
+                        + (u[i + x + Width] - u[i + x] 
+                        - AUXLOAD(dtilde[i + x].y));
+                    dtilde[i + x].x = AUXSTORE(2*(Scale[x]*dx) - dx);
+                    dtilde[i + x].y = AUXSTORE(2*(Scale[x]*dy) - dy);
+                    d[i + x].x = AUXSTORE(Scale[x]*dx);
+                    d[i + x].y = AUXSTORE(Scale[x]*dy);
                 }
         }
         
         /* Right edge */
-        for(i = 0, Magnitude = 0; i < NumEl; i += ChannelStride)
+        for(i = Width - 1, Magnitude = 0; i < NumEl; i += ChannelStride)
         {
-            d[i].y += (u[i + Width] - u[i]) - dtilde[i].y;
-            Magnitude += d[i].y*d[i].y;
-            d[i].x = dtilde[i].x = 0;
+            dy = AUXLOAD(d[i].y) 
+                + (u[i + Width] - u[i] - AUXLOAD(dtilde[i].y));
+            Magnitude += dy*dy;
         }
         
-        if(Magnitude > ThreshSquared)
+        Magnitude = (Magnitude > ThreshSquared) 
+            ? 1 - Thresh/(num)sqrt(Magnitude) : 0;
+        
+        for(i = Width - 1; i < NumEl; i += ChannelStride)
         {
-            Magnitude = 1 - Thresh/(num)sqrt(Magnitude);
-            
-            for(i = 0; i < NumEl; i += ChannelStride)
-            {
-                dnew.y = Magnitude*d[i].y;
-                dtilde[i].y = 2*dnew.y - d[i].y;
-                d[i].y = dnew.y;
-            }
+            dy = AUXLOAD(d[i].y) 
+                + (u[i + Width] - u[i] - AUXLOAD(dtilde[i].y));
+            dtilde[i].y = AUXSTORE(2*(Magnitude*dy) - dy);
+            d[i].y = AUXSTORE(Magnitude*dy);
+            d[i].x = dtilde[i].x = AUXSTORE(0);
         }
-        else
-            for(i = 0; i < NumEl; i += ChannelStride)
-            {
-                dtilde[i].y = -d[i].y;
-                d[i].y = 0;
-            }
     }
     
     /* Bottom edge */
@@ -128,31 +157,25 @@ static void DSolve(tvregsolver *S)
     {
         for(i = 0, Magnitude = 0; i < NumEl; i += ChannelStride)
         {
-            d[i].x += (u[i + 1] - u[i]) - dtilde[i].x;
-            Magnitude += d[i].x*d[i].x;
-            d[i].y = dtilde[i].y = 0;
+            dx = AUXLOAD(d[i].x) 
+                + (u[i + 1] - u[i] - AUXLOAD(dtilde[i].x));
+            Magnitude += dx*dx;
         }
         
-        if(Magnitude > ThreshSquared)
+        Magnitude = (Magnitude > ThreshSquared) 
+            ? 1 - Thresh/(num)sqrt(Magnitude) : 0;
+        
+        for(i = 0; i < NumEl; i += ChannelStride)
         {
-            Magnitude = 1 - Thresh/(num)sqrt(Magnitude);
-            
-            for(i = 0; i < NumEl; i += ChannelStride)
-            {
-                dnew.x = Magnitude*d[i].x;
-                dtilde[i].x = 2*dnew.x - d[i].x;
-                d[i].x = dnew.x;
-            }
+            dx = AUXLOAD(d[i].x) 
+                + (u[i + 1] - u[i] - AUXLOAD(dtilde[i].x));
+            dtilde[i].x = AUXSTORE(2*(Magnitude*dx) - dx);
+            d[i].x = AUXSTORE(Magnitude*dx);
+            d[i].y = dtilde[i].y = AUXSTORE(0);
         }
-        else
-            for(i = 0; i < NumEl; i += ChannelStride)
-            {
-                dtilde[i].x = -d[i].x;
-                d[i].x = 0;
-            }
     }
     
     /* Bottom-right corner */
     for(i = 0; i < NumEl; i += ChannelStride)
-        d[i].x = d[i].y = dtilde[i].x = dtilde[i].y = 0;
+        d[i].x = d[i].y = dtilde[i].x = dtilde[i].y = AUXSTORE(0);
 }
@@ -25,6 +25,9 @@
 #include "cliio.h"
 #include "kernels.h"
 
+/** @brief Number of iterations between checkpoints */
+#define CHECKPOINT_INTERVAL     10
+
 
 /** @brief Program parameters struct */
 typedef struct
@@ -42,6 +45,8 @@ typedef struct
     image Kernel;
     /** @brief Noise model */
     const char *Noise;
+    /** @brief Checkpoint file for resuming, or NULL */
+    const char *CheckpointFile;
 } programparams;
 
 
@@ -62,6 +67,7 @@ static void PrintHelpMessage()
     puts("      noise:gaussian          additive Gaussian noise (default)");
     puts("      noise:laplace           Laplace noise");
     puts("      noise:poisson           Poisson noise");
+    puts("  checkpoint:<file>      save progress to <file> and resume from it");
     puts("  f:<file>               input file (alternative syntax)");
     puts("  u:<file>               output file (alternative syntax)");
 #ifdef USE_LIBJPEG
@@ -71,7 +77,8 @@ static void PrintHelpMessage()
     "   iminttvdeconv noise:gaussian:5 K:disk:2 input.bmp blurry.bmp\n");
 }
 
-int TvDeconv(image u, image f, image Kernel, num Lambda, const char *Noise);
+int TvDeconv(image u, image f, image Kernel, num Lambda, const char *Noise,
+    const char *CheckpointFile);
 int ParseParams(programparams *Params, int argc, const char *argv[]);
 
 int main(int argc, char **argv)
@@ -92,7 +99,8 @@ int main(int argc, char **argv)
         goto Catch;
     }
     
-    if(!TvDeconv(u, f, Params.Kernel, Params.Lambda, Params.Noise))
+    if(!TvDeconv(u, f, Params.Kernel, Params.Lambda, Params.Noise,
+        Params.CheckpointFile))
         goto Catch;
     
     /* Write the deconvolved image */
@@ -108,7 +116,8 @@ Catch:
 }
 
 
-int TvDeconv(image u, image f, image Kernel, num Lambda, const char *Noise)
+int TvDeconv(image u, image f, image Kernel, num Lambda, const char *Noise,
+    const char *CheckpointFile)
 {
     tvregopt *Opt = NULL;
     int Success;
@@ -130,6 +139,7 @@ int TvDeconv(image u, image f, image Kernel, num Lambda, const char *Noise)
     TvRegSetKernel(Opt, Kernel.Data, Kernel.Width, Kernel.Height);
     TvRegSetLambda(Opt, Lambda);
     TvRegSetMaxIter(Opt, 140);
+    TvRegSetCheckpoint(Opt, CheckpointFile, CHECKPOINT_INTERVAL);
     
     if(!(Success = TvRestore(u.Data, f.Data,
         f.Width, f.Height, f.NumChannels, Opt)))
@@ -158,6 +168,7 @@ int ParseParams(programparams *Params, int argc, const char *argv[])
     Params->Lambda = 20;
     Params->Kernel = NullImage;
     Params->Noise = "gaussian";
+    Params->CheckpointFile = NULL;
         
     if(argc < 2)
     {
@@ -237,6 +248,16 @@ int ParseParams(programparams *Params, int argc, const char *argv[])
             else
                 Params->Noise = Value;
         }
+        else if(!strcmp(Param, "checkpoint"))
+        {
+            if(!Value)
+            {
+                fprintf(stderr, "Expected a value for option %s.\n", Param);
+                return 0;
+            }
+            else
+                Params->CheckpointFile = Value;
+        }
         else if(!strcmp(Param, "jpegquality"))
         {
             if(!CliGetNum(&NumValue, Value, Param))
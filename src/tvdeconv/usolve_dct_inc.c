@@ -148,6 +148,37 @@ static int InitDeconvDct(tvregsolver *S)
 }
 
 
+/**
+ * @brief Change Alpha in DCT-based deconvolution (UseZ = 0)
+ * @param S tvreg solver state, prepared by InitDeconvDct()
+ * @param Alpha the new value of Lambda/Gamma1
+ *
+ * S->DenomTrans and S->ATrans depend on Alpha only through the terms
+ * Alpha . KernelTrans^2 and Alpha . KernelTrans . DCT[f], so they are
+ * updated in place rather than recomputed by InitDeconvDct().
+ */
+static void UpdateDeconvDct(tvregsolver *S, num Alpha)
+{
+    num *ATrans = S->ATrans;
+    num *DenomTrans = S->DenomTrans;
+    const num *KernelTrans = S->KernelTrans;
+    const long NumPixels = ((long)S->Width) * ((long)S->Height);
+    const num Delta = (num)(4*NumPixels*(Alpha - S->Alpha));
+    const num Ratio = Alpha / S->Alpha;
+    long i;
+    int k;
+    
+    for(i = 0; i < NumPixels; i++)
+        DenomTrans[i] += Delta*KernelTrans[i]*KernelTrans[i];
+    
+    for(k = 0; k < S->NumChannels; k++, ATrans += NumPixels)
+        for(i = 0; i < NumPixels; i++)
+            ATrans[i] *= Ratio;
+    
+    S->Alpha = Alpha;
+}
+
+
 /**
  * @brief Compute BTrans = ( ATrans - DCT[div(dtilde)] ) / DenomTrans
  *
@@ -155,7 +186,7 @@ static int InitDeconvDct(tvregsolver *S)
  * to both the d,u splitting (UseZ = 0) and d,u,z splitting (UseZ = 1).
  */
 static void UTransSolveDct(num *BTrans, num *B, FFT(plan) TransformB,
-    num *ATrans, const numvec2 *dtilde,
+    num *ATrans, const auxvec2 *dtilde,
     const num *DenomTrans, int Width, int Height, int NumChannels)
 {
     const long NumPixels = ((long)Width) * ((long)Height);
@@ -174,6 +174,42 @@ static int InitDeconvFourier(tvregsolver *S)
 }
 
 
+/**
+ * @brief Change Alpha in DFT-based deconvolution (UseZ = 0)
+ * @param S tvreg solver state, prepared by InitDeconvFourier()
+ * @param Alpha the new value of Lambda/Gamma1
+ *
+ * Same as UpdateDeconvDct(), S->DenomTrans and S->ATrans are updated in
+ * place for the new Alpha.
+ */
+static void UpdateDeconvFourier(tvregsolver *S, num Alpha)
+{
+    numcomplex *ATrans = (numcomplex *)S->ATrans;
+    const numcomplex *KernelTrans = (const numcomplex *)S->KernelTrans;
+    num *DenomTrans = S->DenomTrans;
+    const long PadNumPixels = ((long)S->PadWidth) * ((long)S->PadHeight);
+    const long TransNumPixels = ((long)(S->PadWidth/2 + 1))
+        * ((long)S->PadHeight);
+    const num Delta = (num)(PadNumPixels*(Alpha - S->Alpha));
+    const num Ratio = Alpha / S->Alpha;
+    long i;
+    int k;
+    
+    for(i = 0; i < TransNumPixels; i++)
+        DenomTrans[i] += Delta*(KernelTrans[i][0]*KernelTrans[i][0]
+            + KernelTrans[i][1]*KernelTrans[i][1]);
+    
+    for(k = 0; k < S->NumChannels; k++, ATrans += TransNumPixels)
+        for(i = 0; i < TransNumPixels; i++)
+        {
+            ATrans[i][0] *= Ratio;
+            ATrans[i][1] *= Ratio;
+        }
+    
+    S->Alpha = Alpha;
+}
+
+
 /**
  * @brief Compute BTrans = ( ATrans - DFT[div(dtilde)] ) / DenomTrans
  *
@@ -181,7 +217,7 @@ static int InitDeconvFourier(tvregsolver *S)
  * to both the d,u splitting (UseZ=0) and d,u,z splitting (UseZ=1).
  */
 static void UTransSolveFourier(numcomplex *BTrans, num *B, FFT(plan) TransformB,
-    numcomplex *ATrans, const numvec2 *dtilde,
+    numcomplex *ATrans, const auxvec2 *dtilde,
     const num *DenomTrans, int Width, int Height, int NumChannels)
 {
     const long PadWidth = 2*Width;
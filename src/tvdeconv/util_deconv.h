@@ -38,7 +38,7 @@
  * +V^y_{i,j}-V^y_{i,j-1}, \f]
  * for i = 1, ..., Width-2, j = 1, ..., Height-2.
  *
- * The input vector field V is represented as an array of numvec2 elements,
+ * The input vector field V is represented as an array of auxvec2 elements,
 @code
     V[i + Width*(j + Height*k)].x = x-component at pixel (i,j) channel k,
     V[i + Width*(j + Height*k)].y = y-component at pixel (i,j) channel k,
@@ -47,44 +47,44 @@
  * NumChannels-1.
  */
 static void Divergence(num *DivV, int DivWidth, int DivHeight,
-    const numvec2 *V, int Width, int Height, int NumChannels)
+    const auxvec2 *V, int Width, int Height, int NumChannels)
 {
     int x, y, k;
     
     for(k = 0; k < NumChannels; k++)
     {
         /* Top-left corner */
-        DivV[0] = V[0].x + V[0].y;
+        DivV[0] = AUXLOAD(V[0].x) + AUXLOAD(V[0].y);
         
         /* Top row, x = 1, ..., Width - 2 */
         for(x = 1; x < Width - 1; x++)
-            DivV[x] = V[x].x - V[x - 1].x + V[x].y;
+            DivV[x] = AUXLOAD(V[x].x) - AUXLOAD(V[x - 1].x) + AUXLOAD(V[x].y);
         
         /* Top-right corner */
-        DivV[x] = V[x].y;
+        DivV[x] = AUXLOAD(V[x].y);
         DivV += DivWidth;
         V += Width;
         
         for(y = 1; y < Height - 1; y++, DivV += DivWidth, V += Width)
         {
             /* Left edge */
-            DivV[0] = V[0].x + V[0].y - V[-Width].y;
+            DivV[0] = AUXLOAD(V[0].x) + AUXLOAD(V[0].y) - AUXLOAD(V[-Width].y);
             
             /* Interior */
             for(x = 1; x < Width - 1; x++)
-                DivV[x] = V[x].x - V[x - 1].x
-                    + V[x].y - V[x - Width].y;
+                DivV[x] = AUXLOAD(V[x].x) - AUXLOAD(V[x - 1].x)
+                    + AUXLOAD(V[x].y) - AUXLOAD(V[x - Width].y);
             
             /* Top-right corner */
-            DivV[x] = V[x].y - V[x - Width].y;
+            DivV[x] = AUXLOAD(V[x].y) - AUXLOAD(V[x - Width].y);
         }
         
         /* Bottom-reft corner */
-        DivV[0] = V[0].x;
+        DivV[0] = AUXLOAD(V[0].x);
         
         /* Bottom row, x = 1, ..., Width - 2 */
         for(x = 1; x < Width - 1; x++)
-            DivV[x] = V[x].x - V[x - 1].x;
+            DivV[x] = AUXLOAD(V[x].x) - AUXLOAD(V[x - 1].x);
         
         /* Bottom-right corner */
         DivV[x] = 0;
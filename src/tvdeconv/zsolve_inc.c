@@ -123,13 +123,8 @@ static void ZSolvePoisson(tvregsolver *S)
                 {
 #                   if _FIDELITY == 1      /* L1 fidelity      */
                         znew = Ku[x] - f[x] + z[x] - ztilde[x];
-                
-                        if(znew > Beta)
-                            znew += f[x] - Beta;
-                        else if(znew < -Beta)
-                            znew += f[x] + Beta;
-                        else
-                            znew = f[x];
+                        znew = (znew > Beta) ? znew + (f[x] - Beta)
+                            : (znew < -Beta) ? znew + (f[x] + Beta) : f[x];
 #                   elif _FIDELITY == 2    /* L2 fidelity      */
                         znew = (Ku[x] + z[x] - ztilde[x] + Beta*f[x])
                             / (1 + Beta);
@@ -158,13 +153,8 @@ static void ZSolvePoisson(tvregsolver *S)
                     
 #                   if _FIDELITY == 1      /* L1 fidelity      */
                         znew = Ku[x] - f[x] + z[x] - ztilde[x];
-                
-                        if(znew > Beta)
-                            znew += f[x] - Beta;
-                        else if(znew < -Beta)
-                            znew += f[x] + Beta;
-                        else
-                            znew = f[x];
+                        znew = (znew > Beta) ? znew + (f[x] - Beta)
+                            : (znew < -Beta) ? znew + (f[x] + Beta) : f[x];
 #                   elif _FIDELITY == 2    /* L2 fidelity      */
                         znew = (Ku[x] + z[x] - ztilde[x] + Beta*f[x])
                             / (1 + Beta);
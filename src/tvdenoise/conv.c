@@ -124,23 +124,54 @@ void SeparableConv2D(float *Dest, float *Buffer, const float *Src,
     filter FilterX, filter FilterY, boundaryext Boundary, 
     int Width, int Height, int NumChannels)
 {
-    const int NumPixels = Width*Height;
+    imageview DestView, SrcView;
+
+    DestView.Data = Dest;
+    DestView.Width = Width;
+    DestView.Height = Height;
+    DestView.NumChannels = NumChannels;
+    DestView.PixelStride = 1;
+    DestView.RowStride = Width;
+    DestView.ChannelStride = Width*Height;
+    DestView.Base = NULL;
+    SrcView = DestView;
+    SrcView.Data = (float *)Src;
+    SeparableConv2DView(DestView, Buffer, SrcView,
+        FilterX, FilterY, Boundary);
+}
+
+
+/**
+ * @brief Separable 2D FIR convolution of strided image views
+ *
+ * @param Dest view of the output image, same dimensions as Src
+ * @param Buffer workspace buffer of size Src.Width*Src.Height
+ * @param Src view of the input image
+ * @param FilterX the horizontal filter
+ * @param FilterY the vertical filter
+ * @param Boundary boundary extension
+ *
+ * Src and Dest may be crops of larger images, have padded rows, or have
+ * interleaved channels.  The image outside of the view is not accessed, the
+ * boundaries of the view are handled with Boundary.
+ */
+void SeparableConv2DView(imageview Dest, float *Buffer, imageview Src,
+    filter FilterX, filter FilterY, boundaryext Boundary)
+{
     int i, Channel;
-    
-    for(Channel = 0; Channel < NumChannels; Channel++)
+
+    for(Channel = 0; Channel < Src.NumChannels; Channel++)
     {
         /* Filter Src horizontally and store the result in Buffer */
-        for(i = 0; i < Height; i++)
-            Conv1D(Buffer + Width*i, 1, Src + Width*i, 1, 
-                FilterX, Boundary, Width);
-        
+        for(i = 0; i < Src.Height; i++)
+            Conv1D(Buffer + Src.Width*i, 1,
+                IMAGEVIEW_PTR(Src, 0, i, Channel), Src.PixelStride,
+                FilterX, Boundary, Src.Width);
+
         /* Filter Buffer vertically and store the result in Dest */
-        for(i = 0; i < Width; i++)
-            Conv1D(Dest + i, Width, Buffer + i, Width, FilterY, 
-                Boundary, Height);
-            
-        Src += NumPixels;
-        Dest += NumPixels;
+        for(i = 0; i < Src.Width; i++)
+            Conv1D(IMAGEVIEW_PTR(Dest, i, 0, Channel), Dest.RowStride,
+                Buffer + i, Src.Width, FilterY, Boundary, Src.Height);
     }
 }
 
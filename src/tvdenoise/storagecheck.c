@@ -0,0 +1,143 @@
+/**
+ * @file storagecheck.c
+ * @brief Check of the 16-bit storage of the auxiliary variables
+ *
+ * This program denoises an image corrupted by Gaussian noise generated with
+ * a fixed seed, then prints the number of iterations that TvRestore needed
+ * to reach the tolerance and the PSNR of the result.  It is built once for
+ * each storage format of d and dtilde (32-bit, or 16-bit with TVREG_FP16 or
+ * TVREG_BF16, see tvregopt.h), and "make check-storage" runs storagecheck.sh
+ * to compare the outputs of the builds on einstein.bmp.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include "num.h"
+#include "tvreg.h"
+#include "randmt.h"
+#include <ipol/imageio.h>
+
+/** @brief Noise standard deviation, relative to intensities in [0,255] */
+#define NOISE_SIGMA         15
+/** @brief Seed of the noise, fixed so that every build sees the same input */
+#define NOISE_SEED          1
+/** @brief Stopping tolerance, the same as for the final solve of tvdenoise */
+#define TOL                 5e-4
+/** @brief Maximum number of iterations */
+#define MAX_ITER            100
+
+#ifdef NUM_SINGLE
+#define IMAGEIO_NUM           (IMAGEIO_SINGLE)
+#else
+#define IMAGEIO_NUM           (IMAGEIO_DOUBLE)
+#endif
+
+#if defined(TVREG_FP16)
+#define STORAGE_NAME        "fp16"
+#elif defined(TVREG_BF16)
+#define STORAGE_NAME        "bf16"
+#else
+#define STORAGE_NAME        "f32"
+#endif
+
+
+/** @brief PlotFun recording the final iteration count and state */
+static int RecordIterations(int State, int Iter, num Delta,
+    const num *u, int Width, int Height, int NumChannels, void *Param)
+{
+    int *Result = (int *)Param;
+
+    (void)Delta;
+    (void)u;
+    (void)Width;
+    (void)Height;
+    (void)NumChannels;
+
+    if(State > 0)
+    {
+        Result[0] = State;
+        Result[1] = Iter;
+    }
+
+    return 1;
+}
+
+
+int main(int argc, char **argv)
+{
+    const num Sigma = (num)NOISE_SIGMA / 255;
+    num *Clean = NULL, *f = NULL, *u = NULL;
+    tvregopt *Opt = NULL;
+    double Mse, Diff;
+    long i, NumEl;
+    int Width, Height, Result[2] = {0, 0}, Status = 1;
+
+    if(argc != 2)
+    {
+        puts("Usage: tvstoragecheck <image>\n\n"
+            "Prints the iteration count and PSNR of denoising the image with "
+            "Gaussian\nnoise of standard deviation 15, using "
+            STORAGE_NAME " storage of d and dtilde.");
+        return 0;
+    }
+
+    /* Read the image, the clean reference */
+    if(!(Clean = (num *)ReadImage(&Width, &Height, argv[1],
+        IMAGEIO_RGB | IMAGEIO_PLANAR | IMAGEIO_NUM)))
+        goto Catch;
+
+    NumEl = 3 * ((long)Width) * ((long)Height);
+
+    if(!(f = (num *)Malloc(sizeof(num)*NumEl))
+        || !(u = (num *)Malloc(sizeof(num)*NumEl))
+        || !(Opt = TvRegNewOpt()))
+        goto Catch;
+
+    /* Add Gaussian noise with a fixed seed */
+    init_randmt(NOISE_SEED);
+
+    for(i = 0; i < NumEl; i++)
+        u[i] = f[i] = Clean[i] + Sigma*(num)rand_normal();
+
+    /* Denoise with the empirical lambda estimate of tvdenoise */
+    TvRegSetLambda(Opt, (num)(0.7079 / Sigma + 0.002686 / (Sigma * Sigma)));
+    TvRegSetTol(Opt, (num)TOL);
+    TvRegSetMaxIter(Opt, MAX_ITER);
+    TvRegSetPlotFun(Opt, RecordIterations, Result);
+
+    if(!TvRestore(u, f, Width, Height, 3, Opt))
+    {
+        fprintf(stderr, "Error in computation.\n");
+        goto Catch;
+    }
+
+    for(i = 0, Mse = 0; i < NumEl; i++)
+    {
+        Diff = (u[i] < 0) ? 0 : (u[i] > 1) ? 1 : u[i];
+        Diff -= Clean[i];
+        Mse += Diff * Diff;
+    }
+
+    Mse /= NumEl;
+
+    /* Print the storage, the iteration count (negative if not converged),
+       and the PSNR in dB */
+    printf("%s %d %.4f\n", STORAGE_NAME,
+        (Result[0] == 1) ? Result[1] : -Result[1], -10*log10(Mse));
+    Status = (Result[0] == 1) ? 0 : 1;
+Catch:
+    TvRegFreeOpt(Opt);
+    if(u)
+        Free(u);
+    if(f)
+        Free(f);
+    if(Clean)
+        Free(Clean);
+    return Status;
+}
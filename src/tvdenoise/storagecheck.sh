@@ -0,0 +1,40 @@
+#! /bin/sh
+# Check that storing the auxiliary variables d and dtilde as 16-bit floats
+# (TVREG_FP16 or TVREG_BF16) converges like 32-bit storage: the iteration
+# counts to reach the tolerance may differ by at most MAX_ITER_DIFF and the
+# PSNRs by at most MAX_PSNR_DIFF dB.  Run by "make check-storage", which
+# builds the tvstoragecheck_* programs.
+
+IMAGE=${1:-einstein.bmp}
+MAX_ITER_DIFF=1
+MAX_PSNR_DIFF=0.01
+
+echo "storage iterations PSNR"
+
+if ! Ref=`./tvstoragecheck_f32 $IMAGE`; then
+    echo "f32 did not converge: $Ref"
+    echo "FAIL"
+    exit 1
+fi
+
+echo "$Ref"
+Status=0
+
+for Storage in fp16 bf16; do
+    Out=`./tvstoragecheck_$Storage $IMAGE`
+    echo "$Out"
+    
+    # Fields are: storage iterations PSNR, iterations < 0 if not converged
+    echo "$Ref $Out" | awk -v MaxIter=$MAX_ITER_DIFF -v MaxPsnr=$MAX_PSNR_DIFF '
+        function abs(x) { return (x < 0) ? -x : x }
+        { Ok = $5 > 0 && abs($5 - $2) <= MaxIter && abs($6 - $3) <= MaxPsnr
+          exit !Ok }' || Status=1
+done
+
+if [ $Status -eq 0 ]; then
+    echo "PASS"
+else
+    echo "FAIL"
+fi
+
+exit $Status
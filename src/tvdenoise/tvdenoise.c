@@ -258,6 +258,8 @@ int Denoise(image u, image f, const char *Model, num Sigma, num Lambda)
     TvRegSetPlotFun(Opt, NULL, NULL);
     TvRegSetTol(Opt, (num)1e-2);
     TvRegSetMaxIter(Opt, 40);
+    /* Reuse the workspace for the repeated TvRestore calls */
+    TvRegSetWorkspaceCache(Opt, 1);
     
     if(Sigma <= 0)
         TvRegSetLambda(Opt, Lambda);
@@ -77,7 +77,7 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
 #else
     const num *ztilde = (S->UseZ) ? S->ztilde : S->f;
 #endif
-    const numvec2 *dtilde = S->dtilde;
+    const auxvec2 *dtilde = S->dtilde;
     const int Width = S->Width;
     const int Height = S->Height;
     const int NumChannels = S->NumChannels;
@@ -89,7 +89,8 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
         LAMBDA_INIT;
         
         /* Top-left corner */
-        unew = (ALPHA(0)*ztilde[0] - dtilde[0].x - dtilde[0].y 
+        unew = (ALPHA(0)*ztilde[0]
+            - AUXLOAD(dtilde[0].x) - AUXLOAD(dtilde[0].y)
             + u[1] + u[Width]) / (2 + ALPHA(0));
         Norm += (unew - u[0]) * (unew - u[0]);
         u[0] = unew;
@@ -97,15 +98,16 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
         /* Top row, x = 1, ..., Width - 2 */
         for(x = 1; x < Width - 1; x++)
         {
-            unew = (ALPHA(x)*ztilde[x] - dtilde[x].x + dtilde[x - 1].x
-                - dtilde[x].y + u[x - 1] + u[x + 1] + u[x + Width]) 
+            unew = (ALPHA(x)*ztilde[x]
+                - AUXLOAD(dtilde[x].x) + AUXLOAD(dtilde[x - 1].x)
+                - AUXLOAD(dtilde[x].y) + u[x - 1] + u[x + 1] + u[x + Width])
                 / (3 + ALPHA(x));
             Norm += (unew - u[x]) * (unew - u[x]);
             u[x] = unew;
         }
         
         /* Top-right corner */
-        unew = (ALPHA(x)*ztilde[x] - dtilde[x].y 
+        unew = (ALPHA(x)*ztilde[x] - AUXLOAD(dtilde[x].y) 
             + u[x - 1] + u[x + Width]) / (2 + ALPHA(x));
         Norm += (unew - u[x]) * (unew - u[x]);
         u[x] = unew;
@@ -120,8 +122,9 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
             u += Width, ztilde += Width, dtilde += Width)
         {
             /* Left edge */
-            unew = (ALPHA(0)*ztilde[0] - dtilde[0].x - dtilde[0].y
-                + dtilde[-Width].y + u[1] + u[-Width] + u[Width]) 
+            unew = (ALPHA(0)*ztilde[0]
+                - AUXLOAD(dtilde[0].x) - AUXLOAD(dtilde[0].y)
+                + AUXLOAD(dtilde[-Width].y) + u[1] + u[-Width] + u[Width])
                 / (3 + ALPHA(0));
             Norm += (unew - u[0]) * (unew - u[0]);
             u[0] = unew;
@@ -129,8 +132,9 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
             /* Interior */
             for(x = 1; x < Width - 1; x++)
             {
-                unew = (ALPHA(x)*ztilde[x] - dtilde[x].x + dtilde[x - 1].x
-                    - dtilde[x].y + dtilde[x - Width].y
+                unew = (ALPHA(x)*ztilde[x]
+                    - AUXLOAD(dtilde[x].x) + AUXLOAD(dtilde[x - 1].x)
+                    - AUXLOAD(dtilde[x].y) + AUXLOAD(dtilde[x - Width].y)
                     + u[x - 1] + u[x + 1] + u[x - Width] + u[x + Width])
                     / DENOM_INTERIOR;
                 
@@ -139,7 +143,8 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
             }
             
             /* Right edge */
-            unew = (ALPHA(x)*ztilde[x] - dtilde[x].y + dtilde[x - Width].y 
+            unew = (ALPHA(x)*ztilde[x]
+                - AUXLOAD(dtilde[x].y) + AUXLOAD(dtilde[x - Width].y)
                 + u[x - 1] + u[x - Width] + u[x + Width]) / (3 + ALPHA(x));
             Norm += (unew - u[x]) * (unew - u[x]);
             u[x] = unew;            
@@ -147,7 +152,7 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
         }
         
         /* Bottom-left corner */
-        unew = (ALPHA(0)*ztilde[0] - dtilde[0].x
+        unew = (ALPHA(0)*ztilde[0] - AUXLOAD(dtilde[0].x)
             + u[1] + u[-Width]) / (2 + ALPHA(0));
         Norm += (unew - u[0]) * (unew - u[0]);
         u[0] = unew;
@@ -155,7 +160,8 @@ static num UGaussSeidelVaryingLambda(tvregsolver *S)
         /* Bottom row, x = 1, ..., Width - 2 */
         for(x = 1; x < Width - 1; x++)
         {
-            unew = (ALPHA(x)*ztilde[x] - dtilde[x].x + dtilde[x - 1].x 
+            unew = (ALPHA(x)*ztilde[x]
+                - AUXLOAD(dtilde[x].x) + AUXLOAD(dtilde[x - 1].x)
                 + u[x - 1] + u[x + 1] + u[x - Width]) / (3 + ALPHA(x));
             Norm += (unew - u[x]) * (unew - u[x]);
             u[x] = unew;
@@ -0,0 +1,118 @@
+/**
+ * @file cpudispatch.c
+ * @brief Runtime selection of instruction set specific kernels
+ *
+ * Hot kernels are compiled once per instruction set level, by including
+ * their *_inc.c file once per level, and the variant to run is chosen at
+ * run time with GetCpuLevel, so that a binary built without any -m or
+ * -march flags still uses AVX2 or AVX-512 where the CPU has them.
+ *
+ * The level can be lowered for benchmarking by setting the environment
+ * variable CPU_DISPATCH to "baseline", "sse2", "avx2", or "avx512".  A
+ * level that the CPU does not support is clamped to the detected level,
+ * and an unknown value is reported and ignored.
+ *
+ *
+ * This program is free software: you can use, modify and/or
+ * redistribute it under the terms of the simplified BSD License. You
+ * should have received a copy of this license along this program. If
+ * not, see <http://www.opensource.org/licenses/bsd-license.html>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpudispatch.h"
+
+/** @brief Number of instruction set levels */
+#define NUM_CPU_LEVELS  4
+
+static const char *CpuLevelNames[NUM_CPU_LEVELS] =
+    {"baseline", "sse2", "avx2", "avx512"};
+
+
+/** @brief Detect the instruction set level of the running CPU */
+static cpulevel DetectCpuLevel()
+{
+#ifdef CPUDISPATCH_TARGETS
+    __builtin_cpu_init();
+    
+    if(__builtin_cpu_supports("avx512f"))
+        return CPU_AVX512;
+    else if(__builtin_cpu_supports("avx2"))
+        return CPU_AVX2;
+    else if(__builtin_cpu_supports("sse2"))
+        return CPU_SSE2;
+#endif
+    return CPU_BASELINE;
+}
+
+
+/* Atomic access to the cached level, so that threads calling GetCpuLevel
+   concurrently agree on it and at most one reports an unknown override */
+#if defined(__clang__) || (defined(__GNUC__) \
+    && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+#define LOAD_LEVEL(Ptr)     __atomic_load_n(Ptr, __ATOMIC_ACQUIRE)
+#define CAS_LEVEL(Ptr, Expected, Desired) \
+    __atomic_compare_exchange_n(Ptr, &(Expected), Desired, 0, \
+    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define LOAD_LEVEL(Ptr)     _InterlockedCompareExchange(Ptr, -1, -1)
+#define CAS_LEVEL(Ptr, Expected, Desired) \
+    (_InterlockedCompareExchange(Ptr, Desired, Expected) == (Expected))
+#else
+/* No atomics, call GetCpuLevel once before starting threads */
+#define LOAD_LEVEL(Ptr)     (*(Ptr))
+#define CAS_LEVEL(Ptr, Expected, Desired) \
+    ((*(Ptr) == (Expected)) ? (*(Ptr) = (Desired), 1) : 0)
+#endif
+
+
+/**
+ * @brief Instruction set level for selecting kernel variants
+ * @return the detected level, or the CPU_DISPATCH override if lower
+ *
+ * The level is determined on the first call and cached.  It is safe to call
+ * from several threads.  An unknown CPU_DISPATCH value is reported on
+ * stderr, once, and ignored.
+ */
+cpulevel GetCpuLevel()
+{
+    static volatile long Level = -1;
+    const char *Override;
+    long Cached = LOAD_LEVEL(&Level), Expected = -1;
+    int Detected, i;
+    
+    if(Cached >= 0)
+        return (cpulevel)Cached;
+    
+    if((Override = getenv("CPU_DISPATCH")) && !*Override)
+        Override = NULL;
+    Detected = DetectCpuLevel();
+    
+    for(i = 0; i < NUM_CPU_LEVELS; i++)
+        if(Override && !strcmp(Override, CpuLevelNames[i]))
+            break;
+    
+    Cached = (i < Detected) ? i : Detected;
+    
+    /* Only the thread that stores the level reports the override */
+    if(!CAS_LEVEL(&Level, Expected, Cached))
+        return (cpulevel)LOAD_LEVEL(&Level);
+    
+    if(Override && i == NUM_CPU_LEVELS)
+        fprintf(stderr, "Warning: Unknown CPU_DISPATCH value \"%s\" "
+            "ignored, expected baseline, sse2, avx2, or avx512.\n",
+            Override);
+    
+    return (cpulevel)Cached;
+}
+
+
+/** @brief Name of an instruction set level, as accepted by CPU_DISPATCH */
+const char *CpuLevelName(cpulevel Level)
+{
+    return ((int)Level >= 0 && Level < NUM_CPU_LEVELS) ?
+        CpuLevelNames[Level] : "unknown";
+}
@@ -21,7 +21,33 @@
 #include "tvregmex.h"
 #endif
 
+#include "cpudispatch.h"
+
+/* Instances of DSolve for each instruction set level */
+#define DSOLVE_FUNC     DSolveBaseline
+#include "dsolve_inc.c"
+#undef DSOLVE_FUNC
+
+#ifdef CPUDISPATCH_TARGETS
+#define DSOLVE_FUNC     DSolveSse2
+#define DSOLVE_ISA      "sse2"
+#include "dsolve_inc.c"
+#undef DSOLVE_FUNC
+#undef DSOLVE_ISA
+
+#define DSOLVE_FUNC     DSolveAvx2
+#define DSOLVE_ISA      "avx2"
 #include "dsolve_inc.c"
+#undef DSOLVE_FUNC
+#undef DSOLVE_ISA
+
+#define DSOLVE_FUNC     DSolveAvx512
+#define DSOLVE_ISA      "avx512f"
+#include "dsolve_inc.c"
+#undef DSOLVE_FUNC
+#undef DSOLVE_ISA
+#endif
+
 #if defined(TVREG_DENOISE) || defined(TVREG_INPAINT)
 #include "usolve_gs_inc.c"
 #endif
@@ -33,13 +59,42 @@
 #include "zsolve_inc.c"
 #endif
 
+/**
+ * @brief Solve the d subproblem with the variant for the CPU
+ * @param S tvreg solver state
+ *
+ * The instruction set level is selected with GetCpuLevel(), see
+ * dsolve_inc.c.
+ */
+static void DSolve(tvregsolver *S)
+{
+    switch(GetCpuLevel())
+    {
+#ifdef CPUDISPATCH_TARGETS
+    case CPU_AVX512:
+        DSolveAvx512(S);
+        break;
+    case CPU_AVX2:
+        DSolveAvx2(S);
+        break;
+    case CPU_SSE2:
+        DSolveSse2(S);
+        break;
+#endif
+    default:
+        DSolveBaseline(S);
+        break;
+    }
+}
+
 /**
  * @brief Total variation based image restoration
  * @param u initial guess, overwritten with restored image
  * @param f input image
  * @param Width, Height, NumChannels dimensions of the input image
  * @param Opt tvregopt options object
- * @return 0 on failure, 1 on success, 2 on maximum iterations exceeded
+ * @return 0 on failure, 1 on success, 2 on maximum iterations exceeded,
+ *         3 on time limit reached
  * 
  * This routine implements simultaneous denoising, deconvolution, and 
  * inpainting with total variation (TV) regularization, using either the 
@@ -79,6 +134,10 @@
  *    - TvRegSetGamma1():         constraint weight on d = grad u
  *    - TvRegSetGamma2():         constraint weight on z = Ku
  *    - TvRegSetPlotFun():        custom plotting function
+ *    - TvRegSetCheckpoint():     checkpoint file for resuming
+ *    - TvRegSetTimeLimit():      wall-clock time limit
+ *    - TvRegSetWorkspace():      caller-provided workspace
+ *    - TvRegSetWorkspaceCache(): keep the workspace between calls
  * 
  * When done, call TvRegFreeOpt() to free the options object.  Setting
  * Opt = NULL uses the default options (denoising with Gaussian noise model).
@@ -97,22 +156,101 @@
  */
 int TvRestore(num *u, const num *f, int Width, int Height, int NumChannels,
     tvregopt *Opt)
+{
+    return TvRestorePath(u, f, Width, Height, NumChannels,
+        NULL, 0, 0, NULL, Opt);
+}
+
+
+/**
+ * @brief TV restoration over a sequence of lambda values
+ * @param u initial guess, overwritten with restored image
+ * @param f input image
+ * @param Width, Height, NumChannels dimensions of the input image
+ * @param LambdaPath array of NumLambda fidelity weights
+ * @param NumLambda number of lambda values
+ * @param NoiseLevel target residual, or 0 to solve for every lambda
+ * @param LambdaIndex if non-NULL, set to the index of the last lambda solved
+ * @param Opt tvregopt options object
+ * @return 0 on failure, 1 on success, 2 on maximum iterations exceeded,
+ *         3 on time limit reached
+ *
+ * This routine solves the TvRestore() problem for Lambda = LambdaPath[0],
+ * LambdaPath[1], ..., in order, which is useful for choosing lambda.  Each
+ * solve after the first is warm-started from the previous solution: u and
+ * the auxiliary variables d, dtilde (and z, ztilde) are kept, and only the
+ * quantities depending on lambda are updated, Alpha and, for deconvolution,
+ * the precomputed transforms DenomTrans and ATrans.  Since the solutions
+ * for nearby lambda are close, each solve after the first typically takes
+ * only a few iterations.  The PlotFun is called for each solve.
+ *
+ * If NoiseLevel > 0, the path stops at the first lambda for which the
+ * residual ||Ku - f||_2 / sqrt(Width*Height*NumChannels) has reached
+ * NoiseLevel, that is, is at most NoiseLevel if LambdaPath is increasing or
+ * at least NoiseLevel if it is decreasing (the residual decreases as lambda
+ * increases).  For Gaussian noise, setting NoiseLevel to the noise standard
+ * deviation selects lambda by the discrepancy principle.
+ *
+ * On return, u is the solution for LambdaPath[*LambdaIndex].  All values of
+ * LambdaPath must be positive and finite.  The lambda path requires a
+ * constant lambda, VaryingLambda must not be set in Opt.  If LambdaPath is
+ * NULL, a single solve is done with the lambda in Opt.
+ */
+int TvRestorePath(num *u, const num *f, int Width, int Height,
+    int NumChannels, const num *LambdaPath, int NumLambda,
+    num NoiseLevel, int *LambdaIndex, tvregopt *Opt)
 {
     const long NumPixels = ((long)Width) * ((long)Height);
     const long NumEl = NumPixels * NumChannels;    
     tvregsolver S;  
     usolver USolveFun = NULL;
     zsolver ZSolveFun = NULL;
-    num DiffNorm;
-    int i, Success = 0, DeconvFlag, DctFlag, Iter;
+    num DiffNorm, Residual;
+    uint32_t Hash = 0;
+    unsigned long StartTime;
+    int i, Success = 0, Status = 1, DeconvFlag, DctFlag, Iter, Step;
+    int Increasing, FirstStep = 0, FirstIter = 0, SinceCheckpoint = 0;
+    int TimedOut = 0;
+    char *Workspace, *LocalWorkspace = NULL;
+    size_t WorkspaceSize;
     
-    if(!u || !f || u == f || Width < 2 || Height < 2 || NumChannels <= 0)
+    if(!u || !f || u == f || Width < 2 || Height < 2 || NumChannels <= 0
+        || (LambdaPath && NumLambda <= 0))
         return 0;
     
+    StartTime = Clock();
+    
+    if(LambdaIndex)
+        *LambdaIndex = 0;
+    
     /*** Set algorithm flags ***********************************************/
     S.Opt = (Opt) ? *Opt : TvRegDefaultOpt;
     
-    if(!TvRestoreChooseAlgorithm(&S.UseZ, &DeconvFlag, &DctFlag, 
+    if(!LambdaPath)
+        NumLambda = 1;
+    else if(S.Opt.VaryingLambda)
+    {
+        fprintf(stderr, "Lambda path requires a constant lambda.\n");
+        return 0;
+    }
+    else
+    {
+        /* Every lambda must be positive and finite (written to also
+           reject NaN), since the updates between solves divide by it */
+        for(i = 0; i < NumLambda; i++)
+            if(!(LambdaPath[i] > 0) || LambdaPath[i] - LambdaPath[i] != 0)
+            {
+                fprintf(stderr, "Lambda path values must be positive "
+                    "and finite.\n");
+                return 0;
+            }
+        
+        S.Opt.Lambda = LambdaPath[0];
+    }
+    
+    Increasing = (NumLambda < 2 || LambdaPath[1] >= LambdaPath[0]);
+    
+    if(!TvRestoreChooseAlgorithm(&S.UseZ, &DeconvFlag, &DctFlag,
         &USolveFun, &ZSolveFun, &S.Opt))
         return 0;
     
@@ -146,21 +284,12 @@ int TvRestore(num *u, const num *f, int Width, int Height, int NumChannels,
         / S.Opt.Gamma1;
     
     /*** Allocate memory ***************************************************/
-    S.d = S.dtilde = NULL;
-#ifdef TVREG_USEZ
-    S.z = S.ztilde = NULL;
-#endif    
 #ifdef TVREG_DECONV
-    S.A = S.B = S.ATrans = S.BTrans = S.KernelTrans = S.DenomTrans = NULL;
     S.TransformA = S.TransformB = S.InvTransformA = S.InvTransformB = NULL;
 #endif
     
-    if(!(S.d = (numvec2 *)Malloc(sizeof(numvec2)*NumEl))
-        || !(S.dtilde = (numvec2 *)Malloc(sizeof(numvec2)*NumEl)))
-        goto Catch;
-    
-    if(S.UseZ)
 #ifndef TVREG_USEZ
+    if(S.UseZ)
     {   /* We need z but do not have it, show error message. */
         if(S.Opt.NoiseModel != NOISEMODEL_L2)
             fprintf(stderr, "Please recompile with TVREG_NONGAUSSIAN "
@@ -171,61 +300,65 @@ int TvRestore(num *u, const num *f, int Width, int Height, int NumChannels,
         
         goto Catch;
     }
-#else
-    {   /* Allocate memory for z and ztilde */
-        if(!(S.z = (num *)Malloc(sizeof(num)*NumEl))
-            || !(S.ztilde = (num *)Malloc(sizeof(num)*NumEl)))
-            goto Catch;
-        
-        /* Initialize z = ztilde = u */
-        memcpy(S.z, S.u, sizeof(num)*NumEl);
-        memcpy(S.ztilde, S.u, sizeof(num)*NumEl);
-    }
 #endif
-    
-    if(!DeconvFlag)
-        S.Ku = u;
-    else
 #ifndef TVREG_DECONV
+    if(DeconvFlag)
     {   /* We need deconvolution but do not have it, show error message. */
         fprintf(stderr, "Please recompile with TVREG_DECONV "
             "for deconvolution problems.\n");
         goto Catch;
     }
-#else   /* The following applies only for problems with deconvolution */
-    if(DctFlag)
-    {   /* Prepare for DCT-based deconvolution */
-        if(!(S.ATrans = (num *)FFT(malloc)(sizeof(num)*NumEl))
-            || !(S.BTrans = (num *)FFT(malloc)(sizeof(num)*NumEl))
-            || !(S.A = (num *)FFT(malloc)(sizeof(num)*NumEl))
-            || !(S.B = (num *)FFT(malloc)(sizeof(num)*NumEl))
-            || !(S.KernelTrans = (num *)FFT(malloc)(sizeof(num)*NumPixels))
-            || !(S.DenomTrans = (num *)Malloc(sizeof(num)*NumPixels))
-            || !InitDeconvDct(&S))
+#endif
+    
+    /* Use the caller's workspace if set.  Otherwise, with caching enabled,
+       use the workspace kept in Opt from previous calls, which is grown if
+       it is too small.  Without caching, Opt is not written and the
+       workspace is allocated for this call only. */
+    WorkspaceSize = TvRestorePartition(&S, NULL, DeconvFlag, DctFlag);
+    
+    if(S.Opt.Workspace && !S.Opt.WorkspaceOwned)
+    {
+        if(S.Opt.WorkspaceSize < WorkspaceSize)
+        {
+            fprintf(stderr, "Workspace is too small, %lu bytes needed.\n",
+                (unsigned long)WorkspaceSize);
             goto Catch;
-    }
-    else
-    {   /* Prepare for Fourier-based deconvolution */
-        long NumTransPixels, NumTransEl, PadNumEl;
-        int TransWidth;
+        }
         
-        S.PadWidth = 2*Width;
-        S.PadHeight = 2*Height;
-        TransWidth = S.PadWidth/2 + 1;
-        NumTransPixels = ((long)TransWidth) * ((long)S.PadHeight);
-        NumTransEl = NumTransPixels * NumChannels;
-        PadNumEl = (((long)S.PadWidth) * S.PadHeight) * NumChannels;
+        Workspace = (char *)S.Opt.Workspace;
+    }
+    else if(Opt && Opt->WorkspaceCache && Opt->Workspace
+        && Opt->WorkspaceSize >= WorkspaceSize)
+        Workspace = (char *)Opt->Workspace;
+    else if(!(Workspace = LocalWorkspace =
+        (char *)WorkspaceMalloc(WorkspaceSize)))
+        goto Catch;
+    else if(Opt && Opt->WorkspaceCache)
+    {   /* Keep the new workspace in Opt for the next call */
+        if(Opt->Workspace)
+            WorkspaceFree(Opt->Workspace);
         
-        if(!(S.ATrans = (num *)FFT(malloc)(sizeof(numcomplex)*NumTransEl))
-            || !(S.BTrans = (num *)FFT(malloc)(sizeof(numcomplex)*NumTransEl))
-            || !(S.A = (num *)FFT(malloc)(sizeof(num)*PadNumEl))
-            || !(S.B = (num *)FFT(malloc)(sizeof(num)*PadNumEl))
-            || !(S.KernelTrans = (num *)
-                FFT(malloc)(sizeof(numcomplex)*NumTransPixels))
-            || !(S.DenomTrans = (num *)Malloc(sizeof(num)*NumTransPixels))
-            || !InitDeconvFourier(&S))
-            goto Catch;
+        Opt->Workspace = LocalWorkspace;
+        Opt->WorkspaceSize = WorkspaceSize;
+        Opt->WorkspaceOwned = 1;
+        LocalWorkspace = NULL;
     }
+    
+    TvRestorePartition(&S, Workspace, DeconvFlag, DctFlag);
+    
+#ifdef TVREG_USEZ
+    if(S.UseZ)
+    {   /* Initialize z = ztilde = u */
+        memcpy(S.z, S.u, sizeof(num)*NumEl);
+        memcpy(S.ztilde, S.u, sizeof(num)*NumEl);
+    }
+#endif
+    
+    if(!DeconvFlag)
+        S.Ku = u;
+#ifdef TVREG_DECONV
+    else if(!((DctFlag) ? InitDeconvDct(&S) : InitDeconvFourier(&S)))
+        goto Catch;
 #endif
     
     /*** Algorithm initializations *****************************************/
@@ -250,70 +383,111 @@ int TvRestore(num *u, const num *f, int Width, int Height, int NumChannels,
     for(i = 0; i < NumEl; i++)
         S.dtilde[i].x = S.dtilde[i].y = 0;
     
-    DiffNorm = (S.Opt.Tol > 0) ? 1000*S.Opt.Tol : 1000;    
-    Success = 2;
-    
-    if(S.Opt.PlotFun && !S.Opt.PlotFun(0, 0, DiffNorm, 
-        u, Width, Height, NumChannels, S.Opt.PlotParam))
-        goto Catch;
+    /* Resume from the checkpoint file if it holds a state of this problem */
+    if(S.Opt.CheckpointFile)
+    {
+        Hash = TvRestoreHash(&S, LambdaPath, NumLambda, NoiseLevel);
+        
+        if(!TvRestoreLoadCheckpoint(&S, Hash, NumLambda,
+            &FirstStep, &FirstIter, &Status))
+            goto Catch;
+    }
     
-    /*** Algorithm main loop: Bregman iterations ***************************/
-    for(Iter = 1; Iter <= S.Opt.MaxIter; Iter++)
+    /*** Algorithm main loop: lambda path *********************************/
+    for(Step = FirstStep; Step < NumLambda; Step++, FirstIter = 0)
     {
-        /* Solve d subproblem and update dtilde */
-        DSolve(&S); 
+        /* Warm start from the solution for the previous lambda */
+        if(Step > 0)
+            TvRestoreSetLambda(&S, LambdaPath[Step], DeconvFlag, DctFlag);
         
-        /* Solve u subproblem */
-        DiffNorm = USolveFun(&S);
+        DiffNorm = (S.Opt.Tol > 0) ? 1000*S.Opt.Tol : 1000;
+        Success = 2;
         
-        if(Iter >= 2 + S.UseZ && DiffNorm < S.Opt.Tol)
-            break;
+        if(S.Opt.PlotFun && !S.Opt.PlotFun(0, 0, DiffNorm,
+            u, Width, Height, NumChannels, S.Opt.PlotParam))
+            goto Catch;
         
+        /*** Bregman iterations ********************************************/
+        for(Iter = FirstIter + 1; Iter <= S.Opt.MaxIter; Iter++)
+        {
+            /* Solve d subproblem and update dtilde */
+            DSolve(&S);
+            
+            /* Solve u subproblem */
+            DiffNorm = USolveFun(&S);
+            
+            if(Iter >= 2 + S.UseZ && DiffNorm < S.Opt.Tol)
+                break;
+            
 #ifdef TVREG_USEZ
-        /* Solve z subproblem and update ztilde */
-        if(S.UseZ)
-            ZSolveFun(&S);
+            /* Solve z subproblem and update ztilde */
+            if(S.UseZ)
+                ZSolveFun(&S);
 #endif
+            
+            if(S.Opt.PlotFun && !(S.Opt.PlotFun(0, Iter, DiffNorm, u,
+                Width, Height, NumChannels, S.Opt.PlotParam)))
+                goto Catch;
+            
+            if(S.Opt.CheckpointFile && S.Opt.CheckpointInterval > 0
+                && ++SinceCheckpoint >= S.Opt.CheckpointInterval)
+            {
+                TvRestoreSaveCheckpoint(&S, Hash, Step, Iter, Status);
+                SinceCheckpoint = 0;
+            }
+            
+            if(S.Opt.TimeLimit > 0 
+                && Clock() - StartTime >= S.Opt.TimeLimit)
+            {
+                TimedOut = 1;
+                break;
+            }
+        }
         
-        if(S.Opt.PlotFun && !(S.Opt.PlotFun(0, Iter, DiffNorm, u, 
-            Width, Height, NumChannels, S.Opt.PlotParam)))
-            goto Catch;
+        if(!TimedOut && Iter > S.Opt.MaxIter)
+            Status = 2;
+        
+        if(S.Opt.PlotFun)
+            S.Opt.PlotFun((TimedOut) ? 3 : (Iter <= S.Opt.MaxIter) ? 1 : 2,
+                (Iter <= S.Opt.MaxIter) ? Iter : S.Opt.MaxIter,
+                DiffNorm, u, Width, Height, NumChannels, S.Opt.PlotParam);
+        
+        if(LambdaIndex)
+            *LambdaIndex = Step;
+        
+        if(TimedOut)
+            break;
+        
+        /* Stop when the residual reaches the target noise level */
+        if(LambdaPath && NoiseLevel > 0)
+        {
+            Residual = TvRestoreResidual(&S, DeconvFlag);
+            
+            if((Increasing) ? (Residual <= NoiseLevel)
+                : (Residual >= NoiseLevel))
+                break;
+        }
     }
     /*** End of main loop **************************************************/
-
-    Success = (Iter <= S.Opt.MaxIter) ? 1 : 2;
     
-    if(S.Opt.PlotFun)
-        S.Opt.PlotFun(Success, (Iter <= S.Opt.MaxIter) ? Iter : S.Opt.MaxIter,
-            DiffNorm, u, Width, Height, NumChannels, S.Opt.PlotParam);
+    /* The computation is complete, the checkpoint is no longer needed.  If
+       it was stopped by the time limit, save the state for continuing. */
+    if(S.Opt.CheckpointFile)
+    {
+        if(!TimedOut)
+            remove(S.Opt.CheckpointFile);
+        else
+            TvRestoreSaveCheckpoint(&S, Hash, Step, Iter, Status);
+    }
+    
+    Success = (TimedOut) ? 3 : Status;
 Catch:
     /*** Release memory ****************************************************/
-    if(S.dtilde)
-        Free(S.dtilde);
-    if(S.d)
-        Free(S.d);
-#ifdef TVREG_USEZ
-    if(S.ztilde)
-        Free(S.ztilde);
-    if(S.z)
-        Free(S.z);
-#endif    
+    if(LocalWorkspace)
+        WorkspaceFree(LocalWorkspace);
 #ifdef TVREG_DECONV
     if(DeconvFlag)
     {
-        if(S.DenomTrans)
-            Free(S.DenomTrans);
-        if(S.KernelTrans)
-            FFT(free)(S.KernelTrans);
-        if(S.B)
-            FFT(free)(S.B);
-        if(S.A)
-            FFT(free)(S.A);
-        if(S.BTrans)
-            FFT(free)(S.BTrans);
-        if(S.ATrans)
-            FFT(free)(S.ATrans);
-        
         FFT(destroy_plan)(S.InvTransformB);
         FFT(destroy_plan)(S.TransformB);
         FFT(destroy_plan)(S.InvTransformA);
@@ -325,6 +499,212 @@ Catch:
 }
 
 
+/** @brief Test whether a numview is planar with packed rows */
+static int IsPackedNumView(numview View)
+{
+    return View.PixelStride == 1 && View.RowStride == View.Width
+        && (View.NumChannels <= 1 || View.ChannelStride
+            == ((long)View.Width) * ((long)View.Height));
+}
+
+
+/** @brief Copy between a numview and a planar packed array */
+static void CopyNumView(num *Packed, numview View, int ToView)
+{
+    num *Src;
+    long i = 0;
+    int x, y, k;
+    
+    for(k = 0; k < View.NumChannels; k++)
+        for(y = 0; y < View.Height; y++)
+        {
+            Src = View.Data + View.ChannelStride*k + View.RowStride*y;
+            
+            if(ToView)
+                for(x = 0; x < View.Width; x++, i++)
+                    Src[View.PixelStride*x] = Packed[i];
+            else
+                for(x = 0; x < View.Width; x++, i++)
+                    Packed[i] = Src[View.PixelStride*x];
+        }
+}
+
+
+/**
+ * @brief TV-regularized image restoration on strided image views
+ *
+ * @param u initial guess, overwritten with restored image
+ * @param f input image
+ * @param Opt tvregopt options object
+ *
+ * @return 1 on success, 0 on failure
+ *
+ * Same as TvRestore(), but u and f may have any pixel, row, and channel
+ * strides, for example interleaved channels or a crop of a larger image.
+ * When both views are planar with packed rows, TvRestore() operates on them
+ * directly.  Otherwise, the views are gathered into packed arrays, which the
+ * solver requires for its Gauss-Seidel sweeps and transforms, and the result
+ * is scattered back into u.
+ */
+int TvRestoreView(numview u, numview f, tvregopt *Opt)
+{
+    const long NumEl = ((long)u.Width) * ((long)u.Height) * u.NumChannels;
+    num *PackedU = NULL, *PackedF = NULL;
+    int Success = 0;
+    
+    if(!u.Data || !f.Data || u.Width != f.Width || u.Height != f.Height
+        || u.NumChannels != f.NumChannels)
+        return 0;
+    else if(IsPackedNumView(u) && IsPackedNumView(f))
+        return TvRestore(u.Data, f.Data,
+            u.Width, u.Height, u.NumChannels, Opt);
+    
+    if(!(PackedU = (num *)Malloc(sizeof(num)*NumEl))
+        || !(PackedF = (num *)Malloc(sizeof(num)*NumEl)))
+        goto Catch;
+    
+    CopyNumView(PackedU, u, 0);
+    CopyNumView(PackedF, f, 0);
+    
+    if(!TvRestore(PackedU, PackedF, u.Width, u.Height, u.NumChannels, Opt))
+        goto Catch;
+    
+    CopyNumView(PackedU, u, 1);
+    Success = 1;
+Catch:
+    if(PackedF)
+        Free(PackedF);
+    if(PackedU)
+        Free(PackedU);
+    return Success;
+}
+
+
+/** @brief Reserve Size bytes of Workspace at Offset, aligned for SIMD */
+static void *WorkspacePart(char *Workspace, size_t *Offset, size_t Size)
+{
+    void *Part = (Workspace) ? (void *)(Workspace + *Offset) : NULL;
+    
+    *Offset += (Size + WORKSPACE_ALIGN - 1) & ~((size_t)WORKSPACE_ALIGN - 1);
+    return Part;
+}
+
+
+/**
+ * @brief Partition the workspace among the solver arrays
+ * @param S solver state, with the dimensions and UseZ set
+ * @param Workspace the workspace, or NULL to only compute its size
+ * @param DeconvFlag, DctFlag as selected by TvRestoreChooseAlgorithm()
+ * @return workspace size in bytes
+ *
+ * This sets the array pointers d, dtilde, z, ztilde, and for deconvolution
+ * the transform buffers, and the padded dimensions.  Each array is aligned
+ * to WORKSPACE_ALIGN bytes relative to the start of the workspace.
+ */
+static size_t TvRestorePartition(tvregsolver *S, char *Workspace,
+    int DeconvFlag, int DctFlag)
+{
+    const long NumPixels = ((long)S->Width) * ((long)S->Height);
+    const long NumEl = NumPixels * S->NumChannels;
+    size_t Offset = 0;
+    
+    S->d = (auxvec2 *)WorkspacePart(Workspace, &Offset,
+        sizeof(auxvec2)*NumEl);
+    S->dtilde = (auxvec2 *)WorkspacePart(Workspace, &Offset,
+        sizeof(auxvec2)*NumEl);
+    
+#ifdef TVREG_USEZ
+    if(S->UseZ)
+    {
+        S->z = (num *)WorkspacePart(Workspace, &Offset, sizeof(num)*NumEl);
+        S->ztilde = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumEl);
+    }
+    else
+        S->z = S->ztilde = NULL;
+#endif
+    
+    S->PadWidth = S->Width;
+    S->PadHeight = S->Height;
+    
+#ifdef TVREG_DECONV
+    if(DeconvFlag && DctFlag)
+    {   /* Buffers for DCT-based deconvolution */
+        S->ATrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumEl);
+        S->BTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumEl);
+        S->A = (num *)WorkspacePart(Workspace, &Offset, sizeof(num)*NumEl);
+        S->B = (num *)WorkspacePart(Workspace, &Offset, sizeof(num)*NumEl);
+        S->KernelTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumPixels);
+        S->DenomTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumPixels);
+    }
+    else if(DeconvFlag)
+    {   /* Buffers for Fourier-based deconvolution */
+        long NumTransPixels, NumTransEl, PadNumEl;
+        int TransWidth;
+        
+        S->PadWidth = 2*S->Width;
+        S->PadHeight = 2*S->Height;
+        TransWidth = S->PadWidth/2 + 1;
+        NumTransPixels = ((long)TransWidth) * ((long)S->PadHeight);
+        NumTransEl = NumTransPixels * S->NumChannels;
+        PadNumEl = (((long)S->PadWidth) * S->PadHeight) * S->NumChannels;
+        
+        S->ATrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(numcomplex)*NumTransEl);
+        S->BTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(numcomplex)*NumTransEl);
+        S->A = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*PadNumEl);
+        S->B = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*PadNumEl);
+        S->KernelTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(numcomplex)*NumTransPixels);
+        S->DenomTrans = (num *)WorkspacePart(Workspace, &Offset,
+            sizeof(num)*NumTransPixels);
+    }
+#else
+    (void)DeconvFlag;
+    (void)DctFlag;
+#endif
+    
+    return Offset;
+}
+
+
+/**
+ * @brief Workspace size needed by TvRestore()
+ * @param Width, Height, NumChannels dimensions of the input image
+ * @param Opt tvregopt options object
+ * @return workspace size in bytes, or 0 if the options are invalid
+ *
+ * The size depends on the algorithm selected by the options (the noise
+ * model and whether a kernel is set), so it should be queried after they
+ * are set.  The same size serves TvRestorePath().  See TvRegSetWorkspace().
+ */
+size_t TvRestoreWorkspaceSize(int Width, int Height, int NumChannels,
+    const tvregopt *Opt)
+{
+    tvregsolver S;
+    usolver USolveFun;
+    zsolver ZSolveFun;
+    int DeconvFlag, DctFlag;
+    
+    if(Width < 2 || Height < 2 || NumChannels <= 0
+        || !TvRestoreChooseAlgorithm(&S.UseZ, &DeconvFlag, &DctFlag,
+        &USolveFun, &ZSolveFun, (Opt) ? Opt : &TvRegDefaultOpt))
+        return 0;
+    
+    S.Width = Width;
+    S.Height = Height;
+    S.NumChannels = NumChannels;
+    return TvRestorePartition(&S, NULL, DeconvFlag, DctFlag);
+}
+
+
 /** @brief Test if Kernel is whole-sample symmetric */
 static int IsSymmetric(const num *Kernel, int KernelWidth, int KernelHeight)
 {
@@ -407,3 +787,353 @@ static int TvRestoreChooseAlgorithm(int *UseZ, int *DeconvFlag, int *DctFlag,
 #endif
     return 1;
 }
+
+
+/**
+ * @brief Change lambda between the solves of TvRestorePath()
+ * @param S tvreg solver state
+ * @param Lambda the new fidelity weight
+ * @param DeconvFlag, DctFlag flags from TvRestoreChooseAlgorithm()
+ *
+ * With the d,u,z splitting, lambda only enters the z-subproblem, which reads
+ * S->Opt.Lambda.  Otherwise Alpha = Lambda/Gamma1 changes, and for
+ * deconvolution the precomputed transforms are updated accordingly.
+ */
+static void TvRestoreSetLambda(tvregsolver *S, num Lambda,
+    int DeconvFlag, int DctFlag)
+{
+    S->Opt.Lambda = Lambda;
+    
+    if(S->UseZ)
+        return;
+#ifdef TVREG_DECONV
+    else if(DeconvFlag)
+    {
+        if(DctFlag)
+            UpdateDeconvDct(S, Lambda / S->Opt.Gamma1);
+        else
+            UpdateDeconvFourier(S, Lambda / S->Opt.Gamma1);
+    }
+#endif
+    else
+        S->Alpha = Lambda / S->Opt.Gamma1;
+    
+    (void)DeconvFlag;
+    (void)DctFlag;
+}
+
+
+#ifdef TVREG_DECONV
+/** @brief Half-sample symmetric boundary extension */
+static int HSymExtension(int N, int i)
+{
+    while(1)
+    {
+        if(i < 0)
+            i = -1 - i;
+        else if(i >= N)
+            i = (2*N - 1) - i;
+        else
+            return i;
+    }
+}
+#endif
+
+
+/**
+ * @brief Root mean square of the residual Ku - f
+ * @param S tvreg solver state
+ * @param DeconvFlag flag from TvRestoreChooseAlgorithm()
+ * @return ||Ku - f||_2 / sqrt(Width*Height*NumChannels)
+ *
+ * The u-solvers maintain S->Ku except in deconvolution with UseZ = 0, where
+ * Ku is computed here by direct convolution with half-sample symmetric
+ * boundary extension, the boundary handling of the DCT and Fourier solvers.
+ */
+static num TvRestoreResidual(const tvregsolver *S, int DeconvFlag)
+{
+    const num *Ku = S->Ku;
+    const num *f = S->f;
+    const int Width = S->Width;
+    const int Height = S->Height;
+    const long PadJump = ((long)S->PadWidth) * (S->PadHeight - Height);
+    double Diff, Sum = 0;
+    int x, y, k;
+    
+#ifdef TVREG_DECONV
+    if(DeconvFlag && !S->UseZ)
+    {
+        const num *Kernel = S->Opt.Kernel;
+        const int KernelWidth = S->Opt.KernelWidth;
+        const int KernelHeight = S->Opt.KernelHeight;
+        const int x0 = -KernelWidth/2, y0 = -KernelHeight/2;
+        const num *uk;
+        int i, j;
+        
+        for(k = 0; k < S->NumChannels; k++)
+        {
+            uk = S->u + ((long)Width)*Height*k;
+            
+            for(y = 0; y < Height; y++, f += Width)
+                for(x = 0; x < Width; x++)
+                {
+                    for(j = 0, Diff = -f[x]; j < KernelHeight; j++)
+                        for(i = 0; i < KernelWidth; i++)
+                            Diff += Kernel[i + KernelWidth*j]
+                                * uk[HSymExtension(Width, x - x0 - i)
+                                + Width*HSymExtension(Height, y - y0 - j)];
+                    
+                    Sum += Diff * Diff;
+                }
+        }
+        
+        return (num)sqrt(Sum / (((double)Width)*Height*S->NumChannels));
+    }
+#endif
+    
+    for(k = 0; k < S->NumChannels; k++, Ku += PadJump)
+        for(y = 0; y < Height; y++, f += Width, Ku += S->PadWidth)
+            for(x = 0; x < Width; x++)
+            {
+                Diff = Ku[x] - f[x];
+                Sum += Diff * Diff;
+            }
+    
+    (void)DeconvFlag;
+    return (num)sqrt(Sum / (((double)Width)*Height*S->NumChannels));
+}
+
+
+/** @brief Update a 32-bit FNV-1a hash with Size bytes of Data */
+static uint32_t HashBytes(uint32_t Hash, const void *Data, long Size)
+{
+    const unsigned char *Bytes = (const unsigned char *)Data;
+    long i;
+    
+    for(i = 0; i < Size; i++)
+        Hash = (uint32_t)((Hash ^ Bytes[i]) * 16777619UL);
+    
+    return Hash;
+}
+
+
+/**
+ * @brief Hash identifying a restoration problem for checkpointing
+ * @param S tvreg solver state
+ * @param LambdaPath, NumLambda, NoiseLevel arguments of TvRestorePath()
+ * @return 32-bit hash of f, lambda, the kernel, and the other options
+ *
+ * The hash excludes MaxIter and the checkpoint settings, so that an
+ * interrupted run may be resumed with a larger iteration limit.
+ */
+static uint32_t TvRestoreHash(const tvregsolver *S,
+    const num *LambdaPath, int NumLambda, num NoiseLevel)
+{
+    const long NumEl = ((long)S->Width) * ((long)S->Height) * S->NumChannels;
+    const tvregopt *Opt = &S->Opt;
+    uint32_t Hash = (uint32_t)2166136261UL;
+    int NoiseModel = (int)Opt->NoiseModel;
+    
+    Hash = HashBytes(Hash, S->f, sizeof(num)*NumEl);
+    
+    if(LambdaPath)
+        Hash = HashBytes(Hash, LambdaPath, sizeof(num)*NumLambda);
+    else if(Opt->VaryingLambda)
+        Hash = HashBytes(Hash, Opt->VaryingLambda, sizeof(num)
+            * ((long)Opt->LambdaWidth) * ((long)Opt->LambdaHeight));
+    else
+        Hash = HashBytes(Hash, &Opt->Lambda, sizeof(num));
+    
+    if(Opt->Kernel)
+        Hash = HashBytes(Hash, Opt->Kernel, sizeof(num)
+            * ((long)Opt->KernelWidth) * ((long)Opt->KernelHeight));
+    
+    Hash = HashBytes(Hash, &NoiseLevel, sizeof(num));
+    Hash = HashBytes(Hash, &Opt->Tol, sizeof(num));
+    Hash = HashBytes(Hash, &Opt->Gamma1, sizeof(num));
+    Hash = HashBytes(Hash, &Opt->Gamma2, sizeof(num));
+    Hash = HashBytes(Hash, &NoiseModel, sizeof(int));
+    return Hash;
+}
+
+
+/**
+ * @brief Save the solver state to the checkpoint file
+ * @param S tvreg solver state
+ * @param Hash problem hash from TvRestoreHash()
+ * @param Step, Iter current lambda path step and Bregman iteration
+ * @param Status return status of the completed steps
+ * @return 1 on success, 0 on failure
+ *
+ * The file is a header of CHECKPOINT_MAGIC and CHECKPOINT_NUMFIELDS
+ * unsigned longs, followed by the arrays u, d, dtilde, and if UseZ, z and 
+ * ztilde.  Failure to write a checkpoint only prints a warning, the 
+ * computation continues.
+ */
+static int TvRestoreSaveCheckpoint(const tvregsolver *S, uint32_t Hash,
+    int Step, int Iter, int Status)
+{
+    const char *CheckpointFile = S->Opt.CheckpointFile;
+    const size_t NumEl = ((size_t)S->Width) * ((size_t)S->Height) 
+        * S->NumChannels;
+    unsigned long Header[CHECKPOINT_NUMFIELDS];
+    char *TempFile = NULL;
+    FILE *File = NULL;
+    int Closed, Success = 0;
+    
+    Header[0] = sizeof(num);
+    Header[1] = sizeof(auxnum);
+    Header[2] = S->Width;
+    Header[3] = S->Height;
+    Header[4] = S->NumChannels;
+    Header[5] = S->UseZ;
+    Header[6] = Hash;
+    Header[7] = Step;
+    Header[8] = Iter;
+    Header[9] = Status;
+    
+    if(!(TempFile = (char *)Malloc(strlen(CheckpointFile) + 5)))
+        goto Catch;
+    
+    sprintf(TempFile, "%s.tmp", CheckpointFile);
+    
+    if(!(File = fopen(TempFile, "wb"))
+        || fwrite(CHECKPOINT_MAGIC, 1, 8, File) != 8
+        || fwrite(Header, sizeof(unsigned long), CHECKPOINT_NUMFIELDS, File)
+            != CHECKPOINT_NUMFIELDS
+        || fwrite(S->u, sizeof(num), NumEl, File) != NumEl
+        || fwrite(S->d, sizeof(auxvec2), NumEl, File) != NumEl
+        || fwrite(S->dtilde, sizeof(auxvec2), NumEl, File) != NumEl)
+        goto Catch;
+#ifdef TVREG_USEZ
+    if(S->UseZ && (fwrite(S->z, sizeof(num), NumEl, File) != NumEl
+        || fwrite(S->ztilde, sizeof(num), NumEl, File) != NumEl))
+        goto Catch;
+#endif
+    
+    Closed = !fclose(File);
+    File = NULL;
+    
+    /* Replace the previous checkpoint.  Where rename does not overwrite an
+       existing file, remove the old checkpoint first. */
+    if(!Closed || (rename(TempFile, CheckpointFile) 
+        && (remove(CheckpointFile) || rename(TempFile, CheckpointFile))))
+        goto Catch;
+    
+    Success = 1;
+Catch:
+    if(File)
+        fclose(File);
+    if(!Success)
+    {
+        fprintf(stderr, "Warning: unable to write checkpoint \"%s\".\n",
+            CheckpointFile);
+        
+        if(TempFile)
+            remove(TempFile);
+    }
+    if(TempFile)
+        Free(TempFile);
+    return Success;
+}
+
+
+/**
+ * @brief Restore the solver state from the checkpoint file
+ * @param S tvreg solver state
+ * @param Hash problem hash from TvRestoreHash()
+ * @param NumLambda number of lambda path steps
+ * @param Step, Iter set to the saved lambda path step and iteration
+ * @param Status set to the saved return status
+ * @return 0 if out of memory, 1 otherwise
+ *
+ * If the checkpoint file does not exist, is for a different problem, or is
+ * invalid or truncated, it is ignored and the state and outputs keep their
+ * initial values, so that the computation starts from the beginning.  The
+ * saved u is read into a temporary array and only copied to S->u once the
+ * whole file has been read, and d, dtilde (and z, ztilde) are
+ * reinitialized if reading fails partway.
+ */
+static int TvRestoreLoadCheckpoint(tvregsolver *S, uint32_t Hash,
+    int NumLambda, int *Step, int *Iter, int *Status)
+{
+    const char *CheckpointFile = S->Opt.CheckpointFile;
+    const size_t NumEl = ((size_t)S->Width) * ((size_t)S->Height) 
+        * S->NumChannels;
+    unsigned long Header[CHECKPOINT_NUMFIELDS];
+    char Magic[8];
+    num *uSaved = NULL;
+    FILE *File;
+    size_t i;
+    int Success = 0;
+    
+    if(!(File = fopen(CheckpointFile, "rb")))
+        return 1;
+    
+    if(fread(Magic, 1, 8, File) != 8 
+        || memcmp(Magic, CHECKPOINT_MAGIC, 8)
+        || fread(Header, sizeof(unsigned long), CHECKPOINT_NUMFIELDS, File)
+            != CHECKPOINT_NUMFIELDS
+        || Header[0] != sizeof(num) || Header[1] != sizeof(auxnum)
+        || Header[2] != (unsigned long)S->Width 
+        || Header[3] != (unsigned long)S->Height
+        || Header[4] != (unsigned long)S->NumChannels
+        || Header[5] != (unsigned long)S->UseZ || Header[6] != Hash)
+    {
+        fprintf(stderr, "Ignoring checkpoint \"%s\", "
+            "which is for a different problem.\n", CheckpointFile);
+        Success = 1;
+        goto Catch;
+    }
+    else if(Header[7] >= (unsigned long)NumLambda
+        || Header[8] > (unsigned long)S->Opt.MaxIter
+        || (Header[9] != 1 && Header[9] != 2))
+    {
+        fprintf(stderr, "Ignoring checkpoint \"%s\", which is invalid or "
+            "exceeds the iteration limit.\n", CheckpointFile);
+        Success = 1;
+        goto Catch;
+    }
+    
+    if(!(uSaved = (num *)Malloc(sizeof(num)*NumEl)))
+        goto Catch;
+    
+    if(fread(uSaved, sizeof(num), NumEl, File) != NumEl
+        || fread(S->d, sizeof(auxvec2), NumEl, File) != NumEl
+        || fread(S->dtilde, sizeof(auxvec2), NumEl, File) != NumEl
+#ifdef TVREG_USEZ
+        || (S->UseZ && (fread(S->z, sizeof(num), NumEl, File) != NumEl
+            || fread(S->ztilde, sizeof(num), NumEl, File) != NumEl))
+#endif
+        )
+    {
+        fprintf(stderr, "Ignoring checkpoint \"%s\", which is truncated.\n",
+            CheckpointFile);
+        
+        /* Undo the partial reads, d = dtilde = 0 (and z = ztilde = u) */
+        for(i = 0; i < NumEl; i++)
+            S->d[i].x = S->d[i].y = S->dtilde[i].x = S->dtilde[i].y = 0;
+        
+#ifdef TVREG_USEZ
+        if(S->UseZ)
+        {
+            memcpy(S->z, S->u, sizeof(num)*NumEl);
+            memcpy(S->ztilde, S->u, sizeof(num)*NumEl);
+        }
+#endif
+    }
+    else
+    {
+        memcpy(S->u, uSaved, sizeof(num)*NumEl);
+        *Step = (int)Header[7];
+        *Iter = (int)Header[8];
+        *Status = (int)Header[9];
+    }
+    
+    Success = 1;
+Catch:
+    if(uSaved)
+        Free(uSaved);
+    fclose(File);
+    return Success;
+}
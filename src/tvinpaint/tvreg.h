@@ -31,8 +31,40 @@
 /* tvregopt is encapsulated by forward declaration */
 typedef struct tag_tvregopt tvregopt;
 
+/**
+ * @brief struct representing a strided view of a num image
+ *
+ * Channel c of pixel (x,y) is located at
+ *     Data[PixelStride*x + RowStride*y + ChannelStride*c].
+ * This is the num counterpart of the imageview type used by the other
+ * modules, see TvRestoreView().
+ */
+typedef struct
+{
+    /** @brief Pointer to channel 0 of pixel (0,0) */
+    num *Data;
+    /** @brief Image width */
+    int Width;
+    /** @brief Image height */
+    int Height;
+    /** @brief Number of channels */
+    int NumChannels;
+    /** @brief Step between horizontally adjacent pixels */
+    long PixelStride;
+    /** @brief Step between vertically adjacent pixels */
+    long RowStride;
+    /** @brief Step between channels of the same pixel */
+    long ChannelStride;
+} numview;
+
 int TvRestore(num *u, const num *f, int Width, int Height, int NumChannels,
     tvregopt *Opt);
+int TvRestorePath(num *u, const num *f, int Width, int Height,
+    int NumChannels, const num *LambdaPath, int NumLambda,
+    num NoiseLevel, int *LambdaIndex, tvregopt *Opt);
+int TvRestoreView(numview u, numview f, tvregopt *Opt);
+size_t TvRestoreWorkspaceSize(int Width, int Height, int NumChannels,
+    const tvregopt *Opt);
 
 tvregopt *TvRegNewOpt();
 void TvRegFreeOpt(tvregopt *Opt);
@@ -49,6 +81,11 @@ int TvRegSetNoiseModel(tvregopt *Opt, const char *NoiseModel);
 void TvRegSetPlotFun(tvregopt *Opt, 
     int (*PlotFun)(int, int, num, const num*, int, int, int, void*),
     void *PlotParam);
+void TvRegSetCheckpoint(tvregopt *Opt, 
+    const char *CheckpointFile, int CheckpointInterval);
+void TvRegSetTimeLimit(tvregopt *Opt, unsigned long TimeLimit);
+void TvRegSetWorkspace(tvregopt *Opt, void *Workspace, size_t WorkspaceSize);
+void TvRegSetWorkspaceCache(tvregopt *Opt, int WorkspaceCache);
 void TvRegPrintOpt(const tvregopt *Opt);
 const char *TvRegGetAlgorithm(const tvregopt *Opt);
 
@@ -21,11 +21,22 @@
 #ifdef TVREG_DECONV
 #include <fftw3.h>
 #endif
+#if defined(TVREG_FP16) && defined(__F16C__)
+#include <immintrin.h>
+#endif
 #include "tvreg.h"
 
 /** @brief Size of the string buffer for holding the algorithm description */
 #define ALGSTRING_SIZE  128
 
+/** @brief Identifies a TvRestore checkpoint file, see TvRegSetCheckpoint() */
+#define CHECKPOINT_MAGIC        "TVREGCP1"
+/** @brief Number of unsigned long fields in a checkpoint file header */
+#define CHECKPOINT_NUMFIELDS    10
+
+/** @brief Alignment in bytes of the arrays within the workspace */
+#define WORKSPACE_ALIGN         64
+
 /** 
  * @brief  Token concatenation macro 
  * 
@@ -46,6 +57,16 @@
 #define FFT(S)      _TVREG_CONCAT(fftw_,S)
 #endif
 
+/* The workspace holds the DFT buffers for deconvolution, so it is allocated
+   with the FFTW allocator for its SIMD alignment */
+#ifdef TVREG_DECONV
+#define WorkspaceMalloc(s)      FFT(malloc)(s)
+#define WorkspaceFree(p)        FFT(free)(p)
+#else
+#define WorkspaceMalloc(s)      Malloc(s)
+#define WorkspaceFree(p)        Free(p)
+#endif
+
 
 /* Internal type definitions */
 
@@ -56,6 +77,34 @@ typedef struct
     num y;      /**< y-component */
 } numvec2;
 
+/**
+ * @brief Storage type of the auxiliary variables d and dtilde
+ *
+ * By default, d and dtilde are stored as num.  To halve their memory and
+ * bandwidth, define TVREG_FP16 to store them as IEEE half-precision floats
+ * (11-bit significand) or TVREG_BF16 to store them as bfloat16 (8-bit
+ * significand, the upper half of a float).  They are loaded with AUXLOAD
+ * and stored with AUXSTORE, and all arithmetic is done in num.  The
+ * restored image u and the z-splitting variables remain in num.  With
+ * TVREG_FP16, the F16C conversions are used when __F16C__ is defined.
+ */
+#if defined(TVREG_FP16) || defined(TVREG_BF16)
+typedef uint16_t auxnum;
+#define AUXLOAD(A)      AuxToNum(A)
+#define AUXSTORE(X)     NumToAux(X)
+#else
+typedef num auxnum;
+#define AUXLOAD(A)      (A)
+#define AUXSTORE(X)     (X)
+#endif
+
+/** @brief 2D vector with auxnum components */
+typedef struct
+{
+    auxnum x;   /**< x-component */
+    auxnum y;   /**< y-component */
+} auxvec2;
+
 /** @brief Complex value type */
 typedef num numcomplex[2];
 
@@ -83,6 +132,13 @@ struct tag_tvregopt
     noisemodel NoiseModel;
     int (*PlotFun)(int, int, num, const num*, int, int, int, void*);
     void *PlotParam;
+    const char *CheckpointFile;
+    int CheckpointInterval;
+    unsigned long TimeLimit;
+    void *Workspace;
+    size_t WorkspaceSize;
+    int WorkspaceOwned;
+    int WorkspaceCache;
     char *AlgString;
 };
 
@@ -96,8 +152,8 @@ typedef struct tag_tvregsolver
 {    
     num *u;                     /**< Current restoration solution       */
     const num *f;               /**< Input image                        */
-    numvec2 *d;                 /**< Current solution of d              */
-    numvec2 *dtilde;            /**< Bregman variable for d constraint  */    
+    auxvec2 *d;                 /**< Current solution of d              */
+    auxvec2 *dtilde;            /**< Bregman variable for d constraint  */    
     num *Ku;                    /**< Convolution of kernel with u       */
     
     num fNorm;                  /**< L2 norm of f                       */
@@ -134,10 +190,96 @@ typedef void (*zsolver)(tvregsolver*);
 tvregopt TvRegDefaultOpt = {TVREGOPT_DEFAULT_LAMBDA, NULL, 0, 0, NULL, 0, 0,
     (num)(TVREGOPT_DEFAULT_TOL), TVREGOPT_DEFAULT_GAMMA1, 
     TVREGOPT_DEFAULT_GAMMA2, TVREGOPT_DEFAULT_MAXITER, NOISEMODEL_L2, 
-    TvRestoreSimplePlot, NULL, NULL};
+    TvRestoreSimplePlot, NULL, NULL, 0, 0, NULL, 0, 0, 0, NULL};
+
+#if defined(TVREG_FP16) || defined(TVREG_BF16)
+/** @brief Bits of a float, for converting to and from 16-bit floats */
+typedef union
+{
+    float f;
+    uint32_t u;
+} floatbits;
+
+#if defined(TVREG_FP16) && defined(__F16C__)
+/* Use the hardware conversions, _cvtss_sh rounds to nearest even */
+#define AuxToNum(A)     ((num)_cvtsh_ss(A))
+#define NumToAux(X)     ((auxnum)_cvtss_sh((float)(X), 0))
+#elif defined(TVREG_FP16)
+/** @brief Convert a half-precision float to num */
+static num AuxToNum(auxnum a)
+{
+    const uint32_t Sign = ((uint32_t)(a & 0x8000)) << 16;
+    const uint32_t Exponent = (a >> 10) & 0x1F;
+    const uint32_t Mantissa = a & 0x3FF;
+    floatbits v;
+    
+    if(Exponent == 0)           /* Zero or subnormal */
+    {
+        v.f = Mantissa * (1.0f/16777216.0f);
+        v.u |= Sign;
+    }
+    else if(Exponent == 0x1F)   /* Infinity or NaN */
+        v.u = Sign | 0x7F800000 | (Mantissa << 13);
+    else
+        v.u = Sign | ((Exponent + 112) << 23) | (Mantissa << 13);
+    
+    return (num)v.f;
+}
+
+/** @brief Convert num to a half-precision float, rounding to nearest */
+static auxnum NumToAux(num x)
+{
+    floatbits v;
+    uint32_t Sign;
+    
+    v.f = (float)x;
+    Sign = (v.u >> 16) & 0x8000;
+    v.u &= 0x7FFFFFFF;
+    
+    if(v.u >= 0x47800000)       /* Overflow, infinity, or NaN */
+        return (auxnum)(Sign | ((v.u > 0x7F800000) ? 0x7E00 : 0x7C00));
+    else if(v.u < 0x38800000)   /* Subnormal or zero */
+        return (auxnum)(Sign | (uint32_t)(v.f * 16777216.0f + 0.5f));
+    
+    /* Round to nearest even and rebias the exponent from 127 to 15 */
+    v.u += 0xFFF + ((v.u >> 13) & 1);
+    return (auxnum)(Sign | ((v.u - 0x38000000) >> 13));
+}
+#else
+/** @brief Convert a bfloat16 to num */
+static num AuxToNum(auxnum a)
+{
+    floatbits v;
+    
+    v.u = ((uint32_t)a) << 16;
+    return (num)v.f;
+}
 
+/** @brief Convert num to a bfloat16, rounding to nearest even */
+static auxnum NumToAux(num x)
+{
+    floatbits v;
+    
+    v.f = (float)x;
+    v.u += 0x7FFF + ((v.u >> 16) & 1);
+    return (auxnum)(v.u >> 16);
+}
+#endif
+#endif
+
+static size_t TvRestorePartition(tvregsolver *S, char *Workspace,
+    int DeconvFlag, int DctFlag);
 static int TvRestoreChooseAlgorithm(int *UseZ, int *DeconvFlag, int *DctFlag,
     usolver *USolveFun, zsolver *ZSolveFun, const tvregopt *Opt);
+static void TvRestoreSetLambda(tvregsolver *S, num Lambda,
+    int DeconvFlag, int DctFlag);
+static num TvRestoreResidual(const tvregsolver *S, int DeconvFlag);
+static uint32_t TvRestoreHash(const tvregsolver *S,
+    const num *LambdaPath, int NumLambda, num NoiseLevel);
+static int TvRestoreSaveCheckpoint(const tvregsolver *S, uint32_t Hash,
+    int Step, int Iter, int Status);
+static int TvRestoreLoadCheckpoint(tvregsolver *S, uint32_t Hash,
+    int NumLambda, int *Step, int *Iter, int *Status);
 
 
 /* If GNU C language extensions are available, apply the "unused" attribute
@@ -166,6 +308,10 @@ int TvRestoreSimplePlot(int State, int Iter, num Delta,
     case 2: /* Maximum iterations exceeded */
         fprintf(stderr, "Maximum number of iterations exceeded.\n");
         break;
+    case 3: /* Time limit reached */
+        fprintf(stderr, "Time limit reached after %d iterations, "
+            "Delta %7.4f.\n", Iter, Delta);
+        break;
     }
     return 1;
 }
@@ -204,6 +350,8 @@ void TvRegFreeOpt(tvregopt *Opt)
 {
     if(Opt)
     {
+        if(Opt->Workspace && Opt->WorkspaceOwned)
+            WorkspaceFree(Opt->Workspace);
         if(Opt->AlgString)
             Free(Opt->AlgString);
         Free(Opt);
@@ -394,7 +542,9 @@ int TvRegSetNoiseModel(tvregopt *Opt, const char *NoiseModel)
         return 1;
     }
 @endcode
- * The State argument is either 0, 1, or 2, and indicates TvRestore's status.
+ * The State argument is 0 while running, and when a solve finishes, 1 if it
+ * converged, 2 if the maximum number of iterations was exceeded, or 3 if it
+ * was stopped by the time limit (see TvRegSetTimeLimit()).
  * Iter is the number of Bregman iterations completed, Delta is the change in
  * the solution Delta = ||u^cur - u^prev||_2 / ||f||_2.  Argument u gives a 
  * pointer to the current solution, which can be used to plot an animated  
@@ -413,6 +563,131 @@ void TvRegSetPlotFun(tvregopt *Opt,
 }
 
 
+/**
+ * @brief Specify a checkpoint file for resuming interrupted computations
+ * @param Opt tvregopt options object
+ * @param CheckpointFile file name, or NULL to disable checkpointing
+ * @param CheckpointInterval number of iterations between checkpoints
+ * 
+ * With a checkpoint file set, TvRestore saves the solver state (u, d,
+ * dtilde, and z, ztilde if used) to CheckpointFile every CheckpointInterval
+ * Bregman iterations.  The state is written to CheckpointFile.tmp and then
+ * renamed, so that the file always holds a complete checkpoint.  
+ * 
+ * When TvRestore starts and CheckpointFile exists, it resumes from the
+ * saved state if the checkpoint is for the same problem: the same image
+ * dimensions, num type, algorithm, and a matching hash of f, lambda, the
+ * kernel, and the other options.  Otherwise the file is ignored with a 
+ * warning.  A resumed run continues exactly as the interrupted run would
+ * have.  The file is deleted when TvRestore completes.  
+ * 
+ * The file is in the machine's native byte order and is meant for resuming
+ * on the same system, for example after a batch job is preempted.  At most
+ * CheckpointInterval iterations are lost per interruption.  If 
+ * CheckpointInterval <= 0, an existing checkpoint is resumed but no new
+ * checkpoints are written.
+ */
+void TvRegSetCheckpoint(tvregopt *Opt, 
+    const char *CheckpointFile, int CheckpointInterval)
+{
+    if(Opt)
+    {
+        Opt->CheckpointFile = CheckpointFile;
+        Opt->CheckpointInterval = CheckpointInterval;
+    }
+}
+
+
+/**
+ * @brief Specify a wall-clock time limit
+ * @param Opt tvregopt options object
+ * @param TimeLimit time limit in milliseconds, or 0 for no limit
+ * 
+ * With a time limit, TvRestore runs as many Bregman iterations as fit within
+ * TimeLimit milliseconds, measured from the start of the call, and returns
+ * the last iterate.  The clock is checked between iterations, so the limit
+ * may be exceeded by about one iteration (plus the setup time, which for
+ * deconvolution includes planning the transforms).  A solve stopped by the
+ * time limit makes TvRestore return 3, and PlotFun is called with State = 3
+ * and the Delta of the last iteration, the achieved change in the solution.
+ * For a lambda path, the limit applies to the whole path and the path stops
+ * at the lambda being solved.
+ * 
+ * If a checkpoint file is set (see TvRegSetCheckpoint()), the state is saved
+ * when the time limit is reached instead of the file being deleted, so that
+ * a later call continues the computation.
+ */
+void TvRegSetTimeLimit(tvregopt *Opt, unsigned long TimeLimit)
+{
+    if(Opt)
+        Opt->TimeLimit = TimeLimit;
+}
+
+
+/**
+ * @brief Specify a caller-provided workspace
+ * @param Opt tvregopt options object
+ * @param Workspace workspace, or NULL to let TvRestore allocate it
+ * @param WorkspaceSize size of Workspace in bytes
+ * 
+ * TvRestore needs a workspace for the auxiliary variables of the split
+ * Bregman method (and for deconvolution, the DFT buffers) several times the
+ * size of the image.  By default, the workspace is allocated and freed on
+ * each call, or kept in Opt if TvRegSetWorkspaceCache() is enabled.
+ * 
+ * Alternatively, the caller may provide the workspace, with at least
+ * TvRestoreWorkspaceSize() bytes.  TvRestore fails if it is too small.  The
+ * contents on entry do not matter and are overwritten.  For deconvolution,
+ * it should be allocated with fftw_malloc() (fftwf_malloc() if NUM_SINGLE)
+ * for aligned DFT buffers.  The FFTW plans still allocate internally.  Calls
+ * running at the same time must not share a workspace, so they should not
+ * share an Opt with a workspace set.
+ */
+void TvRegSetWorkspace(tvregopt *Opt, void *Workspace, size_t WorkspaceSize)
+{
+    if(Opt)
+    {
+        if(Opt->Workspace && Opt->WorkspaceOwned)
+            WorkspaceFree(Opt->Workspace);
+        
+        Opt->Workspace = Workspace;
+        Opt->WorkspaceSize = (Workspace) ? WorkspaceSize : 0;
+        Opt->WorkspaceOwned = 0;
+    }
+}
+
+
+/**
+ * @brief Keep the workspace allocated by TvRestore in Opt between calls
+ * @param Opt tvregopt options object
+ * @param WorkspaceCache nonzero to keep the workspace, zero (default) to
+ *        allocate it on each call
+ * 
+ * With caching, the workspace is allocated on the first call and kept in
+ * Opt, so that later calls with the same Opt and images of the same or
+ * smaller size reuse it without allocating.  It is grown if a call needs
+ * more, and freed by TvRegFreeOpt() or by disabling caching.  Since
+ * TvRestore then writes to Opt, an Opt with caching must not be used by
+ * calls running at the same time.  Without caching, TvRestore only reads
+ * Opt.  A workspace set with TvRegSetWorkspace() is used instead if set.
+ */
+void TvRegSetWorkspaceCache(tvregopt *Opt, int WorkspaceCache)
+{
+    if(Opt)
+    {
+        if(!WorkspaceCache && Opt->Workspace && Opt->WorkspaceOwned)
+        {
+            WorkspaceFree(Opt->Workspace);
+            Opt->Workspace = NULL;
+            Opt->WorkspaceSize = 0;
+            Opt->WorkspaceOwned = 0;
+        }
+        
+        Opt->WorkspaceCache = WorkspaceCache;
+    }
+}
+
+
 /** 
  * @brief Debugging function that prints the current options 
  * @param Opt tvregopt options object
@@ -468,6 +743,21 @@ void TvRegPrintOpt(const tvregopt *Opt)
     else
         printf("custom\n");
     
+    printf("checkpoint: ");
+
+    if(!Opt->CheckpointFile)
+        printf("none\n");
+    else
+        printf("%s (every %d iterations)\n", 
+            Opt->CheckpointFile, Opt->CheckpointInterval);
+
+    printf("time limit: ");
+
+    if(!Opt->TimeLimit)
+        printf("none\n");
+    else
+        printf("%lu ms\n", Opt->TimeLimit);
+
     printf("algorithm : %s\n", TvRegGetAlgorithm(Opt));
 }
 